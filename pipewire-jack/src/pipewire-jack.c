@@ -54,6 +54,8 @@
 #include "pipewire/extensions/metadata.h"
 #include "pipewire-jack-extensions.h"
 
+#include "mix-ops.h"
+
 #define JACK_DEFAULT_VIDEO_TYPE	"32 bit float RGBA video"
 
 /* use 512KB stack per thread - the default is way too high to be feasible
@@ -70,7 +72,7 @@
 #define MAX_MIX				1024
 #define MAX_BUFFER_FRAMES		8192
 
-#define MAX_ALIGN			16
+#define MAX_ALIGN			MIX_OPS_MAX_ALIGN
 #define MAX_BUFFERS			2
 #define MAX_BUFFER_DATAS		1u
 
@@ -98,6 +100,7 @@ struct globals {
 	pthread_mutex_t lock;
 	struct pw_array descriptions;
 	struct spa_list free_objects;
+	struct mix_ops mix;		/* F32 mixing of the input port peers */
 };
 
 static struct globals globals;
@@ -106,9 +109,6 @@ static bool mlock_warned = false;
 #define OBJECT_CHUNK		8
 #define RECYCLE_THRESHOLD	128
 
-typedef void (*mix_func) (float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples);
-
-static mix_func mix_function;
 
 struct object {
 	struct spa_list link;
@@ -157,6 +157,22 @@ struct object {
 			struct spa_latency_info latency[2];
 		} port;
 	};
+	/* entries in the name tables of the context, nodes only use the
+	 * first entry, ports have their name, aliases and system name */
+#define NAME_Main	0
+#define NAME_Alias1	1
+#define NAME_Alias2	2
+#define NAME_System	3
+#define MAX_NAMES	4
+	struct name_entry {
+		struct name_entry *next;
+		struct object *object;
+		uint32_t hash;
+		uint32_t kind;
+		bool indexed;
+	} names[MAX_NAMES];
+	uint32_t order;			/* for lookups, first added wins */
+
 	struct pw_proxy *proxy;
 	struct spa_hook proxy_listener;
 	struct spa_hook object_listener;
@@ -164,6 +180,17 @@ struct object {
 	unsigned int removed:1;
 };
 
+struct name_table {
+	struct name_entry **buckets;
+	uint32_t size;
+	uint32_t count;
+};
+
+struct regex_cache {
+	char *pattern;
+	regex_t regex;
+};
+
 struct midi_buffer {
 #define MIDI_BUFFER_MAGIC 0x900df00d
 	uint32_t magic;
@@ -266,6 +293,19 @@ struct context {
 	pthread_mutex_t lock;		/* protects map and lists below, in addition to thread_lock */
 	struct spa_list objects;
 	uint32_t free_count;
+	uint32_t order;
+
+	struct name_table node_names;
+	struct name_table port_names;
+
+	/* the ports for jack_get_ports(), sorted, rebuilt when ports change
+	 * or when the default sink or source changes */
+	struct pw_array sorted_ports;
+	char sorted_sink[1024];
+	char sorted_source[1024];
+	bool sorted_valid;
+	struct regex_cache port_regex;
+	struct regex_cache type_regex;
 };
 
 #define GET_DIRECTION(f)	((f) & JackPortIsInput ? SPA_DIRECTION_INPUT : SPA_DIRECTION_OUTPUT)
@@ -437,6 +477,7 @@ static struct object * alloc_object(struct client *c, int type)
 	o->client = c;
 	o->removed = false;
 	o->type = type;
+	o->order = c->context.order++;
 	pw_log_debug("%p: object:%p type:%d", c, o, type);
 
 	return o;
@@ -460,6 +501,170 @@ static void recycle_objects(struct client *c, uint32_t remain)
 	pthread_mutex_unlock(&globals.lock);
 }
 
+static uint32_t name_hash(const char *name)
+{
+	uint32_t h = 2166136261u;
+	while (*name) {
+		h ^= (uint8_t)*name++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static const char *entry_name(const struct name_entry *e)
+{
+	const struct object *o = e->object;
+
+	if (o->type == INTERFACE_Node)
+		return o->node.name;
+
+	switch (e->kind) {
+	case NAME_Alias1:
+		return o->port.alias1;
+	case NAME_Alias2:
+		return o->port.alias2;
+	case NAME_System:
+		return o->port.system;
+	default:
+		return o->port.name;
+	}
+}
+
+static int name_table_grow(struct name_table *t)
+{
+	uint32_t i, size = t->size ? t->size * 2 : 256;
+	struct name_entry **buckets, *e, *n;
+
+	if ((buckets = calloc(size, sizeof(struct name_entry *))) == NULL)
+		return -errno;
+
+	for (i = 0; i < t->size; i++) {
+		for (e = t->buckets[i]; e; e = n) {
+			n = e->next;
+			e->next = buckets[e->hash & (size - 1)];
+			buckets[e->hash & (size - 1)] = e;
+		}
+	}
+	free(t->buckets);
+	t->buckets = buckets;
+	t->size = size;
+	return 0;
+}
+
+static void name_table_add(struct name_table *t, struct name_entry *e, const char *name)
+{
+	struct name_entry **b;
+
+	if (t->count >= t->size && name_table_grow(t) < 0 && t->size == 0) {
+		pw_log_warn("can't index name %s: %m", name);
+		return;
+	}
+	e->hash = name_hash(name);
+	b = &t->buckets[e->hash & (t->size - 1)];
+	e->next = *b;
+	*b = e;
+	e->indexed = true;
+	t->count++;
+}
+
+static void name_table_remove(struct name_table *t, struct name_entry *e)
+{
+	struct name_entry **p;
+
+	if (!e->indexed)
+		return;
+
+	for (p = &t->buckets[e->hash & (t->size - 1)]; *p; p = &(*p)->next) {
+		if (*p == e) {
+			*p = e->next;
+			break;
+		}
+	}
+	e->indexed = false;
+	t->count--;
+}
+
+static void name_table_clear(struct name_table *t)
+{
+	free(t->buckets);
+	spa_zero(*t);
+}
+
+static struct name_table *object_names(struct client *c, struct object *o)
+{
+	return o->type == INTERFACE_Node ?
+		&c->context.node_names : &c->context.port_names;
+}
+
+/* call with the context lock */
+static void unindex_object(struct client *c, struct object *o)
+{
+	uint32_t i;
+
+	if (o->type == INTERFACE_Link)
+		return;
+
+	for (i = 0; i < MAX_NAMES; i++)
+		name_table_remove(object_names(c, o), &o->names[i]);
+
+	/* the port order depends on the node name and priority as well */
+	c->context.sorted_valid = false;
+}
+
+/* call with the context lock after the names of the object changed */
+static void index_object(struct client *c, struct object *o)
+{
+	uint32_t i, n_names;
+
+	unindex_object(c, o);
+
+	if (o->removed || o->type == INTERFACE_Link)
+		return;
+
+	n_names = o->type == INTERFACE_Node ? 1 : MAX_NAMES;
+	for (i = 0; i < n_names; i++) {
+		struct name_entry *e = &o->names[i];
+		const char *name;
+
+		e->object = o;
+		e->kind = i;
+		name = entry_name(e);
+		if (name[0] != '\0')
+			name_table_add(object_names(c, o), e, name);
+	}
+}
+
+static regex_t *regex_cache_get(struct regex_cache *rc, const char *pattern)
+{
+	int r;
+
+	if (rc->pattern != NULL) {
+		if (spa_streq(rc->pattern, pattern))
+			return &rc->regex;
+		regfree(&rc->regex);
+		free(rc->pattern);
+		rc->pattern = NULL;
+	}
+	if ((r = regcomp(&rc->regex, pattern, REG_EXTENDED | REG_NOSUB)) != 0) {
+		pw_log_error("cant compile regex %s: %d", pattern, r);
+		return NULL;
+	}
+	if ((rc->pattern = strdup(pattern)) == NULL) {
+		regfree(&rc->regex);
+		return NULL;
+	}
+	return &rc->regex;
+}
+
+static void regex_cache_clear(struct regex_cache *rc)
+{
+	if (rc->pattern != NULL) {
+		regfree(&rc->regex);
+		free(rc->pattern);
+		rc->pattern = NULL;
+	}
+}
+
 /* JACK clients expect the objects to hang around after
  * they are unregistered and freed. We mark the object removed and
  * move it to the end of the queue. */
@@ -467,6 +672,7 @@ static void free_object(struct client *c, struct object *o)
 {
 	pw_log_debug("%p: object:%p type:%d", c, o, o->type);
 	pthread_mutex_lock(&c->context.lock);
+	unindex_object(c, o);
 	spa_list_remove(&o->link);
 	o->removed = true;
 	o->id = SPA_ID_INVALID;
@@ -625,15 +831,26 @@ static void free_port(struct client *c, struct port *p)
 
 static struct object *find_node(struct client *c, const char *name)
 {
-	struct object *o;
+	struct name_table *t = &c->context.node_names;
+	struct object *o, *found = NULL;
+	struct name_entry *e;
+	uint32_t hash;
 
-	spa_list_for_each(o, &c->context.objects, link) {
-		if (o->removing || o->removed || o->type != INTERFACE_Node)
+	if (t->size == 0)
+		return NULL;
+
+	hash = name_hash(name);
+	for (e = t->buckets[hash & (t->size - 1)]; e; e = e->next) {
+		o = e->object;
+		if (e->hash != hash || o->removing || o->removed ||
+		    o->type != INTERFACE_Node)
 			continue;
-		if (spa_streq(o->node.name, name))
-			return o;
+		if (!spa_streq(o->node.name, name))
+			continue;
+		if (found == NULL || o->order < found->order)
+			found = o;
 	}
-	return NULL;
+	return found;
 }
 
 static bool is_port_default(struct client *c, struct object *o)
@@ -653,19 +870,27 @@ static bool is_port_default(struct client *c, struct object *o)
 
 static struct object *find_port_by_name(struct client *c, const char *name)
 {
-	struct object *o;
+	struct name_table *t = &c->context.port_names;
+	struct object *o, *found = NULL;
+	struct name_entry *e;
+	uint32_t hash;
 
-	spa_list_for_each(o, &c->context.objects, link) {
-		if (o->type != INTERFACE_Port || o->removed)
+	if (t->size == 0)
+		return NULL;
+
+	hash = name_hash(name);
+	for (e = t->buckets[hash & (t->size - 1)]; e; e = e->next) {
+		o = e->object;
+		if (e->hash != hash || o->removed || o->type != INTERFACE_Port)
 			continue;
-		if (spa_streq(o->port.name, name) ||
-		    spa_streq(o->port.alias1, name) ||
-		    spa_streq(o->port.alias2, name))
-			return o;
-		if (is_port_default(c, o) && spa_streq(o->port.system, name))
-			return o;
+		if (!spa_streq(entry_name(e), name))
+			continue;
+		if (e->kind == NAME_System && !is_port_default(c, o))
+			continue;
+		if (found == NULL || o->order < found->order)
+			found = o;
 	}
-	return NULL;
+	return found;
 }
 
 static struct object *find_by_id(struct client *c, uint32_t id)
@@ -734,44 +959,6 @@ static struct buffer *dequeue_buffer(struct client *c, struct mix *mix)
 	return b;
 }
 
-#if defined (__SSE__)
-#include <xmmintrin.h>
-static void mix_sse(float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples)
-{
-	uint32_t i, n, unrolled;
-	__m128 in[1];
-
-	if (SPA_IS_ALIGNED(dst, 16) && aligned)
-		unrolled = n_samples & ~3;
-	else
-		unrolled = 0;
-
-	for (n = 0; n < unrolled; n += 4) {
-		in[0] = _mm_load_ps(&src[0][n]);
-		for (i = 1; i < n_src; i++)
-			in[0] = _mm_add_ps(in[0], _mm_load_ps(&src[i][n]));
-		_mm_store_ps(&dst[n], in[0]);
-	}
-	for (; n < n_samples; n++) {
-		in[0] = _mm_load_ss(&src[0][n]);
-		for (i = 1; i < n_src; i++)
-			in[0] = _mm_add_ss(in[0], _mm_load_ss(&src[i][n]));
-		_mm_store_ss(&dst[n], in[0]);
-	}
-}
-#endif
-
-static void mix_c(float *dst, float *src[], uint32_t n_src, bool aligned, uint32_t n_samples)
-{
-	uint32_t n, i;
-	for (n = 0; n < n_samples; n++)  {
-		float t = src[0][n];
-		for (i = 1; i < n_src; i++)
-			t += src[i][n];
-		dst[n] = t;
-	}
-}
-
 SPA_EXPORT
 void jack_get_version(int *major_ptr, int *minor_ptr, int *micro_ptr, int *proto_ptr)
 {
@@ -2852,6 +3039,7 @@ static void registry_event_global(void *data, uint32_t id,
 
 		pthread_mutex_lock(&c->context.lock);
 		spa_list_append(&c->context.objects, &o->link);
+		index_object(c, o);
 		pthread_mutex_unlock(&c->context.lock);
 	}
 	else if (spa_streq(type, PW_TYPE_INTERFACE_Port)) {
@@ -2980,6 +3168,10 @@ static void registry_event_global(void *data, uint32_t id,
 		o->port.node_id = node_id;
 		o->port.is_monitor = is_monitor;
 
+		pthread_mutex_lock(&c->context.lock);
+		index_object(c, o);
+		pthread_mutex_unlock(&c->context.lock);
+
 		pw_log_debug("%p: %p add port %d name:%s %d", c, o, id,
 				o->port.name, type_id);
 	}
@@ -3229,6 +3421,7 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	pthread_mutex_init(&client->context.lock, NULL);
 	spa_list_init(&client->context.objects);
+	pw_array_init(&client->context.sorted_ports, sizeof(void*) * 64);
 
 	client->node_id = SPA_ID_INVALID;
 
@@ -3283,14 +3476,18 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	support = pw_context_get_support(client->context.context, &n_support);
 
-	mix_function = mix_c;
 	cpu_iface = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
-	if (cpu_iface) {
-#if defined (__SSE__)
-		uint32_t flags = spa_cpu_get_flags(cpu_iface);
-		if (flags & SPA_CPU_FLAG_SSE)
-			mix_function = mix_sse;
-#endif
+	if (globals.mix.process == NULL) {
+		/* shared by all clients, other clients might be mixing already */
+		struct mix_ops mix = {
+			.fmt = SPA_AUDIO_FORMAT_F32,
+			.n_channels = 1,
+			.cpu_flags = cpu_iface ? spa_cpu_get_flags(cpu_iface) : 0,
+		};
+		if (mix_ops_init(&mix) < 0)
+			goto no_props;
+		pw_log_debug("%p: mix ops cpu flags:%08x", client, mix.cpu_flags);
+		globals.mix = mix;
 	}
 	client->context.old_thread_utils =
 		pw_context_get_object(client->context.context,
@@ -3525,6 +3722,12 @@ int jack_client_close (jack_client_t *client)
 	pw_map_clear(&c->ports[SPA_DIRECTION_INPUT]);
 	pw_map_clear(&c->ports[SPA_DIRECTION_OUTPUT]);
 
+	name_table_clear(&c->context.node_names);
+	name_table_clear(&c->context.port_names);
+	pw_array_clear(&c->context.sorted_ports);
+	regex_cache_clear(&c->context.port_regex);
+	regex_cache_clear(&c->context.type_regex);
+
 	pthread_mutex_destroy(&c->context.lock);
 	pthread_mutex_destroy(&c->rt_lock);
 	pw_properties_free(c->props);
@@ -4335,6 +4538,10 @@ jack_port_t * jack_port_register (jack_client_t *client,
 
 	pw_thread_loop_lock(c->context.loop);
 
+	pthread_mutex_lock(&c->context.lock);
+	index_object(c, o);
+	pthread_mutex_unlock(&c->context.lock);
+
 	pw_client_node_port_update(c->node,
 					 direction,
 					 p->port_id,
@@ -4419,9 +4626,8 @@ static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 	struct mix *mix;
 	struct buffer *b;
 	void *ptr = NULL;
-	float *mix_ptr[MAX_MIX], *np;
+	const void *mix_ptr[MAX_MIX];
 	uint32_t n_ptr = 0;
-	bool ptr_aligned = true;
 
 	spa_list_for_each(mix, &p->mix, port_link) {
 		struct spa_data *d;
@@ -4439,19 +4645,16 @@ static void *get_buffer_input_float(struct port *p, jack_nframes_t frames)
 		if (size / sizeof(float) < frames)
 			continue;
 
-		np = SPA_PTROFF(d->data, offset, float);
-		if (!SPA_IS_ALIGNED(np, 16))
-			ptr_aligned = false;
-
-		mix_ptr[n_ptr++] = np;
+		mix_ptr[n_ptr++] = SPA_PTROFF(d->data, offset, void);
 		if (n_ptr == MAX_MIX)
 			break;
 	}
 	if (n_ptr == 1) {
-		ptr = mix_ptr[0];
+		/* a single peer, use its buffer directly */
+		ptr = (void*)mix_ptr[0];
 	} else if (n_ptr > 1) {
 		ptr = p->emptyptr;
-		mix_function(ptr, mix_ptr, n_ptr, ptr_aligned, frames);
+		mix_ops_process(&globals.mix, ptr, mix_ptr, n_ptr, frames);
 		p->zeroed = false;
 	}
 	if (ptr == NULL)
@@ -4806,7 +5009,11 @@ int jack_port_rename (jack_client_t* client, jack_port_t *port, const char *port
 	}
 
 	pw_properties_set(p->props, PW_KEY_PORT_NAME, port_name);
+
+	pthread_mutex_lock(&c->context.lock);
 	snprintf(o->port.name, sizeof(o->port.name), "%s:%s", c->name, port_name);
+	index_object(c, o);
+	pthread_mutex_unlock(&c->context.lock);
 
 	p->info.change_mask |= SPA_PORT_CHANGE_MASK_PROPS;
 	p->info.props = &p->props->dict;
@@ -4862,6 +5069,10 @@ int jack_port_set_alias (jack_port_t *port, const char *alias)
 		goto done;
 	}
 
+	pthread_mutex_lock(&c->context.lock);
+	index_object(c, o);
+	pthread_mutex_unlock(&c->context.lock);
+
 	pw_properties_set(p->props, key, alias);
 
 	p->info.change_mask |= SPA_PORT_CHANGE_MASK_PROPS;
@@ -5473,6 +5684,44 @@ static int port_compare_func(const void *v1, const void *v2)
 	return res;
 }
 
+static const char *default_node_name(struct client *c, bool source)
+{
+	if (c->metadata == NULL)
+		return "";
+	return source ? c->metadata->default_audio_source :
+		c->metadata->default_audio_sink;
+}
+
+/* call with the context lock. The sort order depends on the default sink
+ * and source so we also need to resort when they change. */
+static void update_sorted_ports(struct client *c)
+{
+	struct pw_array *sorted = &c->context.sorted_ports;
+	const char *sink = default_node_name(c, false);
+	const char *source = default_node_name(c, true);
+	struct object *o;
+
+	if (c->context.sorted_valid &&
+	    spa_streq(c->context.sorted_sink, sink) &&
+	    spa_streq(c->context.sorted_source, source))
+		return;
+
+	pw_array_reset(sorted);
+	spa_list_for_each(o, &c->context.objects, link) {
+		if (o->type != INTERFACE_Port || o->removed)
+			continue;
+		if (o->port.type_id > TYPE_ID_VIDEO)
+			continue;
+		pw_array_add_ptr(sorted, o);
+	}
+	qsort(sorted->data, pw_array_get_len(sorted, struct object *),
+			sizeof(struct object *), port_compare_func);
+
+	snprintf(c->context.sorted_sink, sizeof(c->context.sorted_sink), "%s", sink);
+	snprintf(c->context.sorted_source, sizeof(c->context.sorted_source), "%s", source);
+	c->context.sorted_valid = true;
+}
+
 SPA_EXPORT
 const char ** jack_get_ports (jack_client_t *client,
                               const char *port_name_pattern,
@@ -5481,12 +5730,11 @@ const char ** jack_get_ports (jack_client_t *client,
 {
 	struct client *c = (struct client *) client;
 	const char **res;
-	struct object *o;
+	struct object *o, **op;
 	struct pw_array tmp;
 	const char *str;
-	uint32_t i, count, id;
-	int r;
-	regex_t port_regex, type_regex;
+	uint32_t count, id;
+	regex_t *port_regex = NULL, *type_regex = NULL;
 
 	spa_return_val_if_fail(c != NULL, NULL);
 
@@ -5495,76 +5743,68 @@ const char ** jack_get_ports (jack_client_t *client,
 	else
 		id = SPA_ID_INVALID;
 
+	pw_log_debug("%p: ports id:%d name:\"%s\" type:\"%s\" flags:%08lx", c, id,
+			port_name_pattern, type_name_pattern, flags);
+
+	pthread_mutex_lock(&c->context.lock);
 	if (port_name_pattern && port_name_pattern[0]) {
-		if ((r = regcomp(&port_regex, port_name_pattern, REG_EXTENDED | REG_NOSUB)) != 0) {
-			pw_log_error("cant compile regex %s: %d", port_name_pattern, r);
-			return NULL;
-		}
+		port_regex = regex_cache_get(&c->context.port_regex, port_name_pattern);
+		if (port_regex == NULL)
+			goto error;
 	}
 	if (type_name_pattern && type_name_pattern[0]) {
-		if ((r = regcomp(&type_regex, type_name_pattern, REG_EXTENDED | REG_NOSUB)) != 0) {
-			pw_log_error("cant compile regex %s: %d", type_name_pattern, r);
-			return NULL;
-		}
+		type_regex = regex_cache_get(&c->context.type_regex, type_name_pattern);
+		if (type_regex == NULL)
+			goto error;
 	}
 
-	pw_log_debug("%p: ports id:%d name:\"%s\" type:\"%s\" flags:%08lx", c, id,
-			port_name_pattern, type_name_pattern, flags);
+	update_sorted_ports(c);
 
-	pthread_mutex_lock(&c->context.lock);
 	pw_array_init(&tmp, sizeof(void*) * 32);
 	count = 0;
 
-	spa_list_for_each(o, &c->context.objects, link) {
-		if (o->type != INTERFACE_Port || o->removed)
-			continue;
+	pw_array_for_each(op, &c->context.sorted_ports) {
+		o = *op;
 		pw_log_debug("%p: check port type:%d flags:%08lx name:\"%s\"", c,
 				o->port.type_id, o->port.flags, o->port.name);
-		if (o->port.type_id > TYPE_ID_VIDEO)
-			continue;
 		if (!SPA_FLAG_IS_SET(o->port.flags, flags))
 			continue;
 		if (id != SPA_ID_INVALID && o->port.node_id != id)
 			continue;
 
-		if (port_name_pattern && port_name_pattern[0]) {
+		if (port_regex) {
 			bool match;
-			match = regexec(&port_regex, o->port.name, 0, NULL, 0) == 0;
+			match = regexec(port_regex, o->port.name, 0, NULL, 0) == 0;
 			if (!match && is_port_default(c, o))
-				match = regexec(&port_regex, o->port.system, 0, NULL, 0) == 0;
+				match = regexec(port_regex, o->port.system, 0, NULL, 0) == 0;
 			if (!match)
 				continue;
 		}
-		if (type_name_pattern && type_name_pattern[0]) {
-			if (regexec(&type_regex, type_to_string(o->port.type_id),
+		if (type_regex) {
+			if (regexec(type_regex, type_to_string(o->port.type_id),
 						0, NULL, 0) == REG_NOMATCH)
 				continue;
 		}
 		pw_log_debug("%p: port \"%s\" prio:%d matches (%d)",
 				c, o->port.name, o->port.priority, count);
 
-		pw_array_add_ptr(&tmp, o);
+		pw_array_add_ptr(&tmp, (void*)port_name(o));
 		count++;
 	}
 	pthread_mutex_unlock(&c->context.lock);
 
 	if (count > 0) {
-		qsort(tmp.data, count, sizeof(struct object *), port_compare_func);
 		pw_array_add_ptr(&tmp, NULL);
 		res = tmp.data;
-		for (i = 0; i < count; i++)
-			res[i] = port_name((struct object*)res[i]);
 	} else {
 		pw_array_clear(&tmp);
 		res = NULL;
 	}
-
-	if (port_name_pattern && port_name_pattern[0])
-		regfree(&port_regex);
-	if (type_name_pattern && type_name_pattern[0])
-		regfree(&type_regex);
-
 	return res;
+
+error:
+	pthread_mutex_unlock(&c->context.lock);
+	return NULL;
 }
 
 SPA_EXPORT
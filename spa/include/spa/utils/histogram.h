@@ -0,0 +1,112 @@
+/* Simple Plugin API
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SPA_UTILS_HISTOGRAM_H
+#define SPA_UTILS_HISTOGRAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/utils/defs.h>
+
+/**
+ * \defgroup spa_histogram Histogram
+ * Histogram of times
+ */
+
+/**
+ * \addtogroup spa_histogram
+ * \{
+ */
+
+#define SPA_HISTOGRAM_BUCKETS	128u
+
+/** A histogram of times in nanoseconds.
+ *
+ * The buckets are logarithmic with 4 buckets for each power of 2, which
+ * gives a resolution of 25% and covers times up to 8 seconds. */
+struct spa_histogram {
+	uint64_t count;			/**< number of values */
+	uint64_t max;			/**< largest value */
+	uint32_t buckets[SPA_HISTOGRAM_BUCKETS];
+};
+
+static inline uint32_t spa_histogram_index(uint64_t val)
+{
+	uint32_t log;
+
+	if (val < 4)
+		return val;
+	log = 63 - __builtin_clzll(val);
+	return SPA_MIN(((log - 1) << 2) | ((val >> (log - 2)) & 3),
+			SPA_HISTOGRAM_BUCKETS - 1);
+}
+
+/** the largest value that goes into the bucket at \a index */
+static inline uint64_t spa_histogram_value(uint32_t index)
+{
+	uint32_t shift;
+
+	if (index < 4)
+		return index;
+	shift = (index >> 2) - 1;
+	return ((uint64_t)(4 | (index & 3)) << shift) + (1ull << shift) - 1;
+}
+
+static inline void spa_histogram_add(struct spa_histogram *h, uint64_t val)
+{
+	h->buckets[spa_histogram_index(val)]++;
+	h->max = SPA_MAX(h->max, val);
+	h->count++;
+}
+
+/** Get an upper bound of the value below which \a p (0.0 to 1.0) of the
+ * values fall */
+static inline uint64_t spa_histogram_percentile(const struct spa_histogram *h, double p)
+{
+	uint64_t target, total = 0;
+	uint32_t i;
+
+	if (h->count == 0)
+		return 0;
+
+	target = SPA_CLAMP((uint64_t)(p * h->count + 0.5), 1u, h->count);
+	for (i = 0; i < SPA_HISTOGRAM_BUCKETS; i++) {
+		total += h->buckets[i];
+		if (total >= target)
+			return SPA_MIN(spa_histogram_value(i), h->max);
+	}
+	return h->max;
+}
+
+/**
+ * \}
+ */
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* SPA_UTILS_HISTOGRAM_H */
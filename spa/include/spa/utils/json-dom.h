@@ -0,0 +1,395 @@
+/* Simple Plugin API
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SPA_UTILS_JSON_DOM_H
+#define SPA_UTILS_JSON_DOM_H
+
+#ifdef __cplusplus
+extern "C" {
+#else
+#include <stdbool.h>
+#endif
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/json.h>
+
+/**
+ * \addtogroup spa_json
+ * \{
+ */
+
+/* A parsed JSON document. The text is tokenized once into an array of
+ * nodes that refer to the values with an offset and length in the
+ * (unmodified) source, so values don't need to be NUL terminated and can
+ * be handed to the spa_json_parse_*() functions directly. Object keys are
+ * unescaped once and interned so that lookups compare offsets.
+ *
+ * The nodes are stored depth-first, the first child of a container
+ * follows the container, the other children are linked with next. */
+
+enum spa_json_dom_type {
+	SPA_JSON_DOM_NULL,
+	SPA_JSON_DOM_BOOL,
+	SPA_JSON_DOM_NUMBER,
+	SPA_JSON_DOM_STRING,
+	SPA_JSON_DOM_BARE,		/**< an unquoted string */
+	SPA_JSON_DOM_ARRAY,
+	SPA_JSON_DOM_OBJECT,
+};
+
+struct spa_json_node {
+	uint32_t type;			/**< enum spa_json_dom_type */
+	uint32_t key;			/**< offset of the key in the key arena or
+					  *  SPA_IDX_INVALID when not in an object */
+	uint32_t offset;		/**< offset of the value in the source */
+	uint32_t len;			/**< length of the value, including the
+					  *  brackets for containers */
+	uint32_t next;			/**< index of the next sibling or 0 */
+	uint32_t n_children;
+};
+
+struct spa_json_dom {
+	const char *data;
+	size_t size;
+
+	struct spa_json_node *nodes;
+	uint32_t n_nodes;
+	uint32_t max_nodes;
+
+	char *keys;			/**< unescaped, NUL terminated keys */
+	uint32_t keys_len;
+	uint32_t keys_max;
+
+	uint32_t *key_index;		/**< hash table of key offsets + 1 */
+	uint32_t key_index_size;
+	uint32_t n_keys;
+};
+
+#define SPA_JSON_DOM_MAX_DEPTH	256
+
+static inline int spa_json_dom_grow(void **data, uint32_t *max, uint32_t need, size_t elem)
+{
+	uint32_t size = *max;
+	void *d;
+
+	if (need <= size)
+		return 0;
+	while (size < need)
+		size = size ? size * 2 : 64;
+	if ((d = realloc(*data, size * elem)) == NULL)
+		return -errno;
+	*data = d;
+	*max = size;
+	return 0;
+}
+
+static inline uint32_t spa_json_dom_hash(const char *key)
+{
+	uint32_t h = 2166136261u;
+	while (*key) {
+		h ^= (uint8_t)*key++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static inline uint32_t *spa_json_dom_key_slot(const struct spa_json_dom *dom, const char *key)
+{
+	uint32_t mask = dom->key_index_size - 1;
+	uint32_t i = spa_json_dom_hash(key) & mask;
+
+	while (true) {
+		uint32_t *slot = &dom->key_index[i];
+		if (*slot == 0 || strcmp(dom->keys + *slot - 1, key) == 0)
+			return slot;
+		i = (i + 1) & mask;
+	}
+}
+
+static inline int spa_json_dom_grow_index(struct spa_json_dom *dom)
+{
+	uint32_t i, size, *index, *old = dom->key_index, old_size = dom->key_index_size;
+
+	if ((dom->n_keys + 1) * 2 <= dom->key_index_size)
+		return 0;
+
+	size = old_size ? old_size * 2 : 64;
+	if ((index = (uint32_t*)calloc(size, sizeof(uint32_t))) == NULL)
+		return -errno;
+
+	dom->key_index = index;
+	dom->key_index_size = size;
+	for (i = 0; i < old_size; i++) {
+		if (old[i] != 0)
+			*spa_json_dom_key_slot(dom, dom->keys + old[i] - 1) = old[i];
+	}
+	free(old);
+	return 0;
+}
+
+static inline int spa_json_dom_intern(struct spa_json_dom *dom, const char *val, int len,
+		uint32_t *key)
+{
+	uint32_t *slot;
+	char *k;
+	int res;
+
+	if ((res = spa_json_dom_grow((void**)&dom->keys, &dom->keys_max,
+					dom->keys_len + len + 1, sizeof(char))) < 0)
+		return res;
+	if ((res = spa_json_dom_grow_index(dom)) < 0)
+		return res;
+
+	k = dom->keys + dom->keys_len;
+	if (spa_json_parse_stringn(val, len, k, len + 1) < 0)
+		return -EINVAL;
+
+	slot = spa_json_dom_key_slot(dom, k);
+	if (*slot == 0) {
+		*slot = dom->keys_len + 1;
+		dom->keys_len += strlen(k) + 1;
+		dom->n_keys++;
+	}
+	*key = *slot - 1;
+	return 0;
+}
+
+static inline uint32_t spa_json_dom_type_of(const char *val, int len)
+{
+	if (spa_json_is_object(val, len))
+		return SPA_JSON_DOM_OBJECT;
+	if (spa_json_is_array(val, len))
+		return SPA_JSON_DOM_ARRAY;
+	if (spa_json_is_string(val, len))
+		return SPA_JSON_DOM_STRING;
+	if (spa_json_is_null(val, len))
+		return SPA_JSON_DOM_NULL;
+	if (spa_json_is_bool(val, len))
+		return SPA_JSON_DOM_BOOL;
+	if (spa_json_is_float(val, len))
+		return SPA_JSON_DOM_NUMBER;
+	return SPA_JSON_DOM_BARE;
+}
+
+static inline int spa_json_dom_add(struct spa_json_dom *dom, uint32_t type, uint32_t key,
+		const char *val, int len)
+{
+	struct spa_json_node *n;
+	int res;
+
+	if ((res = spa_json_dom_grow((void**)&dom->nodes, &dom->max_nodes,
+					dom->n_nodes + 1, sizeof(struct spa_json_node))) < 0)
+		return res;
+
+	n = &dom->nodes[dom->n_nodes];
+	n->type = type;
+	n->key = key;
+	n->offset = val - dom->data;
+	n->len = len;
+	n->next = 0;
+	n->n_children = 0;
+	return dom->n_nodes++;
+}
+
+static inline int spa_json_dom_parse_container(struct spa_json_dom *dom, struct spa_json *iter,
+		uint32_t parent, uint32_t depth)
+{
+	bool object = dom->nodes[parent].type == SPA_JSON_DOM_OBJECT;
+	uint32_t prev = 0, key = SPA_IDX_INVALID;
+	const char *val;
+	int len, res, idx;
+
+	if (depth >= SPA_JSON_DOM_MAX_DEPTH)
+		return -EINVAL;
+
+	while (true) {
+		uint32_t type;
+
+		if (object) {
+			if ((len = spa_json_next(iter, &val)) <= 0)
+				break;
+			if ((res = spa_json_dom_intern(dom, val, len, &key)) < 0)
+				return res;
+		}
+		if ((len = spa_json_next(iter, &val)) <= 0)
+			break;
+
+		type = spa_json_dom_type_of(val, len);
+		if ((idx = spa_json_dom_add(dom, type, key, val, len)) < 0)
+			return idx;
+
+		if (prev != 0)
+			dom->nodes[prev].next = idx;
+		dom->nodes[parent].n_children++;
+		prev = idx;
+
+		if (type == SPA_JSON_DOM_OBJECT || type == SPA_JSON_DOM_ARRAY) {
+			struct spa_json sub;
+
+			spa_json_enter(iter, &sub);
+			if ((res = spa_json_dom_parse_container(dom, &sub, idx, depth + 1)) < 0)
+				return res;
+			dom->nodes[idx].len = SPA_MIN(sub.cur + 1, sub.end) - val;
+		}
+	}
+	return len < 0 ? -EINVAL : 0;
+}
+
+/** Parse \a size bytes of \a data into \a dom, which should be zero
+ * initialized or cleared. \a data must stay valid while the dom is used.
+ * When the text is not an object or array, it is parsed as the members
+ * of an object, like a config file.
+ * \return 0 on success or a negative errno */
+static inline int spa_json_dom_parse(struct spa_json_dom *dom, const char *data, size_t size)
+{
+	struct spa_json it[2];
+	const char *val;
+	uint32_t type;
+	bool container;
+	int len, res;
+
+	dom->data = data;
+	dom->size = size;
+
+	spa_json_init(&it[0], data, size);
+	len = spa_json_next(&it[0], &val);
+	if ((container = spa_json_is_container(val, len))) {
+		type = spa_json_dom_type_of(val, len);
+		spa_json_enter(&it[0], &it[1]);
+	} else {
+		val = data;
+		type = SPA_JSON_DOM_OBJECT;
+		spa_json_init(&it[1], data, size);
+	}
+	if ((res = spa_json_dom_add(dom, type, SPA_IDX_INVALID, val, size)) < 0)
+		return res;
+
+	if ((res = spa_json_dom_parse_container(dom, &it[1], 0, 0)) < 0)
+		return res;
+
+	if (container)
+		dom->nodes[0].len = SPA_MIN(it[1].cur + 1, it[1].end) - val;
+
+	return 0;
+}
+
+static inline void spa_json_dom_clear(struct spa_json_dom *dom)
+{
+	free(dom->nodes);
+	free(dom->keys);
+	free(dom->key_index);
+	memset(dom, 0, sizeof(*dom));
+}
+
+static inline const struct spa_json_node *spa_json_dom_root(const struct spa_json_dom *dom)
+{
+	return dom->n_nodes > 0 ? &dom->nodes[0] : NULL;
+}
+
+static inline const struct spa_json_node *spa_json_dom_first(const struct spa_json_dom *dom,
+		const struct spa_json_node *node)
+{
+	return node->n_children > 0 ? node + 1 : NULL;
+}
+
+static inline const struct spa_json_node *spa_json_dom_next(const struct spa_json_dom *dom,
+		const struct spa_json_node *node)
+{
+	return node->next != 0 ? &dom->nodes[node->next] : NULL;
+}
+
+#define spa_json_dom_for_each(dom,parent,node)				\
+	for ((node) = spa_json_dom_first(dom, parent);			\
+	     (node) != NULL;						\
+	     (node) = spa_json_dom_next(dom, node))
+
+/** The unescaped key of a member of an object or NULL */
+static inline const char *spa_json_dom_key(const struct spa_json_dom *dom,
+		const struct spa_json_node *node)
+{
+	return node->key == SPA_IDX_INVALID ? NULL : dom->keys + node->key;
+}
+
+/** The value of \a node in the source, this is not NUL terminated */
+static inline const char *spa_json_dom_value(const struct spa_json_dom *dom,
+		const struct spa_json_node *node, int *len)
+{
+	*len = node->len;
+	return dom->data + node->offset;
+}
+
+/** Find the member \a key of \a object. When a key is used more than
+ * once, the last member is returned, like when the members would be
+ * used to update properties. */
+static inline const struct spa_json_node *spa_json_dom_lookup(const struct spa_json_dom *dom,
+		const struct spa_json_node *object, const char *key)
+{
+	const struct spa_json_node *n, *found = NULL;
+	uint32_t k;
+
+	if (object->type != SPA_JSON_DOM_OBJECT || dom->key_index_size == 0)
+		return NULL;
+	if ((k = *spa_json_dom_key_slot(dom, key)) == 0)
+		return NULL;
+	k--;
+
+	spa_json_dom_for_each(dom, object, n) {
+		if (n->key == k)
+			found = n;
+	}
+	return found;
+}
+
+/** Make \a iter iterate the contents of the container \a node */
+static inline void spa_json_dom_iter(const struct spa_json_dom *dom,
+		const struct spa_json_node *node, struct spa_json *iter)
+{
+	int len;
+	const char *val = spa_json_dom_value(dom, node, &len);
+	spa_json_init(iter, val, len);
+}
+
+/** Unescape the value of \a node into \a result of \a maxlen bytes */
+static inline int spa_json_dom_get_string(const struct spa_json_dom *dom,
+		const struct spa_json_node *node, char *result, int maxlen)
+{
+	int len;
+	const char *val = spa_json_dom_value(dom, node, &len);
+	return spa_json_parse_stringn(val, len, result, maxlen);
+}
+
+/**
+ * \}
+ */
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* SPA_UTILS_JSON_DOM_H */
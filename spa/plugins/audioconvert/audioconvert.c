@@ -30,6 +30,7 @@
 #include <spa/support/plugin.h>
 #include <spa/support/cpu.h>
 #include <spa/support/log.h>
+#include <spa/support/loop.h>
 #include <spa/utils/result.h>
 #include <spa/utils/list.h>
 #include <spa/utils/names.h>
@@ -174,12 +175,33 @@ struct dir {
 	unsigned int control:1;
 };
 
+/* ramp state, owned by the data thread */
+struct volume_ramp {
+	uint32_t pos;
+	uint32_t len;			/**< 0 when no ramp is active */
+	uint32_t n_gains;
+	uint32_t slot;			/**< final matrix to use when the ramp ends */
+	unsigned int per_sample:1;	/**< ramp the output channels, else the input channels */
+	float start[SPA_AUDIO_MAX_CHANNELS];
+	float end[SPA_AUDIO_MAX_CHANNELS];
+};
+
+/* new ramp target, handed to the data thread */
+struct volume_ramp_update {
+	uint32_t len;			/**< 0 to apply the volumes directly */
+	uint32_t n_gains;
+	uint32_t slot;
+	unsigned int per_sample:1;
+	float end[SPA_AUDIO_MAX_CHANNELS];
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_node node;
 
 	struct spa_log *log;
 	struct spa_cpu *cpu;
+	struct spa_loop *data_loop;
 
 	uint32_t cpu_flags;
 	uint32_t max_align;
@@ -209,6 +231,13 @@ struct impl {
 	struct channelmix mix;
 	struct resample resample;
 	struct volume volume;
+	uint32_t volume_ramp_samples;
+	struct volume_ramp ramp;
+	uint32_t ramp_slot;
+	uint32_t n_ramp_target;
+	float ramp_target[SPA_AUDIO_MAX_CHANNELS];
+	struct channelmix_matrix ramp_unity;	/**< matrix used while ramping */
+	struct channelmix_matrix ramp_final[2];	/**< matrix used after the ramp */
 	double rate_scale;
 
 	uint32_t in_offset;
@@ -223,6 +252,8 @@ struct impl {
 	float *scratch;
 	float *tmp[2];
 	float *tmp_datas[2][MAX_PORTS];
+	float *ramp_buf;
+	float *ramp_datas[MAX_PORTS];
 };
 
 #define CHECK_PORT(this,d,p)		((p) < this->dir[d].n_ports)
@@ -650,6 +681,33 @@ static int impl_node_enum_params(void *object, int seq,
 			spa_pod_builder_pop(&b, &f[1]);
 			param = spa_pod_builder_pop(&b, &f[0]);
 			break;
+		case 24:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_name, SPA_POD_String("volume.ramp-samples"),
+				SPA_PROP_INFO_description, SPA_POD_String("Volume ramp length in samples"),
+				SPA_PROP_INFO_type, SPA_POD_CHOICE_RANGE_Int(
+					this->volume_ramp_samples, 0, INT32_MAX),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true));
+			break;
+		case 25:
+			spa_pod_builder_push_object(&b, &f[0], SPA_TYPE_OBJECT_PropInfo, id);
+			spa_pod_builder_add(&b,
+				SPA_PROP_INFO_name, SPA_POD_String("volume.ramp-scale"),
+				SPA_PROP_INFO_description, SPA_POD_String("Volume ramp curve"),
+				SPA_PROP_INFO_type, SPA_POD_String(
+					volume_ramp_info[this->volume.ramp_scale].label),
+				SPA_PROP_INFO_params, SPA_POD_Bool(true),
+				0);
+			spa_pod_builder_prop(&b, SPA_PROP_INFO_labels, 0);
+			spa_pod_builder_push_struct(&b, &f[1]);
+			for (i = 0; i < SPA_N_ELEMENTS(volume_ramp_info); i++) {
+				spa_pod_builder_string(&b, volume_ramp_info[i].label);
+				spa_pod_builder_string(&b, volume_ramp_info[i].description);
+			}
+			spa_pod_builder_pop(&b, &f[1]);
+			param = spa_pod_builder_pop(&b, &f[0]);
+			break;
 		default:
 			return 0;
 		}
@@ -722,6 +780,10 @@ static int impl_node_enum_params(void *object, int seq,
 			spa_pod_builder_int(&b, this->dir[1].conv.noise_bits);
 			spa_pod_builder_string(&b, "dither.method");
 			spa_pod_builder_string(&b, dither_method_info[this->dir[1].conv.method].label);
+			spa_pod_builder_string(&b, "volume.ramp-samples");
+			spa_pod_builder_int(&b, this->volume_ramp_samples);
+			spa_pod_builder_string(&b, "volume.ramp-scale");
+			spa_pod_builder_string(&b, volume_ramp_info[this->volume.ramp_scale].label);
 			spa_pod_builder_pop(&b, &f[1]);
 			param = spa_pod_builder_pop(&b, &f[0]);
 			break;
@@ -795,6 +857,10 @@ static int audioconvert_set_param(struct impl *this, const char *k, const char *
 		spa_atou32(s, &this->dir[1].conv.noise_bits, 0);
 	else if (spa_streq(k, "dither.method"))
 		this->dir[1].conv.method = dither_method_from_label(s);
+	else if (spa_streq(k, "volume.ramp-samples"))
+		spa_atou32(s, &this->volume_ramp_samples, 0);
+	else if (spa_streq(k, "volume.ramp-scale"))
+		this->volume.ramp_scale = volume_ramp_scale_from_label(s);
 	else
 		return 0;
 	return 1;
@@ -1249,6 +1315,100 @@ static int remap_volumes(struct impl *this, const struct spa_audio_info *info)
 	return 1;
 }
 
+static int do_update_ramp(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *this = user_data;
+	const struct volume_ramp_update *u = data;
+	struct volume_ramp *r = &this->ramp;
+	uint32_t i;
+
+	if (u->len == 0 || r->n_gains != u->n_gains) {
+		r->len = 0;
+		r->n_gains = u->n_gains;
+		memcpy(r->end, u->end, u->n_gains * sizeof(float));
+		channelmix_set_matrix(&this->mix, &this->ramp_final[u->slot]);
+		return 0;
+	}
+	for (i = 0; i < u->n_gains; i++) {
+		r->start[i] = r->len > 0 ?
+			volume_ramp_gain(this->volume.ramp_scale,
+					r->start[i], r->end[i], r->pos, r->len) :
+			r->end[i];
+		r->end[i] = u->end[i];
+	}
+	r->pos = 0;
+	r->len = u->len;
+	r->slot = u->slot;
+	r->per_sample = u->per_sample;
+	channelmix_set_matrix(&this->mix, &this->ramp_unity);
+	return 0;
+}
+
+static bool mix_is_diagonal(struct channelmix *mix)
+{
+	uint32_t i, j;
+	for (i = 0; i < mix->dst_chan; i++) {
+		for (j = 0; j < mix->src_chan; j++) {
+			if (i != j && mix->matrix_orig[i][j] != 0.0f)
+				return false;
+		}
+	}
+	return true;
+}
+
+/* Start a ramp from the current gains to the new volumes. The final matrix is
+ * calculated here and the ramp is handed to the data thread, which mixes with
+ * the unity matrix and ramps the gains on the output channels when they map to
+ * the output, or on the input channels otherwise. Returns false when the
+ * volumes should be applied directly. */
+static bool start_volume_ramp(struct impl *this, float volume, bool mute,
+		uint32_t n_volumes, const float *volumes)
+{
+	struct volume_ramp_update u;
+	float vol = mute ? 0.0f : volume;
+	bool changed = this->n_ramp_target != n_volumes;
+	uint32_t i;
+
+	if (this->data_loop == NULL) {
+		this->ramp.len = 0;
+		return false;
+	}
+
+	spa_zero(u);
+	u.n_gains = n_volumes;
+	for (i = 0; i < n_volumes; i++) {
+		u.end[i] = volumes[i] * vol;
+		if (u.end[i] != this->ramp_target[i])
+			changed = true;
+	}
+	if (!changed)
+		return true;
+
+	this->n_ramp_target = n_volumes;
+	memcpy(this->ramp_target, u.end, n_volumes * sizeof(float));
+
+	/* the data thread only uses the slot of the last ramp */
+	this->ramp_slot ^= 1;
+	u.slot = this->ramp_slot;
+	channelmix_get_matrix(&this->mix, volume, mute, n_volumes, volumes,
+			&this->ramp_final[u.slot]);
+
+	u.per_sample = n_volumes == this->mix.dst_chan &&
+		(n_volumes != this->mix.src_chan || mix_is_diagonal(&this->mix));
+	if (this->started && (u.per_sample || n_volumes == this->mix.src_chan))
+		u.len = this->volume_ramp_samples;
+
+	spa_log_debug(this->log, "%p: volume ramp of %d samples per-sample:%d",
+			this, u.len, u.per_sample);
+
+	if (this->started)
+		spa_loop_invoke(this->data_loop, do_update_ramp, 0, &u, sizeof(u), true, this);
+	else
+		do_update_ramp(NULL, false, 0, &u, sizeof(u), this);
+	return true;
+}
+
 static void set_volume(struct impl *this)
 {
 	struct volumes *vol;
@@ -1272,8 +1432,10 @@ static void set_volume(struct impl *this)
 	for (i = 0; i < vol->n_volumes; i++)
 		volumes[i] = vol->volumes[dir->remap[i]];
 
-	channelmix_set_volume(&this->mix, this->props.volume, vol->mute,
-			vol->n_volumes, volumes);
+	if (!start_volume_ramp(this, this->props.volume, vol->mute,
+				vol->n_volumes, volumes))
+		channelmix_set_volume(&this->mix, this->props.volume, vol->mute,
+				vol->n_volumes, volumes);
 
 	this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
 	this->params[IDX_Props].user++;
@@ -1285,6 +1447,7 @@ static int setup_channelmix(struct impl *this)
 	struct dir *out = &this->dir[SPA_DIRECTION_OUTPUT];
 	uint32_t i, src_chan, dst_chan, p;
 	uint64_t src_mask, dst_mask;
+	float unity[SPA_AUDIO_MAX_CHANNELS];
 	int res;
 
 	src_chan = in->format.info.raw.channels;
@@ -1324,6 +1487,14 @@ static int setup_channelmix(struct impl *this)
 	if ((res = channelmix_init(&this->mix)) < 0)
 		return res;
 
+	for (i = 0; i < SPA_AUDIO_MAX_CHANNELS; i++)
+		unity[i] = VOLUME_NORM;
+	channelmix_get_matrix(&this->mix, VOLUME_NORM, false, src_chan, unity,
+			&this->ramp_unity);
+
+	this->n_ramp_target = 0;
+	this->ramp.len = 0;
+	this->ramp.n_gains = 0;
 	set_volume(this);
 
 	spa_log_debug(this->log, "%p: got channelmix features %08x:%08x flags:%08x %s",
@@ -1457,10 +1628,24 @@ static int setup_out_convert(struct impl *this)
 	return 0;
 }
 
+static void setup_tmp_datas(struct impl *this)
+{
+	uint32_t i;
+
+	for (i = 0; i < MAX_PORTS; i++) {
+		this->tmp_datas[0][i] = SPA_PTROFF(this->tmp[0], this->empty_size * i, void);
+		this->tmp_datas[0][i] = SPA_PTR_ALIGN(this->tmp_datas[0][i], MAX_ALIGN, void);
+		this->tmp_datas[1][i] = SPA_PTROFF(this->tmp[1], this->empty_size * i, void);
+		this->tmp_datas[1][i] = SPA_PTR_ALIGN(this->tmp_datas[1][i], MAX_ALIGN, void);
+		this->ramp_datas[i] = SPA_PTROFF(this->ramp_buf, this->empty_size * i, void);
+		this->ramp_datas[i] = SPA_PTR_ALIGN(this->ramp_datas[i], MAX_ALIGN, void);
+	}
+}
+
 static int setup_convert(struct impl *this)
 {
 	struct dir *in, *out;
-	uint32_t i, rate;
+	uint32_t rate;
 	int res;
 
 	in = &this->dir[SPA_DIRECTION_INPUT];
@@ -1503,12 +1688,7 @@ static int setup_convert(struct impl *this)
 	if ((res = setup_out_convert(this)) < 0)
 		return res;
 
-	for (i = 0; i < MAX_PORTS; i++) {
-		this->tmp_datas[0][i] = SPA_PTROFF(this->tmp[0], this->empty_size * i, void);
-		this->tmp_datas[0][i] = SPA_PTR_ALIGN(this->tmp_datas[0][i], MAX_ALIGN, void);
-		this->tmp_datas[1][i] = SPA_PTROFF(this->tmp[1], this->empty_size * i, void);
-		this->tmp_datas[1][i] = SPA_PTR_ALIGN(this->tmp_datas[1][i], MAX_ALIGN, void);
-	}
+	setup_tmp_datas(this);
 
 	emit_node_info(this, false);
 
@@ -2096,11 +2276,15 @@ impl_node_port_use_buffers(void *object,
 		this->scratch = realloc(this->scratch, maxsize + MAX_ALIGN);
 		this->tmp[0] = realloc(this->tmp[0], (maxsize + MAX_ALIGN) * MAX_PORTS);
 		this->tmp[1] = realloc(this->tmp[1], (maxsize + MAX_ALIGN) * MAX_PORTS);
+		this->ramp_buf = realloc(this->ramp_buf, (maxsize + MAX_ALIGN) * MAX_PORTS);
 		if (this->empty == NULL || this->scratch == NULL ||
-		    this->tmp[0] == NULL || this->tmp[1] == NULL)
+		    this->tmp[0] == NULL || this->tmp[1] == NULL ||
+		    this->ramp_buf == NULL)
 			return -errno;
 		memset(this->empty, 0, maxsize + MAX_ALIGN);
 		this->empty_size = maxsize;
+		/* the buffers moved, the converter can already be set up */
+		setup_tmp_datas(this);
 	}
 	port->n_buffers = n_buffers;
 
@@ -2151,6 +2335,53 @@ static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t
 	return 0;
 }
 
+static void channelmix_process_ramp(struct impl *this, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	struct volume_ramp *r = &this->ramp;
+	uint32_t i, chunk;
+	const float *s[MAX_PORTS];
+	float *d[MAX_PORTS];
+
+	for (i = 0; i < this->mix.src_chan; i++)
+		s[i] = src[i];
+	for (i = 0; i < this->mix.dst_chan; i++)
+		d[i] = dst[i];
+
+	while (n_samples > 0 && r->len > 0) {
+		chunk = SPA_MIN(n_samples, r->len - r->pos);
+		if (r->per_sample) {
+			const float **in = s;
+			if (!SPA_FLAG_IS_SET(this->mix.flags, CHANNELMIX_FLAG_IDENTITY)) {
+				channelmix_process(&this->mix, (void**)d, (const void**)s, chunk);
+				in = (const float **)d;
+			}
+			for (i = 0; i < r->n_gains; i++)
+				volume_process_ramp(&this->volume, d[i], in[i],
+						r->start[i], r->end[i], r->pos, r->len, chunk);
+		} else {
+			for (i = 0; i < r->n_gains; i++)
+				volume_process_ramp(&this->volume, this->ramp_datas[i], s[i],
+						r->start[i], r->end[i], r->pos, r->len, chunk);
+			channelmix_process(&this->mix, (void**)d,
+					(const void**)this->ramp_datas, chunk);
+		}
+		for (i = 0; i < this->mix.src_chan; i++)
+			s[i] += chunk;
+		for (i = 0; i < this->mix.dst_chan; i++)
+			d[i] += chunk;
+		n_samples -= chunk;
+		r->pos += chunk;
+
+		if (r->pos >= r->len) {
+			r->len = 0;
+			channelmix_set_matrix(&this->mix, &this->ramp_final[r->slot]);
+		}
+	}
+	if (n_samples > 0)
+		channelmix_process(&this->mix, (void**)d, (const void**)s, n_samples);
+}
+
 static int channelmix_process_control(struct impl *this, struct port *ctrlport,
 				      void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
 				      uint32_t n_samples)
@@ -2212,7 +2443,10 @@ static int channelmix_process_control(struct impl *this, struct port *ctrlport,
 			sd = d;
 		}
 
-		channelmix_process(&this->mix, (void**)sd, (const void**)ss, chunk);
+		if (this->ramp.len > 0)
+			channelmix_process_ramp(this, (void**)sd, (const void**)ss, chunk);
+		else
+			channelmix_process(&this->mix, (void**)sd, (const void**)ss, chunk);
 
 		if (chunk != avail_samples) {
 			for (i = 0; i < this->mix.src_chan; i++)
@@ -2520,7 +2754,8 @@ static int impl_node_process(void *object)
 	}
 
 	mix_passthrough = SPA_FLAG_IS_SET(this->mix.flags, CHANNELMIX_FLAG_IDENTITY) &&
-		(ctrlport == NULL || ctrlport->ctrl == NULL);
+		(ctrlport == NULL || ctrlport->ctrl == NULL) &&
+		this->ramp.len == 0;
 
 	out_passthrough = dir->conv.is_passthrough;
 	if (in_passthrough && mix_passthrough && resample_passthrough)
@@ -2583,6 +2818,8 @@ static int impl_node_process(void *object)
 				ctrlio->status = SPA_STATUS_OK;
 				ctrlport->ctrl = NULL;
 			}
+		} else if (this->ramp.len > 0) {
+			channelmix_process_ramp(this, out_datas, in_datas, n_samples);
 		} else {
 			channelmix_process(&this->mix, out_datas, in_datas, n_samples);
 		}
@@ -2748,6 +2985,7 @@ static int impl_clear(struct spa_handle *handle)
 	free(this->scratch);
 	free(this->tmp[0]);
 	free(this->tmp[1]);
+	free(this->ramp_buf);
 
 	if (this->resample.free)
 		resample_free(&this->resample);
@@ -2787,6 +3025,8 @@ impl_init(const struct spa_handle_factory *factory,
 	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
 	spa_log_topic_init(this->log, log_topic);
 
+	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
+
 	this->cpu = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
 	if (this->cpu) {
 		this->cpu_flags = spa_cpu_get_flags(this->cpu);
@@ -0,0 +1,290 @@
+/* Spa
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/support/log-impl.h>
+
+SPA_LOG_IMPL(logger);
+
+#include "test-helper.h"
+#include "channelmix-ops.h"
+
+static uint32_t cpu_flags;
+
+typedef void (*channelmix_func_t) (struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples);
+
+struct stats {
+	uint32_t n_samples;
+	uint32_t n_channels;
+	uint64_t perf;
+	const char *name;
+	const char *impl;
+};
+
+#define MAX_SAMPLES	4096
+#define MAX_CHANNELS	11
+
+#define MAX_COUNT 100
+
+static float samp_in[MAX_SAMPLES * MAX_CHANNELS];
+static float samp_out[MAX_SAMPLES * MAX_CHANNELS];
+
+static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
+
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * 100
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static struct channelmix mix;
+
+static void run_test1(const char *name, const char *impl, channelmix_func_t func,
+		int n_samples)
+{
+	uint32_t i, j;
+	const void *ip[mix.src_chan];
+	void *op[mix.dst_chan];
+	struct timespec ts;
+	uint64_t count, t1, t2;
+
+	for (j = 0; j < mix.src_chan; j++)
+		ip[j] = &samp_in[j * MAX_SAMPLES];
+	for (j = 0; j < mix.dst_chan; j++)
+		op[j] = &samp_out[j * MAX_SAMPLES];
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		func(&mix, op, ip, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.n_channels = mix.src_chan,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.name = name,
+		.impl = impl
+	};
+}
+
+static void run_test(const char *name, const char *impl, channelmix_func_t func)
+{
+	size_t i;
+	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++)
+		run_test1(name, impl, func, sample_sizes[i]);
+}
+
+static void init_mix(uint32_t src_chan, uint64_t src_mask, uint32_t dst_chan, uint64_t dst_mask)
+{
+	float volumes[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t i;
+
+	for (i = 0; i < src_chan; i++)
+		volumes[i] = 1.0f;
+
+	spa_zero(mix);
+	mix.src_chan = src_chan;
+	mix.dst_chan = dst_chan;
+	mix.src_mask = src_mask;
+	mix.dst_mask = dst_mask;
+	mix.log = &logger.log;
+	mix.freq = 48000.0f;
+	channelmix_init(&mix);
+	channelmix_set_volume(&mix, 1.0f, false, src_chan, volumes);
+}
+
+static void test_n_m(void)
+{
+	init_mix(6, MASK_5_1, 8, MASK_7_1);
+	run_test("test_5p1_7p1_n_m", "c", channelmix_f32_n_m_c);
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_5p1_7p1_n_m", "avx", channelmix_f32_n_m_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_5p1_7p1_n_m", "neon", channelmix_f32_n_m_neon);
+#endif
+	init_mix(8, MASK_7_1, 6, MASK_5_1);
+	run_test("test_7p1_5p1_n_m", "c", channelmix_f32_n_m_c);
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_7p1_5p1_n_m", "avx", channelmix_f32_n_m_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_7p1_5p1_n_m", "neon", channelmix_f32_n_m_neon);
+#endif
+}
+
+static void test_3p1(void)
+{
+	init_mix(4, MASK_3_1, 2, MASK_STEREO);
+	run_test("test_3p1_2", "c", channelmix_f32_3p1_2_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_3p1_2", "sse", channelmix_f32_3p1_2_sse);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_3p1_2", "avx", channelmix_f32_3p1_2_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_3p1_2", "neon", channelmix_f32_3p1_2_neon);
+#endif
+}
+
+static void test_5p1(void)
+{
+	init_mix(6, MASK_5_1, 2, MASK_STEREO);
+	run_test("test_5p1_2", "c", channelmix_f32_5p1_2_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_5p1_2", "sse", channelmix_f32_5p1_2_sse);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_5p1_2", "avx", channelmix_f32_5p1_2_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_5p1_2", "neon", channelmix_f32_5p1_2_neon);
+#endif
+	init_mix(6, MASK_5_1, 4, MASK_3_1);
+	run_test("test_5p1_3p1", "c", channelmix_f32_5p1_3p1_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_5p1_3p1", "sse", channelmix_f32_5p1_3p1_sse);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_5p1_3p1", "avx", channelmix_f32_5p1_3p1_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_5p1_3p1", "neon", channelmix_f32_5p1_3p1_neon);
+#endif
+	init_mix(6, MASK_5_1, 4, MASK_QUAD);
+	run_test("test_5p1_4", "c", channelmix_f32_5p1_4_c);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_5p1_4", "sse", channelmix_f32_5p1_4_sse);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_5p1_4", "avx", channelmix_f32_5p1_4_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_5p1_4", "neon", channelmix_f32_5p1_4_neon);
+#endif
+}
+
+static void test_7p1(void)
+{
+	init_mix(8, MASK_7_1, 2, MASK_STEREO);
+	run_test("test_7p1_2", "c", channelmix_f32_7p1_2_c);
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_7p1_2", "avx", channelmix_f32_7p1_2_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_7p1_2", "neon", channelmix_f32_7p1_2_neon);
+#endif
+	init_mix(8, MASK_7_1, 4, MASK_3_1);
+	run_test("test_7p1_3p1", "c", channelmix_f32_7p1_3p1_c);
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_7p1_3p1", "avx", channelmix_f32_7p1_3p1_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_7p1_3p1", "neon", channelmix_f32_7p1_3p1_neon);
+#endif
+	init_mix(8, MASK_7_1, 4, MASK_QUAD);
+	run_test("test_7p1_4", "c", channelmix_f32_7p1_4_c);
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_7p1_4", "avx", channelmix_f32_7p1_4_avx);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_7p1_4", "neon", channelmix_f32_7p1_4_neon);
+#endif
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+	if ((diff = strcmp(a->name, b->name)) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = a->n_channels - b->n_channels) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t i;
+
+	cpu_flags = get_cpu_flags();
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < SPA_N_ELEMENTS(samp_in); i++)
+		samp_in[i] = drand48() * 2.0 - 1.0;
+
+	test_n_m();
+	test_3p1();
+	test_5p1();
+	test_7p1();
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \t%-32.32s %s \t samples %d, channels %d\n",
+				s->perf, s->name, s->impl, s->n_samples, s->n_channels);
+	}
+	return 0;
+}
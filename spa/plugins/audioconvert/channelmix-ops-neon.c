@@ -0,0 +1,423 @@
+/* Spa
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "channelmix-ops.h"
+
+#include <arm_neon.h>
+
+static inline void clear_neon(float *d, uint32_t n_samples)
+{
+	memset(d, 0, n_samples * sizeof(float));
+}
+
+static inline void copy_neon(float *d, const float *s, uint32_t n_samples)
+{
+	spa_memcpy(d, s, n_samples * sizeof(float));
+}
+
+static inline void vol_neon(float *d, const float *s, float vol, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	if (vol == 0.0f) {
+		clear_neon(d, n_samples);
+	} else if (vol == 1.0f) {
+		copy_neon(d, s, n_samples);
+	} else {
+		const float32x4_t v = vdupq_n_f32(vol);
+
+		unrolled = n_samples & ~7;
+		for(n = 0; n < unrolled; n += 8) {
+			vst1q_f32(&d[n], vmulq_f32(vld1q_f32(&s[n]), v));
+			vst1q_f32(&d[n+4], vmulq_f32(vld1q_f32(&s[n+4]), v));
+		}
+		for(; n < n_samples; n++)
+			d[n] = s[n] * vol;
+	}
+}
+
+/* d = sum(s[i] * m[i]) for the n_src sources with a non-zero coefficient */
+static inline void mix_neon(float *d, const float **s, const float *m,
+		uint32_t n_src, uint32_t n_samples)
+{
+	uint32_t i, n, unrolled;
+	float32x4_t v[SPA_AUDIO_MAX_CHANNELS];
+
+	if (n_src == 0) {
+		clear_neon(d, n_samples);
+		return;
+	} else if (n_src == 1) {
+		vol_neon(d, s[0], m[0], n_samples);
+		return;
+	}
+	for (i = 0; i < n_src; i++)
+		v[i] = vdupq_n_f32(m[i]);
+
+	unrolled = n_samples & ~7;
+	for(n = 0; n < unrolled; n += 8) {
+		float32x4_t t0 = vmulq_f32(vld1q_f32(&s[0][n]), v[0]);
+		float32x4_t t1 = vmulq_f32(vld1q_f32(&s[0][n+4]), v[0]);
+		for (i = 1; i < n_src; i++) {
+			t0 = vaddq_f32(t0, vmulq_f32(vld1q_f32(&s[i][n]), v[i]));
+			t1 = vaddq_f32(t1, vmulq_f32(vld1q_f32(&s[i][n+4]), v[i]));
+		}
+		vst1q_f32(&d[n], t0);
+		vst1q_f32(&d[n+4], t1);
+	}
+	for(; n < n_samples; n++) {
+		float sum = s[0][n] * m[0];
+		for (i = 1; i < n_src; i++)
+			sum += s[i][n] * m[i];
+		d[n] = sum;
+	}
+}
+
+void channelmix_copy_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **)dst;
+	const float **s = (const float **)src;
+	for (i = 0; i < n_dst; i++)
+		vol_neon(d[i], s[i], mix->matrix[i][i], n_samples);
+}
+
+void
+channelmix_f32_n_m_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, j, n_dst = mix->dst_chan, n_src = mix->src_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+	}
+	else if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY)) {
+		uint32_t copy = SPA_MIN(n_dst, n_src);
+		for (i = 0; i < copy; i++)
+			copy_neon(d[i], s[i], n_samples);
+		for (; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+	}
+	else {
+		const float *ms[SPA_AUDIO_MAX_CHANNELS];
+		float mv[SPA_AUDIO_MAX_CHANNELS];
+		uint32_t n_ms;
+
+		/* most matrices are sparse, only mix the sources that contribute */
+		for (i = 0; i < n_dst; i++) {
+			for (j = 0, n_ms = 0; j < n_src; j++) {
+				if (mix->matrix[i][j] == 0.0f)
+					continue;
+				ms[n_ms] = s[j];
+				mv[n_ms++] = mix->matrix[i][j];
+			}
+			mix_neon(d[i], ms, mv, n_ms, n_samples);
+			lr4_process(&mix->lr4[i], d[i], d[i], 1.0f, n_samples);
+		}
+	}
+}
+
+/* FL+FR+FC+LFE -> FL+FR */
+void
+channelmix_f32_3p1_2_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		   const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m0 = mix->matrix[0][0];
+	const float m1 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_neon(d[0], n_samples);
+		clear_neon(d[1], n_samples);
+	}
+	else {
+		uint32_t n, unrolled;
+		const float32x4_t v0 = vdupq_n_f32(m0);
+		const float32x4_t v1 = vdupq_n_f32(m1);
+		const float32x4_t clev = vdupq_n_f32(m2);
+		const float32x4_t llev = vdupq_n_f32(m3);
+		float32x4_t ctr;
+
+		unrolled = n_samples & ~3;
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = vaddq_f32(
+					vmulq_f32(vld1q_f32(&s[2][n]), clev),
+					vmulq_f32(vld1q_f32(&s[3][n]), llev));
+			vst1q_f32(&d[0][n], vaddq_f32(
+					vmulq_f32(vld1q_f32(&s[0][n]), v0), ctr));
+			vst1q_f32(&d[1][n], vaddq_f32(
+					vmulq_f32(vld1q_f32(&s[1][n]), v1), ctr));
+		}
+		for(; n < n_samples; n++) {
+			const float c = s[2][n] * m2 + s[3][n] * m3;
+			d[0][n] = s[0][n] * m0 + c;
+			d[1][n] = s[1][n] * m1 + c;
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR -> FL+FR */
+void
+channelmix_f32_5p1_2_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m00 = mix->matrix[0][0];
+	const float m11 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m04 = mix->matrix[0][4];
+	const float m15 = mix->matrix[1][5];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_neon(d[0], n_samples);
+		clear_neon(d[1], n_samples);
+	}
+	else {
+		uint32_t n, unrolled;
+		const float32x4_t v0 = vdupq_n_f32(m00);
+		const float32x4_t v1 = vdupq_n_f32(m11);
+		const float32x4_t clev = vdupq_n_f32(m2);
+		const float32x4_t llev = vdupq_n_f32(m3);
+		const float32x4_t slev0 = vdupq_n_f32(m04);
+		const float32x4_t slev1 = vdupq_n_f32(m15);
+		float32x4_t in, ctr;
+
+		unrolled = n_samples & ~3;
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = vaddq_f32(vmulq_f32(vld1q_f32(&s[2][n]), clev),
+					vmulq_f32(vld1q_f32(&s[3][n]), llev));
+			in = vmulq_f32(vld1q_f32(&s[4][n]), slev0);
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_f32(vld1q_f32(&s[0][n]), v0));
+			vst1q_f32(&d[0][n], in);
+			in = vmulq_f32(vld1q_f32(&s[5][n]), slev1);
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_f32(vld1q_f32(&s[1][n]), v1));
+			vst1q_f32(&d[1][n], in);
+		}
+		for(; n < n_samples; n++) {
+			const float c = s[2][n] * m2 + s[3][n] * m3;
+			d[0][n] = s[0][n] * m00 + c + s[4][n] * m04;
+			d[1][n] = s[1][n] * m11 + c + s[5][n] * m15;
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR -> FL+FR+FC+LFE*/
+void
+channelmix_f32_5p1_3p1_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+	}
+	else {
+		const float *s0[2] = { s[0], s[4] }, *s1[2] = { s[1], s[5] };
+		const float m0[2] = { mix->matrix[0][0], mix->matrix[0][4] };
+		const float m1[2] = { mix->matrix[1][1], mix->matrix[1][5] };
+
+		mix_neon(d[0], s0, m0, 2, n_samples);
+		mix_neon(d[1], s1, m1, 2, n_samples);
+		vol_neon(d[2], s[2], mix->matrix[2][2], n_samples);
+		vol_neon(d[3], s[3], mix->matrix[3][3], n_samples);
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR -> FL+FR+RL+RR*/
+void
+channelmix_f32_5p1_4_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float v4 = mix->matrix[2][4];
+	const float v5 = mix->matrix[3][5];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+	}
+	else {
+		channelmix_f32_3p1_2_neon(mix, dst, src, n_samples);
+
+		vol_neon(d[2], s[4], v4, n_samples);
+		vol_neon(d[3], s[5], v5, n_samples);
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR */
+void
+channelmix_f32_7p1_2_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m00 = mix->matrix[0][0];
+	const float m11 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m04 = mix->matrix[0][4];
+	const float m15 = mix->matrix[1][5];
+	const float m06 = mix->matrix[0][6];
+	const float m17 = mix->matrix[1][7];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		clear_neon(d[0], n_samples);
+		clear_neon(d[1], n_samples);
+	}
+	else {
+		uint32_t n, unrolled;
+		const float32x4_t v0 = vdupq_n_f32(m00);
+		const float32x4_t v1 = vdupq_n_f32(m11);
+		const float32x4_t clev = vdupq_n_f32(m2);
+		const float32x4_t llev = vdupq_n_f32(m3);
+		const float32x4_t slev0 = vdupq_n_f32(m04);
+		const float32x4_t slev1 = vdupq_n_f32(m15);
+		const float32x4_t rlev0 = vdupq_n_f32(m06);
+		const float32x4_t rlev1 = vdupq_n_f32(m17);
+		float32x4_t in, ctr;
+
+		unrolled = n_samples & ~3;
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = vaddq_f32(vmulq_f32(vld1q_f32(&s[2][n]), clev),
+					vmulq_f32(vld1q_f32(&s[3][n]), llev));
+			in = vaddq_f32(vmulq_f32(vld1q_f32(&s[4][n]), slev0),
+					vmulq_f32(vld1q_f32(&s[6][n]), rlev0));
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_f32(vld1q_f32(&s[0][n]), v0));
+			vst1q_f32(&d[0][n], in);
+			in = vaddq_f32(vmulq_f32(vld1q_f32(&s[5][n]), slev1),
+					vmulq_f32(vld1q_f32(&s[7][n]), rlev1));
+			in = vaddq_f32(in, ctr);
+			in = vaddq_f32(in, vmulq_f32(vld1q_f32(&s[1][n]), v1));
+			vst1q_f32(&d[1][n], in);
+		}
+		for(; n < n_samples; n++) {
+			const float c = s[2][n] * m2 + s[3][n] * m3;
+			d[0][n] = s[0][n] * m00 + c + s[4][n] * m04 + s[6][n] * m06;
+			d[1][n] = s[1][n] * m11 + c + s[5][n] * m15 + s[7][n] * m17;
+		}
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+FC+LFE*/
+void
+channelmix_f32_7p1_3p1_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+	}
+	else {
+		const float v4 = (mix->matrix[0][4] + mix->matrix[0][6]) * 0.5f;
+		const float v5 = (mix->matrix[1][5] + mix->matrix[1][7]) * 0.5f;
+		const float *s0[3] = { s[0], s[4], s[6] }, *s1[3] = { s[1], s[5], s[7] };
+		const float m0[3] = { mix->matrix[0][0], v4, v4 };
+		const float m1[3] = { mix->matrix[1][1], v5, v5 };
+
+		mix_neon(d[0], s0, m0, 3, n_samples);
+		mix_neon(d[1], s1, m1, 3, n_samples);
+		vol_neon(d[2], s[2], mix->matrix[2][2], n_samples);
+		vol_neon(d[3], s[3], mix->matrix[3][3], n_samples);
+	}
+}
+
+/* FL+FR+FC+LFE+SL+SR+RL+RR -> FL+FR+RL+RR*/
+void
+channelmix_f32_7p1_4_neon(struct channelmix *mix, void * SPA_RESTRICT dst[],
+		const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	uint32_t i, n_dst = mix->dst_chan;
+	float **d = (float **) dst;
+	const float **s = (const float **) src;
+	const float m00 = mix->matrix[0][0];
+	const float m11 = mix->matrix[1][1];
+	const float m2 = (mix->matrix[0][2] + mix->matrix[1][2]) * 0.5f;
+	const float m3 = (mix->matrix[0][3] + mix->matrix[1][3]) * 0.5f;
+	const float m24 = mix->matrix[2][4];
+	const float m35 = mix->matrix[3][5];
+	const float m26 = mix->matrix[2][6];
+	const float m37 = mix->matrix[3][7];
+
+	if (SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_ZERO)) {
+		for (i = 0; i < n_dst; i++)
+			clear_neon(d[i], n_samples);
+	}
+	else {
+		uint32_t n, unrolled;
+		const float32x4_t v0 = vdupq_n_f32(m00);
+		const float32x4_t v1 = vdupq_n_f32(m11);
+		const float32x4_t clev = vdupq_n_f32(m2);
+		const float32x4_t llev = vdupq_n_f32(m3);
+		const float32x4_t slev0 = vdupq_n_f32(m24);
+		const float32x4_t slev1 = vdupq_n_f32(m35);
+		const float32x4_t rlev0 = vdupq_n_f32(m26);
+		const float32x4_t rlev1 = vdupq_n_f32(m37);
+		float32x4_t ctr, sl, sr;
+
+		unrolled = n_samples & ~3;
+		for(n = 0; n < unrolled; n += 4) {
+			ctr = vaddq_f32(vmulq_f32(vld1q_f32(&s[2][n]), clev),
+					vmulq_f32(vld1q_f32(&s[3][n]), llev));
+			sl = vmulq_f32(vld1q_f32(&s[4][n]), slev0);
+			sr = vmulq_f32(vld1q_f32(&s[5][n]), slev1);
+			vst1q_f32(&d[0][n], vaddq_f32(vaddq_f32(
+					vmulq_f32(vld1q_f32(&s[0][n]), v0), ctr), sl));
+			vst1q_f32(&d[1][n], vaddq_f32(vaddq_f32(
+					vmulq_f32(vld1q_f32(&s[1][n]), v1), ctr), sr));
+			vst1q_f32(&d[2][n], vaddq_f32(
+					vmulq_f32(vld1q_f32(&s[6][n]), rlev0), sl));
+			vst1q_f32(&d[3][n], vaddq_f32(
+					vmulq_f32(vld1q_f32(&s[7][n]), rlev1), sr));
+		}
+		for(; n < n_samples; n++) {
+			const float c = s[2][n] * m2 + s[3][n] * m3;
+			const float l = s[4][n] * m24;
+			const float r = s[5][n] * m35;
+			d[0][n] = s[0][n] * m00 + c + l;
+			d[1][n] = s[1][n] * m11 + c + r;
+			d[2][n] = s[6][n] * m26 + l;
+			d[3][n] = s[7][n] * m37 + r;
+		}
+	}
+}
@@ -67,6 +67,16 @@ static const struct channelmix_info {
 	uint32_t cpu_flags;
 } channelmix_table[] =
 {
+#if defined (HAVE_NEON)
+	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_neon, SPA_CPU_FLAG_NEON),
+	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_neon, SPA_CPU_FLAG_NEON),
+	MAKE(EQ, 0, EQ, 0, channelmix_copy_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+	MAKE(EQ, 0, EQ, 0, channelmix_copy_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(2, MASK_MONO, 2, MASK_MONO, channelmix_copy_sse, SPA_CPU_FLAG_SSE),
 	MAKE(2, MASK_STEREO, 2, MASK_STEREO, channelmix_copy_sse, SPA_CPU_FLAG_SSE),
@@ -84,28 +94,76 @@ static const struct channelmix_info {
 	MAKE(2, MASK_STEREO, 4, MASK_3_1, channelmix_f32_2_3p1_c),
 	MAKE(2, MASK_STEREO, 6, MASK_5_1, channelmix_f32_2_5p1_c),
 	MAKE(2, MASK_STEREO, 8, MASK_7_1, channelmix_f32_2_7p1_c),
+#if defined (HAVE_NEON)
+	MAKE(4, MASK_3_1, 2, MASK_STEREO, channelmix_f32_3p1_2_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(4, MASK_3_1, 2, MASK_STEREO, channelmix_f32_3p1_2_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(4, MASK_3_1, 2, MASK_STEREO, channelmix_f32_3p1_2_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(4, MASK_3_1, 2, MASK_STEREO, channelmix_f32_3p1_2_c),
+#if defined (HAVE_NEON)
+	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(6, MASK_5_1, 2, MASK_STEREO, channelmix_f32_5p1_2_c),
+#if defined (HAVE_NEON)
+	MAKE(6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(6, MASK_5_1, 4, MASK_QUAD, channelmix_f32_5p1_4_c),
 
+#if defined (HAVE_NEON)
+	MAKE(6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 #if defined (HAVE_SSE)
 	MAKE(6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_sse, SPA_CPU_FLAG_SSE),
 #endif
 	MAKE(6, MASK_5_1, 4, MASK_3_1, channelmix_f32_5p1_3p1_c),
 
+#if defined (HAVE_NEON)
+	MAKE(8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 	MAKE(8, MASK_7_1, 2, MASK_STEREO, channelmix_f32_7p1_2_c),
+#if defined (HAVE_NEON)
+	MAKE(8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 	MAKE(8, MASK_7_1, 4, MASK_QUAD, channelmix_f32_7p1_4_c),
+#if defined (HAVE_NEON)
+	MAKE(8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 	MAKE(8, MASK_7_1, 4, MASK_3_1, channelmix_f32_7p1_3p1_c),
 
+#if defined (HAVE_NEON)
+	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 	MAKE(ANY, 0, ANY, 0, channelmix_f32_n_m_c),
 };
 #undef MAKE
@@ -487,8 +545,9 @@ done:
 	return 0;
 }
 
-static void impl_channelmix_set_volume(struct channelmix *mix, float volume, bool mute,
-		uint32_t n_channel_volumes, float *channel_volumes)
+static void calc_matrix(struct channelmix *mix, float volume, bool mute,
+		uint32_t n_channel_volumes, const float *channel_volumes,
+		float matrix[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS], uint32_t *flags)
 {
 	float volumes[SPA_AUDIO_MAX_CHANNELS];
 	float vol = mute ? 0.0f : volume, t;
@@ -496,52 +555,83 @@ static void impl_channelmix_set_volume(struct channelmix *mix, float volume, boo
 	uint32_t src_chan = mix->src_chan;
 	uint32_t dst_chan = mix->dst_chan;
 
-	spa_log_debug(mix->log, "volume:%f mute:%d n_volumes:%d", volume, mute, n_channel_volumes);
-
 	/** apply global volume to channels */
-	for (i = 0; i < n_channel_volumes; i++) {
+	for (i = 0; i < n_channel_volumes; i++)
 		volumes[i] = channel_volumes[i] * vol;
-		spa_log_debug(mix->log, "%d: %f * %f = %f", i, channel_volumes[i], vol, volumes[i]);
-	}
 
 	/** apply volumes per channel */
 	if (n_channel_volumes == src_chan) {
 		for (i = 0; i < dst_chan; i++) {
 			for (j = 0; j < src_chan; j++) {
-				mix->matrix[i][j] = mix->matrix_orig[i][j] * volumes[j];
+				matrix[i][j] = mix->matrix_orig[i][j] * volumes[j];
 			}
 		}
 	} else if (n_channel_volumes == dst_chan) {
 		for (i = 0; i < dst_chan; i++) {
 			for (j = 0; j < src_chan; j++) {
-				mix->matrix[i][j] = mix->matrix_orig[i][j] * volumes[i];
+				matrix[i][j] = mix->matrix_orig[i][j] * volumes[i];
 			}
 		}
+	} else if (matrix != mix->matrix) {
+		for (i = 0; i < dst_chan; i++)
+			memcpy(matrix[i], mix->matrix[i], src_chan * sizeof(float));
 	}
 
-	SPA_FLAG_SET(mix->flags, CHANNELMIX_FLAG_ZERO);
-	SPA_FLAG_SET(mix->flags, CHANNELMIX_FLAG_EQUAL);
-	SPA_FLAG_SET(mix->flags, CHANNELMIX_FLAG_COPY);
+	SPA_FLAG_SET(*flags, CHANNELMIX_FLAG_ZERO);
+	SPA_FLAG_SET(*flags, CHANNELMIX_FLAG_EQUAL);
+	SPA_FLAG_SET(*flags, CHANNELMIX_FLAG_COPY);
 
 	t = 0.0;
 	for (i = 0; i < dst_chan; i++) {
 		for (j = 0; j < src_chan; j++) {
-			float v = mix->matrix[i][j];
-			spa_log_debug(mix->log, "%d %d: %f", i, j, v);
+			float v = matrix[i][j];
 			if (i == 0 && j == 0)
 				t = v;
 			else if (t != v)
-				SPA_FLAG_CLEAR(mix->flags, CHANNELMIX_FLAG_EQUAL);
+				SPA_FLAG_CLEAR(*flags, CHANNELMIX_FLAG_EQUAL);
 			if (v != 0.0)
-				SPA_FLAG_CLEAR(mix->flags, CHANNELMIX_FLAG_ZERO);
+				SPA_FLAG_CLEAR(*flags, CHANNELMIX_FLAG_ZERO);
 			if ((i == j && v != 1.0f) ||
 			    (i != j && v != 0.0f))
-				SPA_FLAG_CLEAR(mix->flags, CHANNELMIX_FLAG_COPY);
+				SPA_FLAG_CLEAR(*flags, CHANNELMIX_FLAG_COPY);
 		}
 	}
-	SPA_FLAG_UPDATE(mix->flags, CHANNELMIX_FLAG_IDENTITY,
-			dst_chan == src_chan && SPA_FLAG_IS_SET(mix->flags, CHANNELMIX_FLAG_COPY));
+	SPA_FLAG_UPDATE(*flags, CHANNELMIX_FLAG_IDENTITY,
+			dst_chan == src_chan && SPA_FLAG_IS_SET(*flags, CHANNELMIX_FLAG_COPY));
+}
+
+void channelmix_get_matrix(struct channelmix *mix, float volume, bool mute,
+		uint32_t n_channel_volumes, const float *channel_volumes,
+		struct channelmix_matrix *m)
+{
+	m->flags = mix->flags;
+	calc_matrix(mix, volume, mute, n_channel_volumes, channel_volumes,
+			m->matrix, &m->flags);
+}
+
+void channelmix_set_matrix(struct channelmix *mix, const struct channelmix_matrix *m)
+{
+	uint32_t i;
+
+	for (i = 0; i < mix->dst_chan; i++)
+		memcpy(mix->matrix[i], m->matrix[i], mix->src_chan * sizeof(float));
+	mix->flags = m->flags;
+}
+
+static void impl_channelmix_set_volume(struct channelmix *mix, float volume, bool mute,
+		uint32_t n_channel_volumes, float *channel_volumes)
+{
+	uint32_t i, j;
+
+	spa_log_debug(mix->log, "volume:%f mute:%d n_volumes:%d", volume, mute, n_channel_volumes);
 
+	calc_matrix(mix, volume, mute, n_channel_volumes, channel_volumes,
+			mix->matrix, &mix->flags);
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		for (j = 0; j < mix->src_chan; j++)
+			spa_log_debug(mix->log, "%d %d: %f", i, j, mix->matrix[i][j]);
+	}
 	spa_log_debug(mix->log, "flags:%08x", mix->flags);
 }
 
@@ -95,8 +95,21 @@ struct channelmix {
 	void *data;
 };
 
+/** a channelmix matrix with the volumes applied */
+struct channelmix_matrix {
+	uint32_t flags;
+	float matrix[SPA_AUDIO_MAX_CHANNELS][SPA_AUDIO_MAX_CHANNELS];
+};
+
 int channelmix_init(struct channelmix *mix);
 
+/** calculate the matrix for the given volumes without changing \a mix */
+void channelmix_get_matrix(struct channelmix *mix, float volume, bool mute,
+		uint32_t n_channel_volumes, const float *channel_volumes,
+		struct channelmix_matrix *m);
+/** use a matrix that was calculated with channelmix_get_matrix() */
+void channelmix_set_matrix(struct channelmix *mix, const struct channelmix_matrix *m);
+
 static const struct channelmix_upmix_info {
 	const char *label;
 	const char *description;
@@ -154,4 +167,28 @@ DEFINE_FUNCTION(f32_5p1_4, sse);
 DEFINE_FUNCTION(f32_7p1_4, sse);
 #endif
 
+#if defined (HAVE_AVX)
+DEFINE_FUNCTION(copy, avx);
+DEFINE_FUNCTION(f32_n_m, avx);
+DEFINE_FUNCTION(f32_3p1_2, avx);
+DEFINE_FUNCTION(f32_5p1_2, avx);
+DEFINE_FUNCTION(f32_5p1_3p1, avx);
+DEFINE_FUNCTION(f32_5p1_4, avx);
+DEFINE_FUNCTION(f32_7p1_2, avx);
+DEFINE_FUNCTION(f32_7p1_3p1, avx);
+DEFINE_FUNCTION(f32_7p1_4, avx);
+#endif
+
+#if defined (HAVE_NEON)
+DEFINE_FUNCTION(copy, neon);
+DEFINE_FUNCTION(f32_n_m, neon);
+DEFINE_FUNCTION(f32_3p1_2, neon);
+DEFINE_FUNCTION(f32_5p1_2, neon);
+DEFINE_FUNCTION(f32_5p1_3p1, neon);
+DEFINE_FUNCTION(f32_5p1_4, neon);
+DEFINE_FUNCTION(f32_7p1_2, neon);
+DEFINE_FUNCTION(f32_7p1_3p1, neon);
+DEFINE_FUNCTION(f32_7p1_4, neon);
+#endif
+
 #undef DEFINE_FUNCTION
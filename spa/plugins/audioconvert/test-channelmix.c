@@ -22,6 +22,8 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "config.h"
+
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,7 +38,18 @@ SPA_LOG_IMPL(logger);
 
 #define MATRIX(...) (float[]) { __VA_ARGS__ }
 
+#include "test-helper.h"
 #include "channelmix-ops.c"
+
+#define N_SAMPLES	1021
+#define AVX_FLAGS	(SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3)
+
+static uint32_t cpu_flags;
+
+static float src_data[SPA_AUDIO_MAX_CHANNELS][N_SAMPLES] SPA_ALIGNED(32);
+static float c_data[SPA_AUDIO_MAX_CHANNELS][N_SAMPLES] SPA_ALIGNED(32);
+static float simd_data[SPA_AUDIO_MAX_CHANNELS][N_SAMPLES] SPA_ALIGNED(32);
+
 static void dump_matrix(struct channelmix *mix, float *coeff)
 {
 	uint32_t i, j;
@@ -51,6 +64,71 @@ static void dump_matrix(struct channelmix *mix, float *coeff)
 	}
 }
 
+static void run_mix(struct channelmix *mix, float data[][N_SAMPLES])
+{
+	const void *src[SPA_AUDIO_MAX_CHANNELS];
+	void *dst[SPA_AUDIO_MAX_CHANNELS];
+	uint32_t i;
+
+	for (i = 0; i < mix->src_chan; i++)
+		src[i] = src_data[i];
+	for (i = 0; i < mix->dst_chan; i++)
+		dst[i] = data[i];
+
+	channelmix_set_volume(mix, 1.0f, false, 0, NULL);
+	channelmix_process(mix, dst, src, N_SAMPLES);
+}
+
+static void compare_mix(struct channelmix *mix, const char *name, uint32_t flags)
+{
+	struct channelmix simd;
+	uint32_t i, j;
+
+	simd = *mix;
+	simd.cpu_flags = flags;
+	spa_assert_se(channelmix_init(&simd) == 0);
+	/* skip when there is no specialized function for this layout */
+	if (simd.cpu_flags != flags)
+		return;
+
+	spa_log_debug(mix->log, "compare %s with %s", simd.func_name, mix->func_name);
+
+	run_mix(&simd, simd_data);
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		for (j = 0; j < N_SAMPLES; j++) {
+			if (fabsf(c_data[i][j] - simd_data[i][j]) > 0.00001f)
+				fprintf(stderr, "%s %d %d: %f != %f\n", name, i, j,
+						c_data[i][j], simd_data[i][j]);
+			spa_assert_se(fabsf(c_data[i][j] - simd_data[i][j]) <= 0.00001f);
+		}
+	}
+}
+
+static void check_mix(struct channelmix *mix)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < mix->src_chan; i++)
+		for (j = 0; j < N_SAMPLES; j++)
+			src_data[i][j] = drand48() * 2.0 - 1.0;
+
+	run_mix(mix, c_data);
+
+#if defined(HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		compare_mix(mix, "sse", SPA_CPU_FLAG_SSE);
+#endif
+#if defined(HAVE_AVX)
+	if ((cpu_flags & AVX_FLAGS) == AVX_FLAGS)
+		compare_mix(mix, "avx", AVX_FLAGS);
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		compare_mix(mix, "neon", SPA_CPU_FLAG_NEON);
+#endif
+}
+
 static void test_mix(uint32_t src_chan, uint32_t src_mask, uint32_t dst_chan, uint32_t dst_mask, uint32_t options, float *coeff)
 {
 	struct channelmix mix;
@@ -65,8 +143,9 @@ static void test_mix(uint32_t src_chan, uint32_t src_mask, uint32_t dst_chan, ui
 	mix.dst_mask = dst_mask;
 	mix.log = &logger.log;
 
-	channelmix_init(&mix);
+	spa_assert_se(channelmix_init(&mix) == 0);
 	dump_matrix(&mix, coeff);
+	check_mix(&mix);
 }
 
 static void test_1_N_MONO(void)
@@ -224,6 +303,9 @@ int main(int argc, char *argv[])
 {
 	logger.log.level = SPA_LOG_LEVEL_TRACE;
 
+	cpu_flags = get_cpu_flags();
+	printf("got CPU flags %d\n", cpu_flags);
+
 	test_1_N_MONO();
 	test_1_N_FC();
 	test_N_1();
@@ -0,0 +1,165 @@
+/* Spa
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+
+#include <spa/support/cpu.h>
+#include <spa/utils/defs.h>
+
+#include "test-helper.h"
+#include "volume-ops.h"
+
+#define N_SAMPLES	1037
+#define RAMP_LEN	1100
+#define RAMP_OFFSET	13
+
+#define AVX_FLAGS	(SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3)
+
+static uint32_t cpu_flags;
+
+static float samples[N_SAMPLES];
+
+static void init_samples(void)
+{
+	uint32_t i;
+	for (i = 0; i < N_SAMPLES; i++)
+		samples[i] = sinf(i * 0.1f);
+}
+
+static void run_test_volume(const char *name, uint32_t cpu_flags)
+{
+	struct volume vol;
+	float out[N_SAMPLES];
+	uint32_t i;
+
+	spa_zero(vol);
+	vol.cpu_flags = cpu_flags;
+	spa_assert_se(volume_init(&vol) == 0);
+	spa_assert_se(vol.cpu_flags == cpu_flags);
+
+	fprintf(stderr, "test %s:\n", name);
+
+	volume_process(&vol, out, samples, 0.5f, N_SAMPLES);
+	for (i = 0; i < N_SAMPLES; i++)
+		spa_assert_se(fabsf(out[i] - samples[i] * 0.5f) < 1e-6f);
+
+	volume_process(&vol, out, samples, VOLUME_MIN, N_SAMPLES);
+	for (i = 0; i < N_SAMPLES; i++)
+		spa_assert_se(out[i] == 0.0f);
+
+	volume_free(&vol);
+}
+
+static void run_test_ramp(const char *name, uint32_t cpu_flags, uint32_t scale)
+{
+	struct volume vol;
+	float out[N_SAMPLES];
+	uint32_t i;
+
+	spa_zero(vol);
+	vol.cpu_flags = cpu_flags;
+	vol.ramp_scale = scale;
+	spa_assert_se(volume_init(&vol) == 0);
+	spa_assert_se(vol.cpu_flags == cpu_flags);
+
+	fprintf(stderr, "test %s %s ramp:\n", name, volume_ramp_info[scale].label);
+
+	volume_process_ramp(&vol, out, samples, 0.25f, 1.5f,
+			RAMP_OFFSET, RAMP_LEN, N_SAMPLES);
+	for (i = 0; i < N_SAMPLES; i++) {
+		float g = volume_ramp_gain(scale, 0.25f, 1.5f,
+				RAMP_OFFSET + i + 1, RAMP_LEN);
+		spa_assert_se(fabsf(out[i] - samples[i] * g) < 1e-6f);
+	}
+
+	/* in-place and ending exactly on the target gain */
+	memcpy(out, samples, sizeof(out));
+	volume_process_ramp(&vol, out, out, 1.0f, 0.0f,
+			RAMP_LEN - N_SAMPLES, RAMP_LEN, N_SAMPLES);
+	spa_assert_se(out[N_SAMPLES-1] == 0.0f);
+	for (i = 1; i < N_SAMPLES; i++) {
+		float g0 = volume_ramp_gain(scale, 1.0f, 0.0f,
+				RAMP_LEN - N_SAMPLES + i, RAMP_LEN);
+		float g1 = volume_ramp_gain(scale, 1.0f, 0.0f,
+				RAMP_LEN - N_SAMPLES + i + 1, RAMP_LEN);
+		spa_assert_se(g1 <= g0);
+		spa_assert_se(fabsf(out[i] - samples[i] * g1) < 1e-6f);
+	}
+
+	volume_free(&vol);
+}
+
+static void test_f32(void)
+{
+	uint32_t scale;
+
+	run_test_volume("c", 0);
+#if defined(HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test_volume("sse", SPA_CPU_FLAG_SSE);
+#endif
+#if defined(HAVE_AVX)
+	if ((cpu_flags & AVX_FLAGS) == AVX_FLAGS)
+		run_test_volume("avx", AVX_FLAGS);
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test_volume("neon", SPA_CPU_FLAG_NEON);
+#endif
+
+	for (scale = 0; scale < SPA_N_ELEMENTS(volume_ramp_info); scale++) {
+		run_test_ramp("c", 0, scale);
+#if defined(HAVE_SSE)
+		if (cpu_flags & SPA_CPU_FLAG_SSE)
+			run_test_ramp("sse", SPA_CPU_FLAG_SSE, scale);
+#endif
+#if defined(HAVE_AVX)
+		if ((cpu_flags & AVX_FLAGS) == AVX_FLAGS)
+			run_test_ramp("avx", AVX_FLAGS, scale);
+#endif
+#if defined(HAVE_NEON)
+		if (cpu_flags & SPA_CPU_FLAG_NEON)
+			run_test_ramp("neon", SPA_CPU_FLAG_NEON, scale);
+#endif
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	cpu_flags = get_cpu_flags();
+	printf("got CPU flags %d\n", cpu_flags);
+
+	init_samples();
+
+	test_f32();
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+/* Spa
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "volume-ops.h"
+
+#include <immintrin.h>
+
+void
+volume_f32_avx(struct volume *vol, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src, float volume, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+
+	if (volume == VOLUME_MIN) {
+		memset(d, 0, n_samples * sizeof(float));
+	}
+	else if (volume == VOLUME_NORM) {
+		spa_memcpy(d, s, n_samples * sizeof(float));
+	}
+	else {
+		__m256 t[4];
+		const __m256 vol = _mm256_set1_ps(volume);
+
+		unrolled = n_samples & ~31;
+
+		for(n = 0; n < unrolled; n += 32) {
+			t[0] = _mm256_loadu_ps(&s[n]);
+			t[1] = _mm256_loadu_ps(&s[n+8]);
+			t[2] = _mm256_loadu_ps(&s[n+16]);
+			t[3] = _mm256_loadu_ps(&s[n+24]);
+			_mm256_storeu_ps(&d[n], _mm256_mul_ps(t[0], vol));
+			_mm256_storeu_ps(&d[n+8], _mm256_mul_ps(t[1], vol));
+			_mm256_storeu_ps(&d[n+16], _mm256_mul_ps(t[2], vol));
+			_mm256_storeu_ps(&d[n+24], _mm256_mul_ps(t[3], vol));
+		}
+		for(; n < n_samples; n++)
+			_mm_store_ss(&d[n], _mm_mul_ss(_mm_load_ss(&s[n]),
+						_mm256_castps256_ps128(vol)));
+	}
+}
+
+void
+volume_f32_ramp_avx(struct volume *vol, void *dst, const void *src,
+		float start, float end, uint32_t offset, uint32_t length,
+		uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+	const __m256 st = _mm256_set1_ps(start), delta = _mm256_set1_ps(end - start);
+	const __m256 inv = _mm256_set1_ps(1.0f / (float)length);
+	const __m256 step = _mm256_set1_ps(8.0f);
+	const __m256 two = _mm256_set1_ps(2.0f), three = _mm256_set1_ps(3.0f);
+	const bool cubic = vol->ramp_scale == VOLUME_RAMP_CUBIC;
+	__m256 pos, t;
+
+	unrolled = n_samples & ~7;
+	pos = _mm256_setr_ps(offset + 1, offset + 2, offset + 3, offset + 4,
+			offset + 5, offset + 6, offset + 7, offset + 8);
+
+	for (n = 0; n < unrolled; n += 8) {
+		t = _mm256_mul_ps(pos, inv);
+		if (cubic)
+			t = _mm256_mul_ps(_mm256_mul_ps(t, t),
+					_mm256_fnmadd_ps(two, t, three));
+		t = _mm256_fmadd_ps(delta, t, st);
+		_mm256_storeu_ps(&d[n], _mm256_mul_ps(_mm256_loadu_ps(&s[n]), t));
+		pos = _mm256_add_ps(pos, step);
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * volume_ramp_gain(vol->ramp_scale, start, end,
+				offset + n + 1, length);
+}
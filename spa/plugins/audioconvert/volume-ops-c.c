@@ -43,3 +43,17 @@ volume_f32_c(struct volume *vol, void * SPA_RESTRICT dst,
 			d[n] = s[n] * volume;
 	}
 }
+
+void
+volume_f32_ramp_c(struct volume *vol, void *dst, const void *src,
+		float start, float end, uint32_t offset, uint32_t length,
+		uint32_t n_samples)
+{
+	uint32_t n;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+
+	for (n = 0; n < n_samples; n++)
+		d[n] = s[n] * volume_ramp_gain(vol->ramp_scale, start, end,
+				offset + n + 1, length);
+}
@@ -0,0 +1,95 @@
+/* Spa
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "volume-ops.h"
+
+#include <arm_neon.h>
+
+void
+volume_f32_neon(struct volume *vol, void * SPA_RESTRICT dst,
+		const void * SPA_RESTRICT src, float volume, uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+
+	if (volume == VOLUME_MIN) {
+		memset(d, 0, n_samples * sizeof(float));
+	}
+	else if (volume == VOLUME_NORM) {
+		spa_memcpy(d, s, n_samples * sizeof(float));
+	}
+	else {
+		float32x4_t t[4];
+		const float32x4_t vol = vdupq_n_f32(volume);
+
+		unrolled = n_samples & ~15;
+
+		for(n = 0; n < unrolled; n += 16) {
+			t[0] = vld1q_f32(&s[n]);
+			t[1] = vld1q_f32(&s[n+4]);
+			t[2] = vld1q_f32(&s[n+8]);
+			t[3] = vld1q_f32(&s[n+12]);
+			vst1q_f32(&d[n], vmulq_f32(t[0], vol));
+			vst1q_f32(&d[n+4], vmulq_f32(t[1], vol));
+			vst1q_f32(&d[n+8], vmulq_f32(t[2], vol));
+			vst1q_f32(&d[n+12], vmulq_f32(t[3], vol));
+		}
+		for(; n < n_samples; n++)
+			d[n] = s[n] * volume;
+	}
+}
+
+void
+volume_f32_ramp_neon(struct volume *vol, void *dst, const void *src,
+		float start, float end, uint32_t offset, uint32_t length,
+		uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+	const float32x4_t st = vdupq_n_f32(start), delta = vdupq_n_f32(end - start);
+	const float32x4_t inv = vdupq_n_f32(1.0f / (float)length);
+	const float32x4_t step = vdupq_n_f32(4.0f);
+	const float32x4_t two = vdupq_n_f32(2.0f), three = vdupq_n_f32(3.0f);
+	const bool cubic = vol->ramp_scale == VOLUME_RAMP_CUBIC;
+	const float init[4] = { offset + 1, offset + 2, offset + 3, offset + 4 };
+	float32x4_t pos, t;
+
+	unrolled = n_samples & ~3;
+	pos = vld1q_f32(init);
+
+	for (n = 0; n < unrolled; n += 4) {
+		t = vmulq_f32(pos, inv);
+		if (cubic)
+			t = vmulq_f32(vmulq_f32(t, t), vmlsq_f32(three, two, t));
+		t = vmlaq_f32(st, delta, t);
+		vst1q_f32(&d[n], vmulq_f32(vld1q_f32(&s[n]), t));
+		pos = vaddq_f32(pos, step);
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * volume_ramp_gain(vol->ramp_scale, start, end,
+				offset + n + 1, length);
+}
@@ -64,3 +64,35 @@ volume_f32_sse(struct volume *vol, void * SPA_RESTRICT dst,
 			_mm_store_ss(&d[n], _mm_mul_ss(_mm_load_ss(&s[n]), vol));
 	}
 }
+
+void
+volume_f32_ramp_sse(struct volume *vol, void *dst, const void *src,
+		float start, float end, uint32_t offset, uint32_t length,
+		uint32_t n_samples)
+{
+	uint32_t n, unrolled;
+	float *d = (float*)dst;
+	const float *s = (const float*)src;
+	const __m128 st = _mm_set1_ps(start), delta = _mm_set1_ps(end - start);
+	const __m128 inv = _mm_set1_ps(1.0f / (float)length);
+	const __m128 step = _mm_set1_ps(4.0f);
+	const __m128 two = _mm_set1_ps(2.0f), three = _mm_set1_ps(3.0f);
+	const bool cubic = vol->ramp_scale == VOLUME_RAMP_CUBIC;
+	__m128 pos, t;
+
+	unrolled = n_samples & ~3;
+	pos = _mm_setr_ps(offset + 1, offset + 2, offset + 3, offset + 4);
+
+	for (n = 0; n < unrolled; n += 4) {
+		t = _mm_mul_ps(pos, inv);
+		if (cubic)
+			t = _mm_mul_ps(_mm_mul_ps(t, t),
+					_mm_sub_ps(three, _mm_mul_ps(two, t)));
+		t = _mm_add_ps(st, _mm_mul_ps(delta, t));
+		_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_loadu_ps(&s[n]), t));
+		pos = _mm_add_ps(pos, step);
+	}
+	for (; n < n_samples; n++)
+		d[n] = s[n] * volume_ramp_gain(vol->ramp_scale, start, end,
+				offset + n + 1, length);
+}
@@ -35,20 +35,30 @@
 
 typedef void (*volume_func_t) (struct volume *vol, void * SPA_RESTRICT dst,
 			const void * SPA_RESTRICT src, float volume, uint32_t n_samples);
+typedef void (*volume_ramp_func_t) (struct volume *vol, void *dst, const void *src,
+			float start, float end, uint32_t offset, uint32_t length,
+			uint32_t n_samples);
 
-#define MAKE(func,...) \
-	{ func, #func , __VA_ARGS__ }
+#define MAKE(func,ramp,...) \
+	{ func, ramp, #func , __VA_ARGS__ }
 
 static const struct volume_info {
 	volume_func_t process;
+	volume_ramp_func_t process_ramp;
 	const char *name;
 	uint32_t cpu_flags;
 } volume_table[] =
 {
+#if defined (HAVE_NEON)
+	MAKE(volume_f32_neon, volume_f32_ramp_neon, SPA_CPU_FLAG_NEON),
+#endif
+#if defined (HAVE_AVX)
+	MAKE(volume_f32_avx, volume_f32_ramp_avx, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3),
+#endif
 #if defined (HAVE_SSE)
-	MAKE(volume_f32_sse, SPA_CPU_FLAG_SSE),
+	MAKE(volume_f32_sse, volume_f32_ramp_sse, SPA_CPU_FLAG_SSE),
 #endif
-	MAKE(volume_f32_c),
+	MAKE(volume_f32_c, volume_f32_ramp_c),
 };
 #undef MAKE
 
@@ -68,6 +78,7 @@ static const struct volume_info *find_volume_info(uint32_t cpu_flags)
 static void impl_volume_free(struct volume *vol)
 {
 	vol->process = NULL;
+	vol->process_ramp = NULL;
 }
 
 int volume_init(struct volume *vol)
@@ -82,5 +93,6 @@ int volume_init(struct volume *vol)
 	vol->func_name = info->name;
 	vol->free = impl_volume_free;
 	vol->process = info->process;
+	vol->process_ramp = info->process_ramp;
 	return 0;
 }
@@ -26,6 +26,7 @@
 #include <stdio.h>
 
 #include <spa/utils/defs.h>
+#include <spa/utils/string.h>
 #include <spa/param/audio/raw.h>
 
 #define VOLUME_MIN 0.0f
@@ -39,8 +40,15 @@ struct volume {
 
 	uint32_t flags;
 
+#define VOLUME_RAMP_LINEAR	0
+#define VOLUME_RAMP_CUBIC	1
+	uint32_t ramp_scale;
+
 	void (*process) (struct volume *vol, void * SPA_RESTRICT dst,
 			const void * SPA_RESTRICT src, float volume, uint32_t n_samples);
+	void (*process_ramp) (struct volume *vol, void *dst, const void *src,
+			float start, float end, uint32_t offset, uint32_t length,
+			uint32_t n_samples);
 	void (*free) (struct volume *vol);
 
 	void *data;
@@ -48,7 +56,37 @@ struct volume {
 
 int volume_init(struct volume *vol);
 
+static const struct volume_ramp_info {
+	const char *label;
+	const char *description;
+	uint32_t scale;
+} volume_ramp_info[] = {
+	[VOLUME_RAMP_LINEAR] = { "linear", "Linear ramp", VOLUME_RAMP_LINEAR },
+	[VOLUME_RAMP_CUBIC] = { "cubic", "Cubic ramp", VOLUME_RAMP_CUBIC },
+};
+
+static inline uint32_t volume_ramp_scale_from_label(const char *label)
+{
+	uint32_t i;
+	for (i = 0; i < SPA_N_ELEMENTS(volume_ramp_info); i++) {
+		if (spa_streq(volume_ramp_info[i].label, label))
+			return volume_ramp_info[i].scale;
+	}
+	return VOLUME_RAMP_LINEAR;
+}
+
+/** gain at position \a pos of a ramp of \a length samples from \a start to \a end */
+static inline float volume_ramp_gain(uint32_t scale, float start, float end,
+		uint32_t pos, uint32_t length)
+{
+	float t = (float)pos / (float)length;
+	if (scale == VOLUME_RAMP_CUBIC)
+		t = t * t * (3.0f - 2.0f * t);
+	return start + (end - start) * t;
+}
+
 #define volume_process(vol,...)		(vol)->process(vol, __VA_ARGS__)
+#define volume_process_ramp(vol,...)	(vol)->process_ramp(vol, __VA_ARGS__)
 #define volume_free(vol)		(vol)->free(vol)
 
 #define DEFINE_FUNCTION(name,arch)			\
@@ -57,12 +95,29 @@ void volume_##name##_##arch(struct volume *vol,		\
 		const void * SPA_RESTRICT src,		\
 		float volume, uint32_t n_samples);
 
+#define DEFINE_RAMP_FUNCTION(name,arch)			\
+void volume_##name##_ramp_##arch(struct volume *vol,	\
+		void *dst, const void *src,		\
+		float start, float end, uint32_t offset,\
+		uint32_t length, uint32_t n_samples);
+
 #define VOLUME_OPS_MAX_ALIGN	16
 
 DEFINE_FUNCTION(f32, c);
+DEFINE_RAMP_FUNCTION(f32, c);
 
 #if defined (HAVE_SSE)
 DEFINE_FUNCTION(f32, sse);
+DEFINE_RAMP_FUNCTION(f32, sse);
+#endif
+#if defined (HAVE_AVX)
+DEFINE_FUNCTION(f32, avx);
+DEFINE_RAMP_FUNCTION(f32, avx);
+#endif
+#if defined (HAVE_NEON)
+DEFINE_FUNCTION(f32, neon);
+DEFINE_RAMP_FUNCTION(f32, neon);
 #endif
 
 #undef DEFINE_FUNCTION
+#undef DEFINE_RAMP_FUNCTION
@@ -123,6 +123,21 @@ static void test_u8(void)
 static void test_s16(void)
 {
 	run_test("test_s16", "c", mix_s16_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_s16", "sse2", mix_s16_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s16", "avx2", mix_s16_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s16", "neon", mix_s16_neon);
+	}
+#endif
 }
 static void test_u16(void)
 {
@@ -140,6 +155,21 @@ static void test_u24(void)
 static void test_s24_32(void)
 {
 	run_test("test_s24_32", "c", mix_s24_32_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_s24_32", "sse2", mix_s24_32_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_32", "avx2", mix_s24_32_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s24_32", "neon", mix_s24_32_neon);
+	}
+#endif
 }
 static void test_u24_32(void)
 {
@@ -149,6 +179,21 @@ static void test_u24_32(void)
 static void test_s32(void)
 {
 	run_test("test_s32", "c", mix_s32_c);
+#if defined (HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_s32", "sse2", mix_s32_sse2);
+	}
+#endif
+#if defined (HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s32", "avx2", mix_s32_avx2);
+	}
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s32", "neon", mix_s32_neon);
+	}
+#endif
 }
 static void test_u32(void)
 {
@@ -168,6 +213,11 @@ static void test_f32(void)
 		run_test("test_f32", "avx", mix_f32_avx);
 	}
 #endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32", "neon", mix_f32_neon);
+	}
+#endif
 }
 
 static void test_f64(void)
@@ -0,0 +1,207 @@
+/* Spa
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <spa/utils/defs.h>
+
+#include "mix-ops.h"
+
+#include <immintrin.h>
+
+void
+mix_s16_avx2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int16_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int16_t));
+	} else {
+		uint32_t n, i, unrolled;
+		__m256i acc[4];
+		const int16_t **s = (const int16_t **)src;
+		int16_t *d = dst;
+
+		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 32))) {
+			unrolled = n_samples & ~31;
+			for (i = 0; i < n_src; i++) {
+				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 32))) {
+					unrolled = 0;
+					break;
+				}
+			}
+		} else
+			unrolled = 0;
+
+		for (n = 0; n < unrolled; n += 32) {
+			/* sign extend to 32 bits so that only the final sum saturates */
+			acc[0] = _mm256_cvtepi16_epi32(_mm_load_si128((__m128i*)&s[0][n+ 0]));
+			acc[1] = _mm256_cvtepi16_epi32(_mm_load_si128((__m128i*)&s[0][n+ 8]));
+			acc[2] = _mm256_cvtepi16_epi32(_mm_load_si128((__m128i*)&s[0][n+16]));
+			acc[3] = _mm256_cvtepi16_epi32(_mm_load_si128((__m128i*)&s[0][n+24]));
+
+			for (i = 1; i < n_src; i++) {
+				acc[0] = _mm256_add_epi32(acc[0], _mm256_cvtepi16_epi32(
+							_mm_load_si128((__m128i*)&s[i][n+ 0])));
+				acc[1] = _mm256_add_epi32(acc[1], _mm256_cvtepi16_epi32(
+							_mm_load_si128((__m128i*)&s[i][n+ 8])));
+				acc[2] = _mm256_add_epi32(acc[2], _mm256_cvtepi16_epi32(
+							_mm_load_si128((__m128i*)&s[i][n+16])));
+				acc[3] = _mm256_add_epi32(acc[3], _mm256_cvtepi16_epi32(
+							_mm_load_si128((__m128i*)&s[i][n+24])));
+			}
+			/* packs works per 128 bits lane, put the 64 bits blocks back in order */
+			_mm256_store_si256((__m256i*)&d[n+ 0], _mm256_permute4x64_epi64(
+					_mm256_packs_epi32(acc[0], acc[1]), _MM_SHUFFLE(3, 1, 2, 0)));
+			_mm256_store_si256((__m256i*)&d[n+16], _mm256_permute4x64_epi64(
+					_mm256_packs_epi32(acc[2], acc[3]), _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+		for (; n < n_samples; n++) {
+			int32_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S16_ACCUM(ac, s[i][n]);
+			d[n] = S16_CLAMP(ac);
+		}
+	}
+}
+
+void
+mix_s32_avx2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int32_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int32_t));
+	} else {
+		uint32_t n, i, unrolled;
+		__m256d acc[4];
+		const __m256d min = _mm256_set1_pd(S32_MIN), max = _mm256_set1_pd(S32_MAX);
+		const int32_t **s = (const int32_t **)src;
+		int32_t *d = dst;
+
+		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 32))) {
+			unrolled = n_samples & ~15;
+			for (i = 0; i < n_src; i++) {
+				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 32))) {
+					unrolled = 0;
+					break;
+				}
+			}
+		} else
+			unrolled = 0;
+
+		for (n = 0; n < unrolled; n += 16) {
+			/* the sum of less than 2^21 inputs is exact in a double */
+			acc[0] = _mm256_cvtepi32_pd(_mm_load_si128((__m128i*)&s[0][n+ 0]));
+			acc[1] = _mm256_cvtepi32_pd(_mm_load_si128((__m128i*)&s[0][n+ 4]));
+			acc[2] = _mm256_cvtepi32_pd(_mm_load_si128((__m128i*)&s[0][n+ 8]));
+			acc[3] = _mm256_cvtepi32_pd(_mm_load_si128((__m128i*)&s[0][n+12]));
+
+			for (i = 1; i < n_src; i++) {
+				acc[0] = _mm256_add_pd(acc[0], _mm256_cvtepi32_pd(
+							_mm_load_si128((__m128i*)&s[i][n+ 0])));
+				acc[1] = _mm256_add_pd(acc[1], _mm256_cvtepi32_pd(
+							_mm_load_si128((__m128i*)&s[i][n+ 4])));
+				acc[2] = _mm256_add_pd(acc[2], _mm256_cvtepi32_pd(
+							_mm_load_si128((__m128i*)&s[i][n+ 8])));
+				acc[3] = _mm256_add_pd(acc[3], _mm256_cvtepi32_pd(
+							_mm_load_si128((__m128i*)&s[i][n+12])));
+			}
+			for (i = 0; i < 4; i++)
+				_mm_store_si128((__m128i*)&d[n + i * 4], _mm256_cvtpd_epi32(
+						_mm256_min_pd(_mm256_max_pd(acc[i], min), max)));
+		}
+		for (; n < n_samples; n++) {
+			int64_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S32_ACCUM(ac, s[i][n]);
+			d[n] = S32_CLAMP(ac);
+		}
+	}
+}
+
+void
+mix_s24_32_avx2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int32_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int32_t));
+	} else {
+		uint32_t n, i, unrolled;
+		__m256i in[4];
+		const __m256i min = _mm256_set1_epi32(S24_32_MIN), max = _mm256_set1_epi32(S24_32_MAX);
+		const int32_t **s = (const int32_t **)src;
+		int32_t *d = dst;
+
+		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 32))) {
+			unrolled = n_samples & ~31;
+			for (i = 0; i < n_src; i++) {
+				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 32))) {
+					unrolled = 0;
+					break;
+				}
+			}
+		} else
+			unrolled = 0;
+
+		for (n = 0; n < unrolled; n += 32) {
+			in[0] = _mm256_load_si256((__m256i*)&s[0][n+ 0]);
+			in[1] = _mm256_load_si256((__m256i*)&s[0][n+ 8]);
+			in[2] = _mm256_load_si256((__m256i*)&s[0][n+16]);
+			in[3] = _mm256_load_si256((__m256i*)&s[0][n+24]);
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = _mm256_add_epi32(in[0], _mm256_load_si256((__m256i*)&s[i][n+ 0]));
+				in[1] = _mm256_add_epi32(in[1], _mm256_load_si256((__m256i*)&s[i][n+ 8]));
+				in[2] = _mm256_add_epi32(in[2], _mm256_load_si256((__m256i*)&s[i][n+16]));
+				in[3] = _mm256_add_epi32(in[3], _mm256_load_si256((__m256i*)&s[i][n+24]));
+			}
+			for (i = 0; i < 4; i++)
+				_mm256_store_si256((__m256i*)&d[n + i * 8], _mm256_min_epi32(
+						_mm256_max_epi32(in[i], min), max));
+		}
+		for (; n < n_samples; n++) {
+			int32_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S24_32_ACCUM(ac, s[i][n]);
+			d[n] = S24_32_CLAMP(ac);
+		}
+	}
+}
@@ -0,0 +1,221 @@
+/* Spa
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <spa/utils/defs.h>
+
+#include "mix-ops.h"
+
+#include <arm_neon.h>
+
+void
+mix_s16_neon(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int16_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int16_t));
+	} else {
+		uint32_t n, i, unrolled;
+		int16x8_t in[2];
+		int32x4_t acc[4];
+		const int16_t **s = (const int16_t **)src;
+		int16_t *d = dst;
+
+		unrolled = n_samples & ~15;
+
+		for (n = 0; n < unrolled; n += 16) {
+			/* widen to 32 bits so that only the final sum saturates */
+			in[0] = vld1q_s16(&s[0][n+0]);
+			in[1] = vld1q_s16(&s[0][n+8]);
+			acc[0] = vmovl_s16(vget_low_s16(in[0]));
+			acc[1] = vmovl_s16(vget_high_s16(in[0]));
+			acc[2] = vmovl_s16(vget_low_s16(in[1]));
+			acc[3] = vmovl_s16(vget_high_s16(in[1]));
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = vld1q_s16(&s[i][n+0]);
+				in[1] = vld1q_s16(&s[i][n+8]);
+				acc[0] = vaddw_s16(acc[0], vget_low_s16(in[0]));
+				acc[1] = vaddw_s16(acc[1], vget_high_s16(in[0]));
+				acc[2] = vaddw_s16(acc[2], vget_low_s16(in[1]));
+				acc[3] = vaddw_s16(acc[3], vget_high_s16(in[1]));
+			}
+			vst1q_s16(&d[n+0], vcombine_s16(vqmovn_s32(acc[0]), vqmovn_s32(acc[1])));
+			vst1q_s16(&d[n+8], vcombine_s16(vqmovn_s32(acc[2]), vqmovn_s32(acc[3])));
+		}
+		for (; n < n_samples; n++) {
+			int32_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S16_ACCUM(ac, s[i][n]);
+			d[n] = S16_CLAMP(ac);
+		}
+	}
+}
+
+void
+mix_s32_neon(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int32_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int32_t));
+	} else {
+		uint32_t n, i, unrolled;
+		int32x4_t in[2];
+		int64x2_t acc[4];
+		const int32_t **s = (const int32_t **)src;
+		int32_t *d = dst;
+
+		unrolled = n_samples & ~7;
+
+		for (n = 0; n < unrolled; n += 8) {
+			/* widen to 64 bits so that only the final sum saturates */
+			in[0] = vld1q_s32(&s[0][n+0]);
+			in[1] = vld1q_s32(&s[0][n+4]);
+			acc[0] = vmovl_s32(vget_low_s32(in[0]));
+			acc[1] = vmovl_s32(vget_high_s32(in[0]));
+			acc[2] = vmovl_s32(vget_low_s32(in[1]));
+			acc[3] = vmovl_s32(vget_high_s32(in[1]));
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = vld1q_s32(&s[i][n+0]);
+				in[1] = vld1q_s32(&s[i][n+4]);
+				acc[0] = vaddw_s32(acc[0], vget_low_s32(in[0]));
+				acc[1] = vaddw_s32(acc[1], vget_high_s32(in[0]));
+				acc[2] = vaddw_s32(acc[2], vget_low_s32(in[1]));
+				acc[3] = vaddw_s32(acc[3], vget_high_s32(in[1]));
+			}
+			vst1q_s32(&d[n+0], vcombine_s32(vqmovn_s64(acc[0]), vqmovn_s64(acc[1])));
+			vst1q_s32(&d[n+4], vcombine_s32(vqmovn_s64(acc[2]), vqmovn_s64(acc[3])));
+		}
+		for (; n < n_samples; n++) {
+			int64_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S32_ACCUM(ac, s[i][n]);
+			d[n] = S32_CLAMP(ac);
+		}
+	}
+}
+
+void
+mix_s24_32_neon(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int32_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int32_t));
+	} else {
+		uint32_t n, i, unrolled;
+		int32x4_t in[4];
+		const int32x4_t min = vdupq_n_s32(S24_32_MIN), max = vdupq_n_s32(S24_32_MAX);
+		const int32_t **s = (const int32_t **)src;
+		int32_t *d = dst;
+
+		unrolled = n_samples & ~15;
+
+		for (n = 0; n < unrolled; n += 16) {
+			in[0] = vld1q_s32(&s[0][n+ 0]);
+			in[1] = vld1q_s32(&s[0][n+ 4]);
+			in[2] = vld1q_s32(&s[0][n+ 8]);
+			in[3] = vld1q_s32(&s[0][n+12]);
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = vaddq_s32(in[0], vld1q_s32(&s[i][n+ 0]));
+				in[1] = vaddq_s32(in[1], vld1q_s32(&s[i][n+ 4]));
+				in[2] = vaddq_s32(in[2], vld1q_s32(&s[i][n+ 8]));
+				in[3] = vaddq_s32(in[3], vld1q_s32(&s[i][n+12]));
+			}
+			for (i = 0; i < 4; i++)
+				vst1q_s32(&d[n + i * 4], vminq_s32(vmaxq_s32(in[i], min), max));
+		}
+		for (; n < n_samples; n++) {
+			int32_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S24_32_ACCUM(ac, s[i][n]);
+			d[n] = S24_32_CLAMP(ac);
+		}
+	}
+}
+
+void
+mix_f32_neon(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(float));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(float));
+	} else {
+		uint32_t n, i, unrolled;
+		float32x4_t in[4];
+		const float **s = (const float **)src;
+		float *d = dst;
+
+		unrolled = n_samples & ~15;
+
+		for (n = 0; n < unrolled; n += 16) {
+			in[0] = vld1q_f32(&s[0][n+ 0]);
+			in[1] = vld1q_f32(&s[0][n+ 4]);
+			in[2] = vld1q_f32(&s[0][n+ 8]);
+			in[3] = vld1q_f32(&s[0][n+12]);
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = vaddq_f32(in[0], vld1q_f32(&s[i][n+ 0]));
+				in[1] = vaddq_f32(in[1], vld1q_f32(&s[i][n+ 4]));
+				in[2] = vaddq_f32(in[2], vld1q_f32(&s[i][n+ 8]));
+				in[3] = vaddq_f32(in[3], vld1q_f32(&s[i][n+12]));
+			}
+			vst1q_f32(&d[n+ 0], in[0]);
+			vst1q_f32(&d[n+ 4], in[1]);
+			vst1q_f32(&d[n+ 8], in[2]);
+			vst1q_f32(&d[n+12], in[3]);
+		}
+		for (; n < n_samples; n++) {
+			float ac = s[0][n];
+			for (i = 1; i < n_src; i++)
+				ac += s[i][n];
+			d[n] = ac;
+		}
+	}
+}
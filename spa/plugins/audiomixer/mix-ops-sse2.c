@@ -85,3 +85,195 @@ mix_f64_sse2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_REST
 		}
 	}
 }
+
+void
+mix_s16_sse2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int16_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int16_t));
+	} else {
+		uint32_t n, i, unrolled;
+		__m128i in[2], acc[4];
+		const int16_t **s = (const int16_t **)src;
+		int16_t *d = dst;
+
+		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 16))) {
+			unrolled = n_samples & ~15;
+			for (i = 0; i < n_src; i++) {
+				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 16))) {
+					unrolled = 0;
+					break;
+				}
+			}
+		} else
+			unrolled = 0;
+
+		for (n = 0; n < unrolled; n += 16) {
+			/* sign extend to 32 bits so that only the final sum saturates */
+			in[0] = _mm_load_si128((__m128i*)&s[0][n+0]);
+			in[1] = _mm_load_si128((__m128i*)&s[0][n+8]);
+			acc[0] = _mm_srai_epi32(_mm_unpacklo_epi16(in[0], in[0]), 16);
+			acc[1] = _mm_srai_epi32(_mm_unpackhi_epi16(in[0], in[0]), 16);
+			acc[2] = _mm_srai_epi32(_mm_unpacklo_epi16(in[1], in[1]), 16);
+			acc[3] = _mm_srai_epi32(_mm_unpackhi_epi16(in[1], in[1]), 16);
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = _mm_load_si128((__m128i*)&s[i][n+0]);
+				in[1] = _mm_load_si128((__m128i*)&s[i][n+8]);
+				acc[0] = _mm_add_epi32(acc[0],
+						_mm_srai_epi32(_mm_unpacklo_epi16(in[0], in[0]), 16));
+				acc[1] = _mm_add_epi32(acc[1],
+						_mm_srai_epi32(_mm_unpackhi_epi16(in[0], in[0]), 16));
+				acc[2] = _mm_add_epi32(acc[2],
+						_mm_srai_epi32(_mm_unpacklo_epi16(in[1], in[1]), 16));
+				acc[3] = _mm_add_epi32(acc[3],
+						_mm_srai_epi32(_mm_unpackhi_epi16(in[1], in[1]), 16));
+			}
+			_mm_store_si128((__m128i*)&d[n+0], _mm_packs_epi32(acc[0], acc[1]));
+			_mm_store_si128((__m128i*)&d[n+8], _mm_packs_epi32(acc[2], acc[3]));
+		}
+		for (; n < n_samples; n++) {
+			int32_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S16_ACCUM(ac, s[i][n]);
+			d[n] = S16_CLAMP(ac);
+		}
+	}
+}
+
+void
+mix_s32_sse2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int32_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int32_t));
+	} else {
+		uint32_t n, i, unrolled;
+		__m128i in[2];
+		__m128d acc[4];
+		const __m128d min = _mm_set1_pd(S32_MIN), max = _mm_set1_pd(S32_MAX);
+		const int32_t **s = (const int32_t **)src;
+		int32_t *d = dst;
+
+		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 16))) {
+			unrolled = n_samples & ~7;
+			for (i = 0; i < n_src; i++) {
+				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 16))) {
+					unrolled = 0;
+					break;
+				}
+			}
+		} else
+			unrolled = 0;
+
+		for (n = 0; n < unrolled; n += 8) {
+			/* the sum of less than 2^21 inputs is exact in a double */
+			in[0] = _mm_load_si128((__m128i*)&s[0][n+0]);
+			in[1] = _mm_load_si128((__m128i*)&s[0][n+4]);
+			acc[0] = _mm_cvtepi32_pd(in[0]);
+			acc[1] = _mm_cvtepi32_pd(_mm_shuffle_epi32(in[0], _MM_SHUFFLE(1, 0, 3, 2)));
+			acc[2] = _mm_cvtepi32_pd(in[1]);
+			acc[3] = _mm_cvtepi32_pd(_mm_shuffle_epi32(in[1], _MM_SHUFFLE(1, 0, 3, 2)));
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = _mm_load_si128((__m128i*)&s[i][n+0]);
+				in[1] = _mm_load_si128((__m128i*)&s[i][n+4]);
+				acc[0] = _mm_add_pd(acc[0], _mm_cvtepi32_pd(in[0]));
+				acc[1] = _mm_add_pd(acc[1], _mm_cvtepi32_pd(
+						_mm_shuffle_epi32(in[0], _MM_SHUFFLE(1, 0, 3, 2))));
+				acc[2] = _mm_add_pd(acc[2], _mm_cvtepi32_pd(in[1]));
+				acc[3] = _mm_add_pd(acc[3], _mm_cvtepi32_pd(
+						_mm_shuffle_epi32(in[1], _MM_SHUFFLE(1, 0, 3, 2))));
+			}
+			for (i = 0; i < 4; i++)
+				acc[i] = _mm_min_pd(_mm_max_pd(acc[i], min), max);
+
+			_mm_store_si128((__m128i*)&d[n+0], _mm_unpacklo_epi64(
+					_mm_cvtpd_epi32(acc[0]), _mm_cvtpd_epi32(acc[1])));
+			_mm_store_si128((__m128i*)&d[n+4], _mm_unpacklo_epi64(
+					_mm_cvtpd_epi32(acc[2]), _mm_cvtpd_epi32(acc[3])));
+		}
+		for (; n < n_samples; n++) {
+			int64_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S32_ACCUM(ac, s[i][n]);
+			d[n] = S32_CLAMP(ac);
+		}
+	}
+}
+
+static inline __m128i clamp_epi32_sse2(__m128i v, __m128i min, __m128i max)
+{
+	__m128i mask;
+	mask = _mm_cmpgt_epi32(v, max);
+	v = _mm_or_si128(_mm_and_si128(mask, max), _mm_andnot_si128(mask, v));
+	mask = _mm_cmplt_epi32(v, min);
+	v = _mm_or_si128(_mm_and_si128(mask, min), _mm_andnot_si128(mask, v));
+	return v;
+}
+
+void
+mix_s24_32_sse2(struct mix_ops *ops, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_src, uint32_t n_samples)
+{
+	n_samples *= ops->n_channels;
+
+	if (n_src == 0) {
+		memset(dst, 0, n_samples * sizeof(int32_t));
+	} else if (n_src == 1) {
+		if (dst != src[0])
+			spa_memcpy(dst, src[0], n_samples * sizeof(int32_t));
+	} else {
+		uint32_t n, i, unrolled;
+		__m128i in[4];
+		const __m128i min = _mm_set1_epi32(S24_32_MIN), max = _mm_set1_epi32(S24_32_MAX);
+		const int32_t **s = (const int32_t **)src;
+		int32_t *d = dst;
+
+		if (SPA_LIKELY(SPA_IS_ALIGNED(dst, 16))) {
+			unrolled = n_samples & ~15;
+			for (i = 0; i < n_src; i++) {
+				if (SPA_UNLIKELY(!SPA_IS_ALIGNED(src[i], 16))) {
+					unrolled = 0;
+					break;
+				}
+			}
+		} else
+			unrolled = 0;
+
+		for (n = 0; n < unrolled; n += 16) {
+			in[0] = _mm_load_si128((__m128i*)&s[0][n+ 0]);
+			in[1] = _mm_load_si128((__m128i*)&s[0][n+ 4]);
+			in[2] = _mm_load_si128((__m128i*)&s[0][n+ 8]);
+			in[3] = _mm_load_si128((__m128i*)&s[0][n+12]);
+
+			for (i = 1; i < n_src; i++) {
+				in[0] = _mm_add_epi32(in[0], _mm_load_si128((__m128i*)&s[i][n+ 0]));
+				in[1] = _mm_add_epi32(in[1], _mm_load_si128((__m128i*)&s[i][n+ 4]));
+				in[2] = _mm_add_epi32(in[2], _mm_load_si128((__m128i*)&s[i][n+ 8]));
+				in[3] = _mm_add_epi32(in[3], _mm_load_si128((__m128i*)&s[i][n+12]));
+			}
+			_mm_store_si128((__m128i*)&d[n+ 0], clamp_epi32_sse2(in[0], min, max));
+			_mm_store_si128((__m128i*)&d[n+ 4], clamp_epi32_sse2(in[1], min, max));
+			_mm_store_si128((__m128i*)&d[n+ 8], clamp_epi32_sse2(in[2], min, max));
+			_mm_store_si128((__m128i*)&d[n+12], clamp_epi32_sse2(in[3], min, max));
+		}
+		for (; n < n_samples; n++) {
+			int32_t ac = 0;
+			for (i = 0; i < n_src; i++)
+				ac = S24_32_ACCUM(ac, s[i][n]);
+			d[n] = S24_32_CLAMP(ac);
+		}
+	}
+}
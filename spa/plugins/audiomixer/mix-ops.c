@@ -46,6 +46,10 @@ struct mix_info {
 static struct mix_info mix_table[] =
 {
 	/* f32 */
+#if defined (HAVE_NEON)
+	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_NEON, 4, mix_f32_neon },
+	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_NEON, 4, mix_f32_neon },
+#endif
 #if defined(HAVE_AVX)
 	{ SPA_AUDIO_FORMAT_F32, 0, SPA_CPU_FLAG_AVX, 4, mix_f32_avx },
 	{ SPA_AUDIO_FORMAT_F32P, 0, SPA_CPU_FLAG_AVX, 4, mix_f32_avx },
@@ -72,6 +76,18 @@ static struct mix_info mix_table[] =
 	{ SPA_AUDIO_FORMAT_U8P, 0, 0, 1, mix_u8_c },
 
 	/* s16 */
+#if defined (HAVE_NEON)
+	{ SPA_AUDIO_FORMAT_S16, 0, SPA_CPU_FLAG_NEON, 2, mix_s16_neon },
+	{ SPA_AUDIO_FORMAT_S16P, 0, SPA_CPU_FLAG_NEON, 2, mix_s16_neon },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S16, 0, SPA_CPU_FLAG_AVX2, 2, mix_s16_avx2 },
+	{ SPA_AUDIO_FORMAT_S16P, 0, SPA_CPU_FLAG_AVX2, 2, mix_s16_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_S16, 0, SPA_CPU_FLAG_SSE2, 2, mix_s16_sse2 },
+	{ SPA_AUDIO_FORMAT_S16P, 0, SPA_CPU_FLAG_SSE2, 2, mix_s16_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S16, 0, 0, 2, mix_s16_c },
 	{ SPA_AUDIO_FORMAT_S16P, 0, 0, 2, mix_s16_c },
 	{ SPA_AUDIO_FORMAT_U16, 0, 0, 2, mix_u16_c },
@@ -82,11 +98,35 @@ static struct mix_info mix_table[] =
 	{ SPA_AUDIO_FORMAT_U24, 0, 0, 3, mix_u24_c },
 
 	/* s32 */
+#if defined (HAVE_NEON)
+	{ SPA_AUDIO_FORMAT_S32, 0, SPA_CPU_FLAG_NEON, 4, mix_s32_neon },
+	{ SPA_AUDIO_FORMAT_S32P, 0, SPA_CPU_FLAG_NEON, 4, mix_s32_neon },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S32, 0, SPA_CPU_FLAG_AVX2, 4, mix_s32_avx2 },
+	{ SPA_AUDIO_FORMAT_S32P, 0, SPA_CPU_FLAG_AVX2, 4, mix_s32_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_S32, 0, SPA_CPU_FLAG_SSE2, 4, mix_s32_sse2 },
+	{ SPA_AUDIO_FORMAT_S32P, 0, SPA_CPU_FLAG_SSE2, 4, mix_s32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S32, 0, 0, 4, mix_s32_c },
 	{ SPA_AUDIO_FORMAT_S32P, 0, 0, 4, mix_s32_c },
 	{ SPA_AUDIO_FORMAT_U32, 0, 0, 4, mix_u32_c },
 
 	/* s24_32 */
+#if defined (HAVE_NEON)
+	{ SPA_AUDIO_FORMAT_S24_32, 0, SPA_CPU_FLAG_NEON, 4, mix_s24_32_neon },
+	{ SPA_AUDIO_FORMAT_S24_32P, 0, SPA_CPU_FLAG_NEON, 4, mix_s24_32_neon },
+#endif
+#if defined (HAVE_AVX2)
+	{ SPA_AUDIO_FORMAT_S24_32, 0, SPA_CPU_FLAG_AVX2, 4, mix_s24_32_avx2 },
+	{ SPA_AUDIO_FORMAT_S24_32P, 0, SPA_CPU_FLAG_AVX2, 4, mix_s24_32_avx2 },
+#endif
+#if defined (HAVE_SSE2)
+	{ SPA_AUDIO_FORMAT_S24_32, 0, SPA_CPU_FLAG_SSE2, 4, mix_s24_32_sse2 },
+	{ SPA_AUDIO_FORMAT_S24_32P, 0, SPA_CPU_FLAG_SSE2, 4, mix_s24_32_sse2 },
+#endif
 	{ SPA_AUDIO_FORMAT_S24_32, 0, 0, 4, mix_s24_32_c },
 	{ SPA_AUDIO_FORMAT_S24_32P, 0, 0, 4, mix_s24_32_c },
 	{ SPA_AUDIO_FORMAT_U24_32, 0, 0, 4, mix_u24_32_c },
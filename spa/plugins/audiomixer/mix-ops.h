@@ -162,8 +162,22 @@ DEFINE_FUNCTION(f64, c);
 DEFINE_FUNCTION(f32, sse);
 #endif
 #if defined(HAVE_SSE2)
+DEFINE_FUNCTION(s16, sse2);
+DEFINE_FUNCTION(s32, sse2);
+DEFINE_FUNCTION(s24_32, sse2);
 DEFINE_FUNCTION(f64, sse2);
 #endif
 #if defined(HAVE_AVX)
 DEFINE_FUNCTION(f32, avx);
 #endif
+#if defined(HAVE_AVX2)
+DEFINE_FUNCTION(s16, avx2);
+DEFINE_FUNCTION(s32, avx2);
+DEFINE_FUNCTION(s24_32, avx2);
+#endif
+#if defined(HAVE_NEON)
+DEFINE_FUNCTION(s16, neon);
+DEFINE_FUNCTION(s32, neon);
+DEFINE_FUNCTION(s24_32, neon);
+DEFINE_FUNCTION(f32, neon);
+#endif
@@ -70,6 +70,40 @@ static int run_test(const char *name, const void *src[], uint32_t n_src, const v
 	return 0;
 }
 
+#define MAX_SRC 8
+
+static uint8_t samp_in[MAX_SRC][N_SAMPLES * 4] SPA_ALIGNED(32);
+static uint8_t samp_ref[N_SAMPLES * 4] SPA_ALIGNED(32);
+static uint8_t samp_res[N_SAMPLES * 4] SPA_ALIGNED(32);
+
+/* mix random data with an odd number of samples so that both the vectorized
+ * loop and the tail are used and compare with the C version. Samples are
+ * shifted right by shift bits to keep them in range for s24_32. */
+static void run_test_compare(const char *name, uint32_t stride, uint32_t shift,
+		mix_func_t mix, mix_func_t ref)
+{
+	struct mix_ops ops;
+	const void *src[MAX_SRC];
+	uint32_t i, j, n_src, n_samples = N_SAMPLES - 3;
+
+	spa_zero(ops);
+	ops.n_channels = 1;
+
+	fprintf(stderr, "%s\n", name);
+
+	for (i = 0; i < MAX_SRC; i++) {
+		int32_t *d = (int32_t*)samp_in[i];
+		for (j = 0; j < sizeof(samp_in[i]) / sizeof(int32_t); j++)
+			d[j] = (int32_t)((uint32_t)rand() << 1 ^ rand()) >> shift;
+		src[i] = samp_in[i];
+	}
+	for (n_src = 2; n_src <= MAX_SRC; n_src++) {
+		ref(&ops, samp_ref, src, n_src, n_samples);
+		mix(&ops, samp_res, src, n_src, n_samples);
+		compare_mem(n_src, 0, samp_res, samp_ref, n_samples * stride);
+	}
+}
+
 static void test_s8(void)
 {
 	int8_t out[] = { 0x00, 0x00, 0x00, 0x00 };
@@ -113,6 +147,30 @@ static void test_s16(void)
 	run_test("test_s16_0", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s16_c);
 	run_test("test_s16_1", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s16_c);
 	run_test("test_s16_4", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s16_c);
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_s16_0_sse2", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s16_sse2);
+		run_test("test_s16_1_sse2", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s16_sse2);
+		run_test("test_s16_4_sse2", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s16_sse2);
+		run_test_compare("test_s16_compare_sse2", 2, 0, mix_s16_sse2, mix_s16_c);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s16_0_avx2", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s16_avx2);
+		run_test("test_s16_1_avx2", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s16_avx2);
+		run_test("test_s16_4_avx2", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s16_avx2);
+		run_test_compare("test_s16_compare_avx2", 2, 0, mix_s16_avx2, mix_s16_c);
+	}
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s16_0_neon", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s16_neon);
+		run_test("test_s16_1_neon", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s16_neon);
+		run_test("test_s16_4_neon", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s16_neon);
+		run_test_compare("test_s16_compare_neon", 2, 0, mix_s16_neon, mix_s16_c);
+	}
+#endif
 }
 
 static void test_u16(void)
@@ -173,6 +231,30 @@ static void test_s32(void)
 	run_test("test_s32_0", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s32_c);
 	run_test("test_s32_1", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s32_c);
 	run_test("test_s32_4", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s32_c);
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_s32_0_sse2", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s32_sse2);
+		run_test("test_s32_1_sse2", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s32_sse2);
+		run_test("test_s32_4_sse2", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s32_sse2);
+		run_test_compare("test_s32_compare_sse2", 4, 0, mix_s32_sse2, mix_s32_c);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s32_0_avx2", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s32_avx2);
+		run_test("test_s32_1_avx2", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s32_avx2);
+		run_test("test_s32_4_avx2", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s32_avx2);
+		run_test_compare("test_s32_compare_avx2", 4, 0, mix_s32_avx2, mix_s32_c);
+	}
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s32_0_neon", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s32_neon);
+		run_test("test_s32_1_neon", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s32_neon);
+		run_test("test_s32_4_neon", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s32_neon);
+		run_test_compare("test_s32_compare_neon", 4, 0, mix_s32_neon, mix_s32_c);
+	}
+#endif
 }
 
 static void test_u32(void)
@@ -203,6 +285,30 @@ static void test_s24_32(void)
 	run_test("test_s24_32_0", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s24_32_c);
 	run_test("test_s24_32_1", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s24_32_c);
 	run_test("test_s24_32_4", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s24_32_c);
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_CPU_FLAG_SSE2) {
+		run_test("test_s24_32_0_sse2", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s24_32_sse2);
+		run_test("test_s24_32_1_sse2", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s24_32_sse2);
+		run_test("test_s24_32_4_sse2", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s24_32_sse2);
+		run_test_compare("test_s24_32_compare_sse2", 4, 8, mix_s24_32_sse2, mix_s24_32_c);
+	}
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_CPU_FLAG_AVX2) {
+		run_test("test_s24_32_0_avx2", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s24_32_avx2);
+		run_test("test_s24_32_1_avx2", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s24_32_avx2);
+		run_test("test_s24_32_4_avx2", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s24_32_avx2);
+		run_test_compare("test_s24_32_compare_avx2", 4, 8, mix_s24_32_avx2, mix_s24_32_c);
+	}
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_s24_32_0_neon", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_s24_32_neon);
+		run_test("test_s24_32_1_neon", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_s24_32_neon);
+		run_test("test_s24_32_4_neon", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_s24_32_neon);
+		run_test_compare("test_s24_32_compare_neon", 4, 8, mix_s24_32_neon, mix_s24_32_c);
+	}
+#endif
 }
 
 static void test_u24_32(void)
@@ -247,6 +353,13 @@ static void test_f32(void)
 		run_test("test_f32_4_avx", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_f32_avx);
 	}
 #endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON) {
+		run_test("test_f32_0_neon", NULL, 0, out, sizeof(out), SPA_N_ELEMENTS(out), mix_f32_neon);
+		run_test("test_f32_1_neon", src, 1, in_1, sizeof(in_1), SPA_N_ELEMENTS(in_1), mix_f32_neon);
+		run_test("test_f32_4_neon", src, 4, out_4, sizeof(out_4), SPA_N_ELEMENTS(out_4), mix_f32_neon);
+	}
+#endif
 }
 
 static void test_f64(void)
@@ -32,11 +32,14 @@
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
 #include <spa/support/system.h>
+#include <spa/support/thread.h>
+#include <spa/support/plugin-loader.h>
 #include <spa/utils/list.h>
 #include <spa/utils/keys.h>
 #include <spa/utils/names.h>
 #include <spa/utils/result.h>
 #include <spa/utils/string.h>
+#include <spa/utils/ringbuffer.h>
 #include <spa/monitor/device.h>
 
 #include <spa/node/node.h>
@@ -73,6 +76,7 @@ struct props {
 #define MIN_LATENCY	128
 #define MAX_LATENCY	8192
 #define BUFFER_SIZE	(MAX_LATENCY*8)
+#define RING_SIZE	(BUFFER_SIZE*4)
 
 struct buffer {
 	uint32_t id;
@@ -110,6 +114,25 @@ struct port {
 	size_t ready_offset;
 };
 
+/* encoding and sending can be done in a separate thread. The data
+ * thread then only copies the samples into the ring, together with the
+ * time of the cycle. The encoding state, like need_flush and the buffer,
+ * is only used from the flush loop. */
+struct encoder {
+	struct spa_handle *handle;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+	struct spa_thread *thread;
+	bool running;
+
+	struct spa_source source;
+	int eventfd;
+
+	struct spa_ringbuffer ring;
+	uint8_t *ring_data;
+	uint64_t time;			/* current_time of the last data in the ring */
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_node node;
@@ -117,6 +140,13 @@ struct impl {
 	struct spa_log *log;
 	struct spa_loop *data_loop;
 	struct spa_system *data_system;
+	struct spa_plugin_loader *loader;
+	struct spa_thread_utils *thread_utils;
+
+	/* the loop where the encoding and flushing is done, this is
+	 * the data loop or the loop of the encoder */
+	struct spa_loop *flush_loop;
+	struct encoder encoder;
 
 	struct spa_hook_list hooks;
 	struct spa_callbacks callbacks;
@@ -604,7 +634,7 @@ static void enable_flush(struct impl *this, bool enabled, uint64_t timeout)
 
 	if (SPA_FLAG_IS_SET(this->flush_source.mask, SPA_IO_OUT) != flush_enabled) {
 		SPA_FLAG_UPDATE(this->flush_source.mask, SPA_IO_OUT, flush_enabled);
-		spa_loop_update_source(this->data_loop, &this->flush_source);
+		spa_loop_update_source(this->flush_loop, &this->flush_source);
 	}
 
 	if (!enabled)
@@ -618,6 +648,62 @@ static void enable_flush(struct impl *this, bool enabled, uint64_t timeout)
 			this->flush_timerfd, 0, &ts, NULL);
 }
 
+static inline bool have_data(struct impl *this)
+{
+	if (this->encoder.ring_data) {
+		uint32_t index;
+		return spa_ringbuffer_get_read_index(&this->encoder.ring, &index) > 0;
+	}
+	return !spa_list_is_empty(&this->port.ready);
+}
+
+/* the time of the data that is flushed, the data thread updates the
+ * current time while the encoder is flushing */
+static inline uint64_t get_flush_time(struct impl *this)
+{
+	if (this->encoder.ring_data)
+		return __atomic_load_n(&this->encoder.time, __ATOMIC_RELAXED);
+	return this->current_time;
+}
+
+static int encode_ring(struct impl *this, uint32_t *total_frames)
+{
+	struct encoder *e = &this->encoder;
+	struct port *port = &this->port;
+	int32_t avail;
+	uint32_t index, offs, l0, l1;
+	int res, written = 0;
+
+	while (!this->need_flush) {
+		avail = spa_ringbuffer_get_read_index(&e->ring, &index);
+		if (avail <= 0)
+			break;
+
+		offs = index & (RING_SIZE - 1);
+		l0 = SPA_MIN((uint32_t)avail, RING_SIZE - offs);
+		l1 = avail - l0;
+
+		written = add_data(this, e->ring_data + offs, l0);
+		if (written == (int)l0 && l1 > 0 &&
+		    (res = add_data(this, e->ring_data, l1)) > 0)
+			written += res;
+		if (written <= 0) {
+			if (written < 0 && written != -ENOSPC) {
+				spa_log_warn(this->log, "%p: error %s, drop %d bytes",
+						this, spa_strerror(written), avail);
+				spa_ringbuffer_read_update(&e->ring, index + avail);
+			}
+			break;
+		}
+		spa_ringbuffer_read_update(&e->ring, index + written);
+
+		*total_frames += written / port->frame_size;
+
+		spa_log_trace(this->log, "%p: written %u frames", this, *total_frames);
+	}
+	return written;
+}
+
 static int flush_data(struct impl *this, uint64_t now_time)
 {
 	int written;
@@ -641,6 +727,9 @@ again:
 			return res;
 		}
 	}
+	if (this->encoder.ring_data)
+		written = encode_ring(this, &total_frames);
+
 	while (!spa_list_is_empty(&port->ready) && !this->need_flush) {
 		uint8_t *src;
 		uint32_t n_bytes, n_frames;
@@ -770,7 +859,7 @@ again:
 			}
 			this->last_error = now_time;
 		}
-		if (!spa_list_is_empty(&port->ready)) {
+		if (have_data(this)) {
 			spa_log_trace(this->log, "%p: flush after %d ns", this, (int)timeout);
 			if (timeout == 0)
 				goto again;
@@ -797,7 +886,7 @@ static void a2dp_on_flush(struct spa_source *source)
 	if (!SPA_FLAG_IS_SET(source->rmask, SPA_IO_OUT)) {
 		spa_log_warn(this->log, "%p: error %d", this, source->rmask);
 		if (this->flush_source.loop)
-			spa_loop_remove_source(this->data_loop, &this->flush_source);
+			spa_loop_remove_source(this->flush_loop, &this->flush_source);
 		return;
 	}
 
@@ -806,7 +895,7 @@ static void a2dp_on_flush(struct spa_source *source)
 		return;
 	}
 
-	flush_data(this, this->current_time);
+	flush_data(this, get_flush_time(this));
 }
 
 static void a2dp_on_flush_timeout(struct spa_source *source)
@@ -824,7 +913,23 @@ static void a2dp_on_flush_timeout(struct spa_source *source)
 		return;
 	}
 
-	flush_data(this, this->current_time);
+	flush_data(this, get_flush_time(this));
+}
+
+static void a2dp_on_encode(struct spa_source *source)
+{
+	struct impl *this = source->data;
+	uint64_t count;
+
+	if (spa_system_eventfd_read(this->data_system, this->encoder.eventfd, &count) < 0)
+		spa_log_warn(this->log, "error reading eventfd: %s", strerror(errno));
+
+	if (this->transport == NULL || !this->flush_source.loop)
+		return;
+
+	if (this->need_flush)
+		reset_buffer(this);
+	flush_data(this, get_flush_time(this));
 }
 
 static void a2dp_on_timeout(struct spa_source *source)
@@ -883,6 +988,17 @@ static void a2dp_on_timeout(struct spa_source *source)
 	set_timeout(this, this->next_time);
 }
 
+static int do_reset_buffer(struct spa_loop *loop,
+			    bool async,
+			    uint32_t seq,
+			    const void *data,
+			    size_t size,
+			    void *user_data)
+{
+	struct impl *this = user_data;
+	return reset_buffer(this);
+}
+
 static int do_start(struct impl *this)
 {
 	int i, res, val, size;
@@ -959,7 +1075,7 @@ static int do_start(struct impl *this)
 	if (setsockopt(this->transport->fd, SOL_SOCKET, SO_PRIORITY, &val, sizeof(val)) < 0)
 		spa_log_warn(this->log, "SO_PRIORITY failed: %m");
 
-	reset_buffer(this);
+	spa_loop_invoke(this->flush_loop, do_reset_buffer, 0, NULL, 0, true, this);
 
 	this->source.data = this;
 	this->source.fd = this->timerfd;
@@ -973,14 +1089,24 @@ static int do_start(struct impl *this)
 	this->flush_timer_source.func = a2dp_on_flush_timeout;
 	this->flush_timer_source.mask = SPA_IO_IN;
 	this->flush_timer_source.rmask = 0;
-	spa_loop_add_source(this->data_loop, &this->flush_timer_source);
+	spa_loop_add_source(this->flush_loop, &this->flush_timer_source);
 
 	this->flush_source.data = this;
 	this->flush_source.fd = this->transport->fd;
 	this->flush_source.func = a2dp_on_flush;
 	this->flush_source.mask = 0;
 	this->flush_source.rmask = 0;
-	spa_loop_add_source(this->data_loop, &this->flush_source);
+	spa_loop_add_source(this->flush_loop, &this->flush_source);
+
+	if (this->encoder.ring_data) {
+		spa_ringbuffer_init(&this->encoder.ring);
+		this->encoder.source.data = this;
+		this->encoder.source.fd = this->encoder.eventfd;
+		this->encoder.source.func = a2dp_on_encode;
+		this->encoder.source.mask = SPA_IO_IN;
+		this->encoder.source.rmask = 0;
+		spa_loop_add_source(this->flush_loop, &this->encoder.source);
+	}
 
 	set_timers(this);
 	this->started = true;
@@ -1006,11 +1132,27 @@ static int do_remove_source(struct spa_loop *loop,
 	ts.it_interval.tv_nsec = 0;
 	spa_system_timerfd_settime(this->data_system, this->timerfd, 0, &ts, NULL);
 
+	return 0;
+}
+
+static int do_remove_flush_source(struct spa_loop *loop,
+			    bool async,
+			    uint32_t seq,
+			    const void *data,
+			    size_t size,
+			    void *user_data)
+{
+	struct impl *this = user_data;
+	struct itimerspec ts;
+
+	if (this->encoder.source.loop)
+		spa_loop_remove_source(this->flush_loop, &this->encoder.source);
+
 	if (this->flush_source.loop)
-		spa_loop_remove_source(this->data_loop, &this->flush_source);
+		spa_loop_remove_source(this->flush_loop, &this->flush_source);
 
 	if (this->flush_timer_source.loop)
-		spa_loop_remove_source(this->data_loop, &this->flush_timer_source);
+		spa_loop_remove_source(this->flush_loop, &this->flush_timer_source);
 	ts.it_value.tv_sec = 0;
 	ts.it_value.tv_nsec = 0;
 	ts.it_interval.tv_sec = 0;
@@ -1030,6 +1172,7 @@ static int do_stop(struct impl *this)
         spa_log_trace(this->log, "%p: stop", this);
 
 	spa_loop_invoke(this->data_loop, do_remove_source, 0, NULL, 0, true, this);
+	spa_loop_invoke(this->flush_loop, do_remove_flush_source, 0, NULL, 0, true, this);
 
 	this->started = false;
 
@@ -1452,6 +1595,48 @@ static int impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t
 	return -ENOTSUP;
 }
 
+static void update_current_time(struct impl *this)
+{
+	if (this->position) {
+		this->current_time = this->position->clock.nsec;
+	} else {
+		struct timespec now;
+		spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &now);
+		this->current_time = SPA_TIMESPEC_TO_NSEC(&now);
+	}
+}
+
+static void write_ring(struct impl *this, struct buffer *b)
+{
+	struct encoder *e = &this->encoder;
+	struct port *port = &this->port;
+	struct spa_data *d = b->buf->datas;
+	uint32_t index, offs, size, l0, l1;
+	int32_t filled;
+
+	offs = d[0].chunk->offset % d[0].maxsize;
+	size = SPA_MIN(d[0].chunk->size, d[0].maxsize);
+	size -= size % port->frame_size;
+
+	filled = spa_ringbuffer_get_write_index(&e->ring, &index);
+	if (filled < 0 || filled + size > RING_SIZE) {
+		spa_log_debug(this->log, "%p: encoder overrun, drop %u bytes", this, size);
+		return;
+	}
+
+	l0 = SPA_MIN(size, d[0].maxsize - offs);
+	l1 = size - l0;
+	spa_ringbuffer_write_data(&e->ring, e->ring_data, RING_SIZE,
+			index & (RING_SIZE - 1), SPA_PTROFF(d[0].data, offs, void), l0);
+	if (l1 > 0)
+		spa_ringbuffer_write_data(&e->ring, e->ring_data, RING_SIZE,
+				(index + l0) & (RING_SIZE - 1), d[0].data, l1);
+	__atomic_store_n(&e->time, this->current_time, __ATOMIC_RELAXED);
+	spa_ringbuffer_write_update(&e->ring, index + size);
+
+	spa_system_eventfd_write(this->data_system, e->eventfd, 1);
+}
+
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
@@ -1478,6 +1663,17 @@ static int impl_node_process(void *object)
 			return -EINVAL;
 		}
 
+		if (this->encoder.ring_data) {
+			/* copy to the encoder and recycle the buffer right away */
+			if (this->following)
+				update_current_time(this);
+			write_ring(this, b);
+			io->buffer_id = b->id;
+			io->status = SPA_STATUS_OK;
+			spa_node_call_reuse_buffer(&this->callbacks, 0, b->id);
+			return SPA_STATUS_HAVE_DATA;
+		}
+
 		spa_log_trace(this->log, "%p: queue buffer %u", this, io->buffer_id);
 
 		spa_list_append(&port->ready, &b->link);
@@ -1487,15 +1683,8 @@ static int impl_node_process(void *object)
 		io->status = SPA_STATUS_OK;
 	}
 	if (!spa_list_is_empty(&port->ready)) {
-		if (this->following) {
-			if (this->position) {
-				this->current_time = this->position->clock.nsec;
-			} else {
-				struct timespec now;
-				spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &now);
-				this->current_time = SPA_TIMESPEC_TO_NSEC(&now);
-			}
-		}
+		if (this->following)
+			update_current_time(this);
 		if (this->need_flush)
 			reset_buffer(this);
 		flush_data(this, this->current_time);
@@ -1547,6 +1736,9 @@ static void transport_destroy(void *data)
 	struct impl *this = data;
 	spa_log_debug(this->log, "transport %p destroy", this->transport);
 	spa_loop_invoke(this->data_loop, do_transport_destroy, 0, NULL, 0, true, this);
+	/* make sure the encoder is not using the transport anymore */
+	if (this->flush_loop != this->data_loop)
+		spa_loop_invoke(this->flush_loop, NULL, 0, NULL, 0, true, this);
 }
 
 static void transport_state_changed(void *data,
@@ -1589,6 +1781,110 @@ static const struct spa_bt_transport_events transport_events = {
 	.destroy = transport_destroy,
 };
 
+static void *encoder_thread(void *data)
+{
+	struct impl *this = data;
+	struct encoder *e = &this->encoder;
+
+	spa_log_debug(this->log, "%p: encoder thread enter", this);
+
+	spa_loop_control_enter(e->control);
+	while (e->running)
+		spa_loop_control_iterate(e->control, -1);
+	spa_loop_control_leave(e->control);
+
+	spa_log_debug(this->log, "%p: encoder thread leave", this);
+
+	return NULL;
+}
+
+static int do_encoder_stop(struct spa_loop *loop,
+			    bool async,
+			    uint32_t seq,
+			    const void *data,
+			    size_t size,
+			    void *user_data)
+{
+	struct impl *this = user_data;
+	this->encoder.running = false;
+	return 0;
+}
+
+static void encoder_clear(struct impl *this)
+{
+	struct encoder *e = &this->encoder;
+
+	if (e->thread) {
+		spa_loop_invoke(e->loop, do_encoder_stop, 0, NULL, 0, false, this);
+		spa_thread_utils_join(this->thread_utils, e->thread, NULL);
+		e->thread = NULL;
+	}
+	if (e->eventfd > 0)
+		spa_system_close(this->data_system, e->eventfd);
+	e->eventfd = -1;
+	if (e->handle)
+		spa_plugin_loader_unload(this->loader, e->handle);
+	e->handle = NULL;
+	free(e->ring_data);
+	e->ring_data = NULL;
+	this->flush_loop = this->data_loop;
+}
+
+static int encoder_init(struct impl *this)
+{
+	struct encoder *e = &this->encoder;
+	struct spa_dict_item items[1];
+	void *iface;
+	int res;
+
+	if (this->loader == NULL || this->thread_utils == NULL) {
+		spa_log_warn(this->log, "%p: no plugin loader or thread utils, "
+				"encoding in the data thread", this);
+		return -ENOTSUP;
+	}
+	if ((e->ring_data = calloc(1, RING_SIZE)) == NULL)
+		return -errno;
+
+	e->eventfd = spa_system_eventfd_create(this->data_system,
+			SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
+	if (e->eventfd < 0) {
+		res = e->eventfd;
+		goto error;
+	}
+
+	if ((e->handle = spa_plugin_loader_load(this->loader, SPA_NAME_SUPPORT_LOOP, NULL)) == NULL) {
+		res = -errno;
+		goto error;
+	}
+	if ((res = spa_handle_get_interface(e->handle, SPA_TYPE_INTERFACE_Loop, &iface)) < 0)
+		goto error;
+	e->loop = iface;
+	if ((res = spa_handle_get_interface(e->handle, SPA_TYPE_INTERFACE_LoopControl, &iface)) < 0)
+		goto error;
+	e->control = iface;
+
+	e->running = true;
+	items[0] = SPA_DICT_ITEM_INIT(SPA_KEY_THREAD_NAME, "a2dp-encoder");
+	e->thread = spa_thread_utils_create(this->thread_utils,
+			&SPA_DICT_INIT_ARRAY(items), encoder_thread, this);
+	if (e->thread == NULL) {
+		res = -errno;
+		goto error;
+	}
+	spa_thread_utils_acquire_rt(this->thread_utils, e->thread, -1);
+
+	this->flush_loop = e->loop;
+
+	spa_log_info(this->log, "%p: encoding in separate thread", this);
+	return 0;
+
+error:
+	spa_log_warn(this->log, "%p: can't create encoder thread: %s, "
+			"encoding in the data thread", this, spa_strerror(res));
+	encoder_clear(this);
+	return res;
+}
+
 static int impl_get_interface(struct spa_handle *handle, const char *type, void **interface)
 {
 	struct impl *this;
@@ -1616,6 +1912,7 @@ static int impl_clear(struct spa_handle *handle)
 		this->codec->clear_props(this->codec_props);
 	if (this->transport)
 		spa_hook_remove(&this->transport_listener);
+	encoder_clear(this);
 	spa_system_close(this->data_system, this->timerfd);
 	spa_system_close(this->data_system, this->flush_timerfd);
 	return 0;
@@ -1650,6 +1947,8 @@ impl_init(const struct spa_handle_factory *factory,
 	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
 	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
 	this->data_system = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataSystem);
+	this->loader = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_PluginLoader);
+	this->thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
 
 	spa_log_topic_init(this->log, &log_topic);
 
@@ -1661,6 +1960,8 @@ impl_init(const struct spa_handle_factory *factory,
 		spa_log_error(this->log, "a data system is needed");
 		return -EINVAL;
 	}
+	this->flush_loop = this->data_loop;
+	this->encoder.eventfd = -1;
 
 	this->node.iface = SPA_INTERFACE_INIT(
 			SPA_TYPE_INTERFACE_Node,
@@ -1742,6 +2043,12 @@ impl_init(const struct spa_handle_factory *factory,
 	this->flush_timerfd = spa_system_timerfd_create(this->data_system,
 			CLOCK_MONOTONIC, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK);
 
+	if ((info == NULL || (str = spa_dict_lookup(info, "bluez5.a2dp.encoder-thread")) == NULL) &&
+	    this->transport->device->settings != NULL)
+		str = spa_dict_lookup(this->transport->device->settings, "bluez5.a2dp.encoder-thread");
+	if (str != NULL && spa_atob(str))
+		encoder_init(this);
+
 	return 0;
 }
 
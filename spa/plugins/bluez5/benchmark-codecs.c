@@ -0,0 +1,632 @@
+/* Spa Bluez5 codec benchmark
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <limits.h>
+#include <dlfcn.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/plugin-loader.h>
+#include <spa/support/log.h>
+#include <spa/utils/names.h>
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+
+#include "codec-loader.h"
+
+/*
+ * Encodes a sine wave with every codec, at every configuration the
+ * codec can select and at every bitpool/ABR level, then decodes the
+ * result again when the codec can decode. Reports the throughput as
+ * a multiple of realtime, the worst time spent on one packet and the
+ * SNR of the round trip.
+ */
+
+#define MTU		1024
+#define DURATION	2	/* seconds of audio per run */
+#define MAX_RATE	96000
+#define MAX_CHANNELS	8
+#define MAX_SAMPLES	(MAX_RATE * DURATION * MAX_CHANNELS)
+#define MAX_LEVELS	8
+#define MAX_CONFIGS	32
+#define MAX_LAG		8192
+
+#define TONE_FREQ	1000.0
+#define TONE_AMP	0.5
+
+static const uint32_t rates[] = { 16000, 32000, 44100, 48000, 88200, 96000 };
+static const uint32_t channels[] = { 1, 2, 6, 8 };
+
+struct stats {
+	uint64_t n_frames;
+	uint64_t n_packets;
+	uint64_t total_time;
+	uint64_t max_time;
+};
+
+static struct spa_log *logger;
+
+/* input and output samples, as float and in the codec format */
+static float samp_ref[MAX_SAMPLES];
+static float samp_dec[MAX_SAMPLES];
+static uint8_t pcm_in[MAX_SAMPLES * 4];
+static uint8_t pcm_out[MAX_SAMPLES * 4 + 65536];
+static uint8_t packets[MAX_SAMPLES * 4];
+static uint32_t packet_sizes[MAX_SAMPLES / 64];
+
+static inline uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/* plugin loader for the codec loader */
+struct plugin {
+	struct spa_handle *handle;
+	void *hnd;
+};
+
+static const char *plugin_dir(void)
+{
+	const char *str;
+	if ((str = getenv("SPA_PLUGIN_DIR")) == NULL)
+		str = PLUGINDIR;
+	return str;
+}
+
+static struct spa_handle *load_handle(const char *lib, const char *factory_name,
+		const struct spa_dict *info, void **hnd_out)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	const struct spa_handle_factory *factory;
+	struct spa_support support[1];
+	uint32_t i, n_support = 0;
+	struct spa_handle *handle;
+	char path[PATH_MAX];
+	void *hnd;
+	int res;
+
+	snprintf(path, sizeof(path), "%s/%s.so", plugin_dir(), lib);
+
+	if ((hnd = dlopen(path, RTLD_NOW)) == NULL) {
+		res = -ENOENT;
+		goto error;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		res = -ENXIO;
+		goto error_close;
+	}
+	for (i = 0;;) {
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			res = res < 0 ? res : -ENOENT;
+			goto error_close;
+		}
+		if (spa_streq(factory->name, factory_name))
+			break;
+	}
+	if (logger)
+		support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Log, logger);
+
+	if ((handle = calloc(1, spa_handle_factory_get_size(factory, info))) == NULL) {
+		res = -errno;
+		goto error_close;
+	}
+	if ((res = spa_handle_factory_init(factory, handle, info, support, n_support)) < 0) {
+		free(handle);
+		goto error_close;
+	}
+	*hnd_out = hnd;
+	return handle;
+
+error_close:
+	dlclose(hnd);
+error:
+	errno = -res;
+	return NULL;
+}
+
+static struct plugin plugins[16];
+
+static struct spa_handle *loader_load(void *object, const char *factory_name, const struct spa_dict *info)
+{
+	const char *lib;
+	uint32_t i;
+
+	if (info == NULL || (lib = spa_dict_lookup(info, SPA_KEY_LIBRARY_NAME)) == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	for (i = 0; i < SPA_N_ELEMENTS(plugins); i++) {
+		if (plugins[i].handle == NULL) {
+			plugins[i].handle = load_handle(lib, factory_name, info, &plugins[i].hnd);
+			return plugins[i].handle;
+		}
+	}
+	errno = ENOSPC;
+	return NULL;
+}
+
+static int loader_unload(void *object, struct spa_handle *handle)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(plugins); i++) {
+		if (plugins[i].handle != handle)
+			continue;
+		spa_handle_clear(handle);
+		free(handle);
+		dlclose(plugins[i].hnd);
+		spa_zero(plugins[i]);
+		return 0;
+	}
+	return -ENOENT;
+}
+
+static const struct spa_plugin_loader_methods loader_methods = {
+	SPA_VERSION_PLUGIN_LOADER_METHODS,
+	.load = loader_load,
+	.unload = loader_unload,
+};
+
+static struct spa_plugin_loader loader;
+
+/* sample conversion */
+static uint32_t sample_size(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_S16:
+		return 2;
+	case SPA_AUDIO_FORMAT_S24:
+		return 3;
+	case SPA_AUDIO_FORMAT_S24_32:
+	case SPA_AUDIO_FORMAT_S32:
+	case SPA_AUDIO_FORMAT_F32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static void write_sample(uint32_t format, uint8_t *d, float v)
+{
+	int32_t s;
+
+	switch (format) {
+	case SPA_AUDIO_FORMAT_S16:
+		*(int16_t*)d = (int16_t)lrintf(v * 32767.0f);
+		break;
+	case SPA_AUDIO_FORMAT_S24:
+		s = (int32_t)lrintf(v * 8388607.0f);
+		d[0] = s;
+		d[1] = s >> 8;
+		d[2] = s >> 16;
+		break;
+	case SPA_AUDIO_FORMAT_S24_32:
+		*(int32_t*)d = (int32_t)lrintf(v * 8388607.0f);
+		break;
+	case SPA_AUDIO_FORMAT_S32:
+		*(int32_t*)d = (int32_t)lrint(v * 2147483647.0);
+		break;
+	case SPA_AUDIO_FORMAT_F32:
+		*(float*)d = v;
+		break;
+	}
+}
+
+static float read_sample(uint32_t format, const uint8_t *d)
+{
+	int32_t s;
+
+	switch (format) {
+	case SPA_AUDIO_FORMAT_S16:
+		return *(const int16_t*)d / 32767.0f;
+	case SPA_AUDIO_FORMAT_S24:
+		s = (int32_t)(((uint32_t)d[2] << 24) | ((uint32_t)d[1] << 16) | ((uint32_t)d[0] << 8)) >> 8;
+		return s / 8388607.0f;
+	case SPA_AUDIO_FORMAT_S24_32:
+		return *(const int32_t*)d / 8388607.0f;
+	case SPA_AUDIO_FORMAT_S32:
+		return (float)(*(const int32_t*)d / 2147483647.0);
+	case SPA_AUDIO_FORMAT_F32:
+		return *(const float*)d;
+	}
+	return 0.0f;
+}
+
+static uint32_t gen_input(const struct spa_audio_info_raw *info)
+{
+	uint32_t i, c, n_frames = info->rate * DURATION;
+	uint32_t ssize = sample_size(info->format);
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < info->channels; c++) {
+			/* a different phase per channel catches swapped channels */
+			float v = TONE_AMP * sinf(2.0f * M_PI * TONE_FREQ * i / info->rate + c);
+			samp_ref[i * info->channels + c] = v;
+			write_sample(info->format, &pcm_in[(i * info->channels + c) * ssize], v);
+		}
+	}
+	return n_frames;
+}
+
+/* find the codec delay and return the SNR of the first channel */
+static double calc_snr(const struct spa_audio_info_raw *info, uint32_t n_in, uint32_t n_out)
+{
+	uint32_t i, lag, best_lag = 0, start, len;
+	uint32_t nch = info->channels;
+	double best = -INFINITY, sig = 0.0, err = 0.0;
+
+	start = info->rate / 4;
+	if (n_out < start + MAX_LAG + 1024 || n_in < start + 1024)
+		return NAN;
+	len = SPA_MIN(n_out - start - MAX_LAG, n_in - start);
+	len = SPA_MIN(len, info->rate / 2);
+
+	for (lag = 0; lag < MAX_LAG; lag++) {
+		double corr = 0.0;
+		for (i = 0; i < len; i += 4)
+			corr += samp_ref[(start + i) * nch] * samp_dec[(start + i + lag) * nch];
+		if (corr > best) {
+			best = corr;
+			best_lag = lag;
+		}
+	}
+	for (i = 0; i < len; i++) {
+		double r = samp_ref[(start + i) * nch];
+		double d = samp_dec[(start + i + best_lag) * nch] - r;
+		sig += r * r;
+		err += d * d;
+	}
+	if (err == 0.0)
+		return INFINITY;
+	return 10.0 * log10(sig / err);
+}
+
+static int encode_all(const struct a2dp_codec *codec, void *enc,
+		const struct spa_audio_info_raw *info, uint32_t n_frames,
+		uint32_t *n_packets, struct stats *st)
+{
+	uint32_t frame_size = sample_size(info->format) * info->channels;
+	uint32_t in_size = n_frames * frame_size, in_offs = 0;
+	uint32_t out_offs = 0, block_size;
+	uint16_t seqnum = 0;
+	int res;
+
+	block_size = codec->get_block_size(enc);
+	*n_packets = 0;
+
+	while (in_offs + block_size <= in_size &&
+	    *n_packets < SPA_N_ELEMENTS(packet_sizes)) {
+		uint8_t *pkt = &packets[out_offs];
+		size_t avail = sizeof(packets) - out_offs, used, out;
+		int need_flush = NEED_FLUSH_NO;
+		bool fragment;
+		uint64_t t1, t2;
+
+		if (avail < MTU)
+			break;
+
+		t1 = get_time();
+
+		if ((res = codec->start_encode(enc, pkt, avail, seqnum++,
+				in_offs / frame_size)) < 0)
+			return res;
+		used = res;
+
+		while (need_flush == NEED_FLUSH_NO && in_offs + block_size <= in_size) {
+			if ((res = codec->encode(enc, &pcm_in[in_offs], block_size,
+					pkt + used, avail - used, &out, &need_flush)) < 0)
+				return res;
+			in_offs += res;
+			used += out;
+			if (res == 0 && out == 0)
+				break;
+		}
+
+		t2 = get_time();
+		st->total_time += t2 - t1;
+		st->max_time = SPA_MAX(st->max_time, t2 - t1);
+		st->n_packets++;
+
+		packet_sizes[(*n_packets)++] = used;
+		out_offs += used;
+
+		/* the rest of this frame goes in the next packets */
+		fragment = need_flush == NEED_FLUSH_FRAGMENT;
+		while (fragment && *n_packets < SPA_N_ELEMENTS(packet_sizes)) {
+			pkt = &packets[out_offs];
+			avail = sizeof(packets) - out_offs;
+			if (avail < MTU)
+				break;
+
+			t1 = get_time();
+			if ((res = codec->start_encode(enc, pkt, avail, seqnum++,
+					in_offs / frame_size)) < 0)
+				return res;
+			used = res;
+			if ((res = codec->encode(enc, NULL, 0, pkt + used, avail - used,
+					&out, &need_flush)) < 0)
+				return res;
+			used += out;
+			t2 = get_time();
+			st->total_time += t2 - t1;
+			st->max_time = SPA_MAX(st->max_time, t2 - t1);
+			st->n_packets++;
+
+			packet_sizes[(*n_packets)++] = used;
+			out_offs += used;
+			fragment = need_flush == NEED_FLUSH_FRAGMENT;
+		}
+	}
+	st->n_frames += in_offs / frame_size;
+	return 0;
+}
+
+static int decode_all(const struct a2dp_codec *codec, void *dec,
+		const struct spa_audio_info_raw *info, uint32_t n_packets,
+		uint32_t *n_frames, struct stats *st)
+{
+	uint32_t i, c, frame_size = sample_size(info->format) * info->channels;
+	uint32_t in_offs = 0, out_offs = 0;
+	int res;
+
+	for (i = 0; i < n_packets; i++) {
+		const uint8_t *src = &packets[in_offs];
+		size_t src_size = packet_sizes[i], written;
+		uint64_t t1, t2;
+
+		in_offs += packet_sizes[i];
+
+		t1 = get_time();
+		if ((res = codec->start_decode(dec, src, src_size, NULL, NULL)) < 0)
+			return res;
+		src += res;
+		src_size -= res;
+
+		while (src_size > 0) {
+			size_t avail = sizeof(pcm_out) - out_offs;
+
+			if ((res = codec->decode(dec, src, src_size,
+					&pcm_out[out_offs], avail, &written)) <= 0)
+				break;
+			src += res;
+			src_size -= res;
+			out_offs += written;
+		}
+		t2 = get_time();
+		st->total_time += t2 - t1;
+		st->max_time = SPA_MAX(st->max_time, t2 - t1);
+		st->n_packets++;
+
+		if (res < 0)
+			return res;
+	}
+	*n_frames = SPA_MIN(out_offs / frame_size, MAX_SAMPLES / info->channels);
+	for (i = 0; i < *n_frames; i++) {
+		for (c = 0; c < info->channels; c++)
+			samp_dec[i * info->channels + c] = read_sample(info->format,
+					&pcm_out[(i * info->channels + c) * sample_size(info->format)]);
+	}
+	st->n_frames += *n_frames;
+	return 0;
+}
+
+static void print_stats(const char *what, const struct stats *st, uint32_t rate)
+{
+	double audio = (double)st->n_frames / rate;
+	double cpu = st->total_time / 1e9;
+
+	fprintf(stdout, " %s %.1fx realtime, max %"PRIu64" ns/packet", what,
+			cpu > 0.0 ? audio / cpu : 0.0, st->max_time);
+}
+
+static void run_level(const struct a2dp_codec *codec, void *enc, void *dec,
+		const struct spa_audio_info_raw *info, uint32_t n_in, int level, int value)
+{
+	struct stats enc_st, dec_st;
+	uint32_t n_packets = 0, n_out = 0;
+	int res;
+
+	spa_zero(enc_st);
+	spa_zero(dec_st);
+
+	fprintf(stdout, "%-16s %6u Hz %u ch fmt %-6s level %d (%d):", codec->name,
+			info->rate, info->channels,
+			info->format == SPA_AUDIO_FORMAT_F32 ? "F32" :
+			info->format == SPA_AUDIO_FORMAT_S16 ? "S16" :
+			info->format == SPA_AUDIO_FORMAT_S24 ? "S24" :
+			info->format == SPA_AUDIO_FORMAT_S24_32 ? "S24_32" : "S32",
+			level, value);
+
+	if ((res = encode_all(codec, enc, info, n_in, &n_packets, &enc_st)) < 0) {
+		fprintf(stdout, " encode error: %s\n", spa_strerror(res));
+		return;
+	}
+	print_stats("enc", &enc_st, info->rate);
+	fprintf(stdout, " %"PRIu64" packets", enc_st.n_packets);
+
+	if (dec != NULL) {
+		memset(pcm_out, 0, sizeof(pcm_out));
+		if ((res = decode_all(codec, dec, info, n_packets, &n_out, &dec_st)) < 0) {
+			fprintf(stdout, " decode error: %s\n", spa_strerror(res));
+			return;
+		}
+		print_stats("dec", &dec_st, info->rate);
+		fprintf(stdout, " SNR %.1f dB", calc_snr(info, n_in, n_out));
+	}
+	fprintf(stdout, "\n");
+}
+
+static void *codec_init(const struct a2dp_codec *codec, uint32_t flags,
+		uint8_t *config, size_t config_size, struct spa_audio_info *info,
+		void **props)
+{
+	*props = codec->init_props ? codec->init_props(codec, flags, NULL) : NULL;
+	return codec->init(codec, flags, config, config_size, info, *props, MTU);
+}
+
+static void codec_clear(const struct a2dp_codec *codec, void *data, void *props)
+{
+	if (data)
+		codec->deinit(data);
+	if (props && codec->clear_props)
+		codec->clear_props(props);
+}
+
+static void run_config(const struct a2dp_codec *codec, uint8_t *config, size_t config_size)
+{
+	struct spa_audio_info info;
+	void *enc, *dec = NULL, *enc_props, *dec_props = NULL;
+	int level, res, prev = INT32_MIN;
+	uint32_t n_in;
+
+	spa_zero(info);
+	if ((res = codec->validate_config(codec, 0, config, config_size, &info)) < 0) {
+		fprintf(stdout, "%-16s invalid config: %s\n", codec->name, spa_strerror(res));
+		return;
+	}
+	if (sample_size(info.info.raw.format) == 0 ||
+	    info.info.raw.channels > MAX_CHANNELS ||
+	    info.info.raw.rate > MAX_RATE) {
+		fprintf(stdout, "%-16s unsupported format\n", codec->name);
+		return;
+	}
+
+	if ((enc = codec_init(codec, 0, config, config_size, &info, &enc_props)) == NULL) {
+		fprintf(stdout, "%-16s can't init encoder: %m\n", codec->name);
+		codec_clear(codec, NULL, enc_props);
+		return;
+	}
+	n_in = gen_input(&info.info.raw);
+
+	for (level = 0; level < MAX_LEVELS; level++) {
+		if (level > 0) {
+			if (codec->reduce_bitpool == NULL ||
+			    (res = codec->reduce_bitpool(enc)) < 0 || res == prev)
+				break;
+			prev = res;
+		}
+		/* a fresh decoder for each run, so that its state starts clean */
+		if (codec->decode != NULL)
+			dec = codec_init(codec, A2DP_CODEC_FLAG_SINK, config, config_size,
+					&info, &dec_props);
+
+		run_level(codec, enc, dec, &info.info.raw, n_in, level, level > 0 ? prev : 0);
+
+		codec_clear(codec, dec, dec_props);
+		dec = dec_props = NULL;
+	}
+	codec_clear(codec, enc, enc_props);
+}
+
+static void run_codec(const struct a2dp_codec *codec)
+{
+	uint8_t caps[A2DP_MAX_CAPS_SIZE];
+	uint8_t configs[MAX_CONFIGS][A2DP_MAX_CAPS_SIZE];
+	size_t config_sizes[MAX_CONFIGS];
+	uint32_t i, j, k, n_configs = 0;
+	int caps_size, res;
+
+	if (codec->fill_caps == NULL || codec->select_config == NULL ||
+	    codec->validate_config == NULL || codec->encode == NULL)
+		return;
+
+	if ((caps_size = codec->fill_caps(codec, 0, caps)) < 0) {
+		fprintf(stdout, "%-16s can't get caps: %s\n", codec->name, spa_strerror(caps_size));
+		return;
+	}
+
+	/* every distinct config the codec selects for some rate and channels */
+	for (i = 0; i < SPA_N_ELEMENTS(rates); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(channels); j++) {
+			struct a2dp_codec_audio_info info = {
+				.rate = rates[i], .channels = channels[j] };
+			uint8_t config[A2DP_MAX_CAPS_SIZE];
+
+			if ((res = codec->select_config(codec, 0, caps, caps_size,
+					&info, NULL, config)) < 0)
+				continue;
+
+			for (k = 0; k < n_configs; k++) {
+				if (config_sizes[k] == (size_t)res &&
+				    memcmp(configs[k], config, res) == 0)
+					break;
+			}
+			if (k < n_configs || n_configs == MAX_CONFIGS)
+				continue;
+
+			memcpy(configs[n_configs], config, res);
+			config_sizes[n_configs++] = res;
+		}
+	}
+	if (n_configs == 0)
+		fprintf(stdout, "%-16s no usable config\n", codec->name);
+
+	for (k = 0; k < n_configs; k++)
+		run_config(codec, configs[k], config_sizes[k]);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct a2dp_codec * const *codecs;
+	struct spa_handle *log_handle;
+	void *iface, *hnd = NULL;
+	uint32_t i;
+
+	loader.iface = SPA_INTERFACE_INIT(SPA_TYPE_INTERFACE_PluginLoader,
+			SPA_VERSION_PLUGIN_LOADER, &loader_methods, NULL);
+
+	log_handle = load_handle("support/libspa-support", SPA_NAME_SUPPORT_LOG, NULL, &hnd);
+	if (log_handle != NULL &&
+	    spa_handle_get_interface(log_handle, SPA_TYPE_INTERFACE_Log, &iface) >= 0)
+		logger = iface;
+
+	if ((codecs = load_a2dp_codecs(&loader, logger)) == NULL) {
+		fprintf(stderr, "can't load codecs from %s: %m\n", plugin_dir());
+		return -1;
+	}
+
+	for (i = 0; codecs[i]; i++) {
+		if (argc > 1 && !spa_streq(argv[1], codecs[i]->name))
+			continue;
+		run_codec(codecs[i]);
+	}
+
+	free_a2dp_codecs(codecs);
+
+	if (log_handle != NULL) {
+		spa_handle_clear(log_handle);
+		free(log_handle);
+		dlclose(hnd);
+	}
+	return 0;
+}
@@ -60,7 +60,7 @@ struct invoke_item {
 	size_t size;
 	bool block;
 	void *user_data;
-	int res;
+	int *res;
 };
 
 static int loop_signal_event(void *object, struct spa_source *source);
@@ -84,10 +84,16 @@ struct impl {
 
 	struct spa_source *wakeup;
 	int ack_fd;
+	pthread_mutex_t invoke_lock;	/* serializes blocking invokes */
 
+	/* the queue of invoke items. Producers reserve space by moving the
+	 * writeindex and then mark the item as committed, the loop only
+	 * moves the readindex. */
 	struct spa_ringbuffer buffer;
 	uint8_t *buffer_data;
 	uint8_t buffer_mem[DATAS_SIZE + MAX_ALIGN];
+	uint32_t commit[DATAS_SIZE / ITEM_ALIGN];
+	uint32_t wakeup_pending;
 
 	unsigned int flushing:1;
 	unsigned int polling:1;
@@ -166,21 +172,33 @@ static int loop_remove_source(void *object, struct spa_source *source)
 
 static void flush_items(struct impl *impl)
 {
-	uint32_t index;
+	uint32_t index, offset;
 	int res;
 
 	impl->flushing = true;
 	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
 		struct invoke_item *item;
 		bool block;
+		int *item_res;
+
+		offset = index & (DATAS_SIZE - 1);
 
-		item = SPA_PTROFF(impl->buffer_data, index & (DATAS_SIZE - 1), struct invoke_item);
+		/* reserved but not filled yet, the producer will wake us up
+		 * when it is committed */
+		if (!__atomic_load_n(&impl->commit[offset / ITEM_ALIGN], __ATOMIC_ACQUIRE))
+			break;
+		impl->commit[offset / ITEM_ALIGN] = 0;
+
+		item = SPA_PTROFF(impl->buffer_data, offset, struct invoke_item);
 		block = item->block;
+		item_res = item->res;
 
 		spa_log_trace_fp(impl->log, "%p: flush item %p", impl, item);
-		item->res = item->func ? item->func(&impl->loop,
+		res = item->func ? item->func(&impl->loop,
 				true, item->seq, item->data, item->size,
 			   item->user_data) : 0;
+		if (item_res)
+			*item_res = res;
 
 		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
 
@@ -207,90 +225,124 @@ loop_invoke_inthread(struct impl *impl,
 	return func ? func(&impl->loop, true, seq, data, size, user_data) : 0;
 }
 
-static int
-loop_invoke(void *object,
-	    spa_invoke_func_t func,
-	    uint32_t seq,
-	    const void *data,
-	    size_t size,
-	    bool block,
-	    void *user_data)
+/* the space used by an item with size bytes of data at index. When the item
+ * and data don't fit at the end of the ringbuffer, the data is placed at the
+ * start. When there is no space for another item after this one, the item
+ * fills up the ringbuffer so that the next item starts at the start. */
+static uint32_t item_layout(uint32_t index, size_t size, bool *wrap)
 {
-	struct impl *impl = object;
-	struct invoke_item *item;
-	int res;
+	uint32_t offset = index & (DATAS_SIZE - 1);
+	uint32_t l0 = DATAS_SIZE - offset;
+	uint32_t item_size = SPA_ROUND_UP_N(sizeof(struct invoke_item) + size, ITEM_ALIGN);
+
+	if (l0 >= item_size) {
+		*wrap = false;
+		if (l0 < sizeof(struct invoke_item) + item_size)
+			item_size = l0;
+	} else {
+		*wrap = true;
+		item_size = SPA_ROUND_UP_N(l0 + size, ITEM_ALIGN);
+	}
+	return item_size;
+}
+
+/* queue an item from any thread without locks. The loop is only signaled
+ * when it has no wakeup pending. */
+static int queue_item(struct impl *impl, spa_invoke_func_t func, uint32_t seq,
+		const void *data, size_t size, bool block, void *user_data, int *res)
+{
+	uint32_t idx, offset, item_size, avail;
 	int32_t filled;
-	uint32_t avail, idx, offset, l0;
+	struct invoke_item *item;
+	bool wrap;
+
+	idx = __atomic_load_n(&impl->buffer.writeindex, __ATOMIC_RELAXED);
+	do {
+		filled = idx - __atomic_load_n(&impl->buffer.readindex, __ATOMIC_ACQUIRE);
+		if (filled < 0 || filled > DATAS_SIZE) {
+			spa_log_warn(impl->log, "%p: queue xrun %d", impl, filled);
+			return -EPIPE;
+		}
+		avail = DATAS_SIZE - filled;
+		item_size = item_layout(idx, size, &wrap);
 
-	if (impl->thread == 0 || pthread_equal(impl->thread, pthread_self()))
-		return loop_invoke_inthread(impl, func, seq, data, size, block, user_data);
+		if (avail < item_size) {
+			spa_log_warn(impl->log, "%p: queue full %d, need %u", impl, avail,
+					item_size);
+			return -EPIPE;
+		}
+	} while (!__atomic_compare_exchange_n(&impl->buffer.writeindex, &idx, idx + item_size,
+				true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
 
-	filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
-	if (filled < 0 || filled > DATAS_SIZE) {
-		spa_log_warn(impl->log, "%p: queue xrun %d", impl, filled);
-		return -EPIPE;
-	}
-	avail = DATAS_SIZE - filled;
-	if (avail < sizeof(struct invoke_item)) {
-		spa_log_warn(impl->log, "%p: queue full %d", impl, avail);
-		return -EPIPE;
-	}
 	offset = idx & (DATAS_SIZE - 1);
-
-	/* l0 is remaining size in ringbuffer, this should always be larger than
-	 * invoke_item, see below */
-	l0 = DATAS_SIZE - offset;
-
 	item = SPA_PTROFF(impl->buffer_data, offset, struct invoke_item);
+	item->item_size = item_size;
 	item->func = func;
 	item->seq = seq;
 	item->size = size;
 	item->block = block;
 	item->user_data = user_data;
-	item->item_size = SPA_ROUND_UP_N(sizeof(struct invoke_item) + size, ITEM_ALIGN);
-
-	spa_log_trace_fp(impl->log, "%p: add item %p filled:%d", impl, item, filled);
+	item->res = res;
+	item->data = wrap ? impl->buffer_data :
+		SPA_PTROFF(item, sizeof(struct invoke_item), void);
 
-	if (l0 >= item->item_size) {
-		/* item + size fit in current ringbuffer idx */
-		item->data = SPA_PTROFF(item, sizeof(struct invoke_item), void);
-		if (l0 < sizeof(struct invoke_item) + item->item_size) {
-			/* not enough space for next invoke_item, fill up till the end
-			 * so that the next item will be at the start */
-			item->item_size = l0;
-		}
-	} else {
-		/* item does not fit, place the invoke_item at idx and start the
-		 * data at the start of the ringbuffer */
-		item->data = impl->buffer_data;
-		item->item_size = SPA_ROUND_UP_N(l0 + size, ITEM_ALIGN);
-	}
-	if (avail < item->item_size) {
-		spa_log_warn(impl->log, "%p: queue full %d, need %zd", impl, avail,
-				item->item_size);
-		return -EPIPE;
-	}
 	if (data && size > 0)
 		memcpy(item->data, data, size);
 
-	spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
+	spa_log_trace_fp(impl->log, "%p: add item %p filled:%d", impl, item, filled);
+
+	__atomic_store_n(&impl->commit[offset / ITEM_ALIGN], 1, __ATOMIC_RELEASE);
+
+	if (!__atomic_exchange_n(&impl->wakeup_pending, 1, __ATOMIC_ACQ_REL))
+		loop_signal_event(impl, impl->wakeup);
+
+	return 0;
+}
+
+static int
+loop_invoke(void *object,
+	    spa_invoke_func_t func,
+	    uint32_t seq,
+	    const void *data,
+	    size_t size,
+	    bool block,
+	    void *user_data)
+{
+	struct impl *impl = object;
+	int res;
 
-	loop_signal_event(impl, impl->wakeup);
+	if (impl->thread == 0 || pthread_equal(impl->thread, pthread_self()))
+		return loop_invoke_inthread(impl, func, seq, data, size, block, user_data);
 
 	if (block) {
 		uint64_t count = 1;
+		int item_res = 0;
 
+		/* the hooks release the locks of the caller, such as the
+		 * pw_thread_loop lock, do this before waiting for the invoke_lock
+		 * so that another blocking caller does not wait for us with
+		 * that lock held. */
 		spa_loop_control_hook_before(&impl->hooks_list);
 
-		if ((res = spa_system_eventfd_read(impl->system, impl->ack_fd, &count)) < 0)
-			spa_log_warn(impl->log, "%p: failed to read event fd: %s",
-					impl, spa_strerror(res));
+		/* there is only one ack_fd, let one blocking caller wait on it
+		 * at a time */
+		pthread_mutex_lock(&impl->invoke_lock);
+		if ((res = queue_item(impl, func, seq, data, size, true,
+						user_data, &item_res)) >= 0) {
+			if ((res = spa_system_eventfd_read(impl->system, impl->ack_fd, &count)) < 0)
+				spa_log_warn(impl->log, "%p: failed to read event fd: %s",
+						impl, spa_strerror(res));
+			res = item_res;
+		}
+		pthread_mutex_unlock(&impl->invoke_lock);
 
 		spa_loop_control_hook_after(&impl->hooks_list);
-
-		res = item->res;
 	}
 	else {
+		if ((res = queue_item(impl, func, seq, data, size, false,
+						user_data, NULL)) < 0)
+			return res;
+
 		if (seq != SPA_ID_INVALID)
 			res = SPA_RESULT_RETURN_ASYNC(seq);
 		else
@@ -302,6 +354,8 @@ loop_invoke(void *object,
 static void wakeup_func(void *data, uint64_t count)
 {
 	struct impl *impl = data;
+	/* items queued from now on need a new wakeup */
+	__atomic_exchange_n(&impl->wakeup_pending, 0, __ATOMIC_ACQ_REL);
 	flush_items(impl);
 }
 
@@ -876,6 +930,8 @@ static int impl_clear(struct spa_handle *handle)
 	spa_system_close(impl->system, impl->ack_fd);
 	spa_system_close(impl->system, impl->poll_fd);
 
+	pthread_mutex_destroy(&impl->invoke_lock);
+
 	return 0;
 }
 
@@ -954,6 +1010,8 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	impl->ack_fd = res;
 
+	pthread_mutex_init(&impl->invoke_lock, NULL);
+
 	spa_log_debug(impl->log, "%p: initialized", impl);
 
 	return 0;
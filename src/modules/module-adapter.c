@@ -200,6 +200,14 @@ static void *create_object(void *_data,
 				pw_impl_client_get_info(client)->id);
 	}
 
+	/* select the data loop before loading the follower so that the
+	 * plugin and the node run in the same loop */
+	if (pw_properties_get(properties, PW_KEY_NODE_LOOP_NAME) == NULL) {
+		struct pw_loop *loop = pw_context_acquire_loop(d->context, &properties->dict);
+		pw_properties_set(properties, PW_KEY_NODE_LOOP_NAME, loop->name);
+		pw_context_release_loop(d->context, loop);
+	}
+
 	follower = NULL;
 	spa_follower = NULL;
 	str = pw_properties_get(properties, "adapt.follower.node");
@@ -106,12 +106,9 @@ set_iovec(struct spa_ringbuffer *rbuf, void *buffer, uint32_t size,
 static int flush_write(struct stream *stream, uint64_t current_time)
 {
 	int32_t avail;
-	uint32_t index;
+	uint32_t index, i, n_pdus;
         uint64_t ptime, txtime;
-	int pdu_count;
-	ssize_t n;
-	struct avb_frame_header *h = (void*)stream->pdu;
-	struct avb_packet_iec61883 *p = SPA_PTROFF(h, sizeof(*h), void);
+	int pdu_count, n;
 	uint8_t dbc;
 
 	avail = spa_ringbuffer_get_read_index(&stream->ring, &index);
@@ -122,29 +119,45 @@ static int flush_write(struct stream *stream, uint64_t current_time)
 	ptime = txtime + stream->mtt;
 	dbc = stream->dbc;
 
-	while (pdu_count--) {
-		*(uint64_t*)CMSG_DATA(stream->cmsg) = txtime;
+	while (pdu_count > 0) {
+		n_pdus = SPA_MIN(pdu_count, MAX_PDU_BATCH);
+
+		/* each pdu gets its own header and launch time, the payload
+		 * is sent from the ringbuffer without copying */
+		for (i = 0; i < n_pdus; i++) {
+			struct avb_frame_header *h = (void*)stream->hdr[i];
+			struct avb_packet_iec61883 *p = SPA_PTROFF(h, sizeof(*h), void);
+
+			memcpy(h, stream->pdu, stream->hdr_size);
+			*(uint64_t*)CMSG_DATA(stream->cmsg[i]) = txtime;
+
+			set_iovec(&stream->ring,
+				stream->buffer_data,
+				stream->buffer_size,
+				index % stream->buffer_size,
+				&stream->iov[i][1], stream->payload_size);
 
-		set_iovec(&stream->ring,
-			stream->buffer_data,
-			stream->buffer_size,
-			index % stream->buffer_size,
-			&stream->iov[1], stream->payload_size);
+			p->seq_num = stream->pdu_seq++;
+			p->tv = 1;
+			p->timestamp = ptime;
+			p->dbc = dbc;
 
-		p->seq_num = stream->pdu_seq++;
-		p->tv = 1;
-		p->timestamp = ptime;
-		p->dbc = dbc;
+			txtime += stream->pdu_period;
+			ptime += stream->pdu_period;
+			index += stream->payload_size;
+			dbc += stream->frames_per_pdu;
+		}
 
-		n = sendmsg(stream->source->fd, &stream->msg, 0);
-		if (n < 0 || n != (ssize_t)stream->pdu_size) {
-			pw_log_error("sendmsg() failed %zd != %zd: %m",
-					n, stream->pdu_size);
+		n = sendmmsg(stream->source->fd, stream->mmsg, n_pdus, 0);
+		stream->n_syscalls++;
+		if (n < 0) {
+			pw_log_error("sendmmsg() failed: %m");
+		} else {
+			stream->n_packets += n;
+			if (n != (int)n_pdus)
+				pw_log_error("sendmmsg() sent %d of %u pdus", n, n_pdus);
 		}
-		txtime += stream->pdu_period;
-		ptime += stream->pdu_period;
-		index += stream->payload_size;
-		dbc += stream->frames_per_pdu;
+		pdu_count -= n_pdus;
 	}
 	stream->dbc = dbc;
 	spa_ringbuffer_read_update(&stream->ring, index);
@@ -230,22 +243,31 @@ static void setup_pdu(struct stream *stream)
 
 static int setup_msg(struct stream *stream)
 {
-	stream->iov[0].iov_base = stream->pdu;
-	stream->iov[0].iov_len = stream->hdr_size;
-	stream->iov[1].iov_base = SPA_PTROFF(stream->pdu, stream->hdr_size, void);
-	stream->iov[1].iov_len = stream->payload_size;
-	stream->iov[2].iov_base = SPA_PTROFF(stream->pdu, stream->hdr_size, void);
-	stream->iov[2].iov_len = 0;
-	stream->msg.msg_name = &stream->sock_addr;
-	stream->msg.msg_namelen = sizeof(stream->sock_addr);
-	stream->msg.msg_iov = stream->iov;
-	stream->msg.msg_iovlen = 3;
-	stream->msg.msg_control = stream->control;
-	stream->msg.msg_controllen = sizeof(stream->control);
-	stream->cmsg = CMSG_FIRSTHDR(&stream->msg);
-	stream->cmsg->cmsg_level = SOL_SOCKET;
-	stream->cmsg->cmsg_type = SCM_TXTIME;
-	stream->cmsg->cmsg_len = CMSG_LEN(sizeof(__u64));
+	uint32_t i;
+
+	spa_assert(stream->hdr_size <= MAX_HDR_SIZE);
+
+	for (i = 0; i < MAX_PDU_BATCH; i++) {
+		struct msghdr *msg = &stream->mmsg[i].msg_hdr;
+		struct iovec *iov = stream->iov[i];
+
+		iov[0].iov_base = stream->hdr[i];
+		iov[0].iov_len = stream->hdr_size;
+		iov[1].iov_base = stream->buffer_data;
+		iov[1].iov_len = stream->payload_size;
+		iov[2].iov_base = stream->buffer_data;
+		iov[2].iov_len = 0;
+		msg->msg_name = &stream->sock_addr;
+		msg->msg_namelen = sizeof(stream->sock_addr);
+		msg->msg_iov = iov;
+		msg->msg_iovlen = 3;
+		msg->msg_control = stream->control[i];
+		msg->msg_controllen = sizeof(stream->control[i]);
+		stream->cmsg[i] = CMSG_FIRSTHDR(msg);
+		stream->cmsg[i]->cmsg_level = SOL_SOCKET;
+		stream->cmsg[i]->cmsg_type = SCM_TXTIME;
+		stream->cmsg[i]->cmsg_len = CMSG_LEN(sizeof(__u64));
+	}
 	return 0;
 }
 
@@ -573,6 +595,10 @@ int stream_deactivate(struct stream *stream, uint64_t now)
 {
 	pw_stream_set_active(stream->stream, false);
 
+	if (stream->n_syscalls > 0)
+		pw_log_info("stream %p: sent %"PRIu64" pdus in %"PRIu64" syscalls",
+				stream, stream->n_packets, stream->n_syscalls);
+
 	if (stream->source != NULL) {
 		pw_loop_destroy_source(stream->server->impl->loop, stream->source);
 		stream->source = NULL;
@@ -38,6 +38,9 @@
 #define BUFFER_SIZE	(1u<<16)
 #define BUFFER_MASK	(BUFFER_SIZE-1)
 
+#define MAX_PDU_BATCH	64
+#define MAX_HDR_SIZE	64
+
 struct stream {
 	struct spa_list link;
 
@@ -70,11 +73,14 @@ struct stream {
 	uint8_t prev_seq;
 	uint8_t dbc;
 
-	struct iovec iov[3];
 	struct sockaddr_ll sock_addr;
-	struct msghdr msg;
-	char control[CMSG_SPACE(sizeof(uint64_t))];
-	struct cmsghdr *cmsg;
+	struct mmsghdr mmsg[MAX_PDU_BATCH];
+	struct iovec iov[MAX_PDU_BATCH][3];
+	uint8_t hdr[MAX_PDU_BATCH][MAX_HDR_SIZE];
+	char control[MAX_PDU_BATCH][CMSG_SPACE(sizeof(uint64_t))];
+	struct cmsghdr *cmsg[MAX_PDU_BATCH];
+	uint64_t n_packets;
+	uint64_t n_syscalls;
 
 	struct spa_ringbuffer ring;
 	void *buffer_data;
@@ -1734,6 +1734,11 @@ struct pw_impl_client_node *pw_impl_client_node_new(struct pw_resource *resource
 	if (this->node == NULL)
 		goto error_no_node;
 
+	/* the node can run in another data loop than the default one we
+	 * initialized with, depending on node.loop.name and device.id */
+	impl->node.data_loop = this->node->data_loop->loop;
+	impl->node.data_system = this->node->data_loop->system;
+
 	this->node->remote = true;
 	this->flags = 0;
 
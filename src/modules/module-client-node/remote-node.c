@@ -127,7 +127,7 @@ static void clear_link(struct node_data *data, struct link *link)
 {
 	struct pw_context *context = data->context;
 	pw_log_debug("link %p", link);
-	pw_loop_invoke(context->data_loop,
+	pw_loop_invoke(data->node->data_loop,
 		do_deactivate_link, SPA_ID_INVALID, NULL, 0, true, link);
 	pw_memmap_free(link->map);
 	spa_system_close(context->data_system, link->signalfd);
@@ -186,7 +186,7 @@ deactivate_mix(struct node_data *data, struct mix *mix)
 {
 	if (mix->active) {
 		pw_log_debug("node %p: mix %p deactivate", data, mix);
-		pw_loop_invoke(data->context->data_loop,
+		pw_loop_invoke(data->node->data_loop,
                        do_deactivate_mix, SPA_ID_INVALID, NULL, 0, true, mix);
 		mix->active = false;
 	}
@@ -208,7 +208,7 @@ activate_mix(struct node_data *data, struct mix *mix)
 {
 	if (!mix->active) {
 		pw_log_debug("node %p: mix %p activate", data, mix);
-		pw_loop_invoke(data->context->data_loop,
+		pw_loop_invoke(data->node->data_loop,
                        do_activate_mix, SPA_ID_INVALID, NULL, 0, false, mix);
 		mix->active = true;
 	}
@@ -935,7 +935,7 @@ client_node_set_activation(void *_data,
 		link->target.node = NULL;
 		spa_list_append(&data->links, &link->link);
 
-		pw_loop_invoke(data->context->data_loop,
+		pw_loop_invoke(data->node->data_loop,
                        do_activate_link, SPA_ID_INVALID, NULL, 0, false, link);
 
 		pw_log_debug("node %p: link %p: fd:%d id:%u state %p required %d, pending %d",
@@ -73,6 +73,9 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
  * - `filter.graph = []`: a description of the filter graph to run, see below
  * - `capture.props = {}`: properties to be passed to the input stream
  * - `playback.props = {}`: properties to be passed to the output stream
+ * - `filter.threads = <n>`: the number of extra worker threads used to run the
+ *        graph instances in parallel, default 0. See below.
+ * - `filter.thread-affinity = [ <cpu> ... ]`: CPUs to pin the worker threads to.
  *
  * ## Filter graph description
  *
@@ -137,6 +140,23 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
  *
  * links can be omited when the graph has just 1 filter.
  *
+ * ### Parallel processing
+ *
+ * When the capture and playback streams have more channels than the graph
+ * has inputs and outputs, the graph is instantiated multiple times. The
+ * instances are independent and can be processed in parallel by setting
+ * `filter.threads` to the number of extra worker threads. The data thread
+ * and the workers take the instances one by one until all are taken, so the
+ * data thread runs the instances that no worker started yet itself. It then
+ * sleeps until the workers finished the instances that they are processing
+ * before the output is queued.
+ *
+ * The worker threads get realtime priority when available and can be pinned
+ * to CPUs with `filter.thread-affinity`. The average and maximum processing
+ * time of each instance and the number of cycles where the data thread had to
+ * wait longer than a cycle for the workers are logged once per second when the
+ * `mod.filter-chain.stats` log topic is enabled at info level.
+ *
  * ### Inputs and Outputs
  *
  * These are the entry and exit ports into the graph definition. Their number
@@ -191,6 +211,40 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
  * - `bq_notch` a notch filter.
  * - `bq_allpass` an allpass filter.
  *
+ * ### Parametric equalizer
+ *
+ * The `param_eq` filter runs a cascade of biquads on up to 8 channels at once.
+ * It is a faster alternative to a chain of `bq_*` nodes per channel because the
+ * channels are processed together with SIMD instructions when available.
+ *
+ * It has input ports "In 1" to "In 8" and output ports "Out 1" to "Out 8". Unused
+ * ports can be left unconnected. It requires a config section in the node
+ * declaration in this format:
+ *
+ *\code{.unparsed}
+ * filter.graph = {
+ *     nodes = [
+ *         {
+ *             type   = builtin
+ *             name   = ...
+ *             label  = param_eq
+ *             config = {
+ *                 bands = [
+ *                     { type = bq_peaking freq = 1000.0 Q = 1.0 gain = -3.0 }
+ *                     ...
+ *                 ]
+ *             }
+ *             ...
+ *         }
+ *     }
+ *     ...
+ * }
+ *\endcode
+ *
+ * - `bands` an array of up to 32 bands. Each band has a `type`, one of the biquad
+ *           labels above, and a `freq`, `Q` and `gain` with the same meaning as
+ *           the controls of the biquad filters.
+ *
  * ### Convolver
  *
  * The convolver can be used to apply an impulse response to a signal. It is usually used
@@ -210,6 +264,7 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
  *             config = {
  *                 blocksize = ...
  *                 tailsize = ...
+ *                 async = ...
  *                 gain = ...
  *                 delay = ...
  *                 filename = ...
@@ -227,7 +282,16 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
  * - `blocksize` specifies the size of the blocks to use in the FFT. It is a value
  *               between 64 and 256. When not specified, this value is
  *               computed automatically from the number of samples in the file.
- * - `tailsize` specifies the size of the tail blocks to use in the FFT.
+ * - `tailsize` specifies the size of the largest blocks to use in the FFT.
+ *               The IR is split in partitions that grow from `blocksize` to
+ *               `tailsize` in steps of 4, depending on the length of the IR.
+ *               Default 4096, or 16384 with `async`.
+ * - `async`    run the tail partitions of the FFT in a shared pool of realtime
+ *              worker threads. The tail is computed while the next tail block is
+ *              collected so that the data thread only processes the head blocks.
+ *              The data thread never waits for a worker. When a tail block is not
+ *              ready in time, that part of the tail is silent for one block and
+ *              restarts with the next one. Default false.
  * - `gain`     the overall gain to apply to the IR file.
  * - `delay`    The extra delay (in samples) to add to the IR.
  * - `filename` The IR to load or create. Possible values are:
@@ -242,6 +306,11 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
  * - `length`  The number of samples to use as the IR.
  * - `channel` The channel to use from the file as the IR.
  *
+ * The IR is loaded and transformed only once per process for convolvers with
+ * the same `filename`, `channel`, `gain`, `delay`, `offset`, `length`,
+ * `blocksize` and `tailsize`. The transformed IR is shared between those
+ * convolvers.
+ *
  * ### Delay
  *
  * The delay can be used to delay a signal in time.
@@ -417,7 +486,9 @@ static const struct spa_dict_item module_props[] = {
 				"    outputs = [ <portname> ... ] "
 				"] "
 				"[ capture.props=<properties> ] "
-				"[ playback.props=<properties> ] " },
+				"[ playback.props=<properties> ] "
+				"[ filter.threads=<number of worker threads> ] "
+				"[ filter.thread-affinity=<array of cpus> ] " },
 	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
 };
 
@@ -428,6 +499,9 @@ static const struct spa_dict_item module_props[] = {
 #include <getopt.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
 
 #include <spa/utils/result.h>
 #include <spa/pod/builder.h>
@@ -435,9 +509,13 @@ static const struct spa_dict_item module_props[] = {
 #include <spa/param/audio/raw.h>
 
 #include <pipewire/pipewire.h>
+#include <pipewire/thread.h>
 
 #define MAX_HNDL 64
 #define MAX_SAMPLES 8192
+#define MAX_WORKERS 32u
+
+PW_LOG_TOPIC_STATIC(stats_topic, "mod." NAME ".stats");
 
 static float silence_data[MAX_SAMPLES];
 static float discard_data[MAX_SAMPLES];
@@ -543,10 +621,31 @@ struct graph {
 	uint32_t n_hndl;
 	struct graph_hndl *hndl;
 
+	uint32_t n_instance;
+
+	/* silence and discard buffers for each instance when the instances
+	 * run in parallel */
+	float *scratch;
+
 	uint32_t n_control;
 	struct port **control_port;
 };
 
+/* updated by the thread that runs the instance, read and cleared by the
+ * stats timer. All fields are accessed atomically. */
+struct instance_stats {
+	uint64_t total;
+	uint64_t max;
+	uint64_t count;
+};
+
+struct worker {
+	struct impl *impl;
+	uint32_t id;
+	struct spa_thread *thread;
+	sem_t start;
+};
+
 struct impl {
 	struct pw_context *context;
 
@@ -575,8 +674,272 @@ struct impl {
 	long unsigned rate;
 
 	struct graph graph;
+
+	struct spa_thread_utils *thread_utils;
+	uint32_t n_threads;
+	uint32_t n_workers;
+	struct worker workers[MAX_WORKERS];
+	bool workers_running;
+	uint32_t n_samples;
+	uint32_t next_instance;
+	uint32_t done_instances;
+	/* posted by the worker that finishes the last instance */
+	sem_t done;
+	uint32_t late_cycles;
+
+	struct spa_source *stats_timer;
+	struct instance_stats stats[MAX_HNDL];
 };
 
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+/* run all nodes of one instance of the graph. The handles are ordered
+ * per node and then per instance so we need to stride over them. */
+static void run_instance(struct impl *impl, uint32_t instance, uint32_t n_samples)
+{
+	struct graph *graph = &impl->graph;
+	struct instance_stats *st = &impl->stats[instance];
+	uint32_t i;
+	uint64_t t1, t2;
+
+	t1 = impl->n_workers > 0 ? get_time_ns() : 0;
+
+	for (i = instance; i < graph->n_hndl; i += graph->n_instance) {
+		struct graph_hndl *hndl = &graph->hndl[i];
+		hndl->desc->run(hndl->hndl, n_samples);
+	}
+
+	if (impl->n_workers > 0) {
+		uint64_t max = __atomic_load_n(&st->max, __ATOMIC_RELAXED);
+
+		t2 = get_time_ns() - t1;
+		__atomic_fetch_add(&st->total, t2, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&st->count, 1, __ATOMIC_RELAXED);
+		while (t2 > max && !__atomic_compare_exchange_n(&st->max, &max, t2,
+					true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	}
+}
+
+/* take instances until all of them are taken. This is done by the data
+ * thread and the workers so that the data thread never needs to wait for
+ * a worker that did not start yet. Returns true when the caller finished
+ * the last instance. */
+static bool run_worker_instances(struct impl *impl)
+{
+	uint32_t i, n_instance = impl->graph.n_instance;
+	bool last = false;
+
+	while ((i = __atomic_fetch_add(&impl->next_instance, 1, __ATOMIC_ACQ_REL)) < n_instance) {
+		run_instance(impl, i, impl->n_samples);
+		if (__atomic_add_fetch(&impl->done_instances, 1, __ATOMIC_ACQ_REL) == n_instance)
+			last = true;
+	}
+	return last;
+}
+
+static void *worker_thread(void *data)
+{
+	struct worker *w = data;
+	struct impl *impl = w->impl;
+
+	while (true) {
+		while (sem_wait(&w->start) < 0 && errno == EINTR);
+
+		if (!__atomic_load_n(&impl->workers_running, __ATOMIC_ACQUIRE))
+			break;
+
+		if (run_worker_instances(impl))
+			sem_post(&impl->done);
+	}
+	return NULL;
+}
+
+static void graph_run(struct impl *impl, uint32_t n_samples)
+{
+	struct graph *graph = &impl->graph;
+	uint32_t i, n_workers = SPA_MIN(impl->n_workers, graph->n_instance - 1);
+	struct timespec abstime;
+	uint64_t timeout_ns, deadline;
+	int res;
+
+	if (n_workers == 0) {
+		for (i = 0; i < graph->n_hndl; i++) {
+			struct graph_hndl *hndl = &graph->hndl[i];
+			hndl->desc->run(hndl->hndl, n_samples);
+		}
+		return;
+	}
+
+	impl->n_samples = n_samples;
+	__atomic_store_n(&impl->done_instances, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&impl->next_instance, 0, __ATOMIC_RELEASE);
+	for (i = 0; i < n_workers; i++)
+		sem_post(&impl->workers[i].start);
+
+	if (run_worker_instances(impl))
+		return;
+
+	/* all instances are taken and a worker is still processing some of
+	 * them. They can't be run here, their buffers are in use, so sleep
+	 * until the worker that finishes the last one posts. Wait at most one
+	 * cycle at a time and count the cycles where the workers were late. */
+	timeout_ns = (uint64_t)n_samples * SPA_NSEC_PER_SEC / SPA_MAX(impl->rate, 1lu);
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	deadline = SPA_TIMESPEC_TO_NSEC(&abstime);
+
+	do {
+		deadline += timeout_ns;
+		abstime.tv_sec = deadline / SPA_NSEC_PER_SEC;
+		abstime.tv_nsec = deadline % SPA_NSEC_PER_SEC;
+
+		while ((res = sem_timedwait(&impl->done, &abstime)) < 0 && errno == EINTR);
+		if (res < 0)
+			__atomic_fetch_add(&impl->late_cycles, 1, __ATOMIC_RELAXED);
+	} while (res < 0);
+}
+
+static void stats_timeout(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	struct graph *graph = &impl->graph;
+	char avg[1024], max[1024];
+	uint32_t i, late;
+	int avg_len = 0, max_len = 0;
+
+	if (!pw_log_topic_enabled(SPA_LOG_LEVEL_INFO, stats_topic))
+		return;
+
+	for (i = 0; i < graph->n_instance; i++) {
+		struct instance_stats *st = &impl->stats[i];
+		uint64_t total, count, m;
+
+		/* an update that runs concurrently can be split over two
+		 * intervals, that only moves one sample to the next interval */
+		total = __atomic_exchange_n(&st->total, 0, __ATOMIC_RELAXED);
+		count = __atomic_exchange_n(&st->count, 0, __ATOMIC_RELAXED);
+		m = __atomic_exchange_n(&st->max, 0, __ATOMIC_RELAXED);
+
+		avg_len += snprintf(avg + avg_len, sizeof(avg) - avg_len, "%s%"PRIu64,
+				i == 0 ? "[ " : " ", (count ? total / count : 0) / 1000);
+		max_len += snprintf(max + max_len, sizeof(max) - max_len, "%s%"PRIu64,
+				i == 0 ? "[ " : " ", m / 1000);
+		if (avg_len >= (int)sizeof(avg) - 3 || max_len >= (int)sizeof(max) - 3)
+			break;
+	}
+	snprintf(avg + avg_len, sizeof(avg) - avg_len, " ]");
+	snprintf(max + max_len, sizeof(max) - max_len, " ]");
+
+	late = __atomic_exchange_n(&impl->late_cycles, 0, __ATOMIC_RELAXED);
+
+	pw_logt_info(stats_topic, "%p: instance usec avg:%s max:%s late:%u",
+			impl, avg, max, late);
+}
+
+static void parse_affinity(const char *str, cpu_set_t *cpus, uint32_t *n_cpus)
+{
+	struct spa_json it[2];
+	int cpu;
+
+	CPU_ZERO(cpus);
+	*n_cpus = 0;
+
+	spa_json_init(&it[0], str, strlen(str));
+	if (spa_json_enter_array(&it[0], &it[1]) <= 0)
+		spa_json_init(&it[1], str, strlen(str));
+
+	while (spa_json_get_int(&it[1], &cpu) > 0) {
+		if (cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, cpus);
+			(*n_cpus)++;
+		}
+	}
+}
+
+static void stop_workers(struct impl *impl)
+{
+	uint32_t i;
+
+	if (impl->n_workers == 0)
+		return;
+
+	__atomic_store_n(&impl->workers_running, false, __ATOMIC_RELEASE);
+	for (i = 0; i < impl->n_workers; i++) {
+		struct worker *w = &impl->workers[i];
+		sem_post(&w->start);
+		spa_thread_utils_join(impl->thread_utils, w->thread, NULL);
+		sem_destroy(&w->start);
+	}
+	sem_destroy(&impl->done);
+	impl->n_workers = 0;
+}
+
+static int start_workers(struct impl *impl, uint32_t n_workers, const char *affinity)
+{
+	cpu_set_t cpus;
+	uint32_t i, n_cpus = 0;
+	char name[64];
+	struct spa_dict_item items[1];
+	int res;
+
+	n_workers = SPA_MIN(n_workers, MAX_WORKERS);
+	if (n_workers == 0)
+		return 0;
+
+	if (affinity)
+		parse_affinity(affinity, &cpus, &n_cpus);
+
+	impl->thread_utils = pw_context_get_object(impl->context, SPA_TYPE_INTERFACE_ThreadUtils);
+	if (impl->thread_utils == NULL)
+		impl->thread_utils = pw_thread_utils_get();
+
+	impl->workers_running = true;
+	sem_init(&impl->done, 0, 0);
+
+	for (i = 0; i < n_workers; i++) {
+		struct worker *w = &impl->workers[i];
+
+		w->impl = impl;
+		w->id = i + 1;
+		sem_init(&w->start, 0, 0);
+
+		snprintf(name, sizeof(name), "filter-chain-%u", w->id);
+		items[0] = SPA_DICT_ITEM_INIT(SPA_KEY_THREAD_NAME, name);
+
+		w->thread = spa_thread_utils_create(impl->thread_utils,
+				&SPA_DICT_INIT_ARRAY(items), worker_thread, w);
+		if (w->thread == NULL) {
+			res = -errno;
+			sem_destroy(&w->start);
+			pw_log_error("can't create worker thread: %m");
+			stop_workers(impl);
+			return res;
+		}
+		impl->n_workers++;
+
+		if (n_cpus > 0 &&
+		    (res = pthread_setaffinity_np((pthread_t)w->thread, sizeof(cpus), &cpus)) != 0)
+			pw_log_warn("can't set worker affinity: %s", strerror(res));
+
+		spa_thread_utils_acquire_rt(impl->thread_utils, w->thread, -1);
+	}
+	pw_log_info("using %d worker threads for %d instances",
+			impl->n_workers, impl->graph.n_instance);
+
+	impl->stats_timer = pw_loop_add_timer(pw_context_get_main_loop(impl->context),
+			stats_timeout, impl);
+	if (impl->stats_timer != NULL) {
+		struct timespec value = { 1, 0 }, interval = { 1, 0 };
+		pw_loop_update_timer(pw_context_get_main_loop(impl->context),
+				impl->stats_timer, &value, &interval, false);
+	}
+	return 0;
+}
+
 static void capture_destroy(void *d)
 {
 	struct impl *impl = d;
@@ -589,7 +952,7 @@ static void capture_process(void *d)
 	struct impl *impl = d;
 	struct pw_buffer *in, *out;
 	struct graph *graph = &impl->graph;
-	uint32_t i, outsize = 0, n_hndl = graph->n_hndl;
+	uint32_t i, outsize = 0;
 	int32_t stride = 0;
 	struct graph_port *port;
 	struct spa_data *bd;
@@ -636,10 +999,7 @@ static void capture_process(void *d)
 		bd->chunk->size = outsize;
 		bd->chunk->stride = stride;
 	}
-	for (i = 0; i < n_hndl; i++) {
-		struct graph_hndl *hndl = &graph->hndl[i];
-		hndl->desc->run(hndl->hndl, outsize / sizeof(float));
-	}
+	graph_run(impl, outsize / sizeof(float));
 
 done:
 	if (in != NULL)
@@ -1725,17 +2085,30 @@ static int setup_graph(struct graph *graph, struct spa_json *inputs, struct spa_
 	pw_log_info("using %d instances %d %d", n_hndl, n_input, n_output);
 
 	/* now go over all nodes and create instances. */
+	if (n_hndl > 1 && graph->impl->n_threads > 0) {
+		graph->scratch = calloc(n_hndl * 2 * MAX_SAMPLES, sizeof(float));
+		if (graph->scratch == NULL) {
+			res = -errno;
+			goto error;
+		}
+	}
+
 	n_control = 0;
 	n_nodes = 0;
 	spa_list_for_each(node, &graph->node_list, link) {
-		float *sd = silence_data, *dd = discard_data;
-
 		desc = node->desc;
 		d = desc->desc;
-		if (d->flags & FC_DESCRIPTOR_SUPPORTS_NULL_DATA)
-			sd = dd = NULL;
 
 		for (i = 0; i < n_hndl; i++) {
+			float *sd = silence_data, *dd = discard_data;
+
+			if (d->flags & FC_DESCRIPTOR_SUPPORTS_NULL_DATA) {
+				sd = dd = NULL;
+			} else if (graph->scratch != NULL) {
+				sd = graph->scratch + i * 2 * MAX_SAMPLES;
+				dd = sd + MAX_SAMPLES;
+			}
+
 			pw_log_info("instantiate %s %d", d->name, i);
 			if ((node->hndl[i] = d->instantiate(d, &impl->rate, i, node->config)) == NULL) {
 				pw_log_error("cannot create plugin instance: %m");
@@ -1880,6 +2253,7 @@ static int setup_graph(struct graph *graph, struct spa_json *inputs, struct spa_
 	}
 
 	/* order all nodes based on dependencies */
+	graph->n_instance = n_hndl;
 	graph->n_hndl = 0;
 	graph->hndl = calloc(n_nodes * n_hndl, sizeof(struct graph_hndl));
 	graph->n_control = 0;
@@ -2018,6 +2392,7 @@ static void graph_free(struct graph *graph)
 	free(graph->output);
 	free(graph->hndl);
 	free(graph->control_port);
+	free(graph->scratch);
 }
 
 static void core_error(void *data, uint32_t id, int seq, int res, const char *message)
@@ -2050,12 +2425,15 @@ static const struct pw_proxy_events core_proxy_events = {
 
 static void impl_destroy(struct impl *impl)
 {
+	if (impl->stats_timer)
+		pw_loop_destroy_source(pw_context_get_main_loop(impl->context), impl->stats_timer);
 	if (impl->capture)
 		pw_stream_destroy(impl->capture);
 	if (impl->playback)
 		pw_stream_destroy(impl->playback);
 	if (impl->core && impl->do_disconnect)
 		pw_core_disconnect(impl->core);
+	stop_workers(impl);
 	pw_properties_free(impl->capture_props);
 	pw_properties_free(impl->playback_props);
 	graph_free(&impl->graph);
@@ -2136,6 +2514,7 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	int res;
 
 	PW_LOG_TOPIC_INIT(mod_topic);
+	PW_LOG_TOPIC_INIT(stats_topic);
 
 	impl = calloc(1, sizeof(struct impl));
 	if (impl == NULL)
@@ -2215,11 +2594,17 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 		pw_properties_setf(impl->playback_props, PW_KEY_MEDIA_NAME, "%s output",
 				pw_properties_get(impl->playback_props, PW_KEY_NODE_DESCRIPTION));
 
+	impl->n_threads = pw_properties_get_uint32(props, "filter.threads", 0);
+
 	if ((res = load_graph(&impl->graph, props)) < 0) {
 		pw_log_error("can't load graph: %s", spa_strerror(res));
 		goto error;
 	}
 
+	if ((res = start_workers(impl, impl->n_threads,
+				pw_properties_get(props, "filter.thread-affinity"))) < 0)
+		goto error;
+
 	impl->core = pw_context_get_object(impl->context, PW_TYPE_INTERFACE_Core);
 	if (impl->core == NULL) {
 		str = pw_properties_get(props, PW_KEY_REMOTE_NAME);
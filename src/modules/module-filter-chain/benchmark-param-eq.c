@@ -0,0 +1,232 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <spa/support/cpu.h>
+
+#include <pipewire/pipewire.h>
+
+#include "biquad.h"
+#include "eq-ops.h"
+
+static uint32_t cpu_flags;
+
+typedef void (*run_func_t) (struct eq_ops *ops, struct biquad *bq,
+		float *dst[], const float *src[], uint32_t n_samples);
+
+struct stats {
+	uint32_t n_samples;
+	uint32_t n_channels;
+	uint64_t perf;
+	const char *name;
+	const char *impl;
+};
+
+#define MAX_SAMPLES	4096
+#define N_BANDS		10
+
+#define MAX_COUNT 100
+
+static float samp_in[EQ_MAX_CHANNELS][MAX_SAMPLES];
+static float samp_out[EQ_MAX_CHANNELS][MAX_SAMPLES];
+
+static const int sample_sizes[] = { 64, 256, 1024, 4096 };
+static const int channel_counts[] = { 1, 2, 4, 6, 8 };
+
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(channel_counts) * 8
+
+static uint32_t n_results = 0;
+static struct stats results[MAX_RESULTS];
+
+static const struct {
+	enum biquad_type type;
+	float freq;
+	float Q;
+	float gain;
+} bands[N_BANDS] = {
+	{ BQ_HIGHPASS, 20.0f, 0.7f, 0.0f },
+	{ BQ_LOWSHELF, 105.0f, 0.7f, 4.0f },
+	{ BQ_PEAKING, 180.0f, 1.2f, -3.5f },
+	{ BQ_PEAKING, 350.0f, 2.0f, 1.5f },
+	{ BQ_PEAKING, 900.0f, 1.0f, -2.0f },
+	{ BQ_PEAKING, 2200.0f, 3.0f, 2.5f },
+	{ BQ_PEAKING, 3500.0f, 4.0f, -4.0f },
+	{ BQ_PEAKING, 6000.0f, 2.0f, 1.0f },
+	{ BQ_HIGHSHELF, 10000.0f, 0.7f, -2.0f },
+	{ BQ_LOWPASS, 20000.0f, 0.7f, 0.0f },
+};
+
+/* the equivalent chain of bq_* builtin nodes, one filter per node and
+ * channel */
+static void run_chain(struct eq_ops *ops, struct biquad *bq,
+		float *dst[], const float *src[], uint32_t n_samples)
+{
+	uint32_t c, b;
+	for (c = 0; c < ops->n_channels; c++) {
+		const float *s = src[c];
+		for (b = 0; b < N_BANDS; b++) {
+			biquad_run(&bq[c * N_BANDS + b], dst[c], s, n_samples);
+			s = dst[c];
+		}
+	}
+}
+
+static void run_eq(struct eq_ops *ops, struct biquad *bq,
+		float *dst[], const float *src[], uint32_t n_samples)
+{
+	eq_ops_process(ops, dst, src, n_samples);
+}
+
+static void run_test1(const char *name, const char *impl, run_func_t func,
+		uint32_t flags, int n_channels, int n_samples)
+{
+	int i, j;
+	const float *ip[EQ_MAX_CHANNELS];
+	float *op[EQ_MAX_CHANNELS];
+	struct biquad bq[EQ_MAX_CHANNELS * N_BANDS];
+	struct eq_ops eq;
+	struct timespec ts;
+	uint64_t count, t1, t2;
+
+	spa_zero(eq);
+	eq.cpu_flags = flags;
+	eq.n_channels = n_channels;
+	eq.n_bands = N_BANDS;
+	for (j = 0; j < N_BANDS; j++) {
+		biquad_set(&bq[j], bands[j].type, bands[j].freq * 2 / 48000.0f,
+				bands[j].Q, bands[j].gain);
+		eq_ops_set_band(&eq, j, &bq[j]);
+	}
+	for (i = 1; i < n_channels; i++)
+		memcpy(&bq[i * N_BANDS], bq, N_BANDS * sizeof(struct biquad));
+
+	if (eq_ops_init(&eq) < 0 || (flags != 0 && eq.cpu_flags == 0))
+		return;
+
+	for (j = 0; j < n_channels; j++) {
+		ip[j] = samp_in[j];
+		op[j] = samp_out[j];
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	count = 0;
+	for (i = 0; i < MAX_COUNT; i++) {
+		func(&eq, bq, op, ip, n_samples);
+		count++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	spa_assert(n_results < MAX_RESULTS);
+
+	results[n_results++] = (struct stats) {
+		.n_samples = n_samples,
+		.n_channels = n_channels,
+		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
+		.name = name,
+		.impl = impl
+	};
+}
+
+static void run_test(const char *name, const char *impl, run_func_t func, uint32_t flags)
+{
+	size_t i, j;
+
+	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(channel_counts); j++) {
+			run_test1(name, impl, func, flags, channel_counts[j],
+					sample_sizes[i]);
+		}
+	}
+}
+
+static void test_param_eq(void)
+{
+	run_test("test_param_eq", "chain", run_chain, 0);
+	run_test("test_param_eq", "c", run_eq, 0);
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("test_param_eq", "sse", run_eq, SPA_CPU_FLAG_SSE);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("test_param_eq", "avx", run_eq, SPA_CPU_FLAG_AVX);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("test_param_eq", "neon", run_eq, SPA_CPU_FLAG_NEON);
+#endif
+}
+
+static int compare_func(const void *_a, const void *_b)
+{
+	const struct stats *a = _a, *b = _b;
+	int diff;
+	if ((diff = strcmp(a->name, b->name)) != 0) return diff;
+	if ((diff = a->n_samples - b->n_samples) != 0) return diff;
+	if ((diff = a->n_channels - b->n_channels) != 0) return diff;
+	if ((diff = b->perf - a->perf) != 0) return diff;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_support support[16];
+	uint32_t i, j, n_support;
+	struct spa_cpu *cpu;
+
+	pw_init(&argc, &argv);
+
+	n_support = pw_get_support(support, SPA_N_ELEMENTS(support));
+	cpu = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
+	cpu_flags = cpu ? spa_cpu_get_flags(cpu) : 0;
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	for (i = 0; i < EQ_MAX_CHANNELS; i++)
+		for (j = 0; j < MAX_SAMPLES; j++)
+			samp_in[i][j] = drand48() * 2.0 - 1.0;
+
+	test_param_eq();
+
+	qsort(results, n_results, sizeof(struct stats), compare_func);
+
+	for (i = 0; i < n_results; i++) {
+		struct stats *s = &results[i];
+		fprintf(stderr, "%-12."PRIu64" \t%-32.32s %s \t samples %d, channels %d\n",
+				s->perf, s->name, s->impl, s->n_samples, s->n_channels);
+	}
+
+	pw_deinit();
+
+	return 0;
+}
@@ -8,6 +8,7 @@
  * found in the LICENSE.WEBKIT file.
  */
 
+#include <float.h>
 #include <math.h>
 #include "biquad.h"
 
@@ -380,3 +381,35 @@ void biquad_set(struct biquad *bq, enum biquad_type type, double freq, double Q,
 		break;
 	}
 }
+
+void biquad_run(struct biquad *bq, float *out, const float *in, int samples)
+{
+	float x1, x2, y1, y2;
+	float b0, b1, b2, a1, a2;
+	int i;
+
+	x1 = bq->x1;
+	x2 = bq->x2;
+	y1 = bq->y1;
+	y2 = bq->y2;
+	b0 = bq->b0;
+	b1 = bq->b1;
+	b2 = bq->b2;
+	a1 = bq->a1;
+	a2 = bq->a2;
+	for (i = 0; i < samples; i++) {
+		float x = in[i];
+		float y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+		out[i] = y;
+		x2 = x1;
+		x1 = x;
+		y2 = y1;
+		y1 = y;
+	}
+#define F(x) (-FLT_MIN < (x) && (x) < FLT_MIN ? 0.0f : (x))
+	bq->x1 = F(x1);
+	bq->x2 = F(x2);
+	bq->y1 = F(y1);
+	bq->y2 = F(y2);
+#undef F
+}
@@ -50,6 +50,10 @@ enum biquad_type {
 void biquad_set(struct biquad *bq, enum biquad_type type, double freq, double Q,
 		double gain);
 
+/* Run the biquad filter on samples from in and write the result to out.
+ * in and out can be the same buffer. */
+void biquad_run(struct biquad *bq, float *out, const float *in, int samples);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
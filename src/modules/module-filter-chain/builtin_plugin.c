@@ -26,21 +26,32 @@
 
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #ifdef HAVE_SNDFILE
 #include <sndfile.h>
 #endif
 
 #include <spa/utils/json.h>
+#include <spa/utils/list.h>
+#include <spa/utils/result.h>
 #include <spa/support/cpu.h>
+#include <spa/support/thread.h>
 
 #include <pipewire/log.h>
+#include <pipewire/thread.h>
 
 #include "plugin.h"
 
 #include "biquad.h"
+#include "eq-ops.h"
 #include "pffft.h"
 #include "convolver.h"
 
+static uint32_t cpu_flags;
+static uint32_t cpu_count;
+static struct spa_thread_utils *thread_utils;
+
 struct builtin {
 	unsigned long rate;
 	float *port[64];
@@ -271,14 +282,11 @@ static struct fc_port bq_ports[] = {
 static void bq_run(struct builtin *impl, unsigned long samples, int type)
 {
 	struct biquad *bq = &impl->bq;
-	unsigned long i;
 	float *out = impl->port[0];
 	float *in = impl->port[1];
 	float freq = impl->port[2][0];
 	float Q = impl->port[3][0];
 	float gain = impl->port[4][0];
-	float x1, x2, y1, y2;
-	float b0, b1, b2, a1, a2;
 
 	if (impl->freq != freq || impl->Q != Q || impl->gain != gain) {
 		impl->freq = freq;
@@ -286,30 +294,7 @@ static void bq_run(struct builtin *impl, unsigned long samples, int type)
 		impl->gain = gain;
 		biquad_set(bq, type, freq * 2 / impl->rate, Q, gain);
 	}
-	x1 = bq->x1;
-	x2 = bq->x2;
-	y1 = bq->y1;
-	y2 = bq->y2;
-	b0 = bq->b0;
-	b1 = bq->b1;
-	b2 = bq->b2;
-	a1 = bq->a1;
-	a2 = bq->a2;
-	for (i = 0; i < samples; i++) {
-		float x = in[i];
-		float y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
-		out[i] = y;
-		x2 = x1;
-		x1 = x;
-		y2 = y1;
-		y1 = y;
-	}
-#define F(x) (-FLT_MIN < (x) && (x) < FLT_MIN ? 0.0f : (x))
-	bq->x1 = F(x1);
-	bq->x2 = F(x2);
-	bq->y1 = F(y1);
-	bq->y2 = F(y2);
-#undef F
+	biquad_run(bq, out, in, samples);
 }
 
 /** bq_lowpass */
@@ -465,12 +450,264 @@ static const struct fc_descriptor bq_allpass_desc = {
 	.cleanup = builtin_cleanup,
 };
 
+/** param_eq */
+struct param_eq_impl {
+	unsigned long rate;
+	float *port[16];
+
+	struct eq_ops eq;
+};
+
+static int parse_band_type(const char *type)
+{
+	if (spa_streq(type, "bq_lowpass"))
+		return BQ_LOWPASS;
+	else if (spa_streq(type, "bq_highpass"))
+		return BQ_HIGHPASS;
+	else if (spa_streq(type, "bq_bandpass"))
+		return BQ_BANDPASS;
+	else if (spa_streq(type, "bq_lowshelf"))
+		return BQ_LOWSHELF;
+	else if (spa_streq(type, "bq_highshelf"))
+		return BQ_HIGHSHELF;
+	else if (spa_streq(type, "bq_peaking"))
+		return BQ_PEAKING;
+	else if (spa_streq(type, "bq_notch"))
+		return BQ_NOTCH;
+	else if (spa_streq(type, "bq_allpass"))
+		return BQ_ALLPASS;
+	return -EINVAL;
+}
+
+/*
+ * { type = bq_peaking freq = 1000.0 Q = 1.0 gain = -3.0 }
+ */
+static int parse_band(struct spa_json *band, unsigned long rate, struct biquad *bq)
+{
+	char key[256], type[64] = "";
+	const char *val;
+	float freq = 0.0f, Q = 0.0f, gain = 0.0f;
+	int t;
+
+	while (spa_json_get_string(band, key, sizeof(key)) > 0) {
+		if (spa_streq(key, "type")) {
+			if (spa_json_get_string(band, type, sizeof(type)) <= 0)
+				return -EINVAL;
+		}
+		else if (spa_streq(key, "freq")) {
+			if (spa_json_get_float(band, &freq) <= 0)
+				return -EINVAL;
+		}
+		else if (spa_streq(key, "Q")) {
+			if (spa_json_get_float(band, &Q) <= 0)
+				return -EINVAL;
+		}
+		else if (spa_streq(key, "gain")) {
+			if (spa_json_get_float(band, &gain) <= 0)
+				return -EINVAL;
+		}
+		else if (spa_json_next(band, &val) < 0)
+			break;
+	}
+	if ((t = parse_band_type(type)) < 0) {
+		pw_log_error("param_eq: unknown band type '%s'", type);
+		return t;
+	}
+	biquad_set(bq, t, freq * 2 / rate, Q, gain);
+	return 0;
+}
+
+static void *param_eq_instantiate(const struct fc_descriptor * Descriptor,
+		unsigned long *SampleRate, int index, const char *config)
+{
+	struct param_eq_impl *impl;
+	struct spa_json it[3];
+	struct biquad bq;
+	const char *val;
+	char key[256];
+	int res;
+
+	if (config == NULL) {
+		pw_log_error("param_eq: requires a config section");
+		return NULL;
+	}
+
+	impl = calloc(1, sizeof(*impl));
+	if (impl == NULL)
+		return NULL;
+
+	impl->rate = *SampleRate;
+
+	spa_json_init(&it[0], config, strlen(config));
+	if (spa_json_enter_object(&it[0], &it[1]) <= 0)
+		goto error;
+
+	while (spa_json_get_string(&it[1], key, sizeof(key)) > 0) {
+		if (spa_streq(key, "bands")) {
+			struct spa_json bands;
+			if (spa_json_enter_array(&it[1], &bands) <= 0) {
+				pw_log_error("param_eq: bands expects an array");
+				goto error;
+			}
+			while (spa_json_enter_object(&bands, &it[2]) > 0) {
+				if (impl->eq.n_bands >= EQ_MAX_BANDS) {
+					pw_log_error("param_eq: too many bands, max %d",
+							EQ_MAX_BANDS);
+					goto error;
+				}
+				if (parse_band(&it[2], impl->rate, &bq) < 0)
+					goto error;
+				eq_ops_set_band(&impl->eq, impl->eq.n_bands++, &bq);
+			}
+		}
+		else if (spa_json_next(&it[1], &val) < 0)
+			break;
+	}
+
+	impl->eq.cpu_flags = cpu_flags;
+	impl->eq.n_channels = EQ_MAX_CHANNELS;
+	if ((res = eq_ops_init(&impl->eq)) < 0) {
+		pw_log_error("param_eq: can't init eq: %s", spa_strerror(res));
+		goto error;
+	}
+	return impl;
+error:
+	free(impl);
+	return NULL;
+}
+
+static void param_eq_connect_port(void * Instance, unsigned long Port,
+                        float * DataLocation)
+{
+	struct param_eq_impl *impl = Instance;
+	impl->port[Port] = DataLocation;
+}
+
+static void param_eq_cleanup(void * Instance)
+{
+	struct param_eq_impl *impl = Instance;
+	eq_ops_free(&impl->eq);
+	free(impl);
+}
+
+static void param_eq_deactivate(void * Instance)
+{
+	struct param_eq_impl *impl = Instance;
+	eq_ops_reset(&impl->eq);
+}
+
+static void param_eq_run(void * Instance, unsigned long SampleCount)
+{
+	struct param_eq_impl *impl = Instance;
+	const float *in[EQ_MAX_CHANNELS];
+	float *out[EQ_MAX_CHANNELS];
+	uint32_t i, n_channels = 0;
+
+	for (i = 0; i < EQ_MAX_CHANNELS; i++) {
+		in[i] = impl->port[i];
+		out[i] = impl->port[EQ_MAX_CHANNELS + i];
+		if (out[i] != NULL)
+			n_channels = i + 1;
+	}
+	/* only process the channels up to the last connected output */
+	if (n_channels != impl->eq.n_channels) {
+		impl->eq.n_channels = n_channels;
+		impl->eq.cpu_flags = cpu_flags;
+		eq_ops_init(&impl->eq);
+	}
+	eq_ops_process(&impl->eq, out, in, SampleCount);
+}
+
+static struct fc_port param_eq_ports[] = {
+	{ .index = 0,
+	  .name = "In 1",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 1,
+	  .name = "In 2",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 2,
+	  .name = "In 3",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 3,
+	  .name = "In 4",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 4,
+	  .name = "In 5",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 5,
+	  .name = "In 6",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 6,
+	  .name = "In 7",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 7,
+	  .name = "In 8",
+	  .flags = FC_PORT_INPUT | FC_PORT_AUDIO,
+	},
+
+	{ .index = 8,
+	  .name = "Out 1",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 9,
+	  .name = "Out 2",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 10,
+	  .name = "Out 3",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 11,
+	  .name = "Out 4",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 12,
+	  .name = "Out 5",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 13,
+	  .name = "Out 6",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 14,
+	  .name = "Out 7",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+	{ .index = 15,
+	  .name = "Out 8",
+	  .flags = FC_PORT_OUTPUT | FC_PORT_AUDIO,
+	},
+};
+
+static const struct fc_descriptor param_eq_desc = {
+	.name = "param_eq",
+	.flags = FC_DESCRIPTOR_SUPPORTS_NULL_DATA,
+
+	.n_ports = 16,
+	.ports = param_eq_ports,
+
+	.instantiate = param_eq_instantiate,
+	.connect_port = param_eq_connect_port,
+	.deactivate = param_eq_deactivate,
+	.run = param_eq_run,
+	.cleanup = param_eq_cleanup,
+};
+
 /** convolve */
 struct convolver_impl {
 	unsigned long rate;
 	float *port[64];
 
 	struct convolver *conv;
+	struct ir_cache_entry *cache;
+	struct convolver_pool *pool;
 };
 
 static float *read_samples(const char *filename, float gain, int delay, int offset,
@@ -527,6 +764,23 @@ static float *read_samples(const char *filename, float gain, int delay, int offs
 #endif
 }
 
+/* the number of channels in filename, the IR channel is taken modulo this */
+static int get_channels(const char *filename)
+{
+#ifdef HAVE_SNDFILE
+	SF_INFO info;
+	SNDFILE *f;
+
+	spa_zero(info);
+	if ((f = sf_open(filename, SFM_READ, &info)) == NULL)
+		return -ENOENT;
+	sf_close(f);
+	return info.channels;
+#else
+	return -ENOTSUP;
+#endif
+}
+
 static float *create_hilbert(const char *filename, float gain, int delay, int offset,
 		int length, int *n_samples)
 {
@@ -575,106 +829,314 @@ static float *create_dirac(const char *filename, float gain, int delay, int offs
 	return samples;
 }
 
+/* The frequency domain IR is shared between all convolvers in the
+ * process that load the same IR with the same parameters. The file
+ * identity and modification time are part of the key so that an edited
+ * IR file is loaded again. The channel is the channel of the file that is
+ * used, -1 when the IR is not loaded from a file. */
+struct ir_key {
+	char filename[PATH_MAX];
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	int channel;
+	float gain;
+	int delay;
+	int offset;
+	int length;
+	unsigned long rate;
+	int blocksize;
+	int tailsize;
+};
+
+struct ir_cache_entry {
+	struct spa_list link;
+	int ref;
+	struct ir_key key;
+	unsigned long rate;
+	struct convolver_ir *ir;
+	/* the IR is loaded without the lock, other users of the same IR
+	 * wait on ir_cache_cond until loading is cleared */
+	bool loading;
+};
+
+static struct spa_list ir_cache = SPA_LIST_INIT(&ir_cache);
+static pthread_mutex_t ir_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ir_cache_cond = PTHREAD_COND_INITIALIZER;
+
+static bool ir_key_equal(const struct ir_key *a, const struct ir_key *b)
+{
+	return spa_streq(a->filename, b->filename) &&
+		a->dev == b->dev &&
+		a->ino == b->ino &&
+		a->size == b->size &&
+		a->mtime.tv_sec == b->mtime.tv_sec &&
+		a->mtime.tv_nsec == b->mtime.tv_nsec &&
+		a->channel == b->channel &&
+		a->gain == b->gain &&
+		a->delay == b->delay &&
+		a->offset == b->offset &&
+		a->length == b->length &&
+		a->rate == b->rate &&
+		a->blocksize == b->blocksize &&
+		a->tailsize == b->tailsize;
+}
+
+static struct convolver_ir *ir_load(const struct ir_key *key, unsigned long *rate)
+{
+	struct convolver_ir *ir;
+	float *samples;
+	int n_samples, blocksize = key->blocksize, tailsize = key->tailsize;
+	int blocks[8], n_blocks, i, len;
+	char partitions[128];
+
+	if (spa_streq(key->filename, "/hilbert")) {
+		samples = create_hilbert(key->filename, key->gain, key->delay, key->offset,
+				key->length, &n_samples);
+	} else if (spa_streq(key->filename, "/dirac")) {
+		samples = create_dirac(key->filename, key->gain, key->delay, key->offset,
+				key->length, &n_samples);
+	} else {
+		samples = read_samples(key->filename, key->gain, key->delay, key->offset,
+				key->length, key->channel, rate, &n_samples);
+	}
+	if (samples == NULL)
+		return NULL;
+
+	if (blocksize <= 0)
+		blocksize = SPA_CLAMP(n_samples, 64, 256);
+	if (tailsize <= 0)
+		tailsize = SPA_CLAMP(4096, blocksize, 4096);
+
+	n_blocks = convolver_plan(blocksize, tailsize, n_samples, blocks, SPA_N_ELEMENTS(blocks));
+
+	for (i = 0, len = 0; i < n_blocks; i++)
+		len += snprintf(partitions + len, sizeof(partitions) - len, "%s%d",
+				i == 0 ? "" : "/", blocks[i]);
+
+	pw_log_info("using %s partitions ir:%s channel:%d", partitions,
+			key->filename, key->channel);
+
+	ir = convolver_ir_new(blocks, n_blocks, samples, n_samples);
+	free(samples);
+
+	return ir;
+}
+
+static struct ir_cache_entry *ir_cache_get(const struct ir_key *key, unsigned long *rate)
+{
+	struct ir_cache_entry *e;
+	struct convolver_ir *ir;
+	unsigned long ir_rate = *rate;
+
+	pthread_mutex_lock(&ir_cache_lock);
+again:
+	spa_list_for_each(e, &ir_cache, link) {
+		if (!ir_key_equal(&e->key, key))
+			continue;
+		if (e->loading) {
+			/* the entry is removed when loading fails, look again */
+			pthread_cond_wait(&ir_cache_cond, &ir_cache_lock);
+			goto again;
+		}
+		pw_log_debug("%p: reuse ir:%s channel:%d ref:%d", e,
+				key->filename, key->channel, e->ref);
+		e->ref++;
+		*rate = e->rate;
+		pthread_mutex_unlock(&ir_cache_lock);
+		return e;
+	}
+
+	e = calloc(1, sizeof(*e));
+	if (e == NULL) {
+		pthread_mutex_unlock(&ir_cache_lock);
+		return NULL;
+	}
+	e->ref = 1;
+	e->key = *key;
+	e->loading = true;
+	spa_list_append(&ir_cache, &e->link);
+	pthread_mutex_unlock(&ir_cache_lock);
+
+	ir = ir_load(key, &ir_rate);
+
+	pthread_mutex_lock(&ir_cache_lock);
+	e->loading = false;
+	if (ir == NULL) {
+		spa_list_remove(&e->link);
+		free(e);
+		e = NULL;
+	} else {
+		e->ir = ir;
+		e->rate = *rate = ir_rate;
+	}
+	pthread_cond_broadcast(&ir_cache_cond);
+	pthread_mutex_unlock(&ir_cache_lock);
+
+	return e;
+}
+
+static void ir_cache_put(struct ir_cache_entry *e)
+{
+	pthread_mutex_lock(&ir_cache_lock);
+	if (--e->ref == 0) {
+		spa_list_remove(&e->link);
+		convolver_ir_unref(e->ir);
+		free(e);
+	}
+	pthread_mutex_unlock(&ir_cache_lock);
+}
+
+/* The async convolvers of all instances share one pool of realtime
+ * workers. */
+static struct convolver_pool *pool;
+static int pool_ref;
+
+static struct convolver_pool *pool_get(void)
+{
+	pthread_mutex_lock(&ir_cache_lock);
+	if (pool == NULL) {
+		int n_workers = SPA_CLAMP((int)cpu_count - 1, 1, 4);
+		pool = convolver_pool_new(thread_utils, n_workers);
+		if (pool == NULL)
+			pw_log_error("can't create convolver workers: %m");
+		else
+			pw_log_info("using %d convolver workers", n_workers);
+	}
+	if (pool != NULL)
+		pool_ref++;
+	pthread_mutex_unlock(&ir_cache_lock);
+	return pool;
+}
+
+static void pool_put(void)
+{
+	pthread_mutex_lock(&ir_cache_lock);
+	if (--pool_ref == 0) {
+		convolver_pool_free(pool);
+		pool = NULL;
+	}
+	pthread_mutex_unlock(&ir_cache_lock);
+}
+
 static void * convolver_instantiate(const struct fc_descriptor * Descriptor,
 		unsigned long *SampleRate, int index, const char *config)
 {
 	struct convolver_impl *impl;
-	float *samples;
-	int offset = 0, length = 0, channel = index, n_samples;
+	struct ir_key key;
 	struct spa_json it[2];
 	const char *val;
-	char key[256];
-	char filename[PATH_MAX] = "";
-	int blocksize = 0, tailsize = 0;
-	int delay = 0;
-	float gain = 1.0f;
+	char k[256];
+	bool async = false;
 
 	if (config == NULL)
 		return NULL;
 
+	spa_zero(key);
+	key.channel = index;
+	key.gain = 1.0f;
+	key.rate = *SampleRate;
+
 	spa_json_init(&it[0], config, strlen(config));
 	if (spa_json_enter_object(&it[0], &it[1]) <= 0)
 		return NULL;
 
-	while (spa_json_get_string(&it[1], key, sizeof(key)) > 0) {
-		if (spa_streq(key, "blocksize")) {
-			if (spa_json_get_int(&it[1], &blocksize) <= 0)
+	while (spa_json_get_string(&it[1], k, sizeof(k)) > 0) {
+		if (spa_streq(k, "blocksize")) {
+			if (spa_json_get_int(&it[1], &key.blocksize) <= 0)
 				return NULL;
 		}
-		else if (spa_streq(key, "tailsize")) {
-			if (spa_json_get_int(&it[1], &tailsize) <= 0)
+		else if (spa_streq(k, "tailsize")) {
+			if (spa_json_get_int(&it[1], &key.tailsize) <= 0)
 				return NULL;
 		}
-		else if (spa_streq(key, "gain")) {
-			if (spa_json_get_float(&it[1], &gain) <= 0)
+		else if (spa_streq(k, "async")) {
+			if (spa_json_get_bool(&it[1], &async) <= 0)
 				return NULL;
 		}
-		else if (spa_streq(key, "delay")) {
-			if (spa_json_get_int(&it[1], &delay) <= 0)
+		else if (spa_streq(k, "gain")) {
+			if (spa_json_get_float(&it[1], &key.gain) <= 0)
 				return NULL;
 		}
-		else if (spa_streq(key, "filename")) {
-			if (spa_json_get_string(&it[1], filename, sizeof(filename)) <= 0)
+		else if (spa_streq(k, "delay")) {
+			if (spa_json_get_int(&it[1], &key.delay) <= 0)
 				return NULL;
 		}
-		else if (spa_streq(key, "offset")) {
-			if (spa_json_get_int(&it[1], &offset) <= 0)
+		else if (spa_streq(k, "filename")) {
+			if (spa_json_get_string(&it[1], key.filename, sizeof(key.filename)) <= 0)
 				return NULL;
 		}
-		else if (spa_streq(key, "length")) {
-			if (spa_json_get_int(&it[1], &length) <= 0)
+		else if (spa_streq(k, "offset")) {
+			if (spa_json_get_int(&it[1], &key.offset) <= 0)
 				return NULL;
 		}
-		else if (spa_streq(key, "channel")) {
-			if (spa_json_get_int(&it[1], &channel) <= 0)
+		else if (spa_streq(k, "length")) {
+			if (spa_json_get_int(&it[1], &key.length) <= 0)
+				return NULL;
+		}
+		else if (spa_streq(k, "channel")) {
+			if (spa_json_get_int(&it[1], &key.channel) <= 0)
 				return NULL;
 		}
 		else if (spa_json_next(&it[1], &val) < 0)
 			break;
 	}
-	if (!filename[0])
+	if (!key.filename[0])
 		return NULL;
 
-	if (delay < 0)
-		delay = 0;
-	if (offset < 0)
-		offset = 0;
-
-	if (spa_streq(filename, "/hilbert")) {
-		samples = create_hilbert(filename, gain, delay, offset,
-				length, &n_samples);
-	} else if (spa_streq(filename, "/dirac")) {
-		samples = create_dirac(filename, gain, delay, offset,
-				length, &n_samples);
+	if (spa_streq(key.filename, "/hilbert") ||
+	    spa_streq(key.filename, "/dirac")) {
+		key.channel = -1;
 	} else {
-		samples = read_samples(filename, gain, delay, offset,
-				length, channel, SampleRate, &n_samples);
+		struct stat sbuf;
+		int channels;
+
+		if (key.filename[0] == '/' && stat(key.filename, &sbuf) == 0) {
+			key.dev = sbuf.st_dev;
+			key.ino = sbuf.st_ino;
+			key.size = sbuf.st_size;
+			key.mtime = sbuf.st_mtim;
+		}
+		/* instances that use the same channel of the file share the IR */
+		if ((channels = get_channels(key.filename)) > 0)
+			key.channel = key.channel % channels;
+		else if (channels == -ENOTSUP)
+			key.channel = -1;
 	}
-	if (samples == NULL)
-		return NULL;
 
-	if (blocksize <= 0)
-		blocksize = SPA_CLAMP(n_samples, 64, 256);
-	if (tailsize <= 0)
-		tailsize = SPA_CLAMP(4096, blocksize, 4096);
-
-	pw_log_info("using %d:%d blocksize ir:%s", blocksize, tailsize, filename);
+	/* larger tail blocks cause larger spikes when they are computed in
+	 * the data thread, only use them by default with async */
+	if (key.tailsize <= 0 && async)
+		key.tailsize = 16384;
+	if (key.delay < 0)
+		key.delay = 0;
+	if (key.offset < 0)
+		key.offset = 0;
 
 	impl = calloc(1, sizeof(*impl));
 	if (impl == NULL)
+		return NULL;
+
+	impl->cache = ir_cache_get(&key, SampleRate);
+	if (impl->cache == NULL)
 		goto error;
 
 	impl->rate = *SampleRate;
 
-	impl->conv = convolver_new(blocksize, tailsize, samples, n_samples);
-	if (impl->conv == NULL)
+	if (async && (impl->pool = pool_get()) == NULL)
 		goto error;
 
-	free(samples);
+	impl->conv = convolver_new_ir(impl->cache->ir, impl->pool);
+	if (impl->conv == NULL)
+		goto error;
 
 	return impl;
 error:
-	free(samples);
+	if (impl->pool)
+		pool_put();
+	if (impl->cache)
+		ir_cache_put(impl->cache);
 	free(impl);
 	return NULL;
 }
@@ -691,6 +1153,10 @@ static void convolver_cleanup(void * Instance)
 	struct convolver_impl *impl = Instance;
 	if (impl->conv)
 		convolver_free(impl->conv);
+	if (impl->pool)
+		pool_put();
+	if (impl->cache)
+		ir_cache_put(impl->cache);
 	free(impl);
 }
 
@@ -708,6 +1174,10 @@ static struct fc_port convolve_ports[] = {
 static void convolver_deactivate(void * Instance)
 {
 	struct convolver_impl *impl = Instance;
+	uint32_t xruns;
+
+	if ((xruns = convolver_get_xruns(impl->conv)) > 0)
+		pw_log_info("%p: %u late convolver blocks", impl, xruns);
 	convolver_reset(impl->conv);
 }
 
@@ -886,6 +1356,8 @@ static const struct fc_descriptor * builtin_descriptor(unsigned long Index)
 		return &convolve_desc;
 	case 11:
 		return &delay_desc;
+	case 12:
+		return &param_eq_desc;
 	}
 	return NULL;
 }
@@ -912,6 +1384,11 @@ struct fc_plugin *load_builtin_plugin(const struct spa_support *support, uint32_
 {
 	struct spa_cpu *cpu_iface;
 	cpu_iface = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
-	pffft_select_cpu(cpu_iface ? spa_cpu_get_flags(cpu_iface) : 0);
+	cpu_flags = cpu_iface ? spa_cpu_get_flags(cpu_iface) : 0;
+	cpu_count = cpu_iface ? spa_cpu_get_count(cpu_iface) : 1;
+	thread_utils = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_ThreadUtils);
+	if (thread_utils == NULL)
+		thread_utils = pw_thread_utils_get();
+	pffft_select_cpu(cpu_flags);
 	return &builtin_plugin;
 }
@@ -27,8 +27,14 @@
 #include "convolver.h"
 
 #include <spa/utils/defs.h>
+#include <spa/utils/list.h>
+#include <spa/support/thread.h>
 
 #include <math.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include "pffft.h"
 
@@ -43,7 +49,7 @@ struct convolver1 {
 	int fftComplexSize;
 
 	struct fft_cpx *segments;
-	struct fft_cpx *segmentsIr;
+	const struct fft_cpx *segmentsIr;
 
 	float *fft_buffer;
 
@@ -84,9 +90,10 @@ static void fft_cpx_clear(struct fft_cpx *cpx, int size)
 {
 	fft_clear(cpx->v, size * 2);
 }
-static void fft_cpx_init(struct fft_cpx *cpx, int size)
+static int fft_cpx_init(struct fft_cpx *cpx, int size)
 {
 	cpx->v = fft_alloc(size * 2);
+	return cpx->v ? 0 : -ENOMEM;
 }
 
 static void fft_cpx_free(struct fft_cpx *cpx)
@@ -156,28 +163,98 @@ static void convolver1_reset(struct convolver1 *conv)
 	conv->current = 0;
 }
 
-static struct convolver1 *convolver1_new(int block, const float *ir, int irlen)
+/* the frequency domain segments of a part of the IR. They are
+ * read-only after creation and can be shared by convolvers. */
+struct ir_part {
+	int blockSize;
+	int segCount;
+	struct fft_cpx *segments;
+};
+
+static void ir_part_clear(struct ir_part *part)
 {
-	struct convolver1 *conv;
 	int i;
+	if (part->segments) {
+		for (i = 0; i < part->segCount; i++)
+			fft_cpx_free(&part->segments[i]);
+		free(part->segments);
+	}
+	spa_zero(*part);
+}
 
-	if (block == 0)
-		return NULL;
+static int ir_part_init(struct ir_part *part, int block, const float *ir, int irlen)
+{
+	int i, segSize, fftComplexSize;
+	void *fft;
+	float *fft_buffer;
 
 	while (irlen > 0 && fabs(ir[irlen-1]) < 0.000001f)
 		irlen--;
 
+	part->blockSize = next_power_of_two(block);
+	if (irlen == 0)
+		return 0;
+
+	segSize = 2 * part->blockSize;
+	fftComplexSize = (segSize / 2) + 1;
+
+	fft = fft_new(segSize);
+	if (fft == NULL)
+		return -ENOMEM;
+	fft_buffer = fft_alloc(segSize);
+	if (fft_buffer == NULL) {
+		fft_destroy(fft);
+		return -ENOMEM;
+	}
+
+	part->segCount = (irlen + part->blockSize-1) / part->blockSize;
+	part->segments = calloc(sizeof(struct fft_cpx), part->segCount);
+	if (part->segments == NULL)
+		goto error;
+
+	for (i = 0; i < part->segCount; i++) {
+		int left = irlen - (i * part->blockSize);
+		int copy = SPA_MIN(part->blockSize, left);
+
+		if (fft_cpx_init(&part->segments[i], fftComplexSize) < 0)
+			goto error;
+
+		fft_copy(fft_buffer, &ir[i * part->blockSize], copy);
+		if (copy < segSize)
+			fft_clear(fft_buffer + copy, segSize - copy);
+
+	        fft_run(fft, fft_buffer, &part->segments[i]);
+	}
+	fft_free(fft_buffer);
+	fft_destroy(fft);
+
+	return 0;
+error:
+	fft_free(fft_buffer);
+	fft_destroy(fft);
+	return -ENOMEM;
+}
+
+static struct convolver1 *convolver1_new(const struct ir_part *ir)
+{
+	struct convolver1 *conv;
+	int i;
+
+	if (ir->blockSize == 0)
+		return NULL;
+
 	conv = calloc(1, sizeof(*conv));
 	if (conv == NULL)
 		return NULL;
 
-	if (irlen == 0)
+	if (ir->segCount == 0)
 		return conv;
 
-	conv->blockSize = next_power_of_two(block);
+	conv->blockSize = ir->blockSize;
 	conv->segSize = 2 * conv->blockSize;
-	conv->segCount = (irlen + conv->blockSize-1) / conv->blockSize;
+	conv->segCount = ir->segCount;
 	conv->fftComplexSize = (conv->segSize / 2) + 1;
+	conv->segmentsIr = ir->segments;
 
 	conv->fft = fft_new(conv->segSize);
 	if (conv->fft == NULL)
@@ -191,21 +268,9 @@ static struct convolver1 *convolver1_new(int block, const float *ir, int irlen)
 		goto error;
 
 	conv->segments = calloc(sizeof(struct fft_cpx), conv->segCount);
-	conv->segmentsIr = calloc(sizeof(struct fft_cpx), conv->segCount);
-
-	for (i = 0; i < conv->segCount; i++) {
-		int left = irlen - (i * conv->blockSize);
-		int copy = SPA_MIN(conv->blockSize, left);
-
+	for (i = 0; i < conv->segCount; i++)
 		fft_cpx_init(&conv->segments[i], conv->fftComplexSize);
-		fft_cpx_init(&conv->segmentsIr[i], conv->fftComplexSize);
-
-		fft_copy(conv->fft_buffer, &ir[i * conv->blockSize], copy);
-		if (copy < conv->segSize)
-			fft_clear(conv->fft_buffer + copy, conv->segSize - copy);
 
-	        fft_run(conv->fft, conv->fft_buffer, &conv->segmentsIr[i]);
-	}
 	fft_cpx_init(&conv->pre_mult, conv->fftComplexSize);
 	fft_cpx_init(&conv->conv, conv->fftComplexSize);
 	conv->overlap = fft_alloc(conv->blockSize);
@@ -228,19 +293,18 @@ error:
 static void convolver1_free(struct convolver1 *conv)
 {
 	int i;
-	for (i = 0; i < conv->segCount; i++) {
-		fft_cpx_free(&conv->segments[i]);
-		fft_cpx_free(&conv->segmentsIr[i]);
+	if (conv->segCount > 0) {
+		for (i = 0; i < conv->segCount; i++)
+			fft_cpx_free(&conv->segments[i]);
+		fft_destroy(conv->fft);
+		fft_destroy(conv->ifft);
+		fft_free(conv->fft_buffer);
+		free(conv->segments);
+		fft_cpx_free(&conv->pre_mult);
+		fft_cpx_free(&conv->conv);
+		fft_free(conv->overlap);
+		fft_free(conv->inputBuffer);
 	}
-	fft_destroy(conv->fft);
-	fft_destroy(conv->ifft);
-	fft_free(conv->fft_buffer);
-	free(conv->segments);
-	free(conv->segmentsIr);
-	fft_cpx_free(&conv->pre_mult);
-	fft_cpx_free(&conv->conv);
-	fft_free(conv->overlap);
-	fft_free(conv->inputBuffer);
 	free(conv);
 }
 
@@ -315,103 +379,511 @@ static int convolver1_run(struct convolver1 *conv, const float *input, float *ou
 	return len;
 }
 
+#define MAX_STAGES	8
+#define MAX_WORKERS	8
+
+/* A stage collects blockSize input samples and then convolves them with
+ * its part of the IR. The result is only used one block later so that the
+ * computation can be done in the background while the next block is
+ * collected. The stage has a latency of 2 * blockSize and so it can only
+ * handle the part of the IR starting at 2 * blockSize. */
+struct stage {
+	struct convolver1 *conv;
+	int blockSize;
+
+	float *input;
+	int inputFill;
+	int phase;
+	float *output;
+	float *precalculated;
+
+	/* async stages are computed by a worker of the pool. The data thread
+	 * hands a block to the worker by setting the state to PENDING, the
+	 * worker sets it to RUNNING while it computes the output and back to
+	 * IDLE when the output is ready. */
+	struct convolver_worker *worker;
+	struct spa_list link;
+	float *inputAsync;
+	int state;
+	/* the convolver history must be cleared before the next block */
+	bool resync;
+	bool reset;
+	uint32_t xruns;
+};
+
+#define STAGE_IDLE	0
+#define STAGE_PENDING	1
+#define STAGE_RUNNING	2
+
+struct convolver_worker {
+	struct convolver_pool *pool;
+	struct spa_thread *thread;
+	sem_t wakeup;
+	/* protects the stage list, held by the worker while it processes. The
+	 * data thread never takes this lock. */
+	pthread_mutex_t lock;
+	struct spa_list stages;
+	int n_stages;
+};
+
+struct convolver_pool {
+	struct spa_thread_utils *utils;
+	bool running;
+	int n_workers;
+	struct convolver_worker workers[MAX_WORKERS];
+};
+
+struct convolver_ir
+{
+	int ref;
+	struct ir_part head;
+	int n_stages;
+	struct ir_part stages[MAX_STAGES];
+	int phase[MAX_STAGES];
+};
+
 struct convolver
 {
-	int headBlockSize;
-	int tailBlockSize;
+	struct convolver_ir *ir;
 	struct convolver1 *headConvolver;
-	struct convolver1 *tailConvolver0;
-	float *tailOutput0;
-	float *tailPrecalculated0;
-	struct convolver1 *tailConvolver;
-	float *tailOutput;
-	float *tailPrecalculated;
-	float *tailInput;
-	int tailInputFill;
-	int precalculatedPos;
+
+	int n_stages;
+	struct stage stages[MAX_STAGES];
 };
 
+/* compute the block of the stage, called by the worker or by the data thread
+ * after it changed the state from PENDING to RUNNING */
+static void stage_process(struct stage *s)
+{
+	if (s->reset) {
+		convolver1_reset(s->conv);
+		s->reset = false;
+	}
+	convolver1_run(s->conv, s->inputAsync, s->output, s->blockSize);
+	__atomic_store_n(&s->state, STAGE_IDLE, __ATOMIC_RELEASE);
+}
+
+static inline bool stage_claim(struct stage *s)
+{
+	int expected = STAGE_PENDING;
+	return __atomic_compare_exchange_n(&s->state, &expected, STAGE_RUNNING,
+			false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void *worker_thread(void *data)
+{
+	struct convolver_worker *w = data;
+	struct stage *s;
+
+	while (true) {
+		while (sem_wait(&w->wakeup) < 0 && errno == EINTR);
+
+		if (!__atomic_load_n(&w->pool->running, __ATOMIC_ACQUIRE))
+			break;
+
+		pthread_mutex_lock(&w->lock);
+		spa_list_for_each(s, &w->stages, link) {
+			if (stage_claim(s))
+				stage_process(s);
+		}
+		pthread_mutex_unlock(&w->lock);
+	}
+	return NULL;
+}
+
+void convolver_pool_free(struct convolver_pool *pool)
+{
+	int i;
+
+	__atomic_store_n(&pool->running, false, __ATOMIC_RELEASE);
+	for (i = 0; i < pool->n_workers; i++) {
+		struct convolver_worker *w = &pool->workers[i];
+		sem_post(&w->wakeup);
+		spa_thread_utils_join(pool->utils, w->thread, NULL);
+		sem_destroy(&w->wakeup);
+		pthread_mutex_destroy(&w->lock);
+	}
+	free(pool);
+}
+
+struct convolver_pool *convolver_pool_new(struct spa_thread_utils *utils, int n_workers)
+{
+	struct convolver_pool *pool;
+	struct spa_dict_item items[1];
+	char name[64];
+	int i, res;
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return NULL;
+
+	pool->utils = utils;
+	pool->running = true;
+	n_workers = SPA_CLAMP(n_workers, 1, MAX_WORKERS);
+
+	for (i = 0; i < n_workers; i++) {
+		struct convolver_worker *w = &pool->workers[i];
+
+		w->pool = pool;
+		spa_list_init(&w->stages);
+		sem_init(&w->wakeup, 0, 0);
+		pthread_mutex_init(&w->lock, NULL);
+
+		snprintf(name, sizeof(name), "convolver-%d", i);
+		items[0] = SPA_DICT_ITEM_INIT(SPA_KEY_THREAD_NAME, name);
+
+		w->thread = spa_thread_utils_create(utils, &SPA_DICT_INIT_ARRAY(items),
+				worker_thread, w);
+		if (w->thread == NULL) {
+			res = -errno;
+			sem_destroy(&w->wakeup);
+			pthread_mutex_destroy(&w->lock);
+			convolver_pool_free(pool);
+			errno = -res;
+			return NULL;
+		}
+		pool->n_workers++;
+		spa_thread_utils_acquire_rt(utils, w->thread, -1);
+	}
+	return pool;
+}
+
+static void stage_stop(struct stage *s)
+{
+	struct convolver_worker *w = s->worker;
+
+	if (w == NULL)
+		return;
+	pthread_mutex_lock(&w->lock);
+	spa_list_remove(&s->link);
+	w->n_stages--;
+	pthread_mutex_unlock(&w->lock);
+	s->worker = NULL;
+}
+
+static int stage_start(struct stage *s, struct convolver_pool *pool)
+{
+	struct convolver_worker *w = NULL;
+	int i;
+
+	s->inputAsync = fft_alloc(s->blockSize);
+	if (s->inputAsync == NULL)
+		return -ENOMEM;
+
+	/* spread the stages over the workers */
+	for (i = 0; i < pool->n_workers; i++) {
+		if (w == NULL || pool->workers[i].n_stages < w->n_stages)
+			w = &pool->workers[i];
+	}
+	if (w == NULL)
+		return -EINVAL;
+
+	s->state = STAGE_IDLE;
+	pthread_mutex_lock(&w->lock);
+	spa_list_append(&w->stages, &s->link);
+	w->n_stages++;
+	pthread_mutex_unlock(&w->lock);
+	s->worker = w;
+	return 0;
+}
+
+static int stage_init(struct stage *s, const struct ir_part *ir, int phase,
+		struct convolver_pool *pool)
+{
+	int block = ir->blockSize;
+
+	s->blockSize = block;
+	s->phase = phase;
+	s->conv = convolver1_new(ir);
+	s->input = fft_alloc(block);
+	s->output = fft_alloc(block);
+	s->precalculated = fft_alloc(block);
+	if (s->conv == NULL || s->input == NULL ||
+	    s->output == NULL || s->precalculated == NULL)
+		return -ENOMEM;
+	if (pool)
+		return stage_start(s, pool);
+	return 0;
+}
+
+static void stage_reset(struct stage *s)
+{
+	fft_clear(s->precalculated, s->blockSize);
+	fft_clear(s->input, s->blockSize);
+	s->inputFill = s->phase;
+
+	if (s->worker == NULL) {
+		convolver1_reset(s->conv);
+		fft_clear(s->output, s->blockSize);
+		return;
+	}
+	/* drop a pending block. A running block is left to the worker, the
+	 * convolver history is cleared with the next block. */
+	if (stage_claim(s))
+		__atomic_store_n(&s->state, STAGE_IDLE, __ATOMIC_RELEASE);
+	s->resync = true;
+}
+
+static void stage_free(struct stage *s)
+{
+	stage_stop(s);
+	if (s->conv)
+		convolver1_free(s->conv);
+	fft_free(s->input);
+	fft_free(s->output);
+	fft_free(s->precalculated);
+	fft_free(s->inputAsync);
+}
+
+/* Hand the collected input block to the worker and take the output of the
+ * previous block. When the worker did not start the previous block yet, it is
+ * computed here. When the worker is still computing it, the data thread does
+ * not wait: the stage outputs silence for the next block, counts an xrun and
+ * restarts its history with the following block so that the output stays
+ * aligned. */
+static void stage_queue(struct stage *s)
+{
+	int state = __atomic_load_n(&s->state, __ATOMIC_ACQUIRE);
+
+	if (SPA_UNLIKELY(state == STAGE_PENDING) && stage_claim(s)) {
+		stage_process(s);
+		state = STAGE_IDLE;
+	}
+	if (SPA_UNLIKELY(state == STAGE_RUNNING)) {
+		s->xruns++;
+		s->resync = true;
+		fft_clear(s->precalculated, s->blockSize);
+		return;
+	}
+	if (SPA_UNLIKELY(s->resync)) {
+		/* the output of the worker does not belong to the previous
+		 * block, drop it */
+		fft_clear(s->precalculated, s->blockSize);
+		s->reset = true;
+		s->resync = false;
+	} else {
+		SPA_SWAP(s->precalculated, s->output);
+	}
+	fft_copy(s->inputAsync, s->input, s->blockSize);
+	__atomic_store_n(&s->state, STAGE_PENDING, __ATOMIC_RELEASE);
+	sem_post(&s->worker->wakeup);
+}
+
+static void stage_run(struct stage *s, const float *input, float *output, int length)
+{
+	int processed = 0;
+
+	while (processed < length) {
+		const int processing = SPA_MIN(length - processed, s->blockSize - s->inputFill);
+
+		fft_sum(output + processed, output + processed,
+				s->precalculated + s->inputFill, processing);
+
+		fft_copy(s->input + s->inputFill, input + processed, processing);
+		s->inputFill += processing;
+
+		if (s->inputFill == s->blockSize) {
+			if (s->worker) {
+				stage_queue(s);
+			} else {
+				SPA_SWAP(s->precalculated, s->output);
+				convolver1_run(s->conv, s->input, s->output, s->blockSize);
+			}
+			s->inputFill = 0;
+		}
+		processed += processing;
+	}
+}
+
 void convolver_reset(struct convolver *conv)
 {
+	int i;
 	if (conv->headConvolver)
 		convolver1_reset(conv->headConvolver);
-	if (conv->tailConvolver0) {
-		convolver1_reset(conv->tailConvolver0);
-		fft_clear(conv->tailOutput0, conv->tailBlockSize);
-		fft_clear(conv->tailPrecalculated0, conv->tailBlockSize);
-	}
-	if (conv->tailConvolver) {
-		convolver1_reset(conv->tailConvolver);
-		fft_clear(conv->tailOutput, conv->tailBlockSize);
-		fft_clear(conv->tailPrecalculated, conv->tailBlockSize);
+	for (i = 0; i < conv->n_stages; i++)
+		stage_reset(&conv->stages[i]);
+}
+
+int convolver_plan(int head_block, int max_block, int irlen, int *blocks, int max_blocks)
+{
+	int n = 0, block;
+
+	if (head_block <= 0 || max_blocks <= 0)
+		return 0;
+
+	block = next_power_of_two(head_block);
+	max_block = next_power_of_two(SPA_MAX(max_block, block));
+
+	blocks[n++] = block;
+	while (n < max_blocks) {
+		int next = SPA_MIN(block * 4, max_block);
+		/* the stage would not get any part of the IR */
+		if (next == block || 2 * next >= irlen)
+			break;
+		blocks[n++] = block = next;
 	}
-	conv->tailInputFill = 0;
-	conv->precalculatedPos = 0;
+	return n;
 }
 
-struct convolver *convolver_new(int head_block, int tail_block, const float *ir, int irlen)
+void convolver_ir_unref(struct convolver_ir *ir)
 {
-	struct convolver *conv;
-	int head_ir_len;
+	int i;
 
-	if (head_block == 0 || tail_block == 0)
-		return NULL;
+	if (__atomic_sub_fetch(&ir->ref, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
 
-	head_block = SPA_MAX(1, head_block);
-	if (head_block > tail_block)
-		SPA_SWAP(head_block, tail_block);
+	ir_part_clear(&ir->head);
+	for (i = 0; i < ir->n_stages; i++)
+		ir_part_clear(&ir->stages[i]);
+	free(ir);
+}
+
+struct convolver_ir *convolver_ir_ref(struct convolver_ir *ir)
+{
+	__atomic_add_fetch(&ir->ref, 1, __ATOMIC_RELAXED);
+	return ir;
+}
+
+struct convolver_ir *convolver_ir_new(const int *blocks, int n_blocks, const float *ir, int irlen)
+{
+	struct convolver_ir *cir;
+	int i, block, head, head_ir_len;
+
+	if (n_blocks <= 0 || blocks[0] <= 0)
+		return NULL;
 
 	while (irlen > 0 && fabs(ir[irlen-1]) < 0.000001f)
 		irlen--;
 
-	conv = calloc(1, sizeof(*conv));
-	if (conv == NULL)
+	cir = calloc(1, sizeof(*cir));
+	if (cir == NULL)
 		return NULL;
 
-	if (irlen == 0)
-		return conv;
+	cir->ref = 1;
+	head = block = next_power_of_two(blocks[0]);
 
-	conv->headBlockSize = next_power_of_two(head_block);
-	conv->tailBlockSize = next_power_of_two(tail_block);
+	/* the head convolver handles the IR until the first stage starts,
+	 * every stage then handles the IR until the next stage starts */
+	for (i = 1; i < n_blocks && cir->n_stages < MAX_STAGES; i++) {
+		int next, offset, end;
 
-	head_ir_len = SPA_MIN(irlen, conv->tailBlockSize);
-	conv->headConvolver = convolver1_new(conv->headBlockSize, ir, head_ir_len);
+		next = next_power_of_two(blocks[i]);
+		if (next < block || 2 * next >= irlen)
+			continue;
 
-	if (irlen > conv->tailBlockSize) {
-		int conv1IrLen = SPA_MIN(irlen - conv->tailBlockSize, conv->tailBlockSize);
-		conv->tailConvolver0 = convolver1_new(conv->headBlockSize, ir + conv->tailBlockSize, conv1IrLen);
-		conv->tailOutput0 = fft_alloc(conv->tailBlockSize);
-		conv->tailPrecalculated0 = fft_alloc(conv->tailBlockSize);
-	}
+		offset = 2 * next;
+		end = irlen;
+		if (i + 1 < n_blocks)
+			end = SPA_CLAMP(2 * next_power_of_two(blocks[i + 1]), offset, irlen);
+		if (end == offset)
+			continue;
 
-	if (irlen > 2 * conv->tailBlockSize) {
-		int tailIrLen = irlen - (2 * conv->tailBlockSize);
-		conv->tailConvolver = convolver1_new(conv->tailBlockSize, ir + (2 * conv->tailBlockSize), tailIrLen);
-		conv->tailOutput = fft_alloc(conv->tailBlockSize);
-		conv->tailPrecalculated = fft_alloc(conv->tailBlockSize);
+		if (ir_part_init(&cir->stages[cir->n_stages], next, ir + offset, end - offset) < 0) {
+			cir->n_stages++;
+			goto error;
+		}
+		/* spread the block boundaries of the stages so that the larger
+		 * stages don't all need to be computed in the same cycle. The
+		 * stage latency does not depend on the phase. */
+		if (cir->n_stages > 0)
+			cir->phase[cir->n_stages] = (cir->n_stages * cir->stages[0].blockSize) % next;
+		cir->n_stages++;
+		block = next;
 	}
 
-	if (conv->tailConvolver0 || conv->tailConvolver)
-		conv->tailInput = fft_alloc(conv->tailBlockSize);
+	head_ir_len = cir->n_stages > 0 ? 2 * cir->stages[0].blockSize : irlen;
+	if (ir_part_init(&cir->head, head, ir, SPA_MIN(head_ir_len, irlen)) < 0)
+		goto error;
+
+	return cir;
+error:
+	convolver_ir_unref(cir);
+	return NULL;
+}
+
+struct convolver *convolver_new_ir(struct convolver_ir *ir, struct convolver_pool *pool)
+{
+	struct convolver *conv;
+	int i;
+
+	conv = calloc(1, sizeof(*conv));
+	if (conv == NULL)
+		return NULL;
+
+	conv->ir = convolver_ir_ref(ir);
+
+	conv->headConvolver = convolver1_new(&ir->head);
+	if (conv->headConvolver == NULL)
+		goto error;
+
+	for (i = 0; i < ir->n_stages; i++) {
+		struct stage *s = &conv->stages[conv->n_stages++];
+		if (stage_init(s, &ir->stages[i], ir->phase[i], pool) < 0)
+			goto error;
+	}
 
 	convolver_reset(conv);
 
 	return conv;
+error:
+	convolver_free(conv);
+	return NULL;
+}
+
+struct convolver *convolver_new_partitioned(const int *blocks, int n_blocks,
+		const float *ir, int irlen, struct convolver_pool *pool)
+{
+	struct convolver_ir *cir;
+	struct convolver *conv;
+
+	if ((cir = convolver_ir_new(blocks, n_blocks, ir, irlen)) == NULL)
+		return NULL;
+
+	conv = convolver_new_ir(cir, pool);
+	convolver_ir_unref(cir);
+
+	return conv;
+}
+
+struct convolver *convolver_new(int head_block, int tail_block, const float *ir, int irlen)
+{
+	return convolver_new_async(head_block, tail_block, ir, irlen, NULL);
+}
+
+struct convolver *convolver_new_async(int head_block, int tail_block, const float *ir, int irlen,
+		struct convolver_pool *pool)
+{
+	int blocks[2];
+
+	if (head_block == 0 || tail_block == 0)
+		return NULL;
+
+	head_block = SPA_MAX(1, head_block);
+	if (head_block > tail_block)
+		SPA_SWAP(head_block, tail_block);
+
+	blocks[0] = head_block;
+	blocks[1] = tail_block;
+
+	return convolver_new_partitioned(blocks, 2, ir, irlen, pool);
+}
+
+uint32_t convolver_get_xruns(struct convolver *conv)
+{
+	uint32_t i, xruns = 0;
+	for (i = 0; i < (uint32_t)conv->n_stages; i++)
+		xruns += conv->stages[i].xruns;
+	return xruns;
 }
 
 void convolver_free(struct convolver *conv)
 {
+	int i;
+	for (i = 0; i < conv->n_stages; i++)
+		stage_free(&conv->stages[i]);
 	if (conv->headConvolver)
 		convolver1_free(conv->headConvolver);
-	if (conv->tailConvolver0)
-		convolver1_free(conv->tailConvolver0);
-	if (conv->tailConvolver)
-		convolver1_free(conv->tailConvolver);
-	fft_free(conv->tailOutput0);
-	fft_free(conv->tailPrecalculated0);
-	fft_free(conv->tailOutput);
-	fft_free(conv->tailPrecalculated);
-	fft_free(conv->tailInput);
+	convolver_ir_unref(conv->ir);
 	free(conv);
 }
 
@@ -421,57 +893,8 @@ int convolver_run(struct convolver *conv, const float *input, float *output, int
 
 	convolver1_run(conv->headConvolver, input, output, length);
 
-	if (conv->tailInput) {
-		int processed = 0;
+	for (i = 0; i < conv->n_stages; i++)
+		stage_run(&conv->stages[i], input, output, length);
 
-		while (processed < length) {
-			int remaining = length - processed;
-			int processing = SPA_MIN(remaining, conv->headBlockSize - (conv->tailInputFill % conv->headBlockSize));
-
-			const int sumBegin = processed;
-			const int sumEnd = processed + processing;
-
-			if (conv->tailPrecalculated0) {
-				int precalculatedPos = conv->precalculatedPos;
-				for (i = sumBegin; i < sumEnd; i++) {
-					output[i] += conv->tailPrecalculated0[precalculatedPos];
-					precalculatedPos++;
-				}
-			}
-
-			if (conv->tailPrecalculated) {
-				int precalculatedPos = conv->precalculatedPos;
-				for (i = sumBegin; i < sumEnd; i++) {
-					output[i] += conv->tailPrecalculated[precalculatedPos];
-					precalculatedPos++;
-				}
-			}
-			conv->precalculatedPos += processing;
-
-			fft_copy(conv->tailInput + conv->tailInputFill, input + processed, processing);
-			conv->tailInputFill += processing;
-
-			if (conv->tailPrecalculated0 && (conv->tailInputFill % conv->headBlockSize == 0)) {
-				int blockOffset = conv->tailInputFill - conv->headBlockSize;
-				convolver1_run(conv->tailConvolver0,
-						conv->tailInput + blockOffset,
-						conv->tailOutput0 + blockOffset,
-						conv->headBlockSize);
-				if (conv->tailInputFill == conv->tailBlockSize)
-					SPA_SWAP(conv->tailPrecalculated0, conv->tailOutput0);
-			}
-
-			if (conv->tailPrecalculated &&
-			    conv->tailInputFill == conv->tailBlockSize) {
-				SPA_SWAP(conv->tailPrecalculated, conv->tailOutput);
-				convolver1_run(conv->tailConvolver, conv->tailInput, conv->tailOutput, conv->tailBlockSize);
-			}
-			if (conv->tailInputFill == conv->tailBlockSize) {
-				conv->tailInputFill = 0;
-				conv->precalculatedPos = 0;
-			}
-			processed += processing;
-		}
-	}
 	return 0;
 }
@@ -24,9 +24,30 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+
+struct spa_thread_utils;
+
+struct convolver_pool *convolver_pool_new(struct spa_thread_utils *utils, int n_workers);
+void convolver_pool_free(struct convolver_pool *pool);
 
 struct convolver *convolver_new(int block, int tail, const float *ir, int irlen);
+struct convolver *convolver_new_async(int block, int tail, const float *ir, int irlen,
+		struct convolver_pool *pool);
+struct convolver *convolver_new_partitioned(const int *blocks, int n_blocks,
+		const float *ir, int irlen, struct convolver_pool *pool);
+
+struct convolver_ir *convolver_ir_new(const int *blocks, int n_blocks,
+		const float *ir, int irlen);
+struct convolver_ir *convolver_ir_ref(struct convolver_ir *ir);
+void convolver_ir_unref(struct convolver_ir *ir);
+
+struct convolver *convolver_new_ir(struct convolver_ir *ir, struct convolver_pool *pool);
+
+int convolver_plan(int head_block, int max_block, int irlen, int *blocks, int max_blocks);
 void convolver_free(struct convolver *conv);
 
 void convolver_reset(struct convolver *conv);
+/* the number of blocks that a worker did not finish in time */
+uint32_t convolver_get_xruns(struct convolver *conv);
 int convolver_run(struct convolver *conv, const float *input, float *output, int length);
@@ -0,0 +1,69 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <float.h>
+
+#include <spa/utils/defs.h>
+
+#include "eq-ops.h"
+
+#define F(x) (-FLT_MIN < (x) && (x) < FLT_MIN ? 0.0f : (x))
+
+void eq_process_c(struct eq_ops *ops,
+		float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t c, b, i;
+
+	for (c = 0; c < ops->n_channels; c++) {
+		float *d = dst[c];
+		const float *s = src[c];
+
+		if (d == NULL)
+			continue;
+		if (s == NULL) {
+			memset(d, 0, n_samples * sizeof(float));
+			s = d;
+		}
+		if (ops->n_bands == 0 && s != d)
+			memcpy(d, s, n_samples * sizeof(float));
+
+		for (b = 0; b < ops->n_bands; b++) {
+			const struct eq_coefs *k = &ops->coefs[b];
+			float s1 = ops->s1[b][c], s2 = ops->s2[b][c];
+
+			for (i = 0; i < n_samples; i++) {
+				float x = s[i];
+				float y = k->b0 * x + s1;
+				s1 = k->b1 * x - k->a1 * y + s2;
+				s2 = k->b2 * x - k->a2 * y;
+				d[i] = y;
+			}
+			ops->s1[b][c] = F(s1);
+			ops->s2[b][c] = F(s2);
+			s = d;
+		}
+	}
+}
@@ -0,0 +1,99 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <float.h>
+
+#include <spa/utils/defs.h>
+
+#include "eq-ops.h"
+
+#include <arm_neon.h>
+
+/* interleave 4 channels in tmp, run all bands over the interleaved
+ * samples and deinterleave the result again */
+static void eq_process_4(struct eq_ops *ops, uint32_t c, uint32_t n_channels,
+		float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	float tmp[EQ_BLOCK_SIZE * 4] SPA_ALIGNED(16);
+	const float32x4_t min = vdupq_n_f32(FLT_MIN);
+	uint32_t b, i, l, offs, n;
+
+	for (offs = 0; offs < n_samples; offs += n) {
+		n = SPA_MIN(n_samples - offs, (uint32_t)EQ_BLOCK_SIZE);
+
+		for (l = 0; l < 4; l++) {
+			const float *s = l < n_channels ? src[c + l] : NULL;
+			if (s == NULL)
+				for (i = 0; i < n; i++)
+					tmp[i * 4 + l] = 0.0f;
+			else
+				for (i = 0; i < n; i++)
+					tmp[i * 4 + l] = s[offs + i];
+		}
+		for (b = 0; b < ops->n_bands; b++) {
+			const struct eq_coefs *k = &ops->coefs[b];
+			float32x4_t b0 = vdupq_n_f32(k->b0);
+			float32x4_t b1 = vdupq_n_f32(k->b1);
+			float32x4_t b2 = vdupq_n_f32(k->b2);
+			float32x4_t a1 = vdupq_n_f32(k->a1);
+			float32x4_t a2 = vdupq_n_f32(k->a2);
+			float32x4_t s1 = vld1q_f32(&ops->s1[b][c]);
+			float32x4_t s2 = vld1q_f32(&ops->s2[b][c]);
+			float32x4_t x, y;
+
+			for (i = 0; i < n; i++) {
+				x = vld1q_f32(&tmp[i * 4]);
+				y = vmlaq_f32(s1, b0, x);
+				s1 = vmlsq_f32(vmlaq_f32(s2, b1, x), a1, y);
+				s2 = vmlsq_f32(vmulq_f32(b2, x), a2, y);
+				vst1q_f32(&tmp[i * 4], y);
+			}
+			/* flush denormals */
+			s1 = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(s1),
+						vcageq_f32(s1, min)));
+			s2 = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(s2),
+						vcageq_f32(s2, min)));
+			vst1q_f32(&ops->s1[b][c], s1);
+			vst1q_f32(&ops->s2[b][c], s2);
+		}
+		for (l = 0; l < n_channels; l++) {
+			float *d = dst[c + l];
+			if (d == NULL)
+				continue;
+			for (i = 0; i < n; i++)
+				d[offs + i] = tmp[i * 4 + l];
+		}
+	}
+}
+
+void eq_process_neon(struct eq_ops *ops,
+		float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t c;
+	for (c = 0; c < ops->n_channels; c += 4)
+		eq_process_4(ops, c, SPA_MIN(ops->n_channels - c, 4u), dst, src, n_samples);
+}
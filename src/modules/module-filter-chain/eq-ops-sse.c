@@ -0,0 +1,98 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <float.h>
+
+#include <spa/utils/defs.h>
+
+#include "eq-ops.h"
+
+#include <xmmintrin.h>
+
+/* interleave 4 channels in tmp, run all bands over the interleaved
+ * samples and deinterleave the result again */
+static void eq_process_4(struct eq_ops *ops, uint32_t c, uint32_t n_channels,
+		float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	float tmp[EQ_BLOCK_SIZE * 4] SPA_ALIGNED(16);
+	const __m128 min = _mm_set1_ps(FLT_MIN);
+	const __m128 mask = _mm_set1_ps(-0.0f);
+	uint32_t b, i, l, offs, n;
+
+	for (offs = 0; offs < n_samples; offs += n) {
+		n = SPA_MIN(n_samples - offs, (uint32_t)EQ_BLOCK_SIZE);
+
+		for (l = 0; l < 4; l++) {
+			const float *s = l < n_channels ? src[c + l] : NULL;
+			if (s == NULL)
+				for (i = 0; i < n; i++)
+					tmp[i * 4 + l] = 0.0f;
+			else
+				for (i = 0; i < n; i++)
+					tmp[i * 4 + l] = s[offs + i];
+		}
+		for (b = 0; b < ops->n_bands; b++) {
+			const struct eq_coefs *k = &ops->coefs[b];
+			__m128 b0 = _mm_set1_ps(k->b0);
+			__m128 b1 = _mm_set1_ps(k->b1);
+			__m128 b2 = _mm_set1_ps(k->b2);
+			__m128 a1 = _mm_set1_ps(k->a1);
+			__m128 a2 = _mm_set1_ps(k->a2);
+			__m128 s1 = _mm_loadu_ps(&ops->s1[b][c]);
+			__m128 s2 = _mm_loadu_ps(&ops->s2[b][c]);
+			__m128 x, y;
+
+			for (i = 0; i < n; i++) {
+				x = _mm_load_ps(&tmp[i * 4]);
+				y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+				s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+				s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+				_mm_store_ps(&tmp[i * 4], y);
+			}
+			/* flush denormals */
+			s1 = _mm_and_ps(s1, _mm_cmpge_ps(_mm_andnot_ps(mask, s1), min));
+			s2 = _mm_and_ps(s2, _mm_cmpge_ps(_mm_andnot_ps(mask, s2), min));
+			_mm_storeu_ps(&ops->s1[b][c], s1);
+			_mm_storeu_ps(&ops->s2[b][c], s2);
+		}
+		for (l = 0; l < n_channels; l++) {
+			float *d = dst[c + l];
+			if (d == NULL)
+				continue;
+			for (i = 0; i < n; i++)
+				d[offs + i] = tmp[i * 4 + l];
+		}
+	}
+}
+
+void eq_process_sse(struct eq_ops *ops,
+		float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint32_t c;
+	for (c = 0; c < ops->n_channels; c += 4)
+		eq_process_4(ops, c, SPA_MIN(ops->n_channels - c, 4u), dst, src, n_samples);
+}
@@ -0,0 +1,109 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <spa/support/cpu.h>
+#include <spa/utils/defs.h>
+
+#include "eq-ops.h"
+
+typedef void (*eq_func_t) (struct eq_ops *ops,
+		float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],
+		uint32_t n_samples);
+
+struct eq_info {
+	uint32_t min_channels;
+	uint32_t cpu_flags;
+	eq_func_t process;
+};
+
+static struct eq_info eq_table[] =
+{
+#if defined (HAVE_AVX)
+	{ 5, SPA_CPU_FLAG_AVX, eq_process_avx },
+#endif
+#if defined (HAVE_SSE)
+	{ 0, SPA_CPU_FLAG_SSE, eq_process_sse },
+#endif
+#if defined (HAVE_NEON)
+	{ 0, SPA_CPU_FLAG_NEON, eq_process_neon },
+#endif
+	{ 0, 0, eq_process_c },
+};
+
+#define MATCH_CPU_FLAGS(a,b)	((a) == 0 || ((a) & (b)) == a)
+
+static const struct eq_info *find_eq_info(uint32_t n_channels, uint32_t cpu_flags)
+{
+	size_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(eq_table); i++) {
+		if (n_channels >= eq_table[i].min_channels &&
+		    MATCH_CPU_FLAGS(eq_table[i].cpu_flags, cpu_flags))
+			return &eq_table[i];
+	}
+	return NULL;
+}
+
+static void impl_eq_ops_free(struct eq_ops *ops)
+{
+	spa_zero(*ops);
+}
+
+void eq_ops_set_band(struct eq_ops *ops, uint32_t band, const struct biquad *bq)
+{
+	struct eq_coefs *c = &ops->coefs[band];
+	c->b0 = bq->b0;
+	c->b1 = bq->b1;
+	c->b2 = bq->b2;
+	c->a1 = bq->a1;
+	c->a2 = bq->a2;
+}
+
+void eq_ops_reset(struct eq_ops *ops)
+{
+	memset(ops->s1, 0, sizeof(ops->s1));
+	memset(ops->s2, 0, sizeof(ops->s2));
+}
+
+int eq_ops_init(struct eq_ops *ops)
+{
+	const struct eq_info *info;
+
+	if (ops->n_channels > EQ_MAX_CHANNELS || ops->n_bands > EQ_MAX_BANDS)
+		return -EINVAL;
+
+	info = find_eq_info(ops->n_channels, ops->cpu_flags);
+	if (info == NULL)
+		return -ENOTSUP;
+
+	ops->priv = info;
+	ops->cpu_flags = info->cpu_flags;
+	ops->process = info->process;
+	ops->free = impl_eq_ops_free;
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <spa/utils/defs.h>
+
+#include "biquad.h"
+
+#define EQ_MAX_BANDS	32
+#define EQ_MAX_CHANNELS	8
+
+/* A cascade of biquad filters applied to up to EQ_MAX_CHANNELS channels.
+ * The filters use the transposed direct form II. The state is stored with
+ * the channels next to each other so that the SIMD implementations can
+ * process the channels in the lanes of a vector. */
+struct eq_ops {
+	uint32_t n_channels;
+	uint32_t n_bands;
+	uint32_t cpu_flags;
+
+	struct eq_coefs {
+		float b0, b1, b2;
+		float a1, a2;
+	} coefs[EQ_MAX_BANDS];
+
+	float s1[EQ_MAX_BANDS][EQ_MAX_CHANNELS];
+	float s2[EQ_MAX_BANDS][EQ_MAX_CHANNELS];
+
+	void (*process) (struct eq_ops *ops,
+			float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],
+			uint32_t n_samples);
+	void (*free) (struct eq_ops *ops);
+
+	const void *priv;
+};
+
+int eq_ops_init(struct eq_ops *ops);
+
+void eq_ops_set_band(struct eq_ops *ops, uint32_t band, const struct biquad *bq);
+void eq_ops_reset(struct eq_ops *ops);
+
+#define eq_ops_process(ops,...)		(ops)->process(ops, __VA_ARGS__)
+#define eq_ops_free(ops)		(ops)->free(ops)
+
+#define DEFINE_FUNCTION(name,arch) \
+void eq_##name##_##arch(struct eq_ops *ops,				\
+		float * SPA_RESTRICT dst[], const float * SPA_RESTRICT src[],	\
+		uint32_t n_samples)
+
+#define EQ_BLOCK_SIZE	128
+
+DEFINE_FUNCTION(process, c);
+
+#if defined(HAVE_SSE)
+DEFINE_FUNCTION(process, sse);
+#endif
+#if defined(HAVE_AVX)
+DEFINE_FUNCTION(process, avx);
+#endif
+#if defined(HAVE_NEON)
+DEFINE_FUNCTION(process, neon);
+#endif
+
+#undef DEFINE_FUNCTION
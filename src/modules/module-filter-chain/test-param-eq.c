@@ -0,0 +1,182 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <spa/support/cpu.h>
+
+#include <pipewire/pipewire.h>
+
+#include "biquad.h"
+#include "eq-ops.h"
+
+#define MAX_SAMPLES	2048
+#define N_BANDS		10
+
+/* the compiler can use fused multiply-adds in some implementations, the
+ * rounding differences add up in the recursion of the low frequency filters */
+#define TOLERANCE	5e-3f
+
+static uint32_t cpu_flags;
+
+static float samp_in[EQ_MAX_CHANNELS][MAX_SAMPLES];
+static float samp_ref[EQ_MAX_CHANNELS][MAX_SAMPLES];
+static float samp_out[EQ_MAX_CHANNELS][MAX_SAMPLES];
+
+/* the samples are processed in blocks of these sizes, most of them are not
+ * a multiple of the vector width or of EQ_BLOCK_SIZE */
+static const uint32_t block_sizes[] = { 1, 3, 7, 64, 129, 255, 1, 1027 };
+
+static const struct {
+	enum biquad_type type;
+	float freq;
+	float Q;
+	float gain;
+} bands[N_BANDS] = {
+	{ BQ_HIGHPASS, 20.0f, 0.7f, 0.0f },
+	{ BQ_LOWSHELF, 105.0f, 0.7f, 4.0f },
+	{ BQ_PEAKING, 180.0f, 1.2f, -3.5f },
+	{ BQ_PEAKING, 350.0f, 2.0f, 1.5f },
+	{ BQ_PEAKING, 900.0f, 1.0f, -2.0f },
+	{ BQ_PEAKING, 2200.0f, 3.0f, 2.5f },
+	{ BQ_PEAKING, 3500.0f, 4.0f, -4.0f },
+	{ BQ_PEAKING, 6000.0f, 2.0f, 1.0f },
+	{ BQ_HIGHSHELF, 10000.0f, 0.7f, -2.0f },
+	{ BQ_LOWPASS, 20000.0f, 0.7f, 0.0f },
+};
+
+static bool init_eq(struct eq_ops *eq, uint32_t flags, uint32_t n_channels)
+{
+	struct biquad bq;
+	uint32_t i;
+
+	spa_zero(*eq);
+	eq->cpu_flags = flags;
+	eq->n_channels = n_channels;
+	eq->n_bands = N_BANDS;
+	for (i = 0; i < N_BANDS; i++) {
+		biquad_set(&bq, bands[i].type, bands[i].freq * 2 / 48000.0f,
+				bands[i].Q, bands[i].gain);
+		eq_ops_set_band(eq, i, &bq);
+	}
+	spa_assert_se(eq_ops_init(eq) == 0);
+
+	/* not all implementations handle all channel counts */
+	return eq->cpu_flags == flags;
+}
+
+static uint32_t run_blocks(struct eq_ops *eq, float out[][MAX_SAMPLES], uint32_t n_channels)
+{
+	const float *ip[EQ_MAX_CHANNELS];
+	float *op[EQ_MAX_CHANNELS];
+	uint32_t i, c, n, offs = 0;
+
+	for (i = 0; i < SPA_N_ELEMENTS(block_sizes); i++) {
+		n = block_sizes[i];
+		spa_assert_se(offs + n <= MAX_SAMPLES);
+		for (c = 0; c < n_channels; c++) {
+			ip[c] = &samp_in[c][offs];
+			op[c] = &out[c][offs];
+		}
+		eq_ops_process(eq, op, ip, n);
+		offs += n;
+	}
+	return offs;
+}
+
+static void run_test(const char *impl, uint32_t flags)
+{
+	struct eq_ops ref, eq;
+	uint32_t i, c, n_channels, n_samples;
+
+	for (n_channels = 1; n_channels <= EQ_MAX_CHANNELS; n_channels++) {
+		if (!init_eq(&eq, flags, n_channels))
+			continue;
+
+		fprintf(stderr, "test %s channels:%u\n", impl, n_channels);
+
+		spa_assert_se(init_eq(&ref, 0, n_channels));
+		n_samples = run_blocks(&ref, samp_ref, n_channels);
+		spa_assert_se(run_blocks(&eq, samp_out, n_channels) == n_samples);
+
+		for (c = 0; c < n_channels; c++) {
+			for (i = 0; i < n_samples; i++) {
+				float r = samp_ref[c][i], o = samp_out[c][i];
+				if (fabsf(r - o) > TOLERANCE * (1.0f + fabsf(r))) {
+					fprintf(stderr, "%s channel %u sample %u: %f != %f\n",
+							impl, c, i, o, r);
+					spa_assert_not_reached();
+				}
+			}
+		}
+		eq_ops_free(&ref);
+		eq_ops_free(&eq);
+	}
+}
+
+static void test_param_eq(void)
+{
+#if defined (HAVE_SSE)
+	if (cpu_flags & SPA_CPU_FLAG_SSE)
+		run_test("sse", SPA_CPU_FLAG_SSE);
+#endif
+#if defined (HAVE_AVX)
+	if (cpu_flags & SPA_CPU_FLAG_AVX)
+		run_test("avx", SPA_CPU_FLAG_AVX);
+#endif
+#if defined (HAVE_NEON)
+	if (cpu_flags & SPA_CPU_FLAG_NEON)
+		run_test("neon", SPA_CPU_FLAG_NEON);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_support support[16];
+	uint32_t i, j, n_support;
+	struct spa_cpu *cpu;
+
+	pw_init(&argc, &argv);
+
+	n_support = pw_get_support(support, SPA_N_ELEMENTS(support));
+	cpu = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_CPU);
+	cpu_flags = cpu ? spa_cpu_get_flags(cpu) : 0;
+	printf("got get CPU flags %d\n", cpu_flags);
+
+	srand48(0);
+	for (i = 0; i < EQ_MAX_CHANNELS; i++)
+		for (j = 0; j < MAX_SAMPLES; j++)
+			samp_in[i][j] = drand48() * 2.0 - 1.0;
+
+	test_param_eq();
+
+	pw_deinit();
+
+	return 0;
+}
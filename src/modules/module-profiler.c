@@ -49,6 +49,14 @@
  * Use tools like pw-top and pw-profiler to collect profiling information
  * about the pipewire graph.
  *
+ * Clients receive the profiler data as Profiler objects. Clients that bind
+ * with version 4 or later can call pw_profiler_enable_ring() to receive a
+ * shared memory ring with fixed size binary records for each graph cycle and
+ * the node names with separate events instead. They also receive the wait and
+ * busy time histograms and the xrun and incomplete cycle counters of each node
+ * once per second, when they changed. Both are only generated when there are
+ * clients for them.
+ *
  * ## Example configuration
  *
  * The module has no arguments and is usually added to the config file of
@@ -73,9 +81,12 @@ PW_LOG_TOPIC(mod_topic, "mod." NAME);
 
 #define TMP_BUFFER		(16 * 1024)
 #define MAX_BUFFER		(8 * 1024 * 1024)
+#define STATS_INTERVAL		1
 #define MIN_FLUSH		(16 * 1024)
 #define DEFAULT_IDLE		5
 #define DEFAULT_INTERVAL	1
+#define RING_SIZE		(8 * 1024 * 1024)
+#define RING_OFFSET		SPA_ROUND_UP_N(sizeof(struct pw_profiler_ring), 64)
 
 int pw_protocol_native_ext_profiler_init(struct pw_context *context);
 
@@ -84,6 +95,12 @@ int pw_protocol_native_ext_profiler_init(struct pw_context *context);
 
 #define pw_profiler_resource_profile(r,...)        \
         pw_profiler_resource(r,profile,0,__VA_ARGS__)
+#define pw_profiler_resource_ring(r,...)        \
+        pw_profiler_resource(r,ring,1,__VA_ARGS__)
+#define pw_profiler_resource_node(r,...)        \
+        pw_profiler_resource(r,node,1,__VA_ARGS__)
+#define pw_profiler_resource_node_stats(r,...)        \
+        pw_profiler_resource(r,node_stats,1,__VA_ARGS__)
 
 static const struct spa_dict_item module_props[] = {
 	{ PW_KEY_MODULE_AUTHOR, "Wim Taymans <wim.taymans@gmail.com>" },
@@ -91,11 +108,19 @@ static const struct spa_dict_item module_props[] = {
 	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
 };
 
+struct loop_listener {
+	struct spa_list link;
+	struct impl *impl;
+	struct pw_loop *loop;
+	struct spa_hook listener;
+};
+
 struct impl {
 	struct pw_context *context;
 	struct pw_properties *properties;
 
-	struct spa_hook context_listener;
+	struct spa_list loop_listeners;
+	struct spa_hook context_node_listener;
 	struct spa_hook module_listener;
 
 	struct pw_global *global;
@@ -103,11 +128,31 @@ struct impl {
 
 	int64_t count;
 	uint32_t busy;
+	uint32_t n_pod;
+	uint32_t n_ring;
 	uint32_t empty;
 	struct spa_source *flush_timeout;
 	unsigned int flushing:1;
 	unsigned int listening:1;
 
+	struct pw_memblock *ring_block;
+	struct pw_profiler_ring *ring;
+	uint64_t ring_index;
+
+	struct spa_source *stats_timeout;
+	struct pw_array stats;
+
+	struct {
+		bool pod;
+		bool ring;
+		/* drivers can complete their cycle concurrently in different
+		 * data loops, this makes sure the ring, the POD ringbuffer and
+		 * the tmp buffer only have one writer at a time. A driver that
+		 * finds the lock taken drops its record. */
+		bool lock;
+		uint32_t dropped;
+	} rt;
+
 	struct spa_ringbuffer buffer;
 	uint8_t tmp[TMP_BUFFER];
 	uint8_t data[MAX_BUFFER];
@@ -115,13 +160,31 @@ struct impl {
 	uint8_t flush[MAX_BUFFER + sizeof(struct spa_pod_struct)];
 };
 
+struct stats_entry {
+	uint32_t id;
+	uint64_t wait_count;
+	uint32_t xrun_count;
+	uint32_t incomplete_count;
+	uint32_t xrun_pending_count;
+};
+
 struct resource_data {
 	struct impl *impl;
 
 	struct pw_resource *resource;
 	struct spa_hook resource_listener;
+	struct spa_hook object_listener;
+
+	struct pw_memblock *ring;
+	unsigned int use_ring:1;
 };
 
+static inline bool resource_uses_ring(struct pw_resource *resource)
+{
+	struct resource_data *d = pw_resource_get_user_data(resource);
+	return d->use_ring;
+}
+
 static void start_flush(struct impl *impl)
 {
 	struct timespec value, interval;
@@ -151,6 +214,14 @@ static void stop_flush(struct impl *impl)
 	impl->flushing = false;
 }
 
+static void check_dropped(struct impl *impl)
+{
+	uint32_t dropped = __atomic_exchange_n(&impl->rt.dropped, 0, __ATOMIC_RELAXED);
+	if (dropped > 0)
+		pw_log_info("%p: dropped %u records from concurrent drivers",
+				impl, dropped);
+}
+
 static void flush_timeout(void *data, uint64_t expirations)
 {
 	struct impl *impl = data;
@@ -159,6 +230,8 @@ static void flush_timeout(void *data, uint64_t expirations)
 	struct spa_pod_struct *p;
 	struct pw_resource *resource;
 
+	check_dropped(impl);
+
 	avail = spa_ringbuffer_get_read_index(&impl->buffer, &idx);
 
 	pw_log_trace("%p avail %d", impl, avail);
@@ -182,9 +255,119 @@ static void flush_timeout(void *data, uint64_t expirations)
 		pw_profiler_resource_profile(resource, &p->pod);
 }
 
-static void context_do_profile(void *data, struct pw_impl_node *node)
+static void update_stats_timer(struct impl *impl)
+{
+	struct timespec value, interval;
+
+	value.tv_sec = impl->n_ring > 0 ? STATS_INTERVAL : 0;
+	value.tv_nsec = 0;
+	interval.tv_sec = value.tv_sec;
+	interval.tv_nsec = 0;
+	pw_loop_update_timer(impl->context->main_loop,
+			impl->stats_timeout, &value, &interval, false);
+}
+
+static struct stats_entry *find_stats(struct impl *impl, uint32_t id)
+{
+	struct stats_entry *e;
+
+	pw_array_for_each(e, &impl->stats) {
+		if (e->id == id)
+			return e;
+	}
+	return NULL;
+}
+
+static void remove_stats(struct impl *impl, uint32_t id)
+{
+	struct stats_entry *e;
+
+	if ((e = find_stats(impl, id)) != NULL)
+		pw_array_remove(&impl->stats, e);
+}
+
+/* the histograms are updated from the data thread while we copy them, the
+ * copy can be slightly inconsistent but that is fine for statistics. */
+static void get_node_stats(struct pw_impl_node *node, struct pw_profiler_node_stats *stats)
+{
+	struct pw_node_activation *a = node->rt.activation;
+
+	stats->wait = a->wait_histogram;
+	stats->busy = a->busy_histogram;
+	stats->xrun_count = a->xrun_count;
+	stats->incomplete_count = a->incomplete_count;
+	stats->xrun_pending_count = a->xrun_pending_count;
+}
+
+static void send_node_stats(struct impl *impl, struct pw_resource *resource,
+		uint32_t id, const struct pw_profiler_node_stats *stats)
+{
+	if (resource == NULL) {
+		spa_list_for_each(resource, &impl->global->resource_list, link) {
+			if (resource_uses_ring(resource))
+				pw_profiler_resource_node_stats(resource, id, stats);
+		}
+	} else {
+		pw_profiler_resource_node_stats(resource, id, stats);
+	}
+}
+
+static void stats_timeout(void *data, uint64_t expirations)
 {
 	struct impl *impl = data;
+	struct pw_impl_node *node;
+	struct pw_profiler_node_stats stats;
+	struct stats_entry *e;
+
+	if (impl->global == NULL)
+		return;
+
+	check_dropped(impl);
+
+	spa_list_for_each(node, &impl->context->node_list, link) {
+		if (node->global == NULL || node->rt.activation == NULL)
+			continue;
+
+		get_node_stats(node, &stats);
+		if (stats.wait.count == 0 && stats.xrun_count == 0 &&
+		    stats.incomplete_count == 0)
+			continue;
+
+		if ((e = find_stats(impl, node->info.id)) == NULL) {
+			if ((e = pw_array_add(&impl->stats, sizeof(*e))) == NULL)
+				continue;
+			spa_zero(*e);
+			e->id = node->info.id;
+		} else if (e->wait_count == stats.wait.count &&
+		    e->xrun_count == stats.xrun_count &&
+		    e->incomplete_count == stats.incomplete_count &&
+		    e->xrun_pending_count == stats.xrun_pending_count)
+			continue;
+
+		e->wait_count = stats.wait.count;
+		e->xrun_count = stats.xrun_count;
+		e->incomplete_count = stats.incomplete_count;
+		e->xrun_pending_count = stats.xrun_pending_count;
+
+		send_node_stats(impl, NULL, node->info.id, &stats);
+	}
+}
+
+static struct spa_fraction node_latency(struct pw_impl_node *n)
+{
+	struct spa_fraction latency = n->latency;
+
+	if (n->force_quantum != 0)
+		latency.num = n->force_quantum;
+	if (n->force_rate != 0)
+		latency.denom = n->force_rate;
+	else if (n->rate.denom != 0)
+		latency.denom = n->rate.denom;
+	return latency;
+}
+
+static void profile_pod(struct impl *impl, struct pw_impl_node *node)
+{
 	struct spa_pod_builder b;
 	struct spa_pod_frame f[2];
 	struct pw_node_activation *a = node->rt.activation;
@@ -193,9 +376,6 @@ static void context_do_profile(void *data, struct pw_impl_node *node)
 	int32_t filled;
 	uint32_t idx, avail;
 
-	if (SPA_FLAG_IS_SET(pos->clock.flags, SPA_IO_CLOCK_FLAG_FREEWHEEL))
-		return;
-
 	spa_pod_builder_init(&b, impl->tmp, sizeof(impl->tmp));
 	spa_pod_builder_push_object(&b, &f[0],
 			SPA_TYPE_OBJECT_Profiler, 0);
@@ -241,13 +421,7 @@ static void context_do_profile(void *data, struct pw_impl_node *node)
 		if (n == NULL || n == node)
 			continue;
 
-		latency = n->latency;
-		if (n->force_quantum != 0)
-			latency.num = n->force_quantum;
-		if (n->force_rate != 0)
-			latency.denom = n->force_rate;
-		else if (n->rate.denom != 0)
-			latency.denom = n->rate.denom;
+		latency = node_latency(n);
 
 		na = n->rt.activation;
 		spa_pod_builder_prop(&b, SPA_PROFILER_followerBlock, 0);
@@ -264,17 +438,17 @@ static void context_do_profile(void *data, struct pw_impl_node *node)
 	spa_pod_builder_pop(&b, &f[0]);
 
 	if (b.state.offset > sizeof(impl->tmp))
-		goto done;
+		return;
 
 	filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
 	if (filled < 0 || filled > MAX_BUFFER) {
 		pw_log_warn("%p: queue xrun %d", impl, filled);
-		goto done;
+		return;
 	}
 	avail = MAX_BUFFER - filled;
 	if (avail < b.state.offset) {
 		pw_log_warn("%p: queue full %d < %d", impl, avail, b.state.offset);
-		goto done;
+		return;
 	}
 	spa_ringbuffer_write_data(&impl->buffer,
 			impl->data, MAX_BUFFER,
@@ -284,8 +458,101 @@ static void context_do_profile(void *data, struct pw_impl_node *node)
 
 	if (!impl->flushing || filled + b.state.offset > MIN_FLUSH)
 		start_flush(impl);
-done:
+}
+
+static inline void fill_block(struct pw_profiler_block *b, uint32_t id,
+		int64_t prev_signal_time, struct pw_node_activation *a,
+		struct spa_fraction latency)
+{
+	b->id = id;
+	b->status = a->status;
+	b->prev_signal_time = prev_signal_time;
+	b->signal_time = a->signal_time;
+	b->awake_time = a->awake_time;
+	b->finish_time = a->finish_time;
+	b->latency = latency;
+}
+
+static void profile_ring(struct impl *impl, struct pw_impl_node *node)
+{
+	struct pw_profiler_ring *ring = impl->ring;
+	struct pw_profiler_record *r = (struct pw_profiler_record *)impl->tmp;
+	struct pw_node_activation *a = node->rt.activation;
+	struct spa_io_position *pos = &a->position;
+	struct pw_node_target *t;
+	uint32_t max_blocks;
+	uint64_t w;
+
+	max_blocks = (sizeof(impl->tmp) - sizeof(*r)) / sizeof(struct pw_profiler_block);
+
+	r->count = impl->count;
+	r->cpu_load[0] = a->cpu_load[0];
+	r->cpu_load[1] = a->cpu_load[1];
+	r->cpu_load[2] = a->cpu_load[2];
+	r->xrun_count = a->xrun_count;
+	r->clock_flags = pos->clock.flags;
+	r->clock_id = pos->clock.id;
+	r->clock_nsec = pos->clock.nsec;
+	r->clock_rate = pos->clock.rate;
+	r->clock_position = pos->clock.position;
+	r->clock_duration = pos->clock.duration;
+	r->clock_delay = pos->clock.delay;
+	r->clock_rate_diff = pos->clock.rate_diff;
+	r->clock_next_nsec = pos->clock.next_nsec;
+
+	r->n_blocks = 0;
+	fill_block(&r->blocks[r->n_blocks++], node->info.id,
+			a->prev_signal_time, a, node->latency);
+
+	spa_list_for_each(t, &node->rt.target_list, link) {
+		struct pw_impl_node *n = t->node;
+
+		if (n == NULL || n == node)
+			continue;
+		if (r->n_blocks == max_blocks)
+			break;
+
+		fill_block(&r->blocks[r->n_blocks++], n->info.id,
+				a->signal_time, n->rt.activation, node_latency(n));
+	}
+	r->size = sizeof(*r) + r->n_blocks * sizeof(struct pw_profiler_block);
+
+	/* readers check the reserved index after copying a record to see if
+	 * we overwrote it in the meantime. The ring header is writable by the
+	 * clients so only use our own geometry. */
+	w = impl->ring_index;
+	__atomic_store_n(&ring->reserved, w + r->size, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	spa_ringbuffer_write_data(NULL,
+			SPA_PTROFF(ring, RING_OFFSET, void), RING_SIZE,
+			w % RING_SIZE, r, r->size);
+
+	impl->ring_index = w + r->size;
+	__atomic_store_n(&ring->writeindex, impl->ring_index, __ATOMIC_RELEASE);
+}
+
+static void context_do_profile(void *data, struct pw_impl_node *node)
+{
+	struct impl *impl = data;
+	struct spa_io_position *pos = &node->rt.activation->position;
+
+	if (SPA_FLAG_IS_SET(pos->clock.flags, SPA_IO_CLOCK_FLAG_FREEWHEEL))
+		return;
+
+	if (__atomic_test_and_set(&impl->rt.lock, __ATOMIC_ACQUIRE)) {
+		__atomic_fetch_add(&impl->rt.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	if (__atomic_load_n(&impl->rt.ring, __ATOMIC_ACQUIRE))
+		profile_ring(impl, node);
+	if (__atomic_load_n(&impl->rt.pod, __ATOMIC_ACQUIRE))
+		profile_pod(impl, node);
+
 	impl->count++;
+
+	__atomic_clear(&impl->rt.lock, __ATOMIC_RELEASE);
 }
 
 static const struct pw_context_driver_events context_events = {
@@ -294,30 +561,74 @@ static const struct pw_context_driver_events context_events = {
 	.complete = context_do_profile,
 };
 
+/* the driver listeners of a data loop are only changed from that loop */
+static int do_start(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct loop_listener *l = user_data;
+	struct impl *impl = l->impl;
+	spa_hook_list_append(pw_context_get_driver_listener_list(impl->context, l->loop),
+			&l->listener, &context_events, impl);
+	return 0;
+}
+
 static int do_stop(struct spa_loop *loop,
 		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
 {
-	struct impl *impl = user_data;
-	spa_hook_remove(&impl->context_listener);
+	struct loop_listener *l = user_data;
+	spa_hook_remove(&l->listener);
 	return 0;
 }
 
+static void start_listener(struct impl *impl)
+{
+	struct loop_listener *l;
+
+	if (impl->listening)
+		return;
+
+	spa_list_for_each(l, &impl->loop_listeners, link)
+		pw_loop_invoke(l->loop, do_start, SPA_ID_INVALID, NULL, 0, true, l);
+	impl->listening = true;
+}
+
 static void stop_listener(struct impl *impl)
 {
-	if (impl->listening) {
-		pw_loop_invoke(impl->context->data_loop,
-                       do_stop, SPA_ID_INVALID, NULL, 0, true, impl);
-		impl->listening = false;
-	}
+	struct loop_listener *l;
+
+	if (!impl->listening)
+		return;
+
+	spa_list_for_each(l, &impl->loop_listeners, link)
+		pw_loop_invoke(l->loop, do_stop, SPA_ID_INVALID, NULL, 0, true, l);
+	impl->listening = false;
+}
+
+static void update_listener(struct impl *impl)
+{
+	__atomic_store_n(&impl->rt.pod, impl->n_pod > 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&impl->rt.ring, impl->n_ring > 0, __ATOMIC_RELEASE);
 }
 
 static void resource_destroy(void *data)
 {
-	struct impl *impl = data;
+	struct resource_data *d = data;
+	struct impl *impl = d->impl;
+
+	if (resource_uses_ring(d->resource))
+		impl->n_ring--;
+	else
+		impl->n_pod--;
+
 	if (--impl->busy == 0) {
 		pw_log_info("%p: stopping profiler", impl);
 		stop_listener(impl);
 	}
+	update_listener(impl);
+	update_stats_timer(impl);
+
+	if (d->ring)
+		pw_memblock_unref(d->ring);
 }
 
 static const struct pw_resource_events resource_events = {
@@ -325,16 +636,108 @@ static const struct pw_resource_events resource_events = {
 	.destroy = resource_destroy,
 };
 
-static int
-do_start(struct spa_loop *loop,
-		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+static int alloc_ring(struct impl *impl)
 {
-	struct impl *impl = user_data;
-	spa_hook_list_append(&impl->context->driver_listener_list,
-			&impl->context_listener,
-			&context_events, impl);
+	struct pw_profiler_ring *ring;
+
+	if (impl->ring != NULL)
+		return 0;
+
+	impl->ring_block = pw_mempool_alloc(impl->context->pool,
+			PW_MEMBLOCK_FLAG_READWRITE |
+			PW_MEMBLOCK_FLAG_MAP |
+			PW_MEMBLOCK_FLAG_SEAL,
+			SPA_DATA_MemFd, RING_OFFSET + RING_SIZE);
+	if (impl->ring_block == NULL)
+		return -errno;
+
+	ring = impl->ring_block->map->ptr;
+	ring->magic = PW_PROFILER_RING_MAGIC;
+	ring->version = PW_PROFILER_RING_VERSION;
+	ring->offset = RING_OFFSET;
+	ring->size = RING_SIZE;
+	impl->ring = ring;
 	return 0;
 }
+
+static void send_node(struct impl *impl, struct pw_resource *resource,
+		uint32_t id, const char *name)
+{
+	if (resource == NULL) {
+		spa_list_for_each(resource, &impl->global->resource_list, link) {
+			if (resource_uses_ring(resource))
+				pw_profiler_resource_node(resource, id, name);
+		}
+	} else {
+		pw_profiler_resource_node(resource, id, name);
+	}
+}
+
+static int bind_ring(struct impl *impl, struct resource_data *data,
+		struct pw_impl_client *client)
+{
+	struct pw_impl_node *node;
+	int res;
+
+	if ((res = alloc_ring(impl)) < 0)
+		return res;
+
+	data->ring = pw_mempool_import_block(client->pool, impl->ring_block);
+	if (data->ring == NULL)
+		return -errno;
+
+	pw_profiler_resource_ring(data->resource, data->ring->id,
+			0, impl->ring_block->size);
+
+	spa_list_for_each(node, &impl->context->node_list, link) {
+		struct pw_profiler_node_stats stats;
+
+		if (node->global == NULL)
+			continue;
+
+		send_node(impl, data->resource, node->info.id, node->name);
+
+		if (node->rt.activation == NULL)
+			continue;
+		get_node_stats(node, &stats);
+		if (stats.wait.count > 0 || stats.xrun_count > 0 ||
+		    stats.incomplete_count > 0)
+			send_node_stats(impl, data->resource, node->info.id, &stats);
+	}
+	return 0;
+}
+
+static int resource_enable_ring(void *object)
+{
+	struct resource_data *data = object;
+	struct impl *impl = data->impl;
+	struct pw_impl_client *client = pw_resource_get_client(data->resource);
+	int res;
+
+	if (data->use_ring)
+		return 0;
+
+	if ((res = bind_ring(impl, data, client)) < 0) {
+		pw_log_error("%p: can't set up profiler ring: %s",
+				impl, spa_strerror(res));
+		pw_resource_errorf(data->resource, res, "can't set up profiler ring: %s",
+				spa_strerror(res));
+		return res;
+	}
+	data->use_ring = true;
+	impl->n_pod--;
+	impl->n_ring++;
+
+	update_listener(impl);
+	update_stats_timer(impl);
+	return 0;
+}
+
+static const struct pw_profiler_methods profiler_methods = {
+	PW_VERSION_PROFILER_METHODS,
+	.enable_ring = resource_enable_ring,
+};
+
 static int
 global_bind(void *object, struct pw_impl_client *client, uint32_t permissions,
             uint32_t version, uint32_t id)
@@ -354,14 +757,19 @@ global_bind(void *object, struct pw_impl_client *client, uint32_t permissions,
         data->resource = resource;
 	pw_global_add_resource(global, resource);
 
+	impl->n_pod++;
+
 	pw_resource_add_listener(resource, &data->resource_listener,
-			&resource_events, impl);
+			&resource_events, data);
+	pw_resource_add_object_listener(resource, &data->object_listener,
+			&profiler_methods, data);
+
+	update_listener(impl);
+	update_stats_timer(impl);
 
 	if (++impl->busy == 1) {
 		pw_log_info("%p: starting profiler", impl);
-		pw_loop_invoke(impl->context->data_loop,
-                       do_start, SPA_ID_INVALID, NULL, 0, false, impl);
-		impl->listening = true;
+		start_listener(impl);
 	}
 	return 0;
 }
@@ -369,15 +777,27 @@ global_bind(void *object, struct pw_impl_client *client, uint32_t permissions,
 static void module_destroy(void *data)
 {
 	struct impl *impl = data;
+	struct loop_listener *l;
 
 	if (impl->global != NULL)
 		pw_global_destroy(impl->global);
 
+	spa_list_consume(l, &impl->loop_listeners, link) {
+		spa_list_remove(&l->link);
+		free(l);
+	}
+
 	spa_hook_remove(&impl->module_listener);
+	spa_hook_remove(&impl->context_node_listener);
 
 	pw_properties_free(impl->properties);
 
+	if (impl->ring_block)
+		pw_memblock_unref(impl->ring_block);
+
 	pw_loop_destroy_source(pw_context_get_main_loop(impl->context), impl->flush_timeout);
+	pw_loop_destroy_source(pw_context_get_main_loop(impl->context), impl->stats_timeout);
+	pw_array_clear(&impl->stats);
 
 	free(impl);
 }
@@ -403,13 +823,61 @@ static const struct pw_global_events global_events = {
 	.destroy = global_destroy,
 };
 
+static void context_global_added(void *data, struct pw_global *global)
+{
+	struct impl *impl = data;
+	struct pw_impl_node *node;
+
+	if (impl->global == NULL || impl->n_ring == 0 ||
+	    !pw_global_is_type(global, PW_TYPE_INTERFACE_Node))
+		return;
+
+	node = pw_global_get_object(global);
+	send_node(impl, NULL, node->info.id, node->name);
+}
+
+static void context_global_removed(void *data, struct pw_global *global)
+{
+	struct impl *impl = data;
+
+	if (impl->global == NULL ||
+	    !pw_global_is_type(global, PW_TYPE_INTERFACE_Node))
+		return;
+
+	remove_stats(impl, pw_global_get_id(global));
+
+	if (impl->n_ring > 0)
+		send_node(impl, NULL, pw_global_get_id(global), NULL);
+}
+
+static const struct pw_context_events context_node_events = {
+	PW_VERSION_CONTEXT_EVENTS,
+	.global_added = context_global_added,
+	.global_removed = context_global_removed,
+};
+
+static int add_loop_listener(void *data, struct pw_loop *loop)
+{
+	struct impl *impl = data;
+	struct loop_listener *l;
+
+	if ((l = calloc(1, sizeof(*l))) == NULL)
+		return -errno;
+	l->impl = impl;
+	l->loop = loop;
+	spa_list_append(&impl->loop_listeners, &l->link);
+	return 0;
+}
+
 SPA_EXPORT
 int pipewire__module_init(struct pw_impl_module *module, const char *args)
 {
 	struct pw_context *context = pw_impl_module_get_context(module);
 	struct pw_properties *props;
 	struct impl *impl;
+	struct loop_listener *l;
 	struct pw_loop *main_loop = pw_context_get_main_loop(context);
+	int res;
 	static const char * const keys[] = {
 		PW_KEY_OBJECT_SERIAL,
 		NULL
@@ -434,6 +902,13 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 	impl->properties = props;
 
 	spa_ringbuffer_init(&impl->buffer);
+	pw_array_init(&impl->stats, sizeof(struct stats_entry) * 16);
+	spa_list_init(&impl->loop_listeners);
+
+	/* drivers emit their events from their own data loop, we need a
+	 * listener on each of them */
+	if ((res = pw_context_for_each_data_loop(context, add_loop_listener, impl)) < 0)
+		goto error;
 
 	impl->global = pw_global_new(context,
 			PW_TYPE_INTERFACE_Profiler,
@@ -441,14 +916,15 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 			pw_properties_copy(props),
 			global_bind, impl);
 	if (impl->global == NULL) {
-		free(impl);
-		return -errno;
+		res = -errno;
+		goto error;
 	}
 	pw_properties_setf(impl->properties, PW_KEY_OBJECT_ID, "%d", impl->global->id);
 	pw_properties_setf(impl->properties, PW_KEY_OBJECT_SERIAL, "%"PRIu64,
 			pw_global_get_serial(impl->global));
 
 	impl->flush_timeout = pw_loop_add_timer(main_loop, flush_timeout, impl);
+	impl->stats_timeout = pw_loop_add_timer(main_loop, stats_timeout, impl);
 
 	pw_global_update_keys(impl->global, &impl->properties->dict, keys);
 
@@ -460,5 +936,18 @@ int pipewire__module_init(struct pw_impl_module *module, const char *args)
 
 	pw_global_add_listener(impl->global, &impl->global_listener, &global_events, impl);
 
+	pw_context_add_listener(context, &impl->context_node_listener,
+			&context_node_events, impl);
+
 	return 0;
+
+error:
+	spa_list_consume(l, &impl->loop_listeners, link) {
+		spa_list_remove(&l->link);
+		free(l);
+	}
+	pw_array_clear(&impl->stats);
+	pw_properties_free(props);
+	free(impl);
+	return res;
 }
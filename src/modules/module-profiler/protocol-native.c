@@ -52,6 +52,32 @@ static int profiler_demarshal_add_listener(void *object,
 	return -ENOTSUP;
 }
 
+static int profiler_proxy_marshal_enable_ring(void *object)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_proxy(proxy, PW_PROFILER_METHOD_ENABLE_RING, NULL);
+
+	spa_pod_builder_add_struct(b, SPA_POD_None());
+
+	return pw_protocol_native_end_proxy(proxy, b);
+}
+
+static int profiler_demarshal_enable_ring(void *object,
+			const struct pw_protocol_native_message *msg)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_parser prs;
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+
+	if (spa_pod_parser_get_struct(&prs, SPA_POD_None()) < 0)
+		return -EINVAL;
+
+	return pw_resource_notify(resource, struct pw_profiler_methods, enable_ring, 1);
+}
+
 static void profiler_resource_marshal_profile(void *object, const struct spa_pod *pod)
 {
 	struct pw_resource *resource = object;
@@ -80,27 +106,171 @@ static int profiler_proxy_demarshal_profile(void *object,
 	return 0;
 }
 
+static void profiler_resource_marshal_ring(void *object, uint32_t mem_id,
+		uint32_t offset, uint32_t size)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_resource(resource, PW_PROFILER_EVENT_RING, NULL);
+
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(mem_id),
+			SPA_POD_Int(offset),
+			SPA_POD_Int(size));
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
+static int profiler_proxy_demarshal_ring(void *object,
+		const struct pw_protocol_native_message *msg)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	uint32_t mem_id, offset, size;
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+
+	if (spa_pod_parser_get_struct(&prs,
+			SPA_POD_Int(&mem_id),
+			SPA_POD_Int(&offset),
+			SPA_POD_Int(&size)) < 0)
+		return -EINVAL;
+
+	pw_proxy_notify(proxy, struct pw_profiler_events, ring, 1, mem_id, offset, size);
+	return 0;
+}
+
+static void profiler_resource_marshal_node(void *object, uint32_t id, const char *name)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_resource(resource, PW_PROFILER_EVENT_NODE, NULL);
+
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(id),
+			SPA_POD_String(name));
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
+static int profiler_proxy_demarshal_node(void *object,
+		const struct pw_protocol_native_message *msg)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	uint32_t id;
+	const char *name;
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+
+	if (spa_pod_parser_get_struct(&prs,
+			SPA_POD_Int(&id),
+			SPA_POD_String(&name)) < 0)
+		return -EINVAL;
+
+	pw_proxy_notify(proxy, struct pw_profiler_events, node, 1, id, name);
+	return 0;
+}
+
+static void profiler_resource_marshal_node_stats(void *object, uint32_t id,
+		const struct pw_profiler_node_stats *stats)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_resource(resource, PW_PROFILER_EVENT_NODE_STATS, NULL);
+
+	spa_pod_builder_add_struct(b,
+			SPA_POD_Int(id),
+			SPA_POD_Long(stats->wait.count),
+			SPA_POD_Long(stats->wait.max),
+			SPA_POD_Array(sizeof(uint32_t), SPA_TYPE_Int,
+				SPA_HISTOGRAM_BUCKETS, stats->wait.buckets),
+			SPA_POD_Long(stats->busy.count),
+			SPA_POD_Long(stats->busy.max),
+			SPA_POD_Array(sizeof(uint32_t), SPA_TYPE_Int,
+				SPA_HISTOGRAM_BUCKETS, stats->busy.buckets),
+			SPA_POD_Int(stats->xrun_count),
+			SPA_POD_Int(stats->incomplete_count),
+			SPA_POD_Int(stats->xrun_pending_count));
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
+static int profiler_proxy_demarshal_node_stats(void *object,
+		const struct pw_protocol_native_message *msg)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	struct pw_profiler_node_stats stats;
+	uint32_t id, csize[2], ctype[2], n_buckets[2];
+	uint32_t *buckets[2];
+	int64_t count[2], max[2];
+
+	spa_pod_parser_init(&prs, msg->data, msg->size);
+
+	spa_zero(stats);
+	if (spa_pod_parser_get_struct(&prs,
+			SPA_POD_Int(&id),
+			SPA_POD_Long(&count[0]),
+			SPA_POD_Long(&max[0]),
+			SPA_POD_Array(&csize[0], &ctype[0], &n_buckets[0], &buckets[0]),
+			SPA_POD_Long(&count[1]),
+			SPA_POD_Long(&max[1]),
+			SPA_POD_Array(&csize[1], &ctype[1], &n_buckets[1], &buckets[1]),
+			SPA_POD_Int(&stats.xrun_count),
+			SPA_POD_Int(&stats.incomplete_count),
+			SPA_POD_Int(&stats.xrun_pending_count)) < 0)
+		return -EINVAL;
+
+	if (ctype[0] != SPA_TYPE_Int || csize[0] != sizeof(uint32_t) ||
+	    ctype[1] != SPA_TYPE_Int || csize[1] != sizeof(uint32_t))
+		return -EINVAL;
+
+	stats.wait.count = count[0];
+	stats.wait.max = max[0];
+	memcpy(stats.wait.buckets, buckets[0],
+			SPA_MIN(n_buckets[0], SPA_HISTOGRAM_BUCKETS) * sizeof(uint32_t));
+	stats.busy.count = count[1];
+	stats.busy.max = max[1];
+	memcpy(stats.busy.buckets, buckets[1],
+			SPA_MIN(n_buckets[1], SPA_HISTOGRAM_BUCKETS) * sizeof(uint32_t));
+
+	pw_proxy_notify(proxy, struct pw_profiler_events, node_stats, 1, id, &stats);
+	return 0;
+}
+
 
 static const struct pw_profiler_methods pw_protocol_native_profiler_client_method_marshal = {
 	PW_VERSION_PROFILER_METHODS,
 	.add_listener = &profiler_proxy_marshal_add_listener,
+	.enable_ring = &profiler_proxy_marshal_enable_ring,
 };
 
 static const struct pw_protocol_native_demarshal
 pw_protocol_native_profiler_server_method_demarshal[PW_PROFILER_METHOD_NUM] =
 {
 	[PW_PROFILER_METHOD_ADD_LISTENER] = { &profiler_demarshal_add_listener, 0 },
+	[PW_PROFILER_METHOD_ENABLE_RING] = { &profiler_demarshal_enable_ring, 0 },
 };
 
 static const struct pw_profiler_events pw_protocol_native_profiler_server_event_marshal = {
 	PW_VERSION_PROFILER_EVENTS,
 	.profile = &profiler_resource_marshal_profile,
+	.ring = &profiler_resource_marshal_ring,
+	.node = &profiler_resource_marshal_node,
+	.node_stats = &profiler_resource_marshal_node_stats,
 };
 
 static const struct pw_protocol_native_demarshal
 pw_protocol_native_profiler_client_event_demarshal[PW_PROFILER_EVENT_NUM] =
 {
 	[PW_PROFILER_EVENT_PROFILE] = { &profiler_proxy_demarshal_profile, 0 },
+	[PW_PROFILER_EVENT_RING] = { &profiler_proxy_demarshal_ring, 0 },
+	[PW_PROFILER_EVENT_NODE] = { &profiler_proxy_demarshal_node, 0 },
+	[PW_PROFILER_EVENT_NODE_STATS] = { &profiler_proxy_demarshal_node_stats, 0 },
 };
 
 static const struct pw_protocol_marshal pw_protocol_native_profiler_marshal = {
@@ -87,6 +87,7 @@
  *     #pulse.min.quantum      = 256/48000     # 5ms
  *     #pulse.default.format   = F32
  *     #pulse.default.position = [ FL FR ]
+ *     #pulse.sample-mixer     = true
  *     # These overrides are only applied when running in a vm.
  *     vm.overrides = {
  *         pulse.min.quantum = 1024/48000      # 22ms
@@ -201,6 +202,18 @@
  * This is equivalent to the PulseAudio `default-sample-channels` and
  * `default-channel-map` options in `/etc/pulse/daemon.conf`.
  *
+ * ### Sample cache options
+ *
+ *\code{.unparsed}
+ *     pulse.sample-mixer = true
+ *\endcode
+ *
+ * Cached samples are converted to the default format and rate when they are
+ * uploaded and played through a mixer stream, instead of creating a new stream
+ * for each played sample. There is one mixer stream per sink, application and
+ * media role, which carries the application properties of the first play.
+ * Set this to false to always use a stream per played sample.
+ *
  * ### VM options
  *
  *\code{.unparsed}
@@ -25,6 +25,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 
@@ -47,6 +49,7 @@
 #include "operation.h"
 #include "pending-sample.h"
 #include "server.h"
+#include "shm.h"
 #include "stream.h"
 
 #define client_emit_disconnect(c) spa_hook_list_call(&(c)->listener_list, struct client_events, disconnect, 0)
@@ -113,6 +116,13 @@ bool client_detach(struct client *client)
 	return true;
 }
 
+static int remove_temporary_move_data(void *data, struct pw_manager_object *o)
+{
+	struct client *client = data;
+	pw_manager_object_remove_data(o, client->temporary_move_key);
+	return 0;
+}
+
 void client_disconnect(struct client *client)
 {
 	struct impl *impl = client->impl;
@@ -134,12 +144,56 @@ void client_disconnect(struct client *client)
 		client->source = NULL;
 	}
 
-	if (client->manager) {
+	if (client->shared_manager) {
+		/* the objects outlive us, drop our move targets */
+		if (client->temporary_move_key[0] != '\0')
+			pw_manager_for_each_object(client->manager,
+					remove_temporary_move_data, client);
+		spa_hook_remove(&client->manager_listener);
+		spa_hook_remove(&client->core_listener);
+		shared_manager_unref(client->shared_manager);
+		client->shared_manager = NULL;
+		client->manager = NULL;
+	} else if (client->manager) {
 		pw_manager_destroy(client->manager);
 		client->manager = NULL;
 	}
 }
 
+int client_sync_manager(struct client *client)
+{
+	int res;
+
+	if ((res = pw_manager_sync(client->manager)) < 0)
+		return res;
+
+	client->manager_sync_seq = res;
+	client->manager_sync_pending = true;
+	return res;
+}
+
+/* the manager can be shared and synced by other clients, check that our own
+ * sync completed */
+bool client_sync_done(struct client *client)
+{
+	if (client->sync_pending)
+		return false;
+	return !client->manager_sync_pending ||
+		pw_manager_sync_done(client->manager, client->manager_sync_seq);
+}
+
+int client_sync(struct client *client)
+{
+	if (client->shared_manager == NULL)
+		return client_sync_manager(client);
+
+	/* the shared manager uses another connection, first make sure that
+	 * the requests on our own core are processed, see pulse-server.c */
+	client->sync_pending = true;
+	client->sync_seq = pw_core_sync(client->core, PW_ID_CORE, client->sync_seq);
+	return client->sync_seq;
+}
+
 void client_free(struct client *client)
 {
 	struct impl *impl = client->impl;
@@ -161,6 +215,9 @@ void client_free(struct client *client)
 	if (client->message)
 		message_free(client->message, false, false);
 
+	client_close_fds(client);
+	shm_pool_clear(client);
+
 	spa_list_consume(msg, &client->out_messages, link)
 		message_free(msg, true, false);
 
@@ -201,7 +258,7 @@ int client_queue_message(struct client *client, struct message *msg)
 		goto error;
 	}
 
-	if (msg->length == 0) {
+	if (msg->length == 0 && (msg->flags & FLAG_SHMMASK) == 0) {
 		res = 0;
 		goto error;
 	} else if (msg->length > msg->allocated) {
@@ -227,6 +284,37 @@ error:
 	return res;
 }
 
+static ssize_t client_send(struct client *client, const void *data, size_t size, bool creds)
+{
+#ifdef SCM_CREDENTIALS
+	if (creds) {
+		struct iovec iov = { .iov_base = (void*)data, .iov_len = size };
+		uint8_t buffer[CMSG_SPACE(sizeof(struct ucred))];
+		struct msghdr msg = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = buffer,
+			.msg_controllen = sizeof(buffer),
+		};
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		struct ucred ucred = {
+			.pid = getpid(),
+			.uid = getuid(),
+			.gid = getgid(),
+		};
+
+		spa_zero(buffer);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_CREDENTIALS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(ucred));
+		memcpy(CMSG_DATA(cmsg), &ucred, sizeof(ucred));
+
+		return sendmsg(client->source->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	}
+#endif
+	return send(client->source->fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
 static int client_try_flush_messages(struct client *client)
 {
 	pw_log_trace("client %p: flushing", client);
@@ -242,9 +330,9 @@ static int client_try_flush_messages(struct client *client)
 		if (client->out_index < sizeof(desc)) {
 			desc.length = htonl(m->length);
 			desc.channel = htonl(m->channel);
-			desc.offset_hi = 0;
+			desc.offset_hi = htonl(m->block_id);
 			desc.offset_lo = 0;
-			desc.flags = 0;
+			desc.flags = htonl(m->flags);
 
 			data = SPA_PTROFF(&desc, client->out_index, void);
 			size = sizeof(desc) - client->out_index;
@@ -261,7 +349,8 @@ static int client_try_flush_messages(struct client *client)
 		}
 
 		while (true) {
-			ssize_t sent = send(client->source->fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+			ssize_t sent = client_send(client, data, size,
+					m->creds && client->out_index == 0);
 			if (sent < 0) {
 				int res = -errno;
 				if (res == -EINTR)
@@ -394,3 +483,38 @@ int client_queue_subscribe_event(struct client *client, uint32_t mask, uint32_t
 
 	return client_queue_message(client, reply);
 }
+
+int client_queue_shm_release(struct client *client, uint32_t block_id)
+{
+	struct message *msg;
+
+	if ((msg = message_alloc(client->impl, -1, 0)) == NULL)
+		return -errno;
+
+	msg->flags = FLAG_SHMRELEASE;
+	msg->block_id = block_id;
+
+	return client_queue_message(client, msg);
+}
+
+/* take ownership of the next fd that was received with the current packet */
+int client_take_fd(struct client *client)
+{
+	int fd;
+
+	if (client->n_fds == 0)
+		return -EBADF;
+
+	fd = client->fds[0];
+	client->n_fds--;
+	memmove(&client->fds[0], &client->fds[1], client->n_fds * sizeof(int));
+	return fd;
+}
+
+void client_close_fds(struct client *client)
+{
+	uint32_t i;
+	for (i = 0; i < client->n_fds; i++)
+		close(client->fds[i]);
+	client->n_fds = 0;
+}
@@ -32,6 +32,8 @@
 #include <spa/utils/hook.h>
 #include <pipewire/map.h>
 
+#include "shm.h"
+
 struct impl;
 struct server;
 struct message;
@@ -41,6 +43,7 @@ struct pw_core;
 struct pw_manager;
 struct pw_manager_object;
 struct pw_properties;
+struct shared_manager;
 
 struct descriptor {
 	uint32_t length;
@@ -67,8 +70,12 @@ struct client {
 	uint64_t quirks;
 
 	struct pw_core *core;
+	struct spa_hook core_listener;
 	struct pw_manager *manager;
 	struct spa_hook manager_listener;
+	struct shared_manager *shared_manager;	/**< set when manager is shared */
+	int sync_seq;
+	int manager_sync_seq;			/**< our last sync of the manager */
 
 	uint32_t subscribed;
 
@@ -77,6 +84,7 @@ struct client {
 	char *default_source;
 	char *temporary_default_sink;		/**< pending value, for MOVE_* commands */
 	char *temporary_default_source;		/**< pending value, for MOVE_* commands */
+	char temporary_move_key[48];		/**< object data key of our MOVE_* targets */
 	struct pw_manager_object *metadata_routes;
 	struct pw_properties *routes;
 
@@ -87,6 +95,13 @@ struct client {
 	struct descriptor desc;
 	struct message *message;
 
+#define MAX_CLIENT_FDS	4
+	int fds[MAX_CLIENT_FDS];		/**< fds received with the current packet */
+	uint32_t n_fds;
+
+	struct shm_pool shm_pools[MAX_SHM_POOLS];
+	uint32_t n_shm_pools;
+
 	struct pw_map streams;
 	struct spa_list out_messages;
 
@@ -99,6 +114,10 @@ struct client {
 	unsigned int disconnect:1;
 	unsigned int new_msg_since_last_flush:1;
 	unsigned int authenticated:1;
+	unsigned int shm:1;			/**< memblocks can reference shared memory */
+	unsigned int memfd:1;
+	unsigned int sync_pending:1;		/**< waiting for core sync before manager sync */
+	unsigned int manager_sync_pending:1;	/**< waiting for manager_sync_seq */
 
 	struct pw_manager_object *prev_default_sink;
 	struct pw_manager_object *prev_default_source;
@@ -120,6 +139,12 @@ void client_free(struct client *client);
 int client_queue_message(struct client *client, struct message *msg);
 int client_flush_messages(struct client *client);
 int client_queue_subscribe_event(struct client *client, uint32_t mask, uint32_t event, uint32_t id);
+int client_queue_shm_release(struct client *client, uint32_t block_id);
+int client_take_fd(struct client *client);
+int client_sync(struct client *client);
+int client_sync_manager(struct client *client);
+bool client_sync_done(struct client *client);
+void client_close_fds(struct client *client);
 
 static inline void client_unref(struct client *client)
 {
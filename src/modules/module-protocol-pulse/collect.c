@@ -46,11 +46,61 @@ void select_best(struct selector *s, struct pw_manager_object *o)
 	}
 }
 
+static bool selector_matches(struct selector *s, struct pw_manager_object *o)
+{
+	if (o == NULL || o->creating || o->removing)
+		return false;
+	if (s->type != NULL && !s->type(o))
+		return false;
+	return true;
+}
+
+static void select_first(struct selector *s, struct pw_manager_object *o)
+{
+	/* objects are added in serial order, the object with the lowest
+	 * serial is the first one in the object list */
+	if (selector_matches(s, o) &&
+	    (s->best == NULL || o->serial < s->best->serial))
+		s->best = o;
+}
+
+static int select_named(void *data, struct pw_manager_object *o)
+{
+	struct selector *s = data;
+	const char *str;
+
+	if (o->props != NULL &&
+	    (str = pw_properties_get(o->props, s->key)) != NULL &&
+	    spa_streq(str, s->value))
+		select_first(s, o);
+	return 0;
+}
+
+static struct pw_manager_object *select_indexed(struct pw_manager *m, struct selector *s)
+{
+	s->best = NULL;
+	select_first(s, pw_manager_find_object(m, s->id));
+	select_first(s, pw_manager_find_object_by_index(m, s->index));
+	if (s->value != NULL) {
+		select_first(s, pw_manager_find_object_by_index(m, (uint32_t)atoi(s->value)));
+		if (s->key != NULL)
+			pw_manager_for_each_named_object(m, s->value, select_named, s);
+	}
+	return s->best;
+}
+
 struct pw_manager_object *select_object(struct pw_manager *m, struct selector *s)
 {
 	struct pw_manager_object *o;
 	const char *str;
 
+	/* without accumulator, only exact matches are returned and we can use
+	 * the manager indexes */
+	if (s->accumulate == NULL &&
+	    (s->key == NULL || spa_streq(s->key, PW_KEY_NODE_NAME) ||
+	     spa_streq(s->key, PW_KEY_DEVICE_NAME)))
+		return select_indexed(m, s);
+
 	spa_list_for_each(o, &m->object_list, link) {
 		if (o->creating || o->removing)
 			continue;
@@ -74,22 +124,14 @@ struct pw_manager_object *select_object(struct pw_manager *m, struct selector *s
 
 uint32_t id_to_index(struct pw_manager *m, uint32_t id)
 {
-	struct pw_manager_object *o;
-	spa_list_for_each(o, &m->object_list, link) {
-		if (o->id == id)
-			return o->index;
-	}
-	return SPA_ID_INVALID;
+	struct pw_manager_object *o = pw_manager_find_object(m, id);
+	return o ? o->index : SPA_ID_INVALID;
 }
 
 uint32_t index_to_id(struct pw_manager *m, uint32_t index)
 {
-	struct pw_manager_object *o;
-	spa_list_for_each(o, &m->object_list, link) {
-		if (o->index == index)
-			return o->id;
-	}
-	return SPA_ID_INVALID;
+	struct pw_manager_object *o = pw_manager_find_object_by_index(m, index);
+	return o ? o->id : SPA_ID_INVALID;
 }
 
 bool collect_is_linked(struct pw_manager *m, uint32_t id, enum pw_direction direction)
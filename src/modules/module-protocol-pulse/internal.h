@@ -62,6 +62,15 @@ struct stats {
 	uint32_t sample_cache;
 };
 
+/* manager shared by all clients without access restrictions */
+struct shared_manager {
+	struct impl *impl;
+	int ref;
+	struct pw_core *core;
+	struct pw_manager *manager;
+	struct spa_hook manager_listener;
+};
+
 struct impl {
 	struct pw_loop *loop;
 	struct pw_context *context;
@@ -80,13 +89,23 @@ struct impl {
 	struct pw_map samples;
 	struct pw_map modules;
 
+	struct pw_core *mixer_core;
+	struct spa_list sample_mixers;
+
+	struct shared_manager *shared_manager;
+
 	struct spa_list free_messages;
 	struct defs defs;
 	struct stats stat;
+
+	unsigned int use_sample_mixer:1;
 };
 
 extern bool debug_messages;
 
 void broadcast_subscribe_event(struct impl *impl, uint32_t mask, uint32_t event, uint32_t id);
 
+struct shared_manager *shared_manager_get(struct impl *impl);
+void shared_manager_unref(struct shared_manager *sm);
+
 #endif
@@ -34,6 +34,7 @@
 #include "module-protocol-pulse/server.h"
 
 #define MAX_PARAMS 32
+#define MIN_INDEX_SIZE 64
 
 #define manager_emit_sync(m) spa_hook_list_call(&m->hooks, struct pw_manager_events, sync, 0)
 #define manager_emit_added(m,o) spa_hook_list_call(&m->hooks, struct pw_manager_events, added, 0, o)
@@ -55,6 +56,12 @@ struct manager {
 	int sync_seq;
 
 	struct spa_hook_list hooks;
+
+	/* hash indexes of the objects on id, index and name */
+	uint32_t index_size;
+	struct spa_list *id_index;
+	struct spa_list *index_index;
+	struct spa_list *name_index;
 };
 
 struct object_info {
@@ -73,6 +80,14 @@ struct object_data {
 	struct spa_source *timer;
 };
 
+struct metadata_entry {
+	struct spa_list link;
+	uint32_t subject;
+	char *key;
+	char *type;
+	char *value;
+};
+
 struct object {
 	struct pw_manager_object this;
 
@@ -88,6 +103,13 @@ struct object {
 	int param_seq[MAX_PARAMS];
 
 	struct spa_list data_list;
+
+	struct spa_list metadata_list;
+
+	const char *name;
+	struct spa_list id_link;
+	struct spa_list index_link;
+	struct spa_list name_link;
 };
 
 static int core_sync(struct manager *m)
@@ -168,16 +190,92 @@ static bool has_param(struct spa_list *param_list, struct pw_manager_param *p)
 }
 
 
+static inline uint32_t hash_u32(uint32_t val, uint32_t size)
+{
+	return (val * 0x9e3779b1u) & (size - 1);
+}
+
+static inline uint32_t hash_str(const char *str, uint32_t size)
+{
+	uint32_t h = 2166136261u;
+	while (*str)
+		h = (h ^ (uint8_t)*str++) * 16777619u;
+	return h & (size - 1);
+}
+
+static void index_object(struct manager *m, struct object *o)
+{
+	uint32_t size = m->index_size;
+
+	spa_list_append(&m->id_index[hash_u32(o->this.id, size)], &o->id_link);
+
+	if (o->this.index != SPA_ID_INVALID)
+		spa_list_append(&m->index_index[hash_u32(o->this.index, size)], &o->index_link);
+	else
+		spa_list_init(&o->index_link);
+
+	if (o->name != NULL)
+		spa_list_append(&m->name_index[hash_str(o->name, size)], &o->name_link);
+	else
+		spa_list_init(&o->name_link);
+}
+
+static void unindex_object(struct object *o)
+{
+	spa_list_remove(&o->id_link);
+	spa_list_remove(&o->index_link);
+	spa_list_remove(&o->name_link);
+}
+
+static int resize_index(struct manager *m, uint32_t size)
+{
+	struct spa_list *lists;
+	struct object *o;
+	uint32_t i;
+
+	lists = calloc(3 * size, sizeof(struct spa_list));
+	if (lists == NULL)
+		return -errno;
+
+	for (i = 0; i < 3 * size; i++)
+		spa_list_init(&lists[i]);
+
+	free(m->id_index);
+	m->id_index = &lists[0];
+	m->index_index = &lists[size];
+	m->name_index = &lists[2 * size];
+	m->index_size = size;
+
+	spa_list_for_each(o, &m->this.object_list, this.link)
+		index_object(m, o);
+
+	return 0;
+}
+
 static struct object *find_object_by_id(struct manager *m, uint32_t id)
 {
 	struct object *o;
-	spa_list_for_each(o, &m->this.object_list, this.link) {
+	spa_list_for_each(o, &m->id_index[hash_u32(id, m->index_size)], id_link) {
 		if (o->this.id == id)
 			return o;
 	}
 	return NULL;
 }
 
+static struct object *find_object_by_index(struct manager *m, uint32_t index)
+{
+	struct object *o;
+
+	if (index == SPA_ID_INVALID)
+		return NULL;
+
+	spa_list_for_each(o, &m->index_index[hash_u32(index, m->index_size)], index_link) {
+		if (o->this.index == index)
+			return o;
+	}
+	return NULL;
+}
+
 static void object_update_params(struct object *o)
 {
 	struct pw_manager_param *p;
@@ -203,11 +301,22 @@ static void object_data_free(struct object_data *d)
 	free(d);
 }
 
+static void metadata_entry_free(struct metadata_entry *e)
+{
+	spa_list_remove(&e->link);
+	free(e->key);
+	free(e->type);
+	free(e->value);
+	free(e);
+}
+
 static void object_destroy(struct object *o)
 {
 	struct manager *m = o->manager;
 	struct object_data *d;
+	struct metadata_entry *e;
 	spa_list_remove(&o->this.link);
+	unindex_object(o);
 	m->this.n_objects--;
 	if (o->this.proxy)
 		pw_proxy_destroy(o->this.proxy);
@@ -218,6 +327,8 @@ static void object_destroy(struct object *o)
 	clear_params(&o->pending_list, SPA_ID_INVALID);
 	spa_list_consume(d, &o->data_list, link)
 		object_data_free(d);
+	spa_list_consume(e, &o->metadata_list, link)
+		metadata_entry_free(e);
 	free(o);
 }
 
@@ -516,6 +627,22 @@ static int metadata_property(void *data,
 {
 	struct object *o = data;
 	struct manager *m = o->manager;
+	struct metadata_entry *e, *t;
+
+	/* keep the properties so that they can be replayed for new listeners */
+	spa_list_for_each_safe(e, t, &o->metadata_list, link) {
+		if (e->subject == subject && (key == NULL || spa_streq(e->key, key)))
+			metadata_entry_free(e);
+	}
+	if (key != NULL && value != NULL &&
+	    (e = calloc(1, sizeof(*e))) != NULL) {
+		e->subject = subject;
+		e->key = strdup(key);
+		e->type = type ? strdup(type) : NULL;
+		e->value = strdup(value);
+		spa_list_append(&o->metadata_list, &e->link);
+	}
+
 	manager_emit_metadata(m, &o->this, subject, key, type, value);
 	return 0;
 }
@@ -632,12 +759,21 @@ static void registry_event_global(void *data, uint32_t id,
 	spa_list_init(&o->this.param_list);
 	spa_list_init(&o->pending_list);
 	spa_list_init(&o->data_list);
+	spa_list_init(&o->metadata_list);
+
+	if (o->this.props != NULL &&
+	    (o->name = pw_properties_get(o->this.props, PW_KEY_NODE_NAME)) == NULL)
+		o->name = pw_properties_get(o->this.props, PW_KEY_DEVICE_NAME);
 
 	o->manager = m;
 	o->info = info;
 	spa_list_append(&m->this.object_list, &o->this.link);
 	m->this.n_objects++;
 
+	if (m->this.n_objects <= m->index_size ||
+	    resize_index(m, m->index_size * 2) < 0)
+		index_object(m, o);
+
 	if (info->events)
 		pw_proxy_add_object_listener(proxy,
 				&o->object_listener,
@@ -691,6 +827,7 @@ static void on_core_done(void *data, uint32_t id, int seq)
 
 		pw_log_debug("sync end %u/%u", m->sync_seq, seq);
 
+		m->this.sync_seq = seq;
 		manager_emit_sync(m);
 
 		spa_list_for_each(o, &m->this.object_list, this.link)
@@ -702,6 +839,7 @@ static void on_core_done(void *data, uint32_t id, int seq)
 				manager_emit_added(m, &o->this);
 				o->this.changed = 0;
 			} else if (o->this.changed > 0) {
+				o->this.update_seq++;
 				manager_emit_updated(m, &o->this);
 				o->this.changed = 0;
 			}
@@ -750,6 +888,12 @@ struct pw_manager *pw_manager_new(struct pw_core *core)
 
 	spa_list_init(&m->this.object_list);
 
+	if (resize_index(m, MIN_INDEX_SIZE) < 0) {
+		pw_proxy_destroy((struct pw_proxy*)m->this.registry);
+		free(m);
+		return NULL;
+	}
+
 	pw_core_add_listener(m->this.core,
 			&m->core_listener,
 			&core_events, m);
@@ -765,7 +909,23 @@ void pw_manager_add_listener(struct pw_manager *manager,
 		const struct pw_manager_events *events, void *data)
 {
 	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct metadata_entry *e;
+	struct object *o;
+
 	spa_hook_list_append(&m->hooks, listener, events, data);
+
+	/* a manager can be shared, let late listeners know about the
+	 * objects and metadata that were already announced */
+	spa_list_for_each(o, &m->this.object_list, this.link) {
+		if (o->this.creating || o->this.removing)
+			continue;
+		spa_callbacks_call(&listener->cb, struct pw_manager_events,
+				added, 0, &o->this);
+		spa_list_for_each(e, &o->metadata_list, link)
+			spa_callbacks_call(&listener->cb, struct pw_manager_events,
+					metadata, 0, &o->this, e->subject,
+					e->key, e->type, e->value);
+	}
 	core_sync(m);
 }
 
@@ -842,9 +1002,41 @@ void pw_manager_destroy(struct pw_manager *manager)
 	if (m->this.info)
 		pw_core_info_free(m->this.info);
 
+	free(m->id_index);
 	free(m);
 }
 
+struct pw_manager_object *pw_manager_find_object(struct pw_manager *manager, uint32_t id)
+{
+	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct object *o = find_object_by_id(m, id);
+	return o ? &o->this : NULL;
+}
+
+struct pw_manager_object *pw_manager_find_object_by_index(struct pw_manager *manager, uint32_t index)
+{
+	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct object *o = find_object_by_index(m, index);
+	return o ? &o->this : NULL;
+}
+
+int pw_manager_for_each_named_object(struct pw_manager *manager, const char *name,
+		int (*callback) (void *data, struct pw_manager_object *object),
+		void *data)
+{
+	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
+	struct object *o;
+	int res;
+
+	spa_list_for_each(o, &m->name_index[hash_str(name, m->index_size)], name_link) {
+		if (!spa_streq(o->name, name))
+			continue;
+		if ((res = callback(data, &o->this)) != 0)
+			return res;
+	}
+	return 0;
+}
+
 static struct object_data *object_find_data(struct object *o, const char *key)
 {
 	struct object_data *d;
@@ -867,12 +1059,13 @@ void *pw_manager_object_add_data(struct pw_manager_object *obj, const char *key,
 		object_data_free(d);
 	}
 
-	d = calloc(1, sizeof(struct object_data) + size);
+	/* the key is stored after the data */
+	d = calloc(1, sizeof(struct object_data) + size + strlen(key) + 1);
 	if (d == NULL)
 		return NULL;
 
 	d->object = o;
-	d->key = key;
+	d->key = strcpy(SPA_PTROFF(d, sizeof(struct object_data) + size, char), key);
 	d->size = size;
 
 	spa_list_append(&o->data_list, &d->link);
@@ -932,12 +1125,28 @@ void *pw_manager_object_get_data(struct pw_manager_object *obj, const char *id)
 	return d ? SPA_PTROFF(d, sizeof(*d), void) : NULL;
 }
 
+void pw_manager_object_remove_data(struct pw_manager_object *obj, const char *key)
+{
+	struct object *o = SPA_CONTAINER_OF(obj, struct object, this);
+	struct object_data *d = object_find_data(o, key);
+
+	if (d != NULL)
+		object_data_free(d);
+}
+
 int pw_manager_sync(struct pw_manager *manager)
 {
 	struct manager *m = SPA_CONTAINER_OF(manager, struct manager, this);
 	return core_sync(m);
 }
 
+bool pw_manager_sync_done(struct pw_manager *manager, int seq)
+{
+	/* only the last sync is emitted, it completes all earlier syncs */
+	uint32_t diff = SPA_RESULT_ASYNC_SEQ(manager->sync_seq) - SPA_RESULT_ASYNC_SEQ(seq);
+	return (diff & SPA_ASYNC_SEQ_MASK) < SPA_ASYNC_BIT / 2;
+}
+
 bool pw_manager_object_is_client(struct pw_manager_object *o)
 {
 	return spa_streq(o->type, PW_TYPE_INTERFACE_Client);
@@ -68,6 +68,8 @@ struct pw_manager {
 
 	uint32_t n_objects;
 	struct spa_list object_list;
+
+	int sync_seq;			/**< seq of the last completed sync */
 };
 
 struct pw_manager_param {
@@ -91,6 +93,7 @@ struct pw_manager_object {
 	                       const char *message, const char *params, char **response);
 
 	int changed;
+	uint32_t update_seq;		/**< incremented before each updated event */
 	void *info;
 	struct spa_list param_list;
 	unsigned int creating:1;
@@ -104,6 +107,8 @@ void pw_manager_add_listener(struct pw_manager *manager,
 		const struct pw_manager_events *events, void *data);
 
 int pw_manager_sync(struct pw_manager *manager);
+/* check if the sync with \a seq, returned by pw_manager_sync(), completed */
+bool pw_manager_sync_done(struct pw_manager *manager, int seq);
 
 void pw_manager_destroy(struct pw_manager *manager);
 
@@ -116,8 +121,17 @@ int pw_manager_for_each_object(struct pw_manager *manager,
 		int (*callback) (void *data, struct pw_manager_object *object),
 		void *data);
 
+struct pw_manager_object *pw_manager_find_object(struct pw_manager *manager, uint32_t id);
+struct pw_manager_object *pw_manager_find_object_by_index(struct pw_manager *manager, uint32_t index);
+
+/* iterate the objects with the given node.name or, when not set, device.name */
+int pw_manager_for_each_named_object(struct pw_manager *manager, const char *name,
+		int (*callback) (void *data, struct pw_manager_object *object),
+		void *data);
+
 void *pw_manager_object_add_data(struct pw_manager_object *o, const char *key, size_t size);
 void *pw_manager_object_get_data(struct pw_manager_object *obj, const char *key);
+void pw_manager_object_remove_data(struct pw_manager_object *obj, const char *key);
 void *pw_manager_object_add_temporary_data(struct pw_manager_object *o, const char *key,
 		size_t size, uint64_t lifetime_nsec);
 
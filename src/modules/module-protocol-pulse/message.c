@@ -851,6 +851,9 @@ struct message *message_alloc(struct impl *impl, uint32_t channel, uint32_t size
 	msg->channel = channel;
 	msg->offset = 0;
 	msg->length = size;
+	msg->flags = 0;
+	msg->block_id = 0;
+	msg->creds = false;
 
 	return msg;
 }
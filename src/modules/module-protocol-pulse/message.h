@@ -42,6 +42,9 @@ struct message {
 	uint32_t length;
 	uint32_t offset;
 	uint8_t *data;
+	uint32_t flags;		/**< frame descriptor flags */
+	uint32_t block_id;	/**< released block for FLAG_SHMRELEASE frames */
+	unsigned int creds:1;	/**< send our credentials along */
 };
 
 enum {
@@ -71,8 +71,10 @@
 #include "quirks.h"
 #include "reply.h"
 #include "sample.h"
+#include "sample-mixer.h"
 #include "sample-play.h"
 #include "server.h"
+#include "shm.h"
 #include "stream.h"
 #include "utils.h"
 #include "volume.h"
@@ -94,7 +96,9 @@ bool debug_messages = false;
 
 struct latency_offset_data {
 	int64_t prev_latency_offset;
+	uint32_t update_seq;
 	uint8_t initialized:1;
+	uint8_t changed:1;
 };
 
 struct temporary_move_data {
@@ -134,6 +138,7 @@ static int do_command_auth(struct client *client, uint32_t command, uint32_t tag
 	uint32_t version;
 	const void *cookie;
 	size_t len;
+	bool do_shm = false, do_memfd = false;
 
 	if (message_get(m,
 			TAG_U32, &version,
@@ -146,22 +151,67 @@ static int do_command_auth(struct client *client, uint32_t command, uint32_t tag
 	if (len != NATIVE_COOKIE_LENGTH)
 		return -EINVAL;
 
-	if ((version & PROTOCOL_VERSION_MASK) >= 13)
+	if ((version & PROTOCOL_VERSION_MASK) >= 13) {
+		do_shm = SPA_FLAG_IS_SET(version, PROTOCOL_FLAG_SHM);
+		do_memfd = SPA_FLAG_IS_SET(version, PROTOCOL_FLAG_MEMFD);
 		version &= PROTOCOL_VERSION_MASK;
+	}
+
+	/* only share memory with local clients of the same user, the client
+	 * checks the credentials we send along with the reply */
+	do_shm = do_shm && client_is_same_user(client);
+	do_memfd = do_shm && do_memfd && version >= 31;
 
 	client->version = version;
 	client->authenticated = true;
+	client->shm = do_shm;
+	client->memfd = do_memfd;
 
-	pw_log_info("client:%p AUTH tag:%u version:%d", client, tag, version);
+	pw_log_info("client:%p AUTH tag:%u version:%d shm:%d memfd:%d", client, tag,
+			version, do_shm, do_memfd);
 
 	reply = reply_new(client, tag);
 	message_put(reply,
-			TAG_U32, PROTOCOL_VERSION,
+			TAG_U32, PROTOCOL_VERSION |
+				(do_shm ? PROTOCOL_FLAG_SHM : 0) |
+				(do_memfd ? PROTOCOL_FLAG_MEMFD : 0),
 			TAG_INVALID);
+	reply->creds = do_shm;
 
 	return client_queue_message(client, reply);
 }
 
+static int do_register_memfd_shmid(struct client *client, uint32_t command, uint32_t tag, struct message *m)
+{
+	uint32_t shm_id;
+	int fd, res;
+
+	if (message_get(m,
+			TAG_U32, &shm_id,
+			TAG_INVALID) < 0)
+		return -EPROTO;
+
+	if (!client->memfd)
+		return -EPROTO;
+
+	if ((fd = client_take_fd(client)) < 0)
+		return -EPROTO;
+
+	pw_log_info("client:%p [%s] REGISTER_MEMFD_SHMID tag:%u shm_id:%u",
+			client, client->name, tag, shm_id);
+
+	if ((res = shm_pool_add_memfd(client, shm_id, fd)) < 0) {
+		pw_log_warn("client:%p [%s] can't add memfd pool %u: %s",
+				client, client->name, shm_id, spa_strerror(res));
+		/* reply with an error, the client would otherwise use the
+		 * pool and fail later */
+		return res;
+	}
+
+	/* no reply */
+	return 0;
+}
+
 static int reply_set_client_name(struct client *client, uint32_t tag)
 {
 	struct pw_manager *manager = client->manager;
@@ -193,7 +243,13 @@ static void manager_sync(void *data)
 	struct client *client = data;
 	struct operation *o;
 
-	pw_log_debug("%p: manager sync", client);
+	pw_log_debug("%p: manager sync pending:%d/%d", client, client->sync_pending,
+			client->manager_sync_pending);
+
+	/* a sync of the shared manager for another client */
+	if (!client_sync_done(client))
+		return;
+	client->manager_sync_pending = false;
 
 	if (client->connect_tag != SPA_ID_INVALID) {
 		reply_set_client_name(client, client->connect_tag);
@@ -263,11 +319,21 @@ static int send_object_event(struct client *client, struct pw_manager_object *o,
 	return 0;
 }
 
+/* the objects can be shared between clients, each client keeps its own
+ * move targets */
+static const char *temporary_move_key(struct client *client)
+{
+	if (client->temporary_move_key[0] == '\0')
+		snprintf(client->temporary_move_key, sizeof(client->temporary_move_key),
+				"temporary_move_data:%p", (void *)client);
+	return client->temporary_move_key;
+}
+
 static uint32_t get_temporary_move_target(struct client *client, struct pw_manager_object *o)
 {
 	struct temporary_move_data *d;
 
-	d = pw_manager_object_get_data(o, "temporary_move_data");
+	d = pw_manager_object_get_data(o, temporary_move_key(client));
 	if (d == NULL || d->peer_index == SPA_ID_INVALID)
 		return SPA_ID_INVALID;
 
@@ -285,7 +351,7 @@ static void set_temporary_move_target(struct client *client, struct pw_manager_o
 		return;
 
 	if (index == SPA_ID_INVALID) {
-		d = pw_manager_object_get_data(o, "temporary_move_data");
+		d = pw_manager_object_get_data(o, temporary_move_key(client));
 		if (d == NULL)
 			return;
 		if (d->peer_index != SPA_ID_INVALID)
@@ -295,7 +361,7 @@ static void set_temporary_move_target(struct client *client, struct pw_manager_o
 		return;
 	}
 
-	d = pw_manager_object_add_temporary_data(o, "temporary_move_data",
+	d = pw_manager_object_add_temporary_data(o, temporary_move_key(client),
 			sizeof(struct temporary_move_data),
 			TEMPORARY_MOVE_TIMEOUT);
 	if (d == NULL)
@@ -309,7 +375,7 @@ static void set_temporary_move_target(struct client *client, struct pw_manager_o
 
 static void temporary_move_target_timeout(struct client *client, struct pw_manager_object *o)
 {
-	struct temporary_move_data *d = pw_manager_object_get_data(o, "temporary_move_data");
+	struct temporary_move_data *d = pw_manager_object_get_data(o, temporary_move_key(client));
 	struct pw_manager_object *peer;
 
 	/*
@@ -378,11 +444,17 @@ static void send_latency_offset_subscribe_event(struct client *client, struct pw
 	if (d == NULL)
 		return;
 
-	latency_offset = get_node_latency_offset(o);
-	changed = (!d->initialized || latency_offset != d->prev_latency_offset);
+	/* the data is shared by all clients of the manager, only compare
+	 * once per update */
+	if (!d->initialized || d->update_seq != o->update_seq) {
+		latency_offset = get_node_latency_offset(o);
+		d->changed = (!d->initialized || latency_offset != d->prev_latency_offset);
 
-	d->prev_latency_offset = latency_offset;
-	d->initialized = true;
+		d->prev_latency_offset = latency_offset;
+		d->update_seq = o->update_seq;
+		d->initialized = true;
+	}
+	changed = d->changed;
 
 	if (changed)
 		client_queue_subscribe_event(client,
@@ -910,7 +982,7 @@ static void manager_object_data_timeout(void *data, struct pw_manager_object *o,
 {
 	struct client *client = data;
 
-	if (spa_streq(key, "temporary_move_data"))
+	if (spa_streq(key, temporary_move_key(client)))
 		temporary_move_target_timeout(client, o);
 }
 
@@ -1016,6 +1088,111 @@ static const struct pw_manager_events manager_events = {
 	.object_data_timeout = manager_object_data_timeout,
 };
 
+static void client_core_done(void *data, uint32_t id, int seq)
+{
+	struct client *client = data;
+
+	if (id != PW_ID_CORE || seq != client->sync_seq)
+		return;
+
+	/* our requests are processed, now sync the shared manager so that
+	 * it sees the results */
+	client->sync_pending = false;
+	client_sync_manager(client);
+}
+
+static void client_core_error(void *data, uint32_t id, int seq, int res, const char *message)
+{
+	struct client *client = data;
+
+	if (id == PW_ID_CORE && res == -EPIPE) {
+		pw_log_debug("%p: connection error: %d, %s", client, res, message);
+		manager_disconnect(client);
+	}
+}
+
+static const struct pw_core_events client_core_events = {
+	PW_VERSION_CORE_EVENTS,
+	.done = client_core_done,
+	.error = client_core_error,
+};
+
+static void do_unref_shared_manager(void *obj, void *data, int res, uint32_t id)
+{
+	shared_manager_unref(obj);
+}
+
+static void shared_manager_disconnect(void *data)
+{
+	struct shared_manager *sm = data;
+	struct impl *impl = sm->impl;
+
+	pw_log_info("%p: shared manager %p disconnected", impl, sm);
+
+	/* the clients are freed from the work queue, drop our reference
+	 * there as well so that new clients get a new manager */
+	if (impl->shared_manager == sm) {
+		impl->shared_manager = NULL;
+		pw_work_queue_add(impl->work_queue, sm, 0,
+				do_unref_shared_manager, NULL);
+	}
+}
+
+static const struct pw_manager_events shared_manager_events = {
+	PW_VERSION_MANAGER_EVENTS,
+	.disconnect = shared_manager_disconnect,
+};
+
+struct shared_manager *shared_manager_get(struct impl *impl)
+{
+	struct shared_manager *sm = impl->shared_manager;
+
+	if (sm == NULL) {
+		sm = calloc(1, sizeof(*sm));
+		if (sm == NULL)
+			return NULL;
+
+		sm->impl = impl;
+		sm->core = pw_context_connect(impl->context, NULL, 0);
+		if (sm->core == NULL)
+			goto error;
+		sm->manager = pw_manager_new(sm->core);
+		if (sm->manager == NULL)
+			goto error;
+
+		pw_manager_add_listener(sm->manager, &sm->manager_listener,
+				&shared_manager_events, sm);
+
+		/* reference for the impl */
+		sm->ref = 1;
+		impl->shared_manager = sm;
+		pw_log_info("%p: new shared manager %p", impl, sm);
+	}
+	sm->ref++;
+	return sm;
+
+error:
+	if (sm->core)
+		pw_core_disconnect(sm->core);
+	free(sm);
+	return NULL;
+}
+
+void shared_manager_unref(struct shared_manager *sm)
+{
+	struct impl *impl = sm->impl;
+
+	if (--sm->ref > 0)
+		return;
+
+	pw_log_info("%p: free shared manager %p", impl, sm);
+
+	pw_work_queue_cancel(impl->work_queue, sm, SPA_ID_INVALID);
+	pw_manager_destroy(sm->manager);
+	pw_core_disconnect(sm->core);
+	free(sm);
+}
+
 static int do_set_client_name(struct client *client, uint32_t command, uint32_t tag, struct message *m)
 {
 	struct impl *impl = client->impl;
@@ -1051,12 +1228,23 @@ static int do_set_client_name(struct client *client, uint32_t command, uint32_t
 			res = -errno;
 			goto error;
 		}
-		client->manager = pw_manager_new(client->core);
+		/* clients without access restrictions see the same objects and
+		 * can use one manager, the others get their own view */
+		if (pw_properties_get(client->props, PW_KEY_CLIENT_ACCESS) == NULL &&
+		    (client->shared_manager = shared_manager_get(impl)) != NULL) {
+			client->manager = client->shared_manager->manager;
+			pw_core_add_listener(client->core, &client->core_listener,
+					&client_core_events, client);
+		} else {
+			client->manager = pw_manager_new(client->core);
+		}
 		if (client->manager == NULL) {
 			res = -errno;
 			goto error;
 		}
 		client->connect_tag = tag;
+		if (client->shared_manager != NULL)
+			client_sync(client);
 		pw_manager_add_listener(client->manager, &client->manager_listener,
 				&manager_events, client);
 	} else {
@@ -2309,29 +2497,23 @@ static int do_finish_upload_stream(struct client *client, uint32_t command, uint
 			client->name, commands[command].name, tag,
 			channel, name);
 
+	/* always replace the sample, plays that still use the old data, in
+	 * a stream or a mixer voice, keep a reference to it */
 	struct sample *old = find_sample(impl, SPA_ID_INVALID, name);
-	if (old == NULL || old->ref > 1) {
-		sample = calloc(1, sizeof(*sample));
-		if (sample == NULL)
-			goto error_errno;
+	sample = calloc(1, sizeof(*sample));
+	if (sample == NULL)
+		goto error_errno;
 
-		if (old != NULL) {
-			sample->index = old->index;
-			spa_assert_se(pw_map_insert_at(&impl->samples, sample->index, sample) == 0);
+	if (old != NULL) {
+		sample->index = old->index;
+		spa_assert_se(pw_map_insert_at(&impl->samples, sample->index, sample) == 0);
 
-			old->index = SPA_ID_INVALID;
-			sample_unref(old);
-		} else {
-			sample->index = pw_map_insert_new(&impl->samples, sample);
-			if (sample->index == SPA_ID_INVALID)
-				goto error_errno;
-		}
+		old->index = SPA_ID_INVALID;
+		sample_unref(old);
 	} else {
-		pw_properties_free(old->props);
-		free(old->buffer);
-		impl->stat.sample_cache -= old->length;
-
-		sample = old;
+		sample->index = pw_map_insert_new(&impl->samples, sample);
+		if (sample->index == SPA_ID_INVALID)
+			goto error_errno;
 	}
 
 	if (old != NULL)
@@ -2350,6 +2532,16 @@ static int do_finish_upload_stream(struct client *client, uint32_t command, uint
 
 	impl->stat.sample_cache += sample->length;
 
+	if (impl->use_sample_mixer) {
+		struct sample_spec ss;
+		struct channel_map map;
+
+		sample_mixer_get_spec(impl, &ss, &map);
+		if ((res = sample_mixer_convert(sample, &ss, &map)) < 0)
+			pw_log_info("[%s] sample %s will not be mixed: %s",
+					client->name, name, spa_strerror(res));
+	}
+
 	stream->props = NULL;
 	stream->buffer = NULL;
 	stream_free(stream);
@@ -2547,6 +2739,7 @@ static int do_play_sample(struct client *client, uint32_t command, uint32_t tag,
 	uint32_t sink_index, volume;
 	struct sample *sample;
 	struct sample_play *play;
+	struct sample_mixer *mixer;
 	const char *sink_name, *name;
 	struct pw_properties *props = NULL;
 	struct pending_sample *ps;
@@ -2588,11 +2781,20 @@ static int do_play_sample(struct client *client, uint32_t command, uint32_t tag,
 	if (sample == NULL)
 		goto error_noent;
 
-	pw_properties_setf(props, PW_KEY_NODE_TARGET, "%u", o->id);
-	pw_properties_setf(props, PW_KEY_TARGET_OBJECT, "%"PRIu64, o->serial);
+	if (impl->use_sample_mixer && sample->mix_data != NULL &&
+	    (mixer = sample_mixer_get(impl, o->id, o->serial, props)) != NULL &&
+	    sample_mixer_can_play(mixer, sample)) {
+		pw_properties_free(props);
+		props = NULL;
 
-	play = sample_play_new(client->core, sample, props, sizeof(struct pending_sample));
-	props = NULL;
+		play = sample_play_new_mixed(mixer, sample, sizeof(struct pending_sample));
+	} else {
+		pw_properties_setf(props, PW_KEY_NODE_TARGET, "%u", o->id);
+		pw_properties_setf(props, PW_KEY_TARGET_OBJECT, "%"PRIu64, o->serial);
+
+		play = sample_play_new(client->core, sample, props, sizeof(struct pending_sample));
+		props = NULL;
+	}
 	if (play == NULL)
 		goto error_errno;
 
@@ -5011,7 +5213,7 @@ static void on_load_module_manager_sync(void *data)
 	pw_log_debug("pending module %p: manager sync wait_sync:%d tag:%d",
 			pm, pm->wait_sync, pm->tag);
 
-	if (!pm->wait_sync)
+	if (!pm->wait_sync || (pm->client && !client_sync_done(pm->client)))
 		return;
 
 	finish_pending_module(pm);
@@ -5037,7 +5239,7 @@ static void on_module_loaded(void *data, int result)
 	} else {
 		pw_log_debug("pending module %p: wait manager sync tag:%d", pm, pm->tag);
 		pm->wait_sync = true;
-		pw_manager_sync(pm->client->manager);
+		client_sync(pm->client);
 	}
 }
 
@@ -5387,7 +5589,7 @@ const struct command commands[COMMAND_MAX] =
 
 	/* Supported since protocol v31 (9.0)
 	 * BOTH DIRECTIONS */
-	COMMAND(REGISTER_MEMFD_SHMID, do_error_access),
+	COMMAND(REGISTER_MEMFD_SHMID, do_register_memfd_shmid, COMMAND_ACCESS_WITHOUT_MANAGER),
 
 	/* Supported since protocol v35 (15.0) */
 	COMMAND(SEND_OBJECT_MESSAGE, do_send_object_message),
@@ -5416,6 +5618,7 @@ static void impl_clear(struct impl *impl)
 	struct message *msg;
 	struct server *s;
 	struct client *c;
+	struct sample_mixer *sm;
 
 	pw_map_for_each(&impl->modules, impl_unload_module, impl);
 	pw_map_clear(&impl->modules);
@@ -5426,6 +5629,18 @@ static void impl_clear(struct impl *impl)
 	spa_list_consume(c, &impl->cleanup_clients, link)
 		client_free(c);
 
+	spa_list_consume(sm, &impl->sample_mixers, link)
+		sample_mixer_destroy(sm);
+	if (impl->mixer_core) {
+		pw_core_disconnect(impl->mixer_core);
+		impl->mixer_core = NULL;
+	}
+
+	if (impl->shared_manager) {
+		shared_manager_unref(impl->shared_manager);
+		impl->shared_manager = NULL;
+	}
+
 	spa_list_consume(msg, &impl->free_messages, link)
 		message_free(msg, true, true);
 
@@ -5577,6 +5792,8 @@ struct pw_protocol_pulse *pw_protocol_pulse_new(struct pw_context *context,
 	pw_map_init(&impl->modules, 16, 16);
 	spa_list_init(&impl->cleanup_clients);
 	spa_list_init(&impl->free_messages);
+	spa_list_init(&impl->sample_mixers);
+	impl->use_sample_mixer = pw_properties_get_bool(props, "pulse.sample-mixer", true);
 
 	str = pw_properties_get(props, "server.address");
 	if (str == NULL) {
@@ -0,0 +1,578 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <spa/param/audio/raw.h>
+#include <spa/pod/builder.h>
+#include <spa/utils/hook.h>
+#include <spa/utils/string.h>
+#include <pipewire/context.h>
+#include <pipewire/core.h>
+#include <pipewire/keys.h>
+#include <pipewire/log.h>
+#include <pipewire/loop.h>
+#include <pipewire/properties.h>
+#include <pipewire/stream.h>
+#include <pipewire/work-queue.h>
+
+#include "format.h"
+#include "internal.h"
+#include "log.h"
+#include "sample.h"
+#include "sample-mixer.h"
+#include "sample-play.h"
+
+void sample_mixer_get_spec(struct impl *impl, struct sample_spec *ss, struct channel_map *map)
+{
+	ss->format = SPA_AUDIO_FORMAT_F32;
+	ss->rate = impl->defs.sample_spec.rate;
+	ss->channels = impl->defs.channel_map.channels;
+	*map = impl->defs.channel_map;
+}
+
+static inline uint32_t read_le(const uint8_t *s, uint32_t n)
+{
+	uint32_t i, v = 0;
+	for (i = 0; i < n; i++)
+		v |= (uint32_t)s[i] << (8 * i);
+	return v;
+}
+
+static inline uint32_t read_be(const uint8_t *s, uint32_t n)
+{
+	uint32_t i, v = 0;
+	for (i = 0; i < n; i++)
+		v = (v << 8) | s[i];
+	return v;
+}
+
+static inline float u32_to_f32(uint32_t v)
+{
+	float f;
+	memcpy(&f, &v, sizeof(f));
+	return f;
+}
+
+static inline float read_sample(const uint8_t *s, uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_U8:
+		return (s[0] - 128) / 128.0f;
+	case SPA_AUDIO_FORMAT_S16_LE:
+		return (int16_t)read_le(s, 2) / 32768.0f;
+	case SPA_AUDIO_FORMAT_S16_BE:
+		return (int16_t)read_be(s, 2) / 32768.0f;
+	case SPA_AUDIO_FORMAT_F32_LE:
+		return u32_to_f32(read_le(s, 4));
+	case SPA_AUDIO_FORMAT_F32_BE:
+		return u32_to_f32(read_be(s, 4));
+	case SPA_AUDIO_FORMAT_S32_LE:
+		return (int32_t)read_le(s, 4) / 2147483648.0f;
+	case SPA_AUDIO_FORMAT_S32_BE:
+		return (int32_t)read_be(s, 4) / 2147483648.0f;
+	case SPA_AUDIO_FORMAT_S24_LE:
+		return ((int32_t)(read_le(s, 3) << 8) >> 8) / 8388608.0f;
+	case SPA_AUDIO_FORMAT_S24_BE:
+		return ((int32_t)(read_be(s, 3) << 8) >> 8) / 8388608.0f;
+	case SPA_AUDIO_FORMAT_S24_32_LE:
+		return ((int32_t)(read_le(s, 4) << 8) >> 8) / 8388608.0f;
+	case SPA_AUDIO_FORMAT_S24_32_BE:
+		return ((int32_t)(read_be(s, 4) << 8) >> 8) / 8388608.0f;
+	default:
+		return 0.0f;
+	}
+}
+
+static bool format_supported(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_S16_LE:
+	case SPA_AUDIO_FORMAT_S16_BE:
+	case SPA_AUDIO_FORMAT_F32_LE:
+	case SPA_AUDIO_FORMAT_F32_BE:
+	case SPA_AUDIO_FORMAT_S32_LE:
+	case SPA_AUDIO_FORMAT_S32_BE:
+	case SPA_AUDIO_FORMAT_S24_LE:
+	case SPA_AUDIO_FORMAT_S24_BE:
+	case SPA_AUDIO_FORMAT_S24_32_LE:
+	case SPA_AUDIO_FORMAT_S24_32_BE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* for each output channel, the input channel to use. A mono input goes to
+ * all outputs, a mono output gets the average of all inputs */
+#define CHANNEL_AVERAGE	(-1)
+#define CHANNEL_NONE	(-2)
+
+static void setup_channels(const struct sample *sample, const struct channel_map *map,
+		int *src)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < map->channels; i++) {
+		src[i] = CHANNEL_NONE;
+		if (sample->ss.channels == 1) {
+			src[i] = 0;
+			continue;
+		}
+		if (map->channels == 1) {
+			src[i] = CHANNEL_AVERAGE;
+			continue;
+		}
+		for (j = 0; j < sample->map.channels; j++) {
+			if (sample->map.map[j] == map->map[i]) {
+				src[i] = j;
+				break;
+			}
+		}
+	}
+}
+
+int sample_mixer_convert(struct sample *sample, const struct sample_spec *ss,
+		const struct channel_map *map)
+{
+	uint32_t i, j, c, in_stride, in_frames, out_frames, in_channels, bps;
+	int src[CHANNELS_MAX];
+	float *in, *out;
+
+	free(sample->mix_data);
+	sample->mix_data = NULL;
+	sample->mix_frames = 0;
+
+	if (!format_supported(sample->ss.format) ||
+	    sample->ss.rate == 0 || sample->ss.channels == 0 ||
+	    ss->rate == 0 || ss->channels == 0)
+		return -ENOTSUP;
+
+	in_stride = sample_spec_frame_size(&sample->ss);
+	in_channels = sample->ss.channels;
+	in_frames = sample->length / in_stride;
+	bps = in_stride / in_channels;
+	if (in_frames == 0)
+		return -EINVAL;
+
+	/* first decode to float at the sample rate */
+	in = malloc((size_t)in_frames * in_channels * sizeof(float));
+	if (in == NULL)
+		return -errno;
+
+	for (i = 0; i < in_frames * in_channels; i++)
+		in[i] = read_sample(&sample->buffer[i * bps], sample->ss.format);
+
+	out_frames = (uint32_t)((uint64_t)in_frames * ss->rate / sample->ss.rate);
+	out_frames = SPA_MAX(out_frames, 1u);
+	out = calloc((size_t)out_frames * ss->channels, sizeof(float));
+	if (out == NULL) {
+		free(in);
+		return -errno;
+	}
+
+	setup_channels(sample, map, src);
+
+	/* then resample with linear interpolation and remap the channels */
+	for (i = 0; i < out_frames; i++) {
+		double pos = (double)i * sample->ss.rate / ss->rate;
+		uint32_t i0 = SPA_MIN((uint32_t)pos, in_frames - 1);
+		uint32_t i1 = SPA_MIN(i0 + 1, in_frames - 1);
+		float frac = (float)(pos - i0);
+		const float *f0 = &in[i0 * in_channels];
+		const float *f1 = &in[i1 * in_channels];
+		float *o = &out[i * ss->channels];
+
+		for (c = 0; c < ss->channels; c++) {
+			float v;
+
+			if (src[c] == CHANNEL_NONE)
+				continue;
+
+			if (src[c] == CHANNEL_AVERAGE) {
+				float a = 0.0f, b = 0.0f;
+				for (j = 0; j < in_channels; j++) {
+					a += f0[j];
+					b += f1[j];
+				}
+				v = (a + (b - a) * frac) / in_channels;
+			} else {
+				v = f0[src[c]] + (f1[src[c]] - f0[src[c]]) * frac;
+			}
+			o[c] = v;
+		}
+	}
+	free(in);
+
+	sample->mix_data = out;
+	sample->mix_frames = out_frames;
+	sample->mix_ss = *ss;
+
+	pw_log_info("converted sample %s %u frames at %u to %u frames at %u",
+			sample->name, in_frames, sample->ss.rate, out_frames, ss->rate);
+
+	return 0;
+}
+
+static void mixer_process(void *data)
+{
+	struct sample_mixer *m = data;
+	struct sample_play *p, *t;
+	struct pw_buffer *b;
+	struct spa_buffer *buf;
+	uint32_t i, n_frames, n_samples, channels = m->ss.channels;
+	bool done = false;
+	float *d;
+
+	if ((b = pw_stream_dequeue_buffer(m->stream)) == NULL) {
+		pw_log_warn("out of buffers: %m");
+		return;
+	}
+
+	buf = b->buffer;
+	if ((d = buf->datas[0].data) == NULL) {
+		pw_stream_queue_buffer(m->stream, b);
+		return;
+	}
+
+	n_frames = buf->datas[0].maxsize / m->stride;
+	if (b->requested)
+		n_frames = SPA_MIN(n_frames, b->requested);
+
+	memset(d, 0, n_frames * m->stride);
+
+	spa_list_for_each_safe(p, t, &m->voices, mix_link) {
+		struct sample *s = p->sample;
+		const float *src = &s->mix_data[p->offset * channels];
+
+		n_samples = SPA_MIN(n_frames, s->mix_frames - p->offset) * channels;
+		for (i = 0; i < n_samples; i++)
+			d[i] += src[i];
+
+		p->offset += n_samples / channels;
+		if (p->offset >= s->mix_frames) {
+			spa_list_remove(&p->mix_link);
+			__atomic_store_n(&p->mix_done, true, __ATOMIC_RELEASE);
+			done = true;
+		}
+	}
+
+	buf->datas[0].chunk->offset = 0;
+	buf->datas[0].chunk->stride = m->stride;
+	buf->datas[0].chunk->size = n_frames * m->stride;
+
+	pw_stream_queue_buffer(m->stream, b);
+
+	if (done)
+		pw_loop_signal_event(m->main_loop, m->update);
+}
+
+static void do_destroy_mixer(void *obj, void *data, int res, uint32_t id)
+{
+	sample_mixer_destroy(obj);
+}
+
+static void schedule_destroy(struct sample_mixer *m)
+{
+	if (m->destroy_pending)
+		return;
+	m->destroy_pending = true;
+	pw_work_queue_add(m->impl->work_queue, m, 0, do_destroy_mixer, NULL);
+}
+
+static void on_update(void *data, uint64_t count)
+{
+	struct sample_mixer *m = data;
+	struct sample_play *p;
+
+	spa_list_for_each(p, &m->plays, link) {
+		if (!p->ready_sent && m->id != SPA_ID_INVALID) {
+			p->ready_sent = true;
+			p->id = m->id;
+			sample_play_emit_ready(p, m->id);
+		}
+		if (!p->done_sent &&
+		    (__atomic_load_n(&p->mix_done, __ATOMIC_ACQUIRE) || m->failed)) {
+			p->done_sent = true;
+			sample_play_emit_done(p, m->failed ? -EIO : 0);
+		}
+	}
+	if (m->failed && spa_list_is_empty(&m->plays))
+		schedule_destroy(m);
+}
+
+static void mixer_state_changed(void *data, enum pw_stream_state old,
+		enum pw_stream_state state, const char *error)
+{
+	struct sample_mixer *m = data;
+
+	switch (state) {
+	case PW_STREAM_STATE_UNCONNECTED:
+	case PW_STREAM_STATE_ERROR:
+		if (!m->failed) {
+			pw_log_info("mixer %p: target %u gone: %s", m,
+					m->target_id, error ? error : "unconnected");
+			/* new plays will create a new mixer */
+			m->failed = true;
+		}
+		pw_loop_signal_event(m->main_loop, m->update);
+		break;
+	case PW_STREAM_STATE_PAUSED:
+		m->id = pw_stream_get_node_id(m->stream);
+		pw_loop_signal_event(m->main_loop, m->update);
+		break;
+	default:
+		break;
+	}
+}
+
+static const struct pw_stream_events mixer_stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = mixer_state_changed,
+	.process = mixer_process,
+};
+
+static const char *get_role(const struct pw_properties *props)
+{
+	const char *str = pw_properties_get(props, PW_KEY_MEDIA_ROLE);
+	return str ? str : "Notification";
+}
+
+static struct sample_mixer *sample_mixer_new(struct impl *impl, uint32_t target_id,
+		uint64_t target_serial, const struct pw_properties *play_props)
+{
+	const struct spa_dict_item *it;
+	const char *str;
+	struct sample_mixer *m;
+	struct pw_properties *props;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	const struct spa_pod *params[1];
+	uint32_t n_params = 0;
+	int res;
+
+	if (impl->mixer_core == NULL) {
+		impl->mixer_core = pw_context_connect(impl->context, NULL, 0);
+		if (impl->mixer_core == NULL)
+			return NULL;
+	}
+
+	m = calloc(1, sizeof(*m));
+	if (m == NULL)
+		return NULL;
+
+	m->impl = impl;
+	m->target_id = target_id;
+	m->target_serial = target_serial;
+	str = pw_properties_get(play_props, PW_KEY_APP_NAME);
+	m->app_name = strdup(str ? str : "");
+	m->role = strdup(get_role(play_props));
+	m->id = SPA_ID_INVALID;
+	m->main_loop = impl->loop;
+	spa_list_init(&m->plays);
+	spa_list_init(&m->voices);
+
+	sample_mixer_get_spec(impl, &m->ss, &m->map);
+	m->stride = sample_spec_frame_size(&m->ss);
+
+	if (m->app_name == NULL || m->role == NULL)
+		goto error_free;
+
+	m->update = pw_loop_add_event(m->main_loop, on_update, m);
+	if (m->update == NULL)
+		goto error_free;
+
+	props = pw_properties_new(
+			PW_KEY_MEDIA_TYPE, "Audio",
+			PW_KEY_MEDIA_CATEGORY, "Playback",
+			PW_KEY_MEDIA_ROLE, m->role,
+			PW_KEY_MEDIA_NAME, "Sample Mixer",
+			PW_KEY_NODE_NAME, "pulse-sample-mixer",
+			NULL);
+	if (props == NULL)
+		goto error_free;
+
+	/* so that the stream is restored and shown as the application */
+	spa_dict_for_each(it, &play_props->dict) {
+		if (spa_strstartswith(it->key, "application."))
+			pw_properties_set(props, it->key, it->value);
+	}
+
+	pw_properties_setf(props, PW_KEY_NODE_TARGET, "%u", target_id);
+	pw_properties_setf(props, PW_KEY_TARGET_OBJECT, "%"PRIu64, target_serial);
+
+	/* mix in the loop of the stream so that the voices are only
+	 * touched from one thread */
+	m->data_loop = pw_context_acquire_loop(impl->context, &props->dict);
+	pw_properties_set(props, PW_KEY_NODE_LOOP_NAME, m->data_loop->name);
+
+	m->stream = pw_stream_new(impl->mixer_core, "Sample Mixer", props);
+	if (m->stream == NULL)
+		goto error_free;
+
+	pw_stream_add_listener(m->stream, &m->stream_listener,
+			&mixer_stream_events, m);
+
+	params[n_params++] = format_build_param(&b, SPA_PARAM_EnumFormat,
+			&m->ss, &m->map);
+
+	res = pw_stream_connect(m->stream,
+			PW_DIRECTION_OUTPUT,
+			PW_ID_ANY,
+			PW_STREAM_FLAG_AUTOCONNECT |
+			PW_STREAM_FLAG_INACTIVE |
+			PW_STREAM_FLAG_DONT_RECONNECT |
+			PW_STREAM_FLAG_MAP_BUFFERS |
+			PW_STREAM_FLAG_RT_PROCESS,
+			params, n_params);
+	if (res < 0) {
+		errno = -res;
+		goto error_free;
+	}
+
+	spa_list_append(&impl->sample_mixers, &m->link);
+
+	pw_log_info("mixer %p: new for target %u", m, target_id);
+
+	return m;
+
+error_free:
+	res = -errno;
+	if (m->stream)
+		pw_stream_destroy(m->stream);
+	if (m->data_loop)
+		pw_context_release_loop(impl->context, m->data_loop);
+	if (m->update)
+		pw_loop_destroy_source(m->main_loop, m->update);
+	free(m->app_name);
+	free(m->role);
+	free(m);
+	errno = -res;
+	return NULL;
+}
+
+struct sample_mixer *sample_mixer_get(struct impl *impl, uint32_t target_id,
+		uint64_t target_serial, const struct pw_properties *props)
+{
+	struct sample_mixer *m;
+	const char *app_name = pw_properties_get(props, PW_KEY_APP_NAME);
+
+	spa_list_for_each(m, &impl->sample_mixers, link) {
+		if (!m->failed && m->target_id == target_id &&
+		    m->target_serial == target_serial &&
+		    spa_streq(m->app_name, app_name ? app_name : "") &&
+		    spa_streq(m->role, get_role(props)))
+			return m;
+	}
+	return sample_mixer_new(impl, target_id, target_serial, props);
+}
+
+bool sample_mixer_can_play(struct sample_mixer *m, struct sample *sample)
+{
+	return sample->mix_data != NULL &&
+		sample->mix_ss.format == m->ss.format &&
+		sample->mix_ss.rate == m->ss.rate &&
+		sample->mix_ss.channels == m->ss.channels;
+}
+
+static int do_add_voice(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct sample_play *p = user_data;
+	spa_list_append(&p->mixer->voices, &p->mix_link);
+	return 0;
+}
+
+static int do_remove_voice(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct sample_play *p = user_data;
+	if (!__atomic_load_n(&p->mix_done, __ATOMIC_RELAXED))
+		spa_list_remove(&p->mix_link);
+	return 0;
+}
+
+void sample_mixer_add(struct sample_mixer *m, struct sample_play *p)
+{
+	p->mixer = m;
+	p->offset = 0;
+	spa_list_append(&m->plays, &p->link);
+
+	pw_loop_invoke(m->data_loop, do_add_voice, 0, NULL, 0, true, p);
+
+	if (!m->active) {
+		pw_stream_set_active(m->stream, true);
+		m->active = true;
+	}
+	/* emit ready from the main loop, after the caller added its listener */
+	pw_loop_signal_event(m->main_loop, m->update);
+}
+
+void sample_mixer_remove(struct sample_mixer *m, struct sample_play *p)
+{
+	pw_loop_invoke(m->data_loop, do_remove_voice, 0, NULL, 0, true, p);
+
+	spa_list_remove(&p->link);
+	p->mixer = NULL;
+
+	if (!spa_list_is_empty(&m->plays))
+		return;
+
+	if (m->failed) {
+		schedule_destroy(m);
+	} else if (m->active) {
+		/* don't keep the sink busy when nothing is playing */
+		pw_stream_set_active(m->stream, false);
+		m->active = false;
+	}
+}
+
+void sample_mixer_destroy(struct sample_mixer *m)
+{
+	struct impl *impl = m->impl;
+
+	pw_log_info("mixer %p: destroy", m);
+
+	spa_assert(spa_list_is_empty(&m->plays));
+
+	pw_work_queue_cancel(impl->work_queue, m, SPA_ID_INVALID);
+
+	spa_list_remove(&m->link);
+	if (m->stream) {
+		spa_hook_remove(&m->stream_listener);
+		pw_stream_destroy(m->stream);
+	}
+	if (m->data_loop)
+		pw_context_release_loop(impl->context, m->data_loop);
+	if (m->update)
+		pw_loop_destroy_source(m->main_loop, m->update);
+	free(m->app_name);
+	free(m->role);
+	free(m);
+}
@@ -0,0 +1,89 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PULSE_SERVER_SAMPLE_MIXER_H
+#define PULSE_SERVER_SAMPLE_MIXER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <spa/utils/list.h>
+#include <spa/utils/hook.h>
+
+#include "format.h"
+
+struct impl;
+struct sample;
+struct sample_play;
+struct pw_loop;
+struct pw_stream;
+struct pw_properties;
+
+/* A persistent stream to one sink that mixes the cached samples that one
+ * application plays with one role on that sink. The samples are converted
+ * to the mixer format when they are uploaded so that playing a sample only
+ * adds a voice to the mixer. */
+struct sample_mixer {
+	struct spa_list link;
+	struct impl *impl;
+	uint32_t target_id;
+	uint64_t target_serial;
+	char *app_name;			/* application.name of the plays */
+	char *role;			/* media.role of the plays */
+
+	struct pw_stream *stream;
+	struct spa_hook stream_listener;
+	struct pw_loop *main_loop;
+	struct pw_loop *data_loop;
+	struct spa_source *update;
+	uint32_t id;
+
+	struct sample_spec ss;
+	struct channel_map map;
+	uint32_t stride;
+
+	struct spa_list plays;		/* sample_play.link, main thread */
+	struct spa_list voices;		/* sample_play.mix_link, data thread */
+
+	unsigned int active:1;
+	unsigned int failed:1;
+	unsigned int destroy_pending:1;
+};
+
+void sample_mixer_get_spec(struct impl *impl, struct sample_spec *ss, struct channel_map *map);
+
+int sample_mixer_convert(struct sample *sample, const struct sample_spec *ss,
+		const struct channel_map *map);
+
+struct sample_mixer *sample_mixer_get(struct impl *impl, uint32_t target_id,
+		uint64_t target_serial, const struct pw_properties *props);
+
+bool sample_mixer_can_play(struct sample_mixer *m, struct sample *sample);
+
+void sample_mixer_add(struct sample_mixer *m, struct sample_play *p);
+void sample_mixer_remove(struct sample_mixer *m, struct sample_play *p);
+
+void sample_mixer_destroy(struct sample_mixer *m);
+
+#endif /* PULSE_SERVER_SAMPLE_MIXER_H */
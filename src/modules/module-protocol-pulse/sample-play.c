@@ -40,6 +40,7 @@
 #include "format.h"
 #include "log.h"
 #include "sample.h"
+#include "sample-mixer.h"
 #include "sample-play.h"
 
 static void sample_play_stream_state_changed(void *data, enum pw_stream_state old,
@@ -194,8 +195,35 @@ error_free:
 	return NULL;
 }
 
+struct sample_play *sample_play_new_mixed(struct sample_mixer *mixer,
+					  struct sample *sample, size_t user_data_size)
+{
+	struct sample_play *p;
+
+	p = calloc(1, sizeof(*p) + user_data_size);
+	if (p == NULL)
+		return NULL;
+
+	p->id = SPA_ID_INVALID;
+	p->main_loop = mixer->main_loop;
+	spa_hook_list_init(&p->hooks);
+	p->user_data = SPA_PTROFF(p, sizeof(struct sample_play), void);
+
+	p->sample = sample_ref(sample);
+	p->stride = mixer->stride;
+
+	sample_mixer_add(mixer, p);
+
+	return p;
+}
+
 void sample_play_destroy(struct sample_play *p)
 {
+	if (p->mixer) {
+		sample_mixer_remove(p->mixer, p);
+		sample_unref(p->sample);
+		p->sample = NULL;
+	}
 	if (p->stream)
 		pw_stream_destroy(p->stream);
 
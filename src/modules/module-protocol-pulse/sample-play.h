@@ -25,6 +25,7 @@
 #ifndef PULSER_SERVER_SAMPLE_PLAY_H
 #define PULSER_SERVER_SAMPLE_PLAY_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -32,6 +33,7 @@
 #include <spa/utils/hook.h>
 
 struct sample;
+struct sample_mixer;
 struct pw_core;
 struct pw_loop;
 struct pw_stream;
@@ -62,12 +64,21 @@ struct sample_play {
 	uint32_t stride;
 	struct spa_hook_list hooks;
 	void *user_data;
+
+	struct sample_mixer *mixer;
+	struct spa_list mix_link;
+	bool mix_done;			/* set from the data thread, use atomics */
+	unsigned int ready_sent:1;
+	unsigned int done_sent:1;
 };
 
 struct sample_play *sample_play_new(struct pw_core *core,
 				    struct sample *sample, struct pw_properties *props,
 				    size_t user_data_size);
 
+struct sample_play *sample_play_new_mixed(struct sample_mixer *mixer,
+					  struct sample *sample, size_t user_data_size);
+
 void sample_play_destroy(struct sample_play *p);
 
 void sample_play_add_listener(struct sample_play *p, struct spa_hook *listener,
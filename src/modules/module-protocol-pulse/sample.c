@@ -45,6 +45,7 @@ void sample_free(struct sample *sample)
 
 	pw_properties_free(sample->props);
 
+	free(sample->mix_data);
 	free(sample->buffer);
 	free(sample);
 }
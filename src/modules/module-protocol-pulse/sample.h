@@ -42,6 +42,11 @@ struct sample {
 	struct pw_properties *props;
 	uint32_t length;
 	uint8_t *buffer;
+
+	/* the samples converted to the mixer format, see sample-mixer.h */
+	struct sample_spec mix_ss;
+	uint32_t mix_frames;
+	float *mix_data;
 };
 
 void sample_free(struct sample *sample);
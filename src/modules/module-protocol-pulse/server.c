@@ -58,6 +58,7 @@
 #include "message.h"
 #include "reply.h"
 #include "server.h"
+#include "shm.h"
 #include "stream.h"
 #include "utils.h"
 #include "flatpak-utils.h"
@@ -110,6 +111,8 @@ static int handle_packet(struct client *client, struct message *msg)
 	res = cmd->run(client, command, tag, msg);
 
 finish:
+	/* close the fds that were not used by the command */
+	client_close_fds(client);
 	message_free(msg, false, false);
 	if (res < 0)
 		reply_error(client, command, tag, res);
@@ -117,12 +120,28 @@ finish:
 	return 0;
 }
 
+static int write_shm_data(void *buffer, uint32_t size, uint32_t offset,
+		struct shm_pool *pool, uint32_t shm_offset, uint32_t len)
+{
+	uint32_t l0 = SPA_MIN(len, size - offset), l1 = len - l0;
+	int res;
+
+	if ((res = shm_pool_read(pool, shm_offset, SPA_PTROFF(buffer, offset, void), l0)) < 0)
+		return res;
+	if (l1 > 0)
+		res = shm_pool_read(pool, shm_offset + l0, buffer, l1);
+	return res;
+}
+
 static int handle_memblock(struct client *client, struct message *msg)
 {
 	struct stream *stream;
-	uint32_t channel, flags, index;
+	uint32_t channel, flags, index, length;
 	int64_t offset, diff;
 	int32_t filled;
+	struct shm_pool *pool = NULL;
+	uint32_t shm_offset = 0;
+	const void *data = NULL;
 	int res = 0;
 
 	channel = ntohl(client->desc.channel);
@@ -134,6 +153,32 @@ static int handle_memblock(struct client *client, struct message *msg)
 	pw_log_debug("client %p: received memblock channel:%d offset:%" PRIi64 " flags:%08x size:%u",
 		     client, channel, offset, flags, msg->length);
 
+	if (flags & FLAG_SHMDATA) {
+		uint32_t block_id, shm_id;
+
+		block_id = ntohl(((uint32_t*)msg->data)[0]);
+		shm_id = ntohl(((uint32_t*)msg->data)[1]);
+		shm_offset = ntohl(((uint32_t*)msg->data)[2]);
+		length = ntohl(((uint32_t*)msg->data)[3]);
+
+		/* the data is copied into the ringbuffer right away so we can
+		 * release the block immediately */
+		client_queue_shm_release(client, block_id);
+
+		pool = shm_pool_get(client, shm_id,
+				SPA_FLAG_IS_SET(flags, FLAG_SHMDATA_MEMFD_BLOCK),
+				shm_offset, length);
+		if (pool == NULL) {
+			pw_log_warn("client %p [%s]: invalid shm block %u:%u offset:%u length:%u",
+				    client, client->name, block_id, shm_id, shm_offset, length);
+			res = -EPROTO;
+			goto finish;
+		}
+	} else {
+		data = msg->data;
+		length = msg->length;
+	}
+
 	stream = pw_map_lookup(&client->streams, channel);
 	if (stream == NULL || stream->type == STREAM_TYPE_RECORD) {
 		pw_log_info("client %p [%s]: received memblock for unknown channel %d",
@@ -143,7 +188,7 @@ static int handle_memblock(struct client *client, struct message *msg)
 
 	filled = spa_ringbuffer_get_write_index(&stream->ring, &index);
 	pw_log_debug("new block %p %p/%u filled:%d index:%d flags:%02x offset:%" PRIu64,
-		     msg, msg->data, msg->length, filled, index, flags, offset);
+		     msg, data, length, filled, index, flags, offset);
 
 	switch (flags & FLAG_SEEKMASK) {
 	case SEEK_RELATIVE:
@@ -169,22 +214,34 @@ static int handle_memblock(struct client *client, struct message *msg)
 
 	if (filled < 0) {
 		/* underrun, reported on reader side */
-	} else if (filled + msg->length > stream->attr.maxlength) {
+	} else if (filled + length > stream->attr.maxlength) {
 		/* overrun */
 		stream_send_overflow(stream);
 	}
 
 	/* always write data to ringbuffer, we expect the other side
 	 * to recover */
-	spa_ringbuffer_write_data(&stream->ring,
-			stream->buffer, MAXLENGTH,
-			index % MAXLENGTH,
-			msg->data,
-			SPA_MIN(msg->length, MAXLENGTH));
-	index += msg->length;
-	stream->write_index += msg->length;
+	if (flags & FLAG_SHMDATA) {
+		res = write_shm_data(stream->buffer, MAXLENGTH,
+				index % MAXLENGTH, pool, shm_offset,
+				SPA_MIN(length, MAXLENGTH));
+		if (res < 0) {
+			pw_log_warn("client %p [%s]: shm pool was truncated: %s",
+				    client, client->name, spa_strerror(res));
+			res = -EPROTO;
+			goto finish;
+		}
+	} else {
+		spa_ringbuffer_write_data(&stream->ring,
+				stream->buffer, MAXLENGTH,
+				index % MAXLENGTH,
+				data,
+				SPA_MIN(length, MAXLENGTH));
+	}
+	index += length;
+	stream->write_index += length;
 	spa_ringbuffer_write_update(&stream->ring, index);
-	stream->requested -= SPA_MIN(msg->length, stream->requested);
+	stream->requested -= SPA_MIN(length, stream->requested);
 
 	stream_send_request(stream);
 
@@ -193,6 +250,28 @@ finish:
 	return res;
 }
 
+static void add_fds(struct client *client, struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		uint32_t i, n_fds;
+		int *fds;
+
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		fds = (int*)CMSG_DATA(cmsg);
+		n_fds = (cmsg->cmsg_len - ((uint8_t*)fds - (uint8_t*)cmsg)) / sizeof(int);
+		for (i = 0; i < n_fds; i++) {
+			if (client->n_fds < MAX_CLIENT_FDS)
+				client->fds[client->n_fds++] = fds[i];
+			else
+				close(fds[i]);
+		}
+	}
+}
+
 static int do_read(struct client *client)
 {
 	struct impl * const impl = client->impl;
@@ -216,7 +295,15 @@ static int do_read(struct client *client)
 	}
 
 	while (true) {
-		ssize_t r = recv(client->source->fd, data, size, MSG_DONTWAIT);
+		uint8_t buffer[CMSG_SPACE(sizeof(int) * MAX_CLIENT_FDS)];
+		struct iovec iov = { .iov_base = data, .iov_len = size };
+		struct msghdr hdr = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = buffer,
+			.msg_controllen = sizeof(buffer),
+		};
+		ssize_t r = recvmsg(client->source->fd, &hdr, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
 
 		if (r == 0 && size != 0) {
 			res = -EPIPE;
@@ -231,6 +318,9 @@ static int do_read(struct client *client)
 			goto exit;
 		}
 
+		if (hdr.msg_controllen > 0)
+			add_fds(client, &hdr);
+
 		client->in_index += r;
 		break;
 	}
@@ -239,10 +329,17 @@ static int do_read(struct client *client)
 		uint32_t flags, length, channel;
 
 		flags = ntohl(client->desc.flags);
-		if ((flags & FLAG_SHMMASK) != 0) {
+		if ((flags & FLAG_SHMMASK) != 0 && !client->shm) {
 			res = -EPROTO;
 			goto exit;
 		}
+		if ((flags & FLAG_SHMMASK) == FLAG_SHMRELEASE ||
+		    (flags & FLAG_SHMMASK) == FLAG_SHMREVOKE) {
+			/* we don't export memory and don't keep references to
+			 * imported blocks, nothing to do */
+			client->in_index = 0;
+			goto exit;
+		}
 
 		length = ntohl(client->desc.length);
 		if (length > FRAME_SIZE_MAX_ALLOW || length <= 0) {
@@ -260,6 +357,11 @@ static int do_read(struct client *client)
 				res = -EPROTO;
 				goto exit;
 			}
+		} else if ((flags & FLAG_SHMDATA) && length != 4 * sizeof(uint32_t)) {
+			pw_log_warn("client %p: received shm frame with invalid size: %u",
+				    client, length);
+			res = -EPROTO;
+			goto exit;
 		}
 
 		if (client->message)
@@ -0,0 +1,161 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <spa/utils/defs.h>
+#include <pipewire/log.h>
+
+#include "client.h"
+#include "log.h"
+#include "shm.h"
+
+/* The client can truncate POSIX pools and memfd pools that are not sealed
+ * at any time. The pools are not mapped, the data is read from the fd so that
+ * a truncated pool results in a short read instead of a SIGBUS. */
+
+static struct shm_pool *find_pool(struct client *client, uint32_t id, bool memfd)
+{
+	uint32_t i;
+	for (i = 0; i < client->n_shm_pools; i++) {
+		struct shm_pool *p = &client->shm_pools[i];
+		if (p->id == id && p->memfd == memfd)
+			return p;
+	}
+	return NULL;
+}
+
+static int add_pool(struct client *client, uint32_t id, bool memfd, int fd)
+{
+	struct shm_pool *p;
+	struct stat st;
+
+	if (client->n_shm_pools >= MAX_SHM_POOLS)
+		return -ENOSPC;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	if (st.st_size <= 0 || (uint64_t)st.st_size > SIZE_MAX)
+		return -EINVAL;
+
+	p = &client->shm_pools[client->n_shm_pools++];
+	p->id = id;
+	p->memfd = memfd;
+	p->fd = fd;
+	p->size = st.st_size;
+
+	pw_log_debug("client %p [%s]: added %s pool id:%u size:%zu", client,
+			client->name, memfd ? "memfd" : "shm", id, p->size);
+	return 0;
+}
+
+int shm_pool_add_memfd(struct client *client, uint32_t id, int fd)
+{
+	int res;
+
+	if (find_pool(client, id, true) != NULL)
+		res = -EEXIST;
+	else
+		res = add_pool(client, id, true, fd);
+	if (res < 0)
+		close(fd);
+	return res;
+}
+
+static struct shm_pool *attach_posix_pool(struct client *client, uint32_t id)
+{
+	char name[64];
+	int fd, res;
+
+	snprintf(name, sizeof(name), "/pulse-shm-%u", id);
+
+	if ((fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0)) < 0) {
+		pw_log_info("client %p [%s]: can't open %s: %m", client, client->name, name);
+		return NULL;
+	}
+	if ((res = add_pool(client, id, false, fd)) < 0) {
+		close(fd);
+		errno = -res;
+		pw_log_info("client %p [%s]: can't add %s: %m", client, client->name, name);
+		return NULL;
+	}
+	return &client->shm_pools[client->n_shm_pools - 1];
+}
+
+struct shm_pool *shm_pool_get(struct client *client, uint32_t id, bool memfd,
+		uint32_t offset, uint32_t length)
+{
+	struct shm_pool *p;
+
+	if ((p = find_pool(client, id, memfd)) == NULL) {
+		/* memfd pools are registered by the client, POSIX pools are
+		 * attached on first use */
+		if (memfd || (p = attach_posix_pool(client, id)) == NULL)
+			return NULL;
+	}
+	if ((uint64_t)offset + length > p->size)
+		return NULL;
+
+	return p;
+}
+
+int shm_pool_read(struct shm_pool *pool, uint32_t offset, void *dst, uint32_t length)
+{
+	ssize_t res;
+
+	if ((uint64_t)offset + length > pool->size)
+		return -EINVAL;
+
+	while (length > 0) {
+		res = pread(pool->fd, dst, length, offset);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (res == 0)
+			return -EFAULT;
+		dst = SPA_PTROFF(dst, res, void);
+		offset += res;
+		length -= res;
+	}
+	return 0;
+}
+
+void shm_pool_clear(struct client *client)
+{
+	uint32_t i;
+	for (i = 0; i < client->n_shm_pools; i++) {
+		struct shm_pool *p = &client->shm_pools[i];
+		close(p->fd);
+	}
+	client->n_shm_pools = 0;
+}
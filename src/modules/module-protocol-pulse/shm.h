@@ -0,0 +1,54 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef PULSE_SERVER_SHM_H
+#define PULSE_SERVER_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct client;
+
+#define MAX_SHM_POOLS	16
+
+/* a shared memory pool of a client, memblocks from the client
+ * reference data in one of these pools */
+struct shm_pool {
+	uint32_t id;
+	unsigned int memfd:1;
+	int fd;
+	size_t size;
+};
+
+int shm_pool_add_memfd(struct client *client, uint32_t id, int fd);
+/* get the pool with id when it contains length bytes at offset */
+struct shm_pool *shm_pool_get(struct client *client, uint32_t id, bool memfd,
+		uint32_t offset, uint32_t length);
+/* read data from a pool, returns -EFAULT when the pool was truncated */
+int shm_pool_read(struct shm_pool *pool, uint32_t offset, void *dst, uint32_t length);
+void shm_pool_clear(struct client *client);
+
+#endif /* PULSE_SERVER_SHM_H */
@@ -0,0 +1,175 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <spa/utils/defs.h>
+
+#include <pipewire/pipewire.h>
+
+#include "client.h"
+#include "shm.h"
+
+#ifndef F_LINUX_SPECIFIC_BASE
+#define F_LINUX_SPECIFIC_BASE 1024
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (F_LINUX_SPECIFIC_BASE + 9)
+#define F_SEAL_SHRINK   0x0002	/* prevent file from shrinking */
+#endif
+
+#define POOL_SIZE	4096
+
+PW_LOG_TOPIC(mod_topic, "mod.protocol-pulse");
+
+static int make_memfd(bool seal)
+{
+	uint8_t data[POOL_SIZE];
+	int fd;
+
+	fd = memfd_create("pulse-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	spa_assert_se(fd >= 0);
+
+	memset(data, 0x5a, sizeof(data));
+	spa_assert_se(write(fd, data, sizeof(data)) == sizeof(data));
+	if (seal)
+		spa_assert_se(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) == 0);
+	return fd;
+}
+
+static void test_memfd(struct client *client)
+{
+	struct shm_pool *pool;
+	uint8_t buf[16];
+
+	spa_assert_se(shm_pool_get(client, 1, true, 0, 16) == NULL);
+
+	spa_assert_se(shm_pool_add_memfd(client, 1, make_memfd(true)) == 0);
+	spa_assert_se(client->n_shm_pools == 1);
+	spa_assert_se(shm_pool_add_memfd(client, 1, make_memfd(true)) == -EEXIST);
+
+	/* only the memfd pool with the same id is found */
+	spa_assert_se(shm_pool_get(client, 2, true, 0, 16) == NULL);
+
+	pool = shm_pool_get(client, 1, true, POOL_SIZE - 16, 16);
+	spa_assert_se(pool != NULL);
+	spa_assert_se(shm_pool_read(pool, POOL_SIZE - 16, buf, sizeof(buf)) == 0);
+	spa_assert_se(buf[0] == 0x5a && buf[15] == 0x5a);
+
+	/* out of bounds */
+	spa_assert_se(shm_pool_get(client, 1, true, POOL_SIZE - 15, 16) == NULL);
+	spa_assert_se(shm_pool_get(client, 1, true, UINT32_MAX, 2) == NULL);
+	spa_assert_se(shm_pool_read(pool, POOL_SIZE - 15, buf, sizeof(buf)) == -EINVAL);
+	spa_assert_se(shm_pool_read(pool, UINT32_MAX, buf, 2) == -EINVAL);
+
+	shm_pool_clear(client);
+	spa_assert_se(client->n_shm_pools == 0);
+}
+
+static void test_memfd_unsealed(struct client *client)
+{
+	struct shm_pool *pool;
+	uint8_t buf[16];
+	int fd;
+
+	fd = make_memfd(false);
+
+	/* the pool is accepted, reads fail when the client truncates it */
+	spa_assert_se(shm_pool_add_memfd(client, 1, dup(fd)) == 0);
+	spa_assert_se(client->n_shm_pools == 1);
+
+	pool = shm_pool_get(client, 1, true, 0, sizeof(buf));
+	spa_assert_se(pool != NULL);
+	spa_assert_se(shm_pool_read(pool, 0, buf, sizeof(buf)) == 0);
+	spa_assert_se(buf[0] == 0x5a && buf[15] == 0x5a);
+
+	spa_assert_se(ftruncate(fd, 0) == 0);
+	spa_assert_se(shm_pool_read(pool, 0, buf, sizeof(buf)) == -EFAULT);
+
+	/* a partial read of a shrunk pool fails as well */
+	spa_assert_se(ftruncate(fd, 8) == 0);
+	spa_assert_se(shm_pool_read(pool, 0, buf, sizeof(buf)) == -EFAULT);
+
+	shm_pool_clear(client);
+	close(fd);
+}
+
+static void test_posix(struct client *client)
+{
+	char name[64];
+	struct shm_pool *pool;
+	uint8_t buf[16];
+	uint32_t id = getpid();
+	int fd;
+
+	snprintf(name, sizeof(name), "/pulse-shm-%u", id);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "skipping POSIX shm test: %m\n");
+		return;
+	}
+	spa_assert_se(ftruncate(fd, POOL_SIZE) == 0);
+
+	/* attached on first use */
+	pool = shm_pool_get(client, id, false, 0, sizeof(buf));
+	spa_assert_se(pool != NULL);
+	spa_assert_se(client->n_shm_pools == 1);
+	spa_assert_se(shm_pool_get(client, id, true, 0, sizeof(buf)) == NULL);
+	spa_assert_se(shm_pool_read(pool, 0, buf, sizeof(buf)) == 0);
+	spa_assert_se(buf[0] == 0 && buf[15] == 0);
+
+	/* the client truncates the pool, the read must fail */
+	spa_assert_se(ftruncate(fd, 0) == 0);
+	spa_assert_se(shm_pool_read(pool, 0, buf, sizeof(buf)) == -EFAULT);
+
+	shm_pool_clear(client);
+	close(fd);
+	shm_unlink(name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct client client;
+
+	pw_init(&argc, &argv);
+
+	PW_LOG_TOPIC_INIT(mod_topic);
+
+	spa_zero(client);
+	client.name = "test";
+
+	test_memfd(&client);
+	test_memfd_unsealed(&client);
+	test_posix(&client);
+
+	pw_deinit();
+
+	return 0;
+}
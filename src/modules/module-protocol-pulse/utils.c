@@ -42,12 +42,15 @@
 #include <pwd.h>
 #endif
 
+#include <spa/support/loop.h>
 #include <spa/utils/result.h>
 #include <pipewire/context.h>
 #include <pipewire/log.h>
 #include <pipewire/keys.h>
 
+#include "client.h"
 #include "log.h"
+#include "server.h"
 #include "utils.h"
 
 int get_runtime_dir(char *buf, size_t buflen)
@@ -166,6 +169,25 @@ pid_t get_client_pid(struct client *client, int client_fd)
 	return 0;
 }
 
+bool client_is_same_user(struct client *client)
+{
+#if defined(__linux__) && defined(SCM_CREDENTIALS)
+	struct ucred ucred;
+	socklen_t len = sizeof(ucred);
+
+	if (client->source == NULL || client->server == NULL ||
+	    client->server->addr.ss_family != AF_UNIX)
+		return false;
+	if (getsockopt(client->source->fd, SOL_SOCKET, SO_PEERCRED, &ucred, &len) < 0) {
+		pw_log_warn("client %p: no peercred: %m", client);
+		return false;
+	}
+	return ucred.uid == getuid();
+#else
+	return false;
+#endif
+}
+
 const char *get_server_name(struct pw_context *context)
 {
 	const char *name = NULL;
@@ -83,6 +83,9 @@ PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
 #define FRAMES_PER_TCP_PACKET 4096
 #define FRAMES_PER_UDP_PACKET 352
 
+#define MAX_UDP_BATCH		32
+#define MAX_UDP_PACKET_SIZE	(12 + 8 + FRAMES_PER_UDP_PACKET * 4)
+
 #define DEFAULT_TCP_AUDIO_PORT   6000
 #define DEFAULT_UDP_AUDIO_PORT   6000
 #define DEFAULT_UDP_CONTROL_PORT 6001
@@ -204,6 +207,13 @@ struct impl {
 
 	uint8_t buffer[FRAMES_PER_TCP_PACKET * 4];
 	uint32_t filled;
+
+	uint32_t udp_packets[MAX_UDP_BATCH][(MAX_UDP_PACKET_SIZE + 3) / 4];
+	struct iovec udp_iov[MAX_UDP_BATCH];
+	struct mmsghdr udp_mmsg[MAX_UDP_BATCH];
+	uint32_t n_udp_packets;
+	uint64_t n_packets;
+	uint64_t n_syscalls;
 };
 
 static void stream_destroy(void *d)
@@ -335,12 +345,35 @@ static int write_codec_pcm(void *dst, void *frames, uint32_t n_frames)
 	return bp - b + 1;
 }
 
+static int send_udp_packets(struct impl *impl)
+{
+	uint32_t i, n_packets = impl->n_udp_packets;
+	int res;
+
+	if (n_packets == 0)
+		return 0;
+
+	for (i = 0; i < n_packets; i++) {
+		impl->udp_mmsg[i].msg_hdr.msg_iov = &impl->udp_iov[i];
+		impl->udp_mmsg[i].msg_hdr.msg_iovlen = 1;
+	}
+	impl->n_udp_packets = 0;
+
+	res = sendmmsg(impl->server_fd, impl->udp_mmsg, n_packets, 0);
+	impl->n_syscalls++;
+	if (res < 0) {
+		pw_log_warn("sendmmsg() failed: %m");
+		return -errno;
+	}
+	impl->n_packets += res;
+	pw_log_debug("sent %d/%u packets", res, n_packets);
+	return res;
+}
+
 static int flush_to_udp_packet(struct impl *impl)
 {
-	const size_t max = 12 + 8 + impl->block_size;
-	uint32_t pkt[max], len, n_frames;
+	uint32_t *pkt, len, n_frames;
 	uint8_t *dst;
-	int res;
 
 	if (!impl->recording)
 		return 0;
@@ -348,8 +381,12 @@ static int flush_to_udp_packet(struct impl *impl)
 	impl->sync++;
 	if (impl->first || impl->sync == impl->sync_period) {
 		impl->sync = 0;
+		/* keep the sync packet ordered with the audio packets */
+		send_udp_packets(impl);
 		send_udp_sync_packet(impl, NULL, 0);
 	}
+	pkt = impl->udp_packets[impl->n_udp_packets];
+
 	pkt[0] = htonl(0x80600000);
 	if (impl->first)
 		pkt[0] |= htonl((uint32_t)0x80 << 16);
@@ -375,12 +412,17 @@ static int flush_to_udp_packet(struct impl *impl)
 	impl->rtptime += n_frames;
 	impl->seq = (impl->seq + 1) & 0xffff;
 
-	pw_log_debug("send %u", len + 12);
-	res = send(impl->server_fd, pkt, len + 12, 0);
+	pw_log_debug("queue %u", len + 12);
+	impl->udp_iov[impl->n_udp_packets].iov_base = pkt;
+	impl->udp_iov[impl->n_udp_packets].iov_len = len + 12;
+	impl->n_udp_packets++;
 
 	impl->first = false;
 
-	return res;
+	if (impl->n_udp_packets == MAX_UDP_BATCH)
+		return send_udp_packets(impl);
+
+	return 0;
 }
 
 static int flush_to_tcp_packet(struct impl *impl)
@@ -471,6 +513,7 @@ static void playback_stream_process(void *d)
 			impl->filled = 0;
 		}
 	}
+	send_udp_packets(impl);
 
 	pw_stream_queue_buffer(impl->stream, buf);
 }
@@ -1241,6 +1284,12 @@ static void rtsp_connected(void *data)
 static void connection_cleanup(struct impl *impl)
 {
 	impl->ready = false;
+	impl->n_udp_packets = 0;
+	if (impl->n_syscalls > 0) {
+		pw_log_info("sent %"PRIu64" packets in %"PRIu64" syscalls",
+				impl->n_packets, impl->n_syscalls);
+		impl->n_packets = impl->n_syscalls = 0;
+	}
 	if (impl->server_fd != -1) {
 		close(impl->server_fd);
 		impl->server_fd = -1;
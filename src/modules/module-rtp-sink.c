@@ -0,0 +1,983 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "config.h"
+
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/utils/json.h>
+#include <spa/utils/ringbuffer.h>
+#include <spa/debug/types.h>
+#include <spa/pod/builder.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/audio/raw.h>
+
+#include <pipewire/impl.h>
+#include <pipewire/i18n.h>
+#include <pipewire/private.h>
+
+#include "module-rtp/rtp.h"
+#include "module-rtp/sap.h"
+
+/** \page page_module_rtp_sink PipeWire Module: RTP sink
+ *
+ * The `rtp-sink` module creates a PipeWire sink that sends audio
+ * RTP packets in the AES67 L16 or L24 format. The session is announced
+ * with SAP/SDP so that it can be discovered by other AES67 receivers.
+ *
+ * ## Module Options
+ *
+ * Options specific to the behavior of this module
+ *
+ * - `source.ip =<str>`: source IP address, default the wildcard address
+ * - `destination.ip =<str>`: destination IP address, default "224.0.0.56"
+ * - `destination.port =<int>`: destination port, default 46000
+ * - `local.ifname = <str>`: interface name to use
+ * - `net.mtu = <int>`: MTU to use, default 1280
+ * - `net.ttl = <int>`: TTL to use, default 1
+ * - `net.loop = <bool>`: loopback multicast, default false
+ * - `net.dscp = <int>`: DSCP of the RTP packets, default 34 (AF41)
+ * - `sess.name = <str>`: a session name, default "PipeWire RTP Stream"
+ * - `sess.ptime = <float>`: the packet time in milliseconds, default 1
+ * - `sap.ip = <str>`: IP address of the SAP announcements, default "224.0.0.56"
+ * - `sap.port = <int>`: port of the SAP announcements, default 9875
+ * - `stream.props = {}`: properties to be passed to the stream
+ *
+ * ## General options
+ *
+ * Options with well-known behavior:
+ *
+ * - \ref PW_KEY_REMOTE_NAME
+ * - \ref PW_KEY_AUDIO_FORMAT
+ * - \ref PW_KEY_AUDIO_RATE
+ * - \ref PW_KEY_AUDIO_CHANNELS
+ * - \ref SPA_KEY_AUDIO_POSITION
+ * - \ref PW_KEY_NODE_NAME
+ * - \ref PW_KEY_NODE_DESCRIPTION
+ * - \ref PW_KEY_NODE_GROUP
+ * - \ref PW_KEY_NODE_LATENCY
+ * - \ref PW_KEY_NODE_VIRTUAL
+ * - \ref PW_KEY_MEDIA_CLASS
+ *
+ * Only the S16BE (L16) and S24BE (L24) sample formats are supported. The
+ * samples are sent in the wire format so that no conversion is needed in
+ * the sender. When not otherwise specified, a 16 bits, stereo, 48KHz
+ * stream is sent.
+ *
+ * Packets are sent at the end of each graph cycle, so with large quanta
+ * they are sent in bursts. Use \ref PW_KEY_NODE_LATENCY to reduce the
+ * burst size.
+ *
+ * ## Example configuration
+ *\code{.unparsed}
+ * context.modules = [
+ * {   name = libpipewire-module-rtp-sink
+ *     args = {
+ *         #local.ifname = "eth0"
+ *         #source.ip = "0.0.0.0"
+ *         #destination.ip = "224.0.0.56"
+ *         #destination.port = 46000
+ *         #net.mtu = 1280
+ *         #net.ttl = 1
+ *         #net.loop = false
+ *         #sess.name = "PipeWire RTP Stream"
+ *         #sess.ptime = 1
+ *         #audio.format = "S16BE"
+ *         #audio.rate = 48000
+ *         #audio.channels = 2
+ *         #audio.position = [ FL FR ]
+ *         stream.props = {
+ *             node.name = "rtp-sink"
+ *         }
+ *     }
+ * }
+ * ]
+ *\endcode
+ */
+
+#define NAME "rtp-sink"
+
+PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
+#define PW_LOG_TOPIC_DEFAULT mod_topic
+
+#define BUFFER_SIZE		(1u<<20)
+#define BUFFER_MASK		(BUFFER_SIZE-1)
+
+#define SAP_INTERVAL_SEC	5
+#define SAP_MIME_TYPE		"application/sdp"
+
+#define RTP_PAYLOAD_TYPE	127
+
+#define DEFAULT_PORT		46000
+#define DEFAULT_SOURCE_IP	"0.0.0.0"
+#define DEFAULT_SOURCE_IP6	"::"
+#define DEFAULT_DESTINATION_IP	"224.0.0.56"
+#define DEFAULT_SAP_IP		"224.0.0.56"
+#define DEFAULT_SAP_PORT	9875
+#define DEFAULT_MTU		1280
+#define DEFAULT_TTL		1
+#define DEFAULT_LOOP		false
+#define DEFAULT_DSCP		34
+#define DEFAULT_PTIME		1.0f
+#define DEFAULT_SESSION_NAME	"PipeWire RTP Stream"
+
+#define DEFAULT_FORMAT		"S16BE"
+#define DEFAULT_RATE		48000
+#define DEFAULT_CHANNELS	2
+#define DEFAULT_POSITION	"[ FL FR ]"
+
+#define MODULE_USAGE	"[ remote.name=<remote> ] "				\
+			"[ source.ip=<source IP address> ] "			\
+			"[ destination.ip=<destination IP address> ] "		\
+			"[ destination.port=<destination port> ] "		\
+			"[ local.ifname=<local interface name to use> ] "	\
+			"[ net.mtu=<MTU to use, default 1280> ] "		\
+			"[ net.ttl=<TTL to use, default 1> ] "			\
+			"[ net.loop=<enable loopback multicast, default false> ] "	\
+			"[ net.dscp=<DSCP of the packets, default 34> ] "	\
+			"[ sess.name=<a name for the session> ] "		\
+			"[ sess.ptime=<packet time in milliseconds, default 1> ] "	\
+			"[ sap.ip=<SAP IP address> ] "				\
+			"[ sap.port=<SAP port> ] "				\
+			"[ audio.format=S16BE|S24BE ] "				\
+			"[ audio.rate=<sample rate> ] "				\
+			"[ audio.channels=<number of channels> ] "		\
+			"[ audio.position=<channel map> ] "			\
+			"[ stream.props=<properties> ] "
+
+static const struct spa_dict_item module_props[] = {
+	{ PW_KEY_MODULE_AUTHOR, "Wim Taymans <wim.taymans@gmail.com>" },
+	{ PW_KEY_MODULE_DESCRIPTION, "RTP Sink" },
+	{ PW_KEY_MODULE_USAGE, MODULE_USAGE },
+	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
+};
+
+struct impl {
+	struct pw_context *context;
+
+	struct pw_impl_module *module;
+	struct spa_hook module_listener;
+	struct pw_properties *props;
+
+	struct pw_loop *loop;
+	struct pw_loop *data_loop;
+
+	struct pw_core *core;
+	struct spa_hook core_listener;
+	struct spa_hook core_proxy_listener;
+
+	struct spa_source *timer;
+
+	struct pw_properties *stream_props;
+	struct pw_stream *stream;
+	struct spa_hook stream_listener;
+
+	unsigned int do_disconnect:1;
+
+	char *ifname;
+	char *session_name;
+	uint32_t mtu;
+	uint32_t ttl;
+	bool mcast_loop;
+	uint32_t dscp;
+
+	struct sockaddr_storage src_addr;
+	socklen_t src_len;
+	struct sockaddr_storage local_addr;
+
+	uint16_t dst_port;
+	struct sockaddr_storage dst_addr;
+	socklen_t dst_len;
+
+	struct sockaddr_storage sap_addr;
+	socklen_t sap_len;
+
+	struct spa_audio_info_raw info;
+	const char *encoding;
+	uint32_t frame_size;
+	uint32_t payload;
+	float ptime;
+	uint32_t psamples;
+
+	uint16_t seq;
+	uint32_t ssrc;
+	uint32_t ts_offset;
+	uint32_t timestamp;
+	uint16_t msg_id_hash;
+
+	struct spa_ringbuffer ring;
+	uint8_t buffer[BUFFER_SIZE];
+
+	int rtp_fd;
+	int sap_fd;
+};
+
+static void flush_packets(struct impl *impl)
+{
+	int32_t avail;
+	uint32_t index, offset, l0, tosend;
+	struct rtp_header header;
+	struct iovec iov[3];
+	struct msghdr msg;
+	ssize_t n;
+
+	avail = spa_ringbuffer_get_read_index(&impl->ring, &index);
+	tosend = impl->psamples * impl->frame_size;
+
+	if (avail < (int32_t)tosend)
+		return;
+
+	spa_zero(header);
+	header.v = 2;
+	header.pt = impl->payload;
+	header.ssrc = htonl(impl->ssrc);
+
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+
+	spa_zero(msg);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 3;
+
+	while (avail >= (int32_t)tosend) {
+		header.sequence_number = htons(impl->seq);
+		header.timestamp = htonl(impl->ts_offset + impl->timestamp);
+
+		offset = index & BUFFER_MASK;
+		l0 = SPA_MIN(tosend, BUFFER_SIZE - offset);
+
+		iov[1].iov_base = &impl->buffer[offset];
+		iov[1].iov_len = l0;
+		iov[2].iov_base = impl->buffer;
+		iov[2].iov_len = tosend - l0;
+
+		n = sendmsg(impl->rtp_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0)
+			pw_log_debug("sendmsg() failed: %m");
+
+		impl->seq++;
+		impl->timestamp += impl->psamples;
+		index += tosend;
+		avail -= tosend;
+	}
+	spa_ringbuffer_read_update(&impl->ring, index);
+}
+
+static void stream_process(void *data)
+{
+	struct impl *impl = data;
+	struct pw_buffer *buf;
+	struct spa_data *d;
+	uint32_t offs, size, index;
+	int32_t filled;
+
+	if ((buf = pw_stream_dequeue_buffer(impl->stream)) == NULL) {
+		pw_log_debug("out of buffers: %m");
+		return;
+	}
+	d = &buf->buffer->datas[0];
+
+	offs = SPA_MIN(d->chunk->offset, d->maxsize);
+	size = SPA_MIN(d->chunk->size, d->maxsize - offs);
+
+	filled = spa_ringbuffer_get_write_index(&impl->ring, &index);
+	if (filled < 0 || (uint32_t)filled + size > BUFFER_SIZE) {
+		pw_log_warn("%p: overrun write:%u filled:%d + size:%u > max:%u",
+				impl, index, filled, size, BUFFER_SIZE);
+	} else {
+		spa_ringbuffer_write_data(&impl->ring,
+				impl->buffer, BUFFER_SIZE,
+				index & BUFFER_MASK,
+				SPA_PTROFF(d->data, offs, void), size);
+		index += size;
+		spa_ringbuffer_write_update(&impl->ring, index);
+	}
+	pw_stream_queue_buffer(impl->stream, buf);
+
+	flush_packets(impl);
+}
+
+static void stream_destroy(void *d)
+{
+	struct impl *impl = d;
+	spa_hook_remove(&impl->stream_listener);
+	impl->stream = NULL;
+}
+
+static int do_reset_ring(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	spa_ringbuffer_init(&impl->ring);
+	return 0;
+}
+
+static void stream_state_changed(void *data, enum pw_stream_state old,
+		enum pw_stream_state state, const char *error)
+{
+	struct impl *impl = data;
+
+	switch (state) {
+	case PW_STREAM_STATE_UNCONNECTED:
+		pw_log_info("stream disconnected, unloading");
+		pw_impl_module_schedule_destroy(impl->module);
+		break;
+	case PW_STREAM_STATE_ERROR:
+		pw_log_error("stream error: %s", error);
+		break;
+	case PW_STREAM_STATE_PAUSED:
+		/* drop the partial packet, the timestamps keep running. The
+		 * ring is used from the data loop of the stream. */
+		pw_loop_invoke(impl->data_loop, do_reset_ring, 0, NULL, 0, true, impl);
+		break;
+	default:
+		break;
+	}
+}
+
+static const struct pw_stream_events out_stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.destroy = stream_destroy,
+	.state_changed = stream_state_changed,
+	.process = stream_process
+};
+
+static bool is_multicast(struct sockaddr *sa, socklen_t salen)
+{
+	if (sa->sa_family == AF_INET) {
+		struct sockaddr_in *sa4 = (struct sockaddr_in*)sa;
+		return IN_MULTICAST(ntohl(sa4->sin_addr.s_addr));
+	} else if (sa->sa_family == AF_INET6) {
+		struct sockaddr_in6 *sa6 = (struct sockaddr_in6*)sa;
+		return IN6_IS_ADDR_MULTICAST(&sa6->sin6_addr);
+	}
+	return false;
+}
+
+static int make_socket(struct sockaddr_storage *src, socklen_t src_len,
+		struct sockaddr_storage *dst, socklen_t dst_len,
+		bool loop, int ttl, int dscp, const char *ifname)
+{
+	int af, fd, val, res;
+
+	af = src->ss_family;
+	if ((fd = socket(af, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+		pw_log_error("socket failed: %m");
+		return -errno;
+	}
+	if (bind(fd, (struct sockaddr*)src, src_len) < 0) {
+		res = -errno;
+		pw_log_error("bind() failed: %m");
+		goto error;
+	}
+#ifdef SO_BINDTODEVICE
+	if (ifname && setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, ifname, strlen(ifname)) < 0) {
+		res = -errno;
+		pw_log_error("setsockopt(SO_BINDTODEVICE) failed: %m");
+		goto error;
+	}
+#endif
+	if (connect(fd, (struct sockaddr*)dst, dst_len) < 0) {
+		res = -errno;
+		pw_log_error("connect() failed: %m");
+		goto error;
+	}
+	if (is_multicast((struct sockaddr*)dst, dst_len)) {
+		val = loop;
+		if (setsockopt(fd, af == AF_INET ? IPPROTO_IP : IPPROTO_IPV6,
+				af == AF_INET ? IP_MULTICAST_LOOP : IPV6_MULTICAST_LOOP,
+				&val, sizeof(val)) < 0)
+			pw_log_warn("setsockopt(MULTICAST_LOOP) failed: %m");
+
+		val = ttl;
+		if (setsockopt(fd, af == AF_INET ? IPPROTO_IP : IPPROTO_IPV6,
+				af == AF_INET ? IP_MULTICAST_TTL : IPV6_MULTICAST_HOPS,
+				&val, sizeof(val)) < 0)
+			pw_log_warn("setsockopt(MULTICAST_TTL) failed: %m");
+	}
+	if (dscp > 0) {
+		val = dscp << 2;
+		if (setsockopt(fd, af == AF_INET ? IPPROTO_IP : IPPROTO_IPV6,
+				af == AF_INET ? IP_TOS : IPV6_TCLASS,
+				&val, sizeof(val)) < 0)
+			pw_log_warn("setsockopt(TOS/TCLASS) failed: %m");
+	}
+	return fd;
+error:
+	close(fd);
+	return res;
+}
+
+static int get_ip(const struct sockaddr_storage *sa, char *ip, size_t len)
+{
+	if (sa->ss_family == AF_INET) {
+		struct sockaddr_in *in = (struct sockaddr_in*)sa;
+		inet_ntop(sa->ss_family, &in->sin_addr, ip, len);
+	} else if (sa->ss_family == AF_INET6) {
+		struct sockaddr_in6 *in = (struct sockaddr_in6*)sa;
+		inet_ntop(sa->ss_family, &in->sin6_addr, ip, len);
+	} else
+		return -EIO;
+	return 0;
+}
+
+static int send_sap(struct impl *impl, bool bye)
+{
+	char buffer[2048], src_addr[64], dst_addr[64], dst_ttl[8];
+	const char *af;
+	struct sockaddr *sa = (struct sockaddr*)&impl->local_addr;
+	struct sap_header header;
+	struct iovec iov[4];
+	struct msghdr msg;
+	ssize_t n;
+
+	spa_zero(header);
+	header.v = 1;
+	header.t = bye;
+	header.msg_id_hash = impl->msg_id_hash;
+
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+
+	if (sa->sa_family == AF_INET) {
+		iov[1].iov_base = &((struct sockaddr_in*) sa)->sin_addr;
+		iov[1].iov_len = 4U;
+		af = "IP4";
+	} else {
+		iov[1].iov_base = &((struct sockaddr_in6*) sa)->sin6_addr;
+		iov[1].iov_len = 16U;
+		header.a = 1;
+		af = "IP6";
+	}
+	iov[2].iov_base = SAP_MIME_TYPE;
+	iov[2].iov_len = sizeof(SAP_MIME_TYPE);
+
+	get_ip(&impl->local_addr, src_addr, sizeof(src_addr));
+	get_ip(&impl->dst_addr, dst_addr, sizeof(dst_addr));
+
+	if (is_multicast((struct sockaddr*)&impl->dst_addr, impl->dst_len) &&
+	    impl->dst_addr.ss_family == AF_INET)
+		snprintf(dst_ttl, sizeof(dst_ttl), "/%d", impl->ttl);
+	else
+		dst_ttl[0] = '\0';
+
+	snprintf(buffer, sizeof(buffer),
+			"v=0\n"
+			"o=- %u 0 IN %s %s\n"
+			"s=%s\n"
+			"c=IN %s %s%s\n"
+			"t=0 0\n"
+			"a=recvonly\n"
+			"a=tool:PipeWire %s\n"
+			"m=audio %u RTP/AVP %u\n"
+			"a=rtpmap:%u %s/%u/%u\n"
+			"a=ptime:%g\n"
+			"a=ts-refclk:local\n"
+			"a=mediaclk:direct=%u\n",
+			impl->ssrc, af, src_addr,
+			impl->session_name,
+			af, dst_addr, dst_ttl,
+			PACKAGE_VERSION,
+			impl->dst_port, impl->payload,
+			impl->payload, impl->encoding, impl->info.rate, impl->info.channels,
+			impl->ptime,
+			impl->ts_offset);
+
+	pw_log_debug("sending SAP for %u %s", impl->ssrc, buffer);
+
+	iov[3].iov_base = buffer;
+	iov[3].iov_len = strlen(buffer);
+
+	spa_zero(msg);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 4;
+
+	n = sendmsg(impl->sap_fd, &msg, MSG_NOSIGNAL);
+	if (n < 0) {
+		pw_log_warn("sendmsg() failed: %m");
+		return -errno;
+	}
+	return 0;
+}
+
+static void on_timer_event(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	send_sap(impl, false);
+}
+
+static int start_sap_announce(struct impl *impl)
+{
+	int fd, res;
+	struct timespec value, interval;
+
+	if ((fd = make_socket(&impl->src_addr, impl->src_len,
+					&impl->sap_addr, impl->sap_len,
+					impl->mcast_loop, impl->ttl, 0, impl->ifname)) < 0)
+		return fd;
+
+	impl->sap_fd = fd;
+
+	pw_log_info("starting SAP timer");
+	impl->timer = pw_loop_add_timer(impl->loop, on_timer_event, impl);
+	if (impl->timer == NULL) {
+		res = -errno;
+		pw_log_error("can't create timer source: %m");
+		return res;
+	}
+	value.tv_sec = 0;
+	value.tv_nsec = 1;
+	interval.tv_sec = SAP_INTERVAL_SEC;
+	interval.tv_nsec = 0;
+	pw_loop_update_timer(impl->loop, impl->timer, &value, &interval, false);
+
+	return 0;
+}
+
+static int setup_stream(struct impl *impl)
+{
+	const struct spa_pod *params[1];
+	struct spa_pod_builder b;
+	uint32_t n_params;
+	uint8_t buffer[1024];
+	struct pw_properties *props;
+	socklen_t len;
+	int res, fd;
+
+	props = pw_properties_copy(impl->stream_props);
+	if (props == NULL)
+		return -errno;
+
+	pw_properties_setf(props, PW_KEY_NODE_RATE, "1/%d", impl->info.rate);
+
+	/* keep the stream in a known loop so that we can reset the
+	 * ringbuffer from it */
+	impl->data_loop = pw_context_acquire_loop(impl->context, &props->dict);
+	pw_properties_set(props, PW_KEY_NODE_LOOP_NAME, impl->data_loop->name);
+
+	impl->stream = pw_stream_new(impl->core,
+			"rtp-sink playback", props);
+	if (impl->stream == NULL)
+		return -errno;
+
+	pw_stream_add_listener(impl->stream,
+			&impl->stream_listener,
+			&out_stream_events, impl);
+
+	n_params = 0;
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	params[n_params++] = spa_format_audio_raw_build(&b,
+			SPA_PARAM_EnumFormat, &impl->info);
+
+	if ((res = pw_stream_connect(impl->stream,
+			PW_DIRECTION_INPUT,
+			PW_ID_ANY,
+			PW_STREAM_FLAG_MAP_BUFFERS |
+			PW_STREAM_FLAG_AUTOCONNECT |
+			PW_STREAM_FLAG_RT_PROCESS,
+			params, n_params)) < 0)
+		return res;
+
+	if ((fd = make_socket(&impl->src_addr, impl->src_len,
+					&impl->dst_addr, impl->dst_len,
+					impl->mcast_loop, impl->ttl, impl->dscp,
+					impl->ifname)) < 0)
+		return fd;
+
+	impl->rtp_fd = fd;
+
+	/* the SDP needs a real address as the origin */
+	len = sizeof(impl->local_addr);
+	if (getsockname(fd, (struct sockaddr*)&impl->local_addr, &len) < 0)
+		impl->local_addr = impl->src_addr;
+
+	return 0;
+}
+
+static void core_error(void *data, uint32_t id, int seq, int res, const char *message)
+{
+	struct impl *impl = data;
+
+	pw_log_error("error id:%u seq:%d res:%d (%s): %s",
+			id, seq, res, spa_strerror(res), message);
+
+	if (id == PW_ID_CORE && res == -EPIPE)
+		pw_impl_module_schedule_destroy(impl->module);
+}
+
+static const struct pw_core_events core_events = {
+	PW_VERSION_CORE_EVENTS,
+	.error = core_error,
+};
+
+static void core_destroy(void *d)
+{
+	struct impl *impl = d;
+	spa_hook_remove(&impl->core_listener);
+	impl->core = NULL;
+	pw_impl_module_schedule_destroy(impl->module);
+}
+
+static const struct pw_proxy_events core_proxy_events = {
+	.destroy = core_destroy,
+};
+
+static void impl_destroy(struct impl *impl)
+{
+	if (impl->sap_fd != -1)
+		send_sap(impl, true);
+
+	if (impl->stream)
+		pw_stream_destroy(impl->stream);
+
+	if (impl->core && impl->do_disconnect)
+		pw_core_disconnect(impl->core);
+
+	if (impl->timer)
+		pw_loop_destroy_source(impl->loop, impl->timer);
+
+	if (impl->rtp_fd != -1)
+		close(impl->rtp_fd);
+	if (impl->sap_fd != -1)
+		close(impl->sap_fd);
+
+	if (impl->data_loop)
+		pw_context_release_loop(impl->context, impl->data_loop);
+
+	pw_properties_free(impl->stream_props);
+	pw_properties_free(impl->props);
+
+	free(impl->ifname);
+	free(impl->session_name);
+	free(impl);
+}
+
+static void module_destroy(void *d)
+{
+	struct impl *impl = d;
+	spa_hook_remove(&impl->module_listener);
+	impl_destroy(impl);
+}
+
+static const struct pw_impl_module_events module_events = {
+	PW_VERSION_IMPL_MODULE_EVENTS,
+	.destroy = module_destroy,
+};
+
+static inline uint32_t format_from_name(const char *name, size_t len)
+{
+	int i;
+	for (i = 0; spa_type_audio_format[i].name; i++) {
+		if (strncmp(name, spa_debug_type_short_name(spa_type_audio_format[i].name), len) == 0)
+			return spa_type_audio_format[i].type;
+	}
+	return SPA_AUDIO_FORMAT_UNKNOWN;
+}
+
+static uint32_t channel_from_name(const char *name)
+{
+	int i;
+	for (i = 0; spa_type_audio_channel[i].name; i++) {
+		if (spa_streq(name, spa_debug_type_short_name(spa_type_audio_channel[i].name)))
+			return spa_type_audio_channel[i].type;
+	}
+	return SPA_AUDIO_CHANNEL_UNKNOWN;
+}
+
+static void parse_position(struct spa_audio_info_raw *info, const char *val, size_t len)
+{
+	struct spa_json it[2];
+	char v[256];
+
+	spa_json_init(&it[0], val, len);
+	if (spa_json_enter_array(&it[0], &it[1]) <= 0)
+		spa_json_init(&it[1], val, len);
+
+	info->channels = 0;
+	while (spa_json_get_string(&it[1], v, sizeof(v)) > 0 &&
+	    info->channels < SPA_AUDIO_MAX_CHANNELS) {
+		info->position[info->channels++] = channel_from_name(v);
+	}
+}
+
+static void parse_audio_info(const struct pw_properties *props, struct spa_audio_info_raw *info)
+{
+	const char *str;
+
+	spa_zero(*info);
+	if ((str = pw_properties_get(props, PW_KEY_AUDIO_FORMAT)) == NULL)
+		str = DEFAULT_FORMAT;
+	info->format = format_from_name(str, strlen(str));
+
+	info->rate = pw_properties_get_uint32(props, PW_KEY_AUDIO_RATE, info->rate);
+	if (info->rate == 0)
+		info->rate = DEFAULT_RATE;
+
+	info->channels = pw_properties_get_uint32(props, PW_KEY_AUDIO_CHANNELS, info->channels);
+	info->channels = SPA_MIN(info->channels, SPA_AUDIO_MAX_CHANNELS);
+	if ((str = pw_properties_get(props, SPA_KEY_AUDIO_POSITION)) != NULL)
+		parse_position(info, str, strlen(str));
+	if (info->channels == 0)
+		parse_position(info, DEFAULT_POSITION, strlen(DEFAULT_POSITION));
+}
+
+static int parse_address(const char *address, uint16_t port,
+		struct sockaddr_storage *addr, socklen_t *len)
+{
+	struct sockaddr_in *sa4 = (struct sockaddr_in*)addr;
+	struct sockaddr_in6 *sa6 = (struct sockaddr_in6*)addr;
+
+	spa_zero(*addr);
+	if (inet_pton(AF_INET, address, &sa4->sin_addr) > 0) {
+		sa4->sin_family = AF_INET;
+		sa4->sin_port = htons(port);
+		*len = sizeof(*sa4);
+	} else if (inet_pton(AF_INET6, address, &sa6->sin6_addr) > 0) {
+		sa6->sin6_family = AF_INET6;
+		sa6->sin6_port = htons(port);
+		*len = sizeof(*sa6);
+	} else
+		return -EINVAL;
+
+	return 0;
+}
+
+static void copy_props(struct impl *impl, struct pw_properties *props, const char *key)
+{
+	const char *str;
+	if ((str = pw_properties_get(props, key)) != NULL) {
+		if (pw_properties_get(impl->stream_props, key) == NULL)
+			pw_properties_set(impl->stream_props, key, str);
+	}
+}
+
+SPA_EXPORT
+int pipewire__module_init(struct pw_impl_module *module, const char *args)
+{
+	struct pw_context *context = pw_impl_module_get_context(module);
+	struct impl *impl;
+	struct pw_properties *props = NULL, *stream_props = NULL;
+	uint32_t port, max_samples;
+	const char *str;
+	int res = 0;
+
+	PW_LOG_TOPIC_INIT(mod_topic);
+
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
+		return -errno;
+
+	impl->rtp_fd = -1;
+	impl->sap_fd = -1;
+
+	if (args == NULL)
+		args = "";
+
+	props = pw_properties_new_string(args);
+	if (props == NULL) {
+		res = -errno;
+		pw_log_error( "can't create properties: %m");
+		goto out;
+	}
+	impl->props = props;
+
+	stream_props = pw_properties_new(NULL, NULL);
+	if (stream_props == NULL) {
+		res = -errno;
+		pw_log_error( "can't create properties: %m");
+		goto out;
+	}
+	impl->stream_props = stream_props;
+
+	impl->module = module;
+	impl->context = context;
+	impl->loop = pw_context_get_main_loop(context);
+
+	if (pw_properties_get(props, PW_KEY_NODE_VIRTUAL) == NULL)
+		pw_properties_set(props, PW_KEY_NODE_VIRTUAL, "true");
+	if (pw_properties_get(props, PW_KEY_NODE_NETWORK) == NULL)
+		pw_properties_set(props, PW_KEY_NODE_NETWORK, "true");
+	if (pw_properties_get(props, PW_KEY_MEDIA_CLASS) == NULL)
+		pw_properties_set(props, PW_KEY_MEDIA_CLASS, "Audio/Sink");
+
+	if ((str = pw_properties_get(props, "stream.props")) != NULL)
+		pw_properties_update_string(stream_props, str, strlen(str));
+
+	copy_props(impl, props, PW_KEY_AUDIO_FORMAT);
+	copy_props(impl, props, PW_KEY_AUDIO_RATE);
+	copy_props(impl, props, PW_KEY_AUDIO_CHANNELS);
+	copy_props(impl, props, SPA_KEY_AUDIO_POSITION);
+	copy_props(impl, props, PW_KEY_NODE_NAME);
+	copy_props(impl, props, PW_KEY_NODE_DESCRIPTION);
+	copy_props(impl, props, PW_KEY_NODE_GROUP);
+	copy_props(impl, props, PW_KEY_NODE_LATENCY);
+	copy_props(impl, props, PW_KEY_NODE_VIRTUAL);
+	copy_props(impl, props, PW_KEY_NODE_NETWORK);
+	copy_props(impl, props, PW_KEY_MEDIA_CLASS);
+
+	parse_audio_info(stream_props, &impl->info);
+
+	switch (impl->info.format) {
+	case SPA_AUDIO_FORMAT_S16_BE:
+		impl->encoding = "L16";
+		break;
+	case SPA_AUDIO_FORMAT_S24_BE:
+		impl->encoding = "L24";
+		break;
+	default:
+		pw_log_error("unsupported audio format:%s, use S16BE or S24BE",
+				pw_properties_get(stream_props, PW_KEY_AUDIO_FORMAT));
+		res = -EINVAL;
+		goto out;
+	}
+	impl->frame_size = (impl->info.format == SPA_AUDIO_FORMAT_S16_BE ? 2 : 3) *
+		impl->info.channels;
+	impl->payload = RTP_PAYLOAD_TYPE;
+
+	impl->mtu = pw_properties_get_uint32(props, "net.mtu", DEFAULT_MTU);
+	impl->ttl = pw_properties_get_uint32(props, "net.ttl", DEFAULT_TTL);
+	impl->mcast_loop = pw_properties_get_bool(props, "net.loop", DEFAULT_LOOP);
+	impl->dscp = pw_properties_get_uint32(props, "net.dscp", DEFAULT_DSCP);
+
+	impl->ptime = DEFAULT_PTIME;
+	if ((str = pw_properties_get(props, "sess.ptime")) != NULL)
+		impl->ptime = strtof(str, NULL);
+	if (impl->ptime <= 0.0f) {
+		pw_log_error("invalid sess.ptime %f", impl->ptime);
+		res = -EINVAL;
+		goto out;
+	}
+	impl->psamples = (uint32_t)(impl->ptime * impl->info.rate / 1000.0f);
+	if (impl->mtu <= sizeof(struct rtp_header)) {
+		pw_log_error("invalid net.mtu %u", impl->mtu);
+		res = -EINVAL;
+		goto out;
+	}
+	max_samples = (impl->mtu - sizeof(struct rtp_header)) / impl->frame_size;
+	if (impl->psamples > max_samples) {
+		pw_log_warn("sess.ptime %f does not fit in net.mtu %u, using %u samples",
+				impl->ptime, impl->mtu, max_samples);
+		impl->psamples = max_samples;
+	}
+	impl->psamples = SPA_MAX(impl->psamples, 1u);
+	impl->ptime = impl->psamples * 1000.0f / impl->info.rate;
+
+	if ((str = pw_properties_get(props, "local.ifname")) != NULL)
+		impl->ifname = strdup(str);
+
+	if ((str = pw_properties_get(props, "sess.name")) == NULL)
+		str = DEFAULT_SESSION_NAME;
+	impl->session_name = strdup(str);
+
+	port = pw_properties_get_uint32(props, "destination.port", DEFAULT_PORT);
+	impl->dst_port = port;
+	if ((str = pw_properties_get(props, "destination.ip")) == NULL)
+		str = DEFAULT_DESTINATION_IP;
+	if ((res = parse_address(str, port, &impl->dst_addr, &impl->dst_len)) < 0) {
+		pw_log_error("invalid destination.ip %s: %s", str, spa_strerror(res));
+		goto out;
+	}
+	if ((str = pw_properties_get(props, "source.ip")) == NULL)
+		str = impl->dst_addr.ss_family == AF_INET ?
+			DEFAULT_SOURCE_IP : DEFAULT_SOURCE_IP6;
+	if ((res = parse_address(str, 0, &impl->src_addr, &impl->src_len)) < 0) {
+		pw_log_error("invalid source.ip %s: %s", str, spa_strerror(res));
+		goto out;
+	}
+
+	port = pw_properties_get_uint32(props, "sap.port", DEFAULT_SAP_PORT);
+	if ((str = pw_properties_get(props, "sap.ip")) == NULL)
+		str = DEFAULT_SAP_IP;
+	if ((res = parse_address(str, port, &impl->sap_addr, &impl->sap_len)) < 0) {
+		pw_log_error("invalid sap.ip %s: %s", str, spa_strerror(res));
+		goto out;
+	}
+	if (impl->sap_addr.ss_family != impl->src_addr.ss_family ||
+	    impl->dst_addr.ss_family != impl->src_addr.ss_family) {
+		pw_log_error("source.ip, destination.ip and sap.ip must use the same address family");
+		res = -EINVAL;
+		goto out;
+	}
+
+	pw_getrandom(&impl->ts_offset, sizeof(impl->ts_offset), 0);
+	pw_getrandom(&impl->ssrc, sizeof(impl->ssrc), 0);
+	pw_getrandom(&impl->seq, sizeof(impl->seq), 0);
+	pw_getrandom(&impl->msg_id_hash, sizeof(impl->msg_id_hash), 0);
+
+	spa_ringbuffer_init(&impl->ring);
+
+	impl->core = pw_context_get_object(impl->context, PW_TYPE_INTERFACE_Core);
+	if (impl->core == NULL) {
+		str = pw_properties_get(props, PW_KEY_REMOTE_NAME);
+		impl->core = pw_context_connect(impl->context,
+				pw_properties_new(
+					PW_KEY_REMOTE_NAME, str,
+					NULL),
+				0);
+		impl->do_disconnect = true;
+	}
+	if (impl->core == NULL) {
+		res = -errno;
+		pw_log_error("can't connect: %m");
+		goto out;
+	}
+
+	pw_proxy_add_listener((struct pw_proxy*)impl->core,
+			&impl->core_proxy_listener,
+			&core_proxy_events, impl);
+	pw_core_add_listener(impl->core,
+			&impl->core_listener,
+			&core_events, impl);
+
+	if ((res = setup_stream(impl)) < 0)
+		goto out;
+
+	if ((res = start_sap_announce(impl)) < 0)
+		goto out;
+
+	pw_log_info("sending %s/%u/%u to %s:%u, %u samples per packet",
+			impl->encoding, impl->info.rate, impl->info.channels,
+			pw_properties_get(props, "destination.ip") ? : DEFAULT_DESTINATION_IP,
+			impl->dst_port, impl->psamples);
+
+	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
+
+	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(module_props));
+
+	return 0;
+out:
+	impl_destroy(impl);
+	return res;
+}
@@ -0,0 +1,977 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "config.h"
+
+#include <spa/utils/result.h>
+#include <spa/utils/string.h>
+#include <spa/utils/json.h>
+#include <spa/utils/ringbuffer.h>
+#include <spa/utils/dll.h>
+#include <spa/debug/types.h>
+#include <spa/pod/builder.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/audio/raw.h>
+#include <spa/node/io.h>
+
+#include <pipewire/impl.h>
+#include <pipewire/i18n.h>
+#include <pipewire/private.h>
+
+#include "module-rtp/rtp.h"
+
+/** \page page_module_rtp_source PipeWire Module: RTP source
+ *
+ * The `rtp-source` module creates a PipeWire source that receives audio
+ * RTP packets in the AES67 L16 or L24 format, such as the ones sent by
+ * \ref page_module_rtp_sink.
+ *
+ * The packets are placed in a jitter buffer at the position given by their
+ * RTP timestamp. The fill level of the buffer is kept around the configured
+ * latency by adjusting the rate of the stream, so that the sender clock is
+ * followed.
+ *
+ * When `sess.driver` is enabled, the source can also drive the graph. It
+ * then wakes up the graph from a timer that is paced by the sender clock,
+ * so that the whole graph runs at the rate of the sender without
+ * resampling.
+ *
+ * ## Module Options
+ *
+ * Options specific to the behavior of this module
+ *
+ * - `source.ip =<str>`: the source IP address, default "224.0.0.56". When
+ *    this is a multicast address, the group is joined.
+ * - `source.port =<int>`: the source port, default 46000
+ * - `local.ifname = <str>`: interface name to use
+ * - `sess.latency.msec = <int>`: target network latency in milliseconds,
+ *    default 100
+ * - `sess.driver = <bool>`: drive the graph with the sender clock,
+ *    default false
+ * - `stream.props = {}`: properties to be passed to the stream
+ *
+ * ## General options
+ *
+ * Options with well-known behavior:
+ *
+ * - \ref PW_KEY_REMOTE_NAME
+ * - \ref PW_KEY_AUDIO_FORMAT
+ * - \ref PW_KEY_AUDIO_RATE
+ * - \ref PW_KEY_AUDIO_CHANNELS
+ * - \ref SPA_KEY_AUDIO_POSITION
+ * - \ref PW_KEY_NODE_NAME
+ * - \ref PW_KEY_NODE_DESCRIPTION
+ * - \ref PW_KEY_NODE_GROUP
+ * - \ref PW_KEY_NODE_LATENCY
+ * - \ref PW_KEY_NODE_VIRTUAL
+ * - \ref PW_KEY_MEDIA_CLASS
+ *
+ * The format of the session is not parsed from the SDP and needs to be
+ * given with the audio options. Only the S16BE (L16) and S24BE (L24) sample
+ * formats are supported. When not otherwise specified, a 16 bits, stereo,
+ * 48KHz stream is expected.
+ *
+ * ## Example configuration
+ *\code{.unparsed}
+ * context.modules = [
+ * {   name = libpipewire-module-rtp-source
+ *     args = {
+ *         #local.ifname = "eth0"
+ *         #source.ip = "224.0.0.56"
+ *         #source.port = 46000
+ *         #sess.latency.msec = 100
+ *         #sess.driver = false
+ *         #audio.format = "S16BE"
+ *         #audio.rate = 48000
+ *         #audio.channels = 2
+ *         #audio.position = [ FL FR ]
+ *         stream.props = {
+ *             node.name = "rtp-source"
+ *         }
+ *     }
+ * }
+ * ]
+ *\endcode
+ */
+
+#define NAME "rtp-source"
+
+PW_LOG_TOPIC_STATIC(mod_topic, "mod." NAME);
+#define PW_LOG_TOPIC_DEFAULT mod_topic
+
+#define BUFFER_SIZE		(1u<<22)
+#define BUFFER_MASK		(BUFFER_SIZE-1)
+
+#define MAX_PACKET_SIZE		65536
+
+#define DEFAULT_SOURCE_IP	"224.0.0.56"
+#define DEFAULT_SOURCE_PORT	46000
+#define DEFAULT_SESS_LATENCY	100
+#define DEFAULT_DRIVER		false
+
+#define DEFAULT_FORMAT		"S16BE"
+#define DEFAULT_RATE		48000
+#define DEFAULT_CHANNELS	2
+#define DEFAULT_POSITION	"[ FL FR ]"
+
+#define DEFAULT_QUANTUM		1024
+
+#define MODULE_USAGE	"[ remote.name=<remote> ] "				\
+			"[ source.ip=<source IP address> ] "			\
+			"[ source.port=<source port> ] "			\
+			"[ local.ifname=<local interface name to use> ] "	\
+			"[ sess.latency.msec=<target network latency in milliseconds> ] "	\
+			"[ sess.driver=<drive the graph with the sender clock> ] "	\
+			"[ audio.format=S16BE|S24BE ] "				\
+			"[ audio.rate=<sample rate> ] "				\
+			"[ audio.channels=<number of channels> ] "		\
+			"[ audio.position=<channel map> ] "			\
+			"[ stream.props=<properties> ] "
+
+static const struct spa_dict_item module_props[] = {
+	{ PW_KEY_MODULE_AUTHOR, "Wim Taymans <wim.taymans@gmail.com>" },
+	{ PW_KEY_MODULE_DESCRIPTION, "RTP Source" },
+	{ PW_KEY_MODULE_USAGE, MODULE_USAGE },
+	{ PW_KEY_MODULE_VERSION, PACKAGE_VERSION },
+};
+
+struct impl {
+	struct pw_context *context;
+
+	struct pw_impl_module *module;
+	struct spa_hook module_listener;
+	struct pw_properties *props;
+
+	struct pw_loop *data_loop;
+
+	struct pw_core *core;
+	struct spa_hook core_listener;
+	struct spa_hook core_proxy_listener;
+
+	struct pw_properties *stream_props;
+	struct pw_stream *stream;
+	struct spa_hook stream_listener;
+
+	unsigned int do_disconnect:1;
+	unsigned int driver:1;
+	unsigned int started:1;
+	unsigned int have_ssrc:1;
+	unsigned int have_seq:1;
+	unsigned int have_sync:1;
+
+	char *ifname;
+	uint32_t latency_msec;
+
+	struct sockaddr_storage src_addr;
+	socklen_t src_len;
+
+	struct spa_audio_info_raw info;
+	uint32_t frame_size;
+
+	int fd;
+	struct spa_source *source;
+	struct spa_source *timer;
+	uint64_t next_time;
+
+	struct spa_io_position *position;
+
+	uint32_t ssrc;
+	uint16_t expected_seq;
+	uint32_t target_buffer;
+
+	struct spa_dll dll;
+	float max_error;
+	double corr;
+
+	struct spa_ringbuffer ring;
+	uint8_t buffer[BUFFER_SIZE];
+
+	uint8_t packet[MAX_PACKET_SIZE];
+};
+
+static void ringbuffer_clear(uint8_t *buffer, uint32_t offset, uint32_t size)
+{
+	uint32_t l0 = SPA_MIN(size, BUFFER_SIZE - offset);
+	memset(&buffer[offset], 0, l0);
+	memset(buffer, 0, size - l0);
+}
+
+static void stream_process(void *data)
+{
+	struct impl *impl = data;
+	struct pw_buffer *buf;
+	struct spa_data *d;
+	uint32_t index, wanted;
+	int32_t avail;
+
+	if ((buf = pw_stream_dequeue_buffer(impl->stream)) == NULL) {
+		pw_log_debug("out of buffers: %m");
+		return;
+	}
+	d = &buf->buffer->datas[0];
+
+	if ((wanted = buf->requested) == 0)
+		wanted = DEFAULT_QUANTUM;
+	wanted = SPA_MIN(wanted * impl->frame_size, d->maxsize);
+	wanted -= wanted % impl->frame_size;
+
+	avail = spa_ringbuffer_get_read_index(&impl->ring, &index);
+
+	if (!impl->have_sync) {
+		memset(d->data, 0, wanted);
+	} else if (avail < (int32_t)wanted) {
+		/* the sender stopped or is too slow, wait for the next packet
+		 * and sync again */
+		pw_log_debug("underrun %d < %u", avail, wanted);
+		memset(d->data, 0, wanted);
+		impl->have_sync = false;
+	} else {
+		float error, corr;
+
+		if (avail > (int32_t)BUFFER_SIZE) {
+			pw_log_warn("overrun %d > %u", avail, BUFFER_SIZE);
+			index += avail - impl->target_buffer;
+			avail = impl->target_buffer;
+		}
+		error = (float)(avail / impl->frame_size) -
+			(float)(impl->target_buffer / impl->frame_size);
+		error = SPA_CLAMP(error, -impl->max_error, impl->max_error);
+
+		corr = spa_dll_update(&impl->dll, error);
+		impl->corr = corr;
+
+		pw_log_trace("avail:%d target:%u error:%f corr:%f", avail,
+				impl->target_buffer, error, corr);
+
+		/* when we drive the graph, the timer follows the sender */
+		if (!impl->driver || !pw_stream_is_driving(impl->stream))
+			pw_stream_set_control(impl->stream,
+					SPA_PROP_rate, 1, &corr, NULL);
+
+		spa_ringbuffer_read_data(&impl->ring,
+				impl->buffer, BUFFER_SIZE,
+				index & BUFFER_MASK,
+				d->data, wanted);
+		/* clear what we read so that lost packets play silence */
+		ringbuffer_clear(impl->buffer, index & BUFFER_MASK, wanted);
+
+		index += wanted;
+		spa_ringbuffer_read_update(&impl->ring, index);
+	}
+	d->chunk->offset = 0;
+	d->chunk->size = wanted;
+	d->chunk->stride = impl->frame_size;
+
+	pw_stream_queue_buffer(impl->stream, buf);
+}
+
+static void on_rtp_io(void *data, int fd, uint32_t mask)
+{
+	struct impl *impl = data;
+	struct rtp_header *hdr;
+	uint8_t *buffer = impl->packet;
+	ssize_t len, hlen;
+	uint32_t plen, timestamp, write, expected_write;
+	int32_t filled;
+	uint16_t seq;
+
+	if (!(mask & SPA_IO_IN))
+		return;
+
+	if ((len = recv(fd, buffer, MAX_PACKET_SIZE, 0)) < 0)
+		goto receive_error;
+
+	if (len < (ssize_t)sizeof(struct rtp_header))
+		goto short_packet;
+
+	hdr = (struct rtp_header*)buffer;
+	if (hdr->v != 2)
+		goto invalid_version;
+
+	hlen = sizeof(struct rtp_header) + hdr->cc * 4;
+	if (hlen > len)
+		goto invalid_len;
+
+	if (hdr->x) {
+		if (hlen + 4 > len)
+			goto invalid_len;
+		hlen += 4 + ((buffer[hlen + 2] << 8) | buffer[hlen + 3]) * 4;
+		if (hlen > len)
+			goto invalid_len;
+	}
+	if (hdr->p) {
+		if (hlen + buffer[len - 1] > len)
+			goto invalid_len;
+		len -= buffer[len - 1];
+	}
+
+	if (impl->have_ssrc && impl->ssrc != hdr->ssrc) {
+		pw_log_info("new SSRC %08x, resync", ntohl(hdr->ssrc));
+		impl->have_sync = false;
+		impl->have_seq = false;
+	}
+	impl->ssrc = hdr->ssrc;
+	impl->have_ssrc = true;
+
+	seq = ntohs(hdr->sequence_number);
+	if (impl->have_seq && impl->expected_seq != seq)
+		pw_log_info("unexpected seq (%d != %d)", seq, impl->expected_seq);
+	impl->expected_seq = seq + 1;
+	impl->have_seq = true;
+
+	plen = len - hlen;
+	if (plen % impl->frame_size != 0)
+		goto invalid_len;
+
+	timestamp = ntohl(hdr->timestamp);
+	/* wraps around together with the 32 bits timestamp */
+	expected_write = timestamp * impl->frame_size;
+
+	spa_ringbuffer_get_write_index(&impl->ring, &write);
+
+	if (!impl->have_sync) {
+		pw_log_info("sync to timestamp %u target:%u", timestamp,
+				impl->target_buffer / impl->frame_size);
+		memset(impl->buffer, 0, BUFFER_SIZE);
+		spa_ringbuffer_read_update(&impl->ring,
+				expected_write - impl->target_buffer);
+		write = expected_write;
+
+		spa_dll_init(&impl->dll);
+		spa_dll_set_bw(&impl->dll, SPA_DLL_BW_MIN, 128, impl->info.rate);
+		impl->corr = 1.0;
+		impl->have_sync = true;
+	}
+
+	filled = expected_write - impl->ring.readindex;
+	if (filled < 0) {
+		pw_log_debug("late packet %d", filled);
+		return;
+	}
+	if ((uint32_t)filled + plen > BUFFER_SIZE) {
+		pw_log_warn("overrun %u + %u > %u", filled, plen, BUFFER_SIZE);
+		impl->have_sync = false;
+		return;
+	}
+
+	spa_ringbuffer_write_data(&impl->ring,
+			impl->buffer, BUFFER_SIZE,
+			expected_write & BUFFER_MASK,
+			&buffer[hlen], plen);
+	expected_write += plen;
+
+	if ((int32_t)(expected_write - write) > 0)
+		spa_ringbuffer_write_update(&impl->ring, expected_write);
+
+	return;
+
+receive_error:
+	pw_log_warn("recv error: %m");
+	return;
+short_packet:
+	pw_log_warn("short packet received");
+	return;
+invalid_version:
+	pw_log_warn("invalid RTP version");
+	return;
+invalid_len:
+	pw_log_warn("invalid RTP length");
+	return;
+}
+
+static void set_timer(struct impl *impl, uint64_t time)
+{
+	struct timespec value, interval;
+
+	value.tv_sec = time / SPA_NSEC_PER_SEC;
+	value.tv_nsec = time % SPA_NSEC_PER_SEC;
+	interval.tv_sec = 0;
+	interval.tv_nsec = 0;
+	pw_loop_update_timer(impl->data_loop, impl->timer, &value, &interval, true);
+}
+
+static void on_timer_event(void *data, uint64_t expirations)
+{
+	struct impl *impl = data;
+	struct spa_io_position *pos = impl->position;
+	uint64_t duration, rate, nsec;
+
+	if (pos != NULL) {
+		duration = pos->clock.duration;
+		rate = pos->clock.rate.denom;
+	} else {
+		duration = DEFAULT_QUANTUM;
+		rate = impl->info.rate;
+	}
+	if (duration == 0 || rate == 0) {
+		duration = DEFAULT_QUANTUM;
+		rate = impl->info.rate;
+	}
+	nsec = impl->next_time;
+	/* with more data than the target, corr < 1 and we run faster */
+	impl->next_time = nsec + (uint64_t)(duration * SPA_NSEC_PER_SEC * impl->corr / rate);
+
+	set_timer(impl, impl->next_time);
+
+	/* when another driver was selected, we follow it from the process
+	 * function and the timer does nothing */
+	if (pos == NULL || !pw_stream_is_driving(impl->stream))
+		return;
+
+	pos->clock.nsec = nsec;
+	pos->clock.position += duration;
+	pos->clock.duration = duration;
+	pos->clock.rate_diff = impl->corr;
+	pos->clock.next_nsec = impl->next_time;
+
+	pw_stream_trigger_process(impl->stream);
+}
+
+static int do_start_timer(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	struct timespec now;
+
+	if (impl->timer == NULL)
+		return 0;
+
+	if (impl->started) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		impl->next_time = SPA_TIMESPEC_TO_NSEC(&now);
+		set_timer(impl, impl->next_time);
+	} else {
+		set_timer(impl, 0);
+	}
+	return 0;
+}
+
+static int do_add_sources(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+
+	impl->source = pw_loop_add_io(impl->data_loop, impl->fd,
+				SPA_IO_IN, false, on_rtp_io, impl);
+	if (impl->driver)
+		impl->timer = pw_loop_add_timer(impl->data_loop, on_timer_event, impl);
+	return 0;
+}
+
+static int do_remove_sources(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+
+	if (impl->source) {
+		pw_loop_destroy_source(impl->data_loop, impl->source);
+		impl->source = NULL;
+	}
+	if (impl->timer) {
+		pw_loop_destroy_source(impl->data_loop, impl->timer);
+		impl->timer = NULL;
+	}
+	return 0;
+}
+
+static void stream_destroy(void *d)
+{
+	struct impl *impl = d;
+	spa_hook_remove(&impl->stream_listener);
+	impl->stream = NULL;
+}
+
+static void stream_state_changed(void *data, enum pw_stream_state old,
+		enum pw_stream_state state, const char *error)
+{
+	struct impl *impl = data;
+
+	switch (state) {
+	case PW_STREAM_STATE_UNCONNECTED:
+		pw_log_info("stream disconnected, unloading");
+		pw_impl_module_schedule_destroy(impl->module);
+		break;
+	case PW_STREAM_STATE_ERROR:
+		pw_log_error("stream error: %s", error);
+		break;
+	case PW_STREAM_STATE_PAUSED:
+		impl->started = false;
+		pw_loop_invoke(impl->data_loop, do_start_timer, 0, NULL, 0, true, impl);
+		break;
+	case PW_STREAM_STATE_STREAMING:
+		impl->started = true;
+		pw_loop_invoke(impl->data_loop, do_start_timer, 0, NULL, 0, true, impl);
+		break;
+	default:
+		break;
+	}
+}
+
+static void stream_io_changed(void *data, uint32_t id, void *area, uint32_t size)
+{
+	struct impl *impl = data;
+
+	switch (id) {
+	case SPA_IO_Position:
+		impl->position = area;
+		break;
+	default:
+		break;
+	}
+}
+
+static const struct pw_stream_events in_stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.destroy = stream_destroy,
+	.state_changed = stream_state_changed,
+	.io_changed = stream_io_changed,
+	.process = stream_process
+};
+
+static int make_socket(struct sockaddr_storage *sa, socklen_t salen, const char *ifname)
+{
+	int af, fd, val, res;
+	struct ifreq req;
+
+	af = sa->ss_family;
+	if ((fd = socket(af, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+		pw_log_error("socket failed: %m");
+		return -errno;
+	}
+	val = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val)) < 0) {
+		res = -errno;
+		pw_log_error("setsockopt(SO_REUSEADDR) failed: %m");
+		goto error;
+	}
+
+	spa_zero(req);
+	if (ifname) {
+		snprintf(req.ifr_name, sizeof(req.ifr_name), "%s", ifname);
+		if (ioctl(fd, SIOCGIFINDEX, &req) < 0)
+			pw_log_warn("SIOCGIFINDEX %s failed: %m", ifname);
+	}
+	res = 0;
+	if (af == AF_INET) {
+		struct sockaddr_in *sa4 = (struct sockaddr_in*)sa;
+		if (IN_MULTICAST(ntohl(sa4->sin_addr.s_addr))) {
+			struct ip_mreqn mr4;
+			spa_zero(mr4);
+			mr4.imr_multiaddr = sa4->sin_addr;
+			mr4.imr_ifindex = req.ifr_ifindex;
+			res = setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mr4, sizeof(mr4));
+		}
+	} else if (af == AF_INET6) {
+		struct sockaddr_in6 *sa6 = (struct sockaddr_in6*)sa;
+		if (IN6_IS_ADDR_MULTICAST(&sa6->sin6_addr)) {
+			struct ipv6_mreq mr6;
+			spa_zero(mr6);
+			mr6.ipv6mr_multiaddr = sa6->sin6_addr;
+			mr6.ipv6mr_interface = req.ifr_ifindex;
+			res = setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mr6, sizeof(mr6));
+		}
+	}
+	if (res < 0) {
+		res = -errno;
+		pw_log_error("join multicast group failed: %m");
+		goto error;
+	}
+	if (bind(fd, (struct sockaddr*)sa, salen) < 0) {
+		res = -errno;
+		pw_log_error("bind() failed: %m");
+		goto error;
+	}
+	return fd;
+error:
+	close(fd);
+	return res;
+}
+
+static int setup_stream(struct impl *impl)
+{
+	const struct spa_pod *params[1];
+	struct spa_pod_builder b;
+	uint32_t n_params;
+	uint8_t buffer[1024];
+	struct pw_properties *props;
+	int res, fd;
+
+	props = pw_properties_copy(impl->stream_props);
+	if (props == NULL)
+		return -errno;
+
+	pw_properties_setf(props, PW_KEY_NODE_RATE, "1/%d", impl->info.rate);
+
+	/* receive the packets in the loop of the stream so that the
+	 * ringbuffer is only used from one thread */
+	impl->data_loop = pw_context_acquire_loop(impl->context, &props->dict);
+	pw_properties_set(props, PW_KEY_NODE_LOOP_NAME, impl->data_loop->name);
+
+	impl->stream = pw_stream_new(impl->core,
+			"rtp-source capture", props);
+	if (impl->stream == NULL)
+		return -errno;
+
+	pw_stream_add_listener(impl->stream,
+			&impl->stream_listener,
+			&in_stream_events, impl);
+
+	n_params = 0;
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	params[n_params++] = spa_format_audio_raw_build(&b,
+			SPA_PARAM_EnumFormat, &impl->info);
+
+	if ((res = pw_stream_connect(impl->stream,
+			PW_DIRECTION_OUTPUT,
+			PW_ID_ANY,
+			PW_STREAM_FLAG_MAP_BUFFERS |
+			PW_STREAM_FLAG_AUTOCONNECT |
+			PW_STREAM_FLAG_RT_PROCESS |
+			(impl->driver ? PW_STREAM_FLAG_DRIVER : 0),
+			params, n_params)) < 0)
+		return res;
+
+	if ((fd = make_socket(&impl->src_addr, impl->src_len, impl->ifname)) < 0)
+		return fd;
+
+	impl->fd = fd;
+
+	pw_loop_invoke(impl->data_loop, do_add_sources, 0, NULL, 0, true, impl);
+	if (impl->source == NULL || (impl->driver && impl->timer == NULL)) {
+		res = -errno;
+		pw_log_error("can't create sources: %m");
+		return res;
+	}
+	return 0;
+}
+
+static void core_error(void *data, uint32_t id, int seq, int res, const char *message)
+{
+	struct impl *impl = data;
+
+	pw_log_error("error id:%u seq:%d res:%d (%s): %s",
+			id, seq, res, spa_strerror(res), message);
+
+	if (id == PW_ID_CORE && res == -EPIPE)
+		pw_impl_module_schedule_destroy(impl->module);
+}
+
+static const struct pw_core_events core_events = {
+	PW_VERSION_CORE_EVENTS,
+	.error = core_error,
+};
+
+static void core_destroy(void *d)
+{
+	struct impl *impl = d;
+	spa_hook_remove(&impl->core_listener);
+	impl->core = NULL;
+	pw_impl_module_schedule_destroy(impl->module);
+}
+
+static const struct pw_proxy_events core_proxy_events = {
+	.destroy = core_destroy,
+};
+
+static void impl_destroy(struct impl *impl)
+{
+	if (impl->data_loop)
+		pw_loop_invoke(impl->data_loop, do_remove_sources, 0, NULL, 0, true, impl);
+
+	if (impl->stream)
+		pw_stream_destroy(impl->stream);
+
+	if (impl->core && impl->do_disconnect)
+		pw_core_disconnect(impl->core);
+
+	if (impl->fd != -1)
+		close(impl->fd);
+
+	if (impl->data_loop)
+		pw_context_release_loop(impl->context, impl->data_loop);
+
+	pw_properties_free(impl->stream_props);
+	pw_properties_free(impl->props);
+
+	free(impl->ifname);
+	free(impl);
+}
+
+static void module_destroy(void *d)
+{
+	struct impl *impl = d;
+	spa_hook_remove(&impl->module_listener);
+	impl_destroy(impl);
+}
+
+static const struct pw_impl_module_events module_events = {
+	PW_VERSION_IMPL_MODULE_EVENTS,
+	.destroy = module_destroy,
+};
+
+static inline uint32_t format_from_name(const char *name, size_t len)
+{
+	int i;
+	for (i = 0; spa_type_audio_format[i].name; i++) {
+		if (strncmp(name, spa_debug_type_short_name(spa_type_audio_format[i].name), len) == 0)
+			return spa_type_audio_format[i].type;
+	}
+	return SPA_AUDIO_FORMAT_UNKNOWN;
+}
+
+static uint32_t channel_from_name(const char *name)
+{
+	int i;
+	for (i = 0; spa_type_audio_channel[i].name; i++) {
+		if (spa_streq(name, spa_debug_type_short_name(spa_type_audio_channel[i].name)))
+			return spa_type_audio_channel[i].type;
+	}
+	return SPA_AUDIO_CHANNEL_UNKNOWN;
+}
+
+static void parse_position(struct spa_audio_info_raw *info, const char *val, size_t len)
+{
+	struct spa_json it[2];
+	char v[256];
+
+	spa_json_init(&it[0], val, len);
+	if (spa_json_enter_array(&it[0], &it[1]) <= 0)
+		spa_json_init(&it[1], val, len);
+
+	info->channels = 0;
+	while (spa_json_get_string(&it[1], v, sizeof(v)) > 0 &&
+	    info->channels < SPA_AUDIO_MAX_CHANNELS) {
+		info->position[info->channels++] = channel_from_name(v);
+	}
+}
+
+static void parse_audio_info(const struct pw_properties *props, struct spa_audio_info_raw *info)
+{
+	const char *str;
+
+	spa_zero(*info);
+	if ((str = pw_properties_get(props, PW_KEY_AUDIO_FORMAT)) == NULL)
+		str = DEFAULT_FORMAT;
+	info->format = format_from_name(str, strlen(str));
+
+	info->rate = pw_properties_get_uint32(props, PW_KEY_AUDIO_RATE, info->rate);
+	if (info->rate == 0)
+		info->rate = DEFAULT_RATE;
+
+	info->channels = pw_properties_get_uint32(props, PW_KEY_AUDIO_CHANNELS, info->channels);
+	info->channels = SPA_MIN(info->channels, SPA_AUDIO_MAX_CHANNELS);
+	if ((str = pw_properties_get(props, SPA_KEY_AUDIO_POSITION)) != NULL)
+		parse_position(info, str, strlen(str));
+	if (info->channels == 0)
+		parse_position(info, DEFAULT_POSITION, strlen(DEFAULT_POSITION));
+}
+
+static int parse_address(const char *address, uint16_t port,
+		struct sockaddr_storage *addr, socklen_t *len)
+{
+	struct sockaddr_in *sa4 = (struct sockaddr_in*)addr;
+	struct sockaddr_in6 *sa6 = (struct sockaddr_in6*)addr;
+
+	spa_zero(*addr);
+	if (inet_pton(AF_INET, address, &sa4->sin_addr) > 0) {
+		sa4->sin_family = AF_INET;
+		sa4->sin_port = htons(port);
+		*len = sizeof(*sa4);
+	} else if (inet_pton(AF_INET6, address, &sa6->sin6_addr) > 0) {
+		sa6->sin6_family = AF_INET6;
+		sa6->sin6_port = htons(port);
+		*len = sizeof(*sa6);
+	} else
+		return -EINVAL;
+
+	return 0;
+}
+
+static void copy_props(struct impl *impl, struct pw_properties *props, const char *key)
+{
+	const char *str;
+	if ((str = pw_properties_get(props, key)) != NULL) {
+		if (pw_properties_get(impl->stream_props, key) == NULL)
+			pw_properties_set(impl->stream_props, key, str);
+	}
+}
+
+SPA_EXPORT
+int pipewire__module_init(struct pw_impl_module *module, const char *args)
+{
+	struct pw_context *context = pw_impl_module_get_context(module);
+	struct impl *impl;
+	struct pw_properties *props = NULL, *stream_props = NULL;
+	uint32_t port;
+	const char *str;
+	int res = 0;
+
+	PW_LOG_TOPIC_INIT(mod_topic);
+
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
+		return -errno;
+
+	impl->fd = -1;
+
+	if (args == NULL)
+		args = "";
+
+	props = pw_properties_new_string(args);
+	if (props == NULL) {
+		res = -errno;
+		pw_log_error( "can't create properties: %m");
+		goto out;
+	}
+	impl->props = props;
+
+	stream_props = pw_properties_new(NULL, NULL);
+	if (stream_props == NULL) {
+		res = -errno;
+		pw_log_error( "can't create properties: %m");
+		goto out;
+	}
+	impl->stream_props = stream_props;
+
+	impl->module = module;
+	impl->context = context;
+
+	if (pw_properties_get(props, PW_KEY_NODE_VIRTUAL) == NULL)
+		pw_properties_set(props, PW_KEY_NODE_VIRTUAL, "true");
+	if (pw_properties_get(props, PW_KEY_NODE_NETWORK) == NULL)
+		pw_properties_set(props, PW_KEY_NODE_NETWORK, "true");
+	if (pw_properties_get(props, PW_KEY_MEDIA_CLASS) == NULL)
+		pw_properties_set(props, PW_KEY_MEDIA_CLASS, "Audio/Source");
+
+	if ((str = pw_properties_get(props, "stream.props")) != NULL)
+		pw_properties_update_string(stream_props, str, strlen(str));
+
+	copy_props(impl, props, PW_KEY_AUDIO_FORMAT);
+	copy_props(impl, props, PW_KEY_AUDIO_RATE);
+	copy_props(impl, props, PW_KEY_AUDIO_CHANNELS);
+	copy_props(impl, props, SPA_KEY_AUDIO_POSITION);
+	copy_props(impl, props, PW_KEY_NODE_NAME);
+	copy_props(impl, props, PW_KEY_NODE_DESCRIPTION);
+	copy_props(impl, props, PW_KEY_NODE_GROUP);
+	copy_props(impl, props, PW_KEY_NODE_LATENCY);
+	copy_props(impl, props, PW_KEY_NODE_VIRTUAL);
+	copy_props(impl, props, PW_KEY_NODE_NETWORK);
+	copy_props(impl, props, PW_KEY_MEDIA_CLASS);
+
+	parse_audio_info(stream_props, &impl->info);
+
+	switch (impl->info.format) {
+	case SPA_AUDIO_FORMAT_S16_BE:
+		impl->frame_size = 2 * impl->info.channels;
+		break;
+	case SPA_AUDIO_FORMAT_S24_BE:
+		impl->frame_size = 3 * impl->info.channels;
+		break;
+	default:
+		pw_log_error("unsupported audio format:%s, use S16BE or S24BE",
+				pw_properties_get(stream_props, PW_KEY_AUDIO_FORMAT));
+		res = -EINVAL;
+		goto out;
+	}
+
+	impl->latency_msec = pw_properties_get_uint32(props,
+			"sess.latency.msec", DEFAULT_SESS_LATENCY);
+	impl->target_buffer = impl->latency_msec * impl->info.rate / 1000 * impl->frame_size;
+	if (impl->target_buffer == 0 || impl->target_buffer > BUFFER_SIZE / 2) {
+		pw_log_error("invalid sess.latency.msec %u", impl->latency_msec);
+		res = -EINVAL;
+		goto out;
+	}
+	impl->driver = pw_properties_get_bool(props, "sess.driver", DEFAULT_DRIVER);
+
+	if ((str = pw_properties_get(props, "local.ifname")) != NULL)
+		impl->ifname = strdup(str);
+
+	port = pw_properties_get_uint32(props, "source.port", DEFAULT_SOURCE_PORT);
+	if ((str = pw_properties_get(props, "source.ip")) == NULL)
+		str = DEFAULT_SOURCE_IP;
+	if ((res = parse_address(str, port, &impl->src_addr, &impl->src_len)) < 0) {
+		pw_log_error("invalid source.ip %s: %s", str, spa_strerror(res));
+		goto out;
+	}
+
+	spa_ringbuffer_init(&impl->ring);
+	spa_dll_init(&impl->dll);
+	spa_dll_set_bw(&impl->dll, SPA_DLL_BW_MIN, 128, impl->info.rate);
+	impl->max_error = 256.0f;
+	impl->corr = 1.0;
+
+	impl->core = pw_context_get_object(impl->context, PW_TYPE_INTERFACE_Core);
+	if (impl->core == NULL) {
+		str = pw_properties_get(props, PW_KEY_REMOTE_NAME);
+		impl->core = pw_context_connect(impl->context,
+				pw_properties_new(
+					PW_KEY_REMOTE_NAME, str,
+					NULL),
+				0);
+		impl->do_disconnect = true;
+	}
+	if (impl->core == NULL) {
+		res = -errno;
+		pw_log_error("can't connect: %m");
+		goto out;
+	}
+
+	pw_proxy_add_listener((struct pw_proxy*)impl->core,
+			&impl->core_proxy_listener,
+			&core_proxy_events, impl);
+	pw_core_add_listener(impl->core,
+			&impl->core_listener,
+			&core_events, impl);
+
+	if ((res = setup_stream(impl)) < 0)
+		goto out;
+
+	pw_log_info("receiving from %s:%u latency:%ums%s",
+			pw_properties_get(props, "source.ip") ? : DEFAULT_SOURCE_IP,
+			port, impl->latency_msec, impl->driver ? " driver" : "");
+
+	pw_impl_module_add_listener(module, &impl->module_listener, &module_events, impl);
+
+	pw_impl_module_update_properties(module, &SPA_DICT_INIT_ARRAY(module_props));
+
+	return 0;
+out:
+	impl_destroy(impl);
+	return res;
+}
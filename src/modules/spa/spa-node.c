@@ -248,6 +248,12 @@ struct pw_impl_node *pw_spa_node_load(struct pw_context *context,
 		p = pw_context_get_properties(context);
 		pw_properties_set(properties, "clock.quantum-limit",
 				pw_properties_get(p, "default.clock.quantum-limit"));
+
+		if (pw_properties_get(properties, PW_KEY_NODE_LOOP_NAME) == NULL) {
+			struct pw_loop *loop = pw_context_acquire_loop(context, &properties->dict);
+			pw_properties_set(properties, PW_KEY_NODE_LOOP_NAME, loop->name);
+			pw_context_release_loop(context, loop);
+		}
 	}
 
 	handle = pw_context_load_spa_handle(context,
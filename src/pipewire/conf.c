@@ -28,13 +28,13 @@
 #include <getopt.h>
 #include <limits.h>
 #include <sys/stat.h>
-#include <sys/mman.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <dirent.h>
 #include <regex.h>
+#include <pthread.h>
 #ifdef HAVE_PWD_H
 #include <pwd.h>
 #endif
@@ -45,6 +45,7 @@
 #include <spa/utils/result.h>
 #include <spa/utils/string.h>
 #include <spa/utils/json.h>
+#include <spa/utils/json-dom.h>
 
 #include <pipewire/impl.h>
 #include <pipewire/private.h>
@@ -394,23 +395,200 @@ error:
 	return res;
 }
 
+/* the parsed config files, shared by all contexts of the process. A file
+ * is parsed again only when it changed on disk. */
+struct conf_file {
+	struct spa_list link;
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	char *data;
+	struct spa_json_dom dom;
+	int ref;
+};
+
+static pthread_mutex_t conf_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct spa_list conf_cache = SPA_LIST_INIT(&conf_cache);
+
+static void conf_file_unref(struct conf_file *f)
+{
+	if (--f->ref > 0)
+		return;
+	spa_json_dom_clear(&f->dom);
+	free(f->data);
+	free(f->path);
+	free(f);
+}
+
+/* the file stays alive while a section of it is being parsed */
+static void conf_file_remove(struct conf_file *f)
+{
+	spa_list_remove(&f->link);
+	conf_file_unref(f);
+}
+
+static struct conf_file *conf_file_new(const char *path, int fd, const struct stat *sbuf)
+{
+	struct conf_file *f;
+	size_t offset = 0;
+	int res;
+
+	if ((f = calloc(1, sizeof(*f))) == NULL)
+		return NULL;
+
+	f->ref = 1;
+	f->dev = sbuf->st_dev;
+	f->ino = sbuf->st_ino;
+	f->size = sbuf->st_size;
+	f->mtime = sbuf->st_mtim;
+
+	if ((f->path = strdup(path)) == NULL ||
+	    (f->data = malloc(f->size + 1)) == NULL)
+		goto error;
+
+	while (offset < (size_t)f->size) {
+		ssize_t r = read(fd, f->data + offset, f->size - offset);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			goto error;
+		}
+		if (r == 0)
+			break;
+		offset += r;
+	}
+	f->size = offset;
+	f->data[offset] = '\0';
+
+	if ((res = spa_json_dom_parse(&f->dom, f->data, f->size)) < 0) {
+		errno = -res;
+		goto error;
+	}
+	return f;
+error:
+	res = -errno;
+	conf_file_unref(f);
+	errno = -res;
+	return NULL;
+}
+
+static struct conf_file *conf_file_get(const char *path, int fd, const struct stat *sbuf)
+{
+	struct conf_file *f;
+
+	spa_list_for_each(f, &conf_cache, link) {
+		if (!spa_streq(f->path, path))
+			continue;
+		if (f->dev == sbuf->st_dev && f->ino == sbuf->st_ino &&
+		    f->size == sbuf->st_size &&
+		    f->mtime.tv_sec == sbuf->st_mtim.tv_sec &&
+		    f->mtime.tv_nsec == sbuf->st_mtim.tv_nsec)
+			return f;
+		conf_file_remove(f);
+		break;
+	}
+	if ((f = conf_file_new(path, fd, sbuf)) == NULL)
+		return NULL;
+
+	spa_list_append(&conf_cache, &f->link);
+	return f;
+}
+
+void pw_conf_clear_cache(void)
+{
+	struct conf_file *f;
+
+	pthread_mutex_lock(&conf_cache_lock);
+	spa_list_consume(f, &conf_cache, link)
+		conf_file_remove(f);
+	pthread_mutex_unlock(&conf_cache_lock);
+}
+
+/* a newly allocated copy of the value of node, strings are unescaped and
+ * containers are copied as is */
+static char *dom_node_dup(const struct spa_json_dom *dom, const struct spa_json_node *node)
+{
+	char *val;
+
+	if (node->type == SPA_JSON_DOM_NULL)
+		return NULL;
+	if ((val = malloc(node->len + 1)) != NULL)
+		spa_json_dom_get_string(dom, node, val, node->len + 1);
+	return val;
+}
+
+static char *dom_member_dup(const struct spa_json_dom *dom,
+		const struct spa_json_node *object, const char *key)
+{
+	const struct spa_json_node *n = spa_json_dom_lookup(dom, object, key);
+	return n ? dom_node_dup(dom, n) : NULL;
+}
+
+/* find the node of a section in the cached file at path. The section is only
+ * used when it is still the same as str, the value that was copied into the
+ * config. A reference is taken on the file. */
+static struct conf_file *conf_file_find_section(const char *path, const char *section,
+		const char *str, size_t len, const struct spa_json_node **node)
+{
+	const struct spa_json_node *root, *n;
+	struct conf_file *f, *res = NULL;
+
+	pthread_mutex_lock(&conf_cache_lock);
+	spa_list_for_each(f, &conf_cache, link) {
+		if (!spa_streq(f->path, path))
+			continue;
+		root = spa_json_dom_root(&f->dom);
+		if (root != NULL && root->type == SPA_JSON_DOM_OBJECT &&
+		    (n = spa_json_dom_lookup(&f->dom, root, section)) != NULL &&
+		    n->len == len && memcmp(f->data + n->offset, str, len) == 0) {
+			f->ref++;
+			*node = n;
+			res = f;
+		}
+		break;
+	}
+	pthread_mutex_unlock(&conf_cache_lock);
+	return res;
+}
+
+static void conf_file_release(struct conf_file *f)
+{
+	pthread_mutex_lock(&conf_cache_lock);
+	conf_file_unref(f);
+	pthread_mutex_unlock(&conf_cache_lock);
+}
+
 static int conf_load(const char *path, struct pw_properties *conf)
 {
-	char *data;
+	const struct spa_json_node *root, *n;
+	struct conf_file *f;
 	struct stat sbuf;
-	int fd, count;
+	int fd, count = 0;
 
 	if ((fd = open(path,  O_CLOEXEC | O_RDONLY)) < 0)
 		goto error;
 
 	if (fstat(fd, &sbuf) < 0)
 		goto error_close;
-	if ((data = mmap(NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+
+	pthread_mutex_lock(&conf_cache_lock);
+	if ((f = conf_file_get(path, fd, &sbuf)) == NULL) {
+		pthread_mutex_unlock(&conf_cache_lock);
 		goto error_close;
+	}
 	close(fd);
 
-	count = pw_properties_update_string(conf, data, sbuf.st_size);
-	munmap(data, sbuf.st_size);
+	root = spa_json_dom_root(&f->dom);
+	if (root->type == SPA_JSON_DOM_OBJECT) {
+		spa_json_dom_for_each(&f->dom, root, n) {
+			char *val = dom_node_dup(&f->dom, n);
+			count += pw_properties_set(conf, spa_json_dom_key(&f->dom, n), val);
+			free(val);
+		}
+	}
+	pthread_mutex_unlock(&conf_cache_lock);
 
 	pw_log_info("%p: loaded config '%s' with %d items", conf, path, count);
 
@@ -521,31 +699,36 @@ struct data {
 	struct pw_context *context;
 	struct pw_properties *props;
 	int count;
+	int (*parse) (struct data *d, const struct spa_json_dom *dom,
+			const struct spa_json_node *root);
 };
 
 /* context.spa-libs = {
  *  <factory-name regex> = <library-name>
  * }
  */
-static int parse_spa_libs(void *user_data, const char *location,
-		const char *section, const char *str, size_t len)
+static int parse_spa_libs(struct data *d, const struct spa_json_dom *dom,
+		const struct spa_json_node *root)
 {
-	struct data *d = user_data;
 	struct pw_context *context = d->context;
-	struct spa_json it[2];
-	char key[512], value[512];
+	const struct spa_json_node *n;
 
-	spa_json_init(&it[0], str, len);
-	if (spa_json_enter_object(&it[0], &it[1]) < 0) {
+	/* a config section that is not a container is parsed as the
+	 * members of an object, only accept a real object here */
+	if (root == NULL ||
+	    !spa_json_is_object(dom->data + root->offset, root->len)) {
 		pw_log_error("config file error: context.spa-libs is not an object");
 		return -EINVAL;
 	}
 
-	while (spa_json_get_string(&it[1], key, sizeof(key)) > 0) {
-		if (spa_json_get_string(&it[1], value, sizeof(value)) > 0) {
-			pw_context_add_spa_lib(context, key, value);
-			d->count++;
-		}
+	spa_json_dom_for_each(dom, root, n) {
+		char *value;
+
+		if ((value = dom_node_dup(dom, n)) == NULL)
+			continue;
+		pw_context_add_spa_lib(context, spa_json_dom_key(dom, n), value);
+		free(value);
+		d->count++;
 	}
 	return 0;
 }
@@ -578,59 +761,39 @@ static int load_module(struct pw_context *context, const char *key, const char *
  *   }
  * ]
  */
-static int parse_modules(void *user_data, const char *location,
-		const char *section, const char *str, size_t len)
+static int parse_modules(struct data *d, const struct spa_json_dom *dom,
+		const struct spa_json_node *root)
 {
-	struct data *d = user_data;
 	struct pw_context *context = d->context;
-	struct spa_json it[3];
-	char key[512], *s;
+	const struct spa_json_node *n;
 	int res = 0;
 
-	s = strndup(str, len);
-	spa_json_init(&it[0], s, len);
-	if (spa_json_enter_array(&it[0], &it[1]) < 0) {
+	if (root == NULL || root->type != SPA_JSON_DOM_ARRAY) {
 		pw_log_error("config file error: context.modules is not an array");
-		res = -EINVAL;
-		goto exit;
+		return -EINVAL;
 	}
 
-	while (spa_json_enter_object(&it[1], &it[2]) > 0) {
-		char *name = NULL, *args = NULL, *flags = NULL;
-
-		while (spa_json_get_string(&it[2], key, sizeof(key)) > 0) {
-			const char *val;
-			int len;
+	spa_json_dom_for_each(dom, root, n) {
+		char *name, *args, *flags;
 
-			if ((len = spa_json_next(&it[2], &val)) <= 0)
-				break;
+		if (n->type != SPA_JSON_DOM_OBJECT)
+			break;
 
-			if (spa_streq(key, "name")) {
-				name = (char*)val;
-				spa_json_parse_stringn(val, len, name, len+1);
-			} else if (spa_streq(key, "args")) {
-				if (spa_json_is_container(val, len))
-					len = spa_json_container_len(&it[2], val, len);
-
-				args = (char*)val;
-				spa_json_parse_stringn(val, len, args, len+1);
-			} else if (spa_streq(key, "flags")) {
-				if (spa_json_is_container(val, len))
-					len = spa_json_container_len(&it[2], val, len);
-				flags = (char*)val;
-				spa_json_parse_stringn(val, len, flags, len+1);
-			}
-		}
+		name = dom_member_dup(dom, n, "name");
+		args = dom_member_dup(dom, n, "args");
+		flags = dom_member_dup(dom, n, "flags");
 		if (name != NULL)
 			res = load_module(context, name, args, flags);
 
+		free(name);
+		free(args);
+		free(flags);
+
 		if (res < 0)
 			break;
 
 		d->count++;
 	}
-exit:
-	free(s);
 	return res;
 }
 
@@ -669,59 +832,39 @@ static int create_object(struct pw_context *context, const char *key, const char
  *   }
  * ]
  */
-static int parse_objects(void *user_data, const char *location,
-		const char *section, const char *str, size_t len)
+static int parse_objects(struct data *d, const struct spa_json_dom *dom,
+		const struct spa_json_node *root)
 {
-	struct data *d = user_data;
 	struct pw_context *context = d->context;
-	struct spa_json it[3];
-	char key[512], *s;
+	const struct spa_json_node *n;
 	int res = 0;
 
-	s = strndup(str, len);
-	spa_json_init(&it[0], s, len);
-	if (spa_json_enter_array(&it[0], &it[1]) < 0) {
+	if (root == NULL || root->type != SPA_JSON_DOM_ARRAY) {
 		pw_log_error("config file error: context.objects is not an array");
-		res = -EINVAL;
-		goto exit;
+		return -EINVAL;
 	}
 
-	while (spa_json_enter_object(&it[1], &it[2]) > 0) {
-		char *factory = NULL, *args = NULL, *flags = NULL;
-
-		while (spa_json_get_string(&it[2], key, sizeof(key)) > 0) {
-			const char *val;
-			int len;
+	spa_json_dom_for_each(dom, root, n) {
+		char *factory, *args, *flags;
 
-			if ((len = spa_json_next(&it[2], &val)) <= 0)
-				break;
+		if (n->type != SPA_JSON_DOM_OBJECT)
+			break;
 
-			if (spa_streq(key, "factory")) {
-				factory = (char*)val;
-				spa_json_parse_stringn(val, len, factory, len+1);
-			} else if (spa_streq(key, "args")) {
-				if (spa_json_is_container(val, len))
-					len = spa_json_container_len(&it[2], val, len);
-
-				args = (char*)val;
-				spa_json_parse_stringn(val, len, args, len+1);
-			} else if (spa_streq(key, "flags")) {
-				if (spa_json_is_container(val, len))
-					len = spa_json_container_len(&it[2], val, len);
-
-				flags = (char*)val;
-				spa_json_parse_stringn(val, len, flags, len+1);
-			}
-		}
+		factory = dom_member_dup(dom, n, "factory");
+		args = dom_member_dup(dom, n, "args");
+		flags = dom_member_dup(dom, n, "flags");
 		if (factory != NULL)
 			res = create_object(context, factory, args, flags);
 
+		free(factory);
+		free(args);
+		free(flags);
+
 		if (res < 0)
 			break;
+
 		d->count++;
 	}
-exit:
-	free(s);
 	return res;
 }
 
@@ -778,51 +921,37 @@ static int do_exec(struct pw_context *context, const char *key, const char *args
  *   }
  * ]
  */
-static int parse_exec(void *user_data, const char *location,
-		const char *section, const char *str, size_t len)
+static int parse_exec(struct data *d, const struct spa_json_dom *dom,
+		const struct spa_json_node *root)
 {
-	struct data *d = user_data;
 	struct pw_context *context = d->context;
-	struct spa_json it[3];
-	char key[512], *s;
+	const struct spa_json_node *n;
 	int res = 0;
 
-	s = strndup(str, len);
-	spa_json_init(&it[0], s, len);
-	if (spa_json_enter_array(&it[0], &it[1]) < 0) {
+	if (root == NULL || root->type != SPA_JSON_DOM_ARRAY) {
 		pw_log_error("config file error: context.exec is not an array");
-		res = -EINVAL;
-		goto exit;
+		return -EINVAL;
 	}
 
-	while (spa_json_enter_object(&it[1], &it[2]) > 0) {
-		char *path = NULL, *args = NULL;
+	spa_json_dom_for_each(dom, root, n) {
+		char *path, *args;
 
-		while (spa_json_get_string(&it[2], key, sizeof(key)) > 0) {
-			const char *val;
-			int len;
-
-			if ((len = spa_json_next(&it[2], &val)) <= 0)
-				break;
+		if (n->type != SPA_JSON_DOM_OBJECT)
+			break;
 
-			if (spa_streq(key, "path")) {
-				path = (char*)val;
-				spa_json_parse_stringn(val, len, path, len+1);
-			} else if (spa_streq(key, "args")) {
-				args = (char*)val;
-				spa_json_parse_stringn(val, len, args, len+1);
-			}
-		}
+		path = dom_member_dup(dom, n, "path");
+		args = dom_member_dup(dom, n, "args");
 		if (path != NULL)
 			res = do_exec(context, path, args);
 
+		free(path);
+		free(args);
+
 		if (res < 0)
 			break;
 
 		d->count++;
 	}
-exit:
-	free(s);
 	return res;
 }
 
@@ -858,6 +987,31 @@ int pw_context_conf_section_for_each(struct pw_context *context, const char *sec
 	return res;
 }
 
+/* walk the nodes of the section in the cached config file when it is still
+ * the same, only parse the string again when the section did not come from
+ * a cached file */
+static int parse_section(void *user_data, const char *location,
+		const char *section, const char *str, size_t len)
+{
+	struct data *d = user_data;
+	struct spa_json_dom dom = { 0 };
+	const struct spa_json_node *root;
+	struct conf_file *f;
+	int res;
+
+	if (location != NULL &&
+	    (f = conf_file_find_section(location, section, str, len, &root)) != NULL) {
+		res = d->parse(d, &f->dom, root);
+		conf_file_release(f);
+		return res;
+	}
+
+	root = spa_json_dom_parse(&dom, str, len) < 0 ? NULL : spa_json_dom_root(&dom);
+	res = d->parse(d, &dom, root);
+	spa_json_dom_clear(&dom);
+	return res;
+}
+
 SPA_EXPORT
 int pw_context_parse_conf_section(struct pw_context *context,
 		struct pw_properties *conf, const char *section)
@@ -866,19 +1020,18 @@ int pw_context_parse_conf_section(struct pw_context *context,
 	int res;
 
 	if (spa_streq(section, "context.spa-libs"))
-		res = pw_context_conf_section_for_each(context, section,
-				parse_spa_libs, &data);
+		data.parse = parse_spa_libs;
 	else if (spa_streq(section, "context.modules"))
-		res = pw_context_conf_section_for_each(context, section,
-				parse_modules, &data);
+		data.parse = parse_modules;
 	else if (spa_streq(section, "context.objects"))
-		res = pw_context_conf_section_for_each(context, section,
-				parse_objects, &data);
+		data.parse = parse_objects;
 	else if (spa_streq(section, "context.exec"))
-		res = pw_context_conf_section_for_each(context, section,
-				parse_exec, &data);
+		data.parse = parse_exec;
 	else
-		res = -EINVAL;
+		return -EINVAL;
+
+	res = pw_context_conf_section_for_each(context, section,
+			parse_section, &data);
 
 	return res == 0 ? data.count : res;
 }
@@ -911,12 +1064,129 @@ int pw_context_conf_update_props(struct pw_context *context,
 }
 
 struct match {
+	struct pw_context *context;
 	const struct spa_dict *props;
 	int (*matched) (void *data, const char *location, const char *action,
 			const char *val, size_t len);
 	void *data;
 };
 
+/* a key = value condition, the value can be null or a regex */
+struct match_value {
+	const char *key;
+	char *value;
+	regex_t regex;
+	unsigned int is_null:1;
+	unsigned int is_regex:1;
+	unsigned int regex_valid:1;
+};
+
+/* all values in an item need to match */
+struct match_item {
+	uint32_t n_values;
+	struct match_value *values;
+};
+
+struct match_action {
+	const char *key;
+	const char *val;		/* points into the rules source */
+	size_t len;
+};
+
+struct match_rule {
+	struct pw_array items;		/* struct match_item */
+	struct pw_array actions;	/* struct match_action */
+};
+
+/* the compiled rules of one config section, the rules are reused as
+ * long as the source string is unchanged. At most MAX_CONF_RULES are kept
+ * per context, the least recently used ones are dropped first. */
+#define MAX_CONF_RULES	32
+
+struct conf_rules {
+	struct spa_list link;
+	int ref;
+	const char *origin;		/* the config string the rules were compiled from */
+	char *location;
+	char *src;
+	size_t len;
+	struct pw_array rules;		/* struct match_rule */
+	struct pw_array keys;		/* interned keys */
+};
+
+static const char *intern_key(struct conf_rules *r, const char *key)
+{
+	char **k;
+	pw_array_for_each(k, &r->keys) {
+		if (spa_streq(*k, key))
+			return *k;
+	}
+	if ((k = pw_array_add(&r->keys, sizeof(char*))) == NULL)
+		return NULL;
+	if ((*k = strdup(key)) == NULL) {
+		pw_array_remove(&r->keys, k);
+		return NULL;
+	}
+	return *k;
+}
+
+static void match_item_clear(struct match_item *item)
+{
+	uint32_t i;
+	for (i = 0; i < item->n_values; i++) {
+		struct match_value *v = &item->values[i];
+		if (v->regex_valid)
+			regfree(&v->regex);
+		free(v->value);
+	}
+	free(item->values);
+}
+
+static void conf_rules_free(struct conf_rules *r)
+{
+	struct match_rule *rule;
+	struct match_item *item;
+	char **k;
+
+	pw_array_for_each(rule, &r->rules) {
+		pw_array_for_each(item, &rule->items)
+			match_item_clear(item);
+		pw_array_clear(&rule->items);
+		pw_array_clear(&rule->actions);
+	}
+	pw_array_clear(&r->rules);
+	pw_array_for_each(k, &r->keys)
+		free(*k);
+	pw_array_clear(&r->keys);
+	free(r->location);
+	free(r->src);
+	free(r);
+}
+
+/* protects the conf_rules list of all contexts and the refcounts */
+static pthread_mutex_t conf_rules_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the rules stay alive while they are being matched */
+static void conf_rules_unref(struct conf_rules *r)
+{
+	if (--r->ref > 0)
+		return;
+	conf_rules_free(r);
+}
+
+static void conf_rules_remove(struct conf_rules *r)
+{
+	spa_list_remove(&r->link);
+	conf_rules_unref(r);
+}
+
+static void conf_rules_release(struct conf_rules *r)
+{
+	pthread_mutex_lock(&conf_rules_lock);
+	conf_rules_unref(r);
+	pthread_mutex_unlock(&conf_rules_lock);
+}
+
 /*
  * {
  *     # all keys must match the value. ~ in value starts regex.
@@ -924,56 +1194,56 @@ struct match {
  *     ...
  * }
  */
-static bool find_match(struct spa_json *arr, const struct spa_dict *props)
+static int compile_match(struct conf_rules *r, struct spa_json *arr, struct pw_array *items)
 {
 	struct spa_json it[1];
 
 	while (spa_json_enter_object(arr, &it[0]) > 0) {
 		char key[256], val[1024];
-		const char *str, *value;
-		int match = 0, fail = 0;
+		struct match_item *item;
+		struct match_value *v, *values = NULL;
+		uint32_t n_values = 0;
+		const char *value;
 		int len;
 
 		while (spa_json_get_string(&it[0], key, sizeof(key)) > 0) {
-			bool success = false;
+			struct match_value mv;
 
 			if ((len = spa_json_next(&it[0], &value)) <= 0)
 				break;
 
-			str = spa_dict_lookup(props, key);
-
+			spa_zero(mv);
 			if (spa_json_is_null(value, len)) {
-				success = str == NULL;
+				mv.is_null = true;
 			} else {
 				if (spa_json_parse_stringn(value, len, val, sizeof(val)) < 0)
 					continue;
-				value = val;
-				len = strlen(val);
-			}
-			if (str != NULL) {
-				if (value[0] == '~') {
-					regex_t preg;
-					if (regcomp(&preg, value+1, REG_EXTENDED | REG_NOSUB) == 0) {
-						if (regexec(&preg, str, 0, NULL, 0) == 0)
-							success = true;
-						regfree(&preg);
-					}
-				} else if (strncmp(str, value, len) == 0 &&
-				    strlen(str) == (size_t)len) {
-					success = true;
+				if ((mv.value = strdup(val)) == NULL)
+					goto error;
+				if (val[0] == '~') {
+					mv.is_regex = true;
+					mv.regex_valid = regcomp(&mv.regex, val+1,
+							REG_EXTENDED | REG_NOSUB) == 0;
 				}
 			}
-			if (success) {
-				match++;
-				pw_log_debug("'%s' match '%s' < > '%.*s'", key, str, len, value);
+			if ((mv.key = intern_key(r, key)) == NULL ||
+			    (v = reallocarray(values, n_values + 1, sizeof(*v))) == NULL) {
+				match_item_clear(&(struct match_item) { 1, &mv });
+				goto error;
 			}
-			else
-				fail++;
+			values = v;
+			values[n_values++] = mv;
 		}
-		if (match > 0 && fail == 0)
-			return true;
+		if ((item = pw_array_add(items, sizeof(*item))) == NULL)
+			goto error;
+		item->n_values = n_values;
+		item->values = values;
+		continue;
+error:
+		match_item_clear(&(struct match_item) { n_values, values });
+		return -errno;
 	}
-	return false;
+	return 0;
 }
 
 /**
@@ -996,42 +1266,67 @@ static bool find_match(struct spa_json *arr, const struct spa_dict *props)
  *     }
  * ]
  */
-static int match_rules(void *data, const char *location, const char *section,
-		const char *str, size_t len)
+static struct conf_rules *compile_rules(const char *location, const char *str, size_t len)
 {
-	struct match *match = data;
-	const struct spa_dict *props = match->props;
+	struct conf_rules *r;
 	const char *val;
 	struct spa_json it[4], actions;
+	int res;
+
+	if ((r = calloc(1, sizeof(*r))) == NULL)
+		return NULL;
 
-	spa_json_init(&it[0], str, len);
+	pw_array_init(&r->rules, 4 * sizeof(struct match_rule));
+	pw_array_init(&r->keys, 8 * sizeof(char*));
+	r->ref = 1;
+	r->origin = str;
+	r->len = len;
+	if ((r->src = strndup(str, len)) == NULL)
+		goto error;
+	if (location != NULL && (r->location = strdup(location)) == NULL)
+		goto error;
+
+	spa_json_init(&it[0], r->src, len);
 	if (spa_json_enter_array(&it[0], &it[1]) < 0)
-		return 0;
+		return r;
 
 	while (spa_json_enter_object(&it[1], &it[2]) > 0) {
 		char key[64];
-		bool have_match = false, have_actions = false;
+		struct match_rule *rule;
+		bool have_actions = false;
+
+		if ((rule = pw_array_add(&r->rules, sizeof(*rule))) == NULL)
+			goto error;
+		pw_array_init(&rule->items, 4 * sizeof(struct match_item));
+		pw_array_init(&rule->actions, 4 * sizeof(struct match_action));
 
 		while (spa_json_get_string(&it[2], key, sizeof(key)) > 0) {
 			if (spa_streq(key, "matches")) {
+				struct match_item *item;
+
 				if (spa_json_enter_array(&it[2], &it[3]) < 0)
 					break;
 
-				have_match = find_match(&it[3], props);
+				pw_array_for_each(item, &rule->items)
+					match_item_clear(item);
+				pw_array_reset(&rule->items);
+
+				if ((res = compile_match(r, &it[3], &rule->items)) < 0)
+					goto error_errno;
 			}
 			else if (spa_streq(key, "actions")) {
 				if (spa_json_enter_object(&it[2], &actions) > 0)
 					have_actions = true;
 			}
 			else if (spa_json_next(&it[2], &val) <= 0)
-                                break;
+				break;
 		}
-		if (!have_match || !have_actions)
+		if (!have_actions)
 			continue;
 
 		while (spa_json_get_string(&actions, key, sizeof(key)) > 0) {
-			int res, len;
-			pw_log_debug("action %s", key);
+			struct match_action *a;
+			int len;
 
 			if ((len = spa_json_next(&actions, &val)) <= 0)
 				break;
@@ -1039,11 +1334,140 @@ static int match_rules(void *data, const char *location, const char *section,
 			if (spa_json_is_container(val, len))
 				len = spa_json_container_len(&actions, val, len);
 
-			if ((res = match->matched(match->data, location, key, val, len)) < 0)
-				return res;
+			if ((a = pw_array_add(&rule->actions, sizeof(*a))) == NULL)
+				goto error;
+			a->key = intern_key(r, key);
+			a->val = val;
+			a->len = len;
+			if (a->key == NULL)
+				goto error;
 		}
 	}
-	return 0;
+	return r;
+
+error:
+	res = -errno;
+error_errno:
+	conf_rules_free(r);
+	errno = -res;
+	return NULL;
+}
+
+/* find or compile the rules for str, a reference is taken on the rules */
+static struct conf_rules *find_rules(struct pw_context *context, const char *location,
+		const char *str, size_t len)
+{
+	struct conf_rules *r, *t;
+	uint32_t n_rules = 0;
+
+	pthread_mutex_lock(&conf_rules_lock);
+	spa_list_for_each_safe(r, t, &context->conf_rules, link) {
+		if (r->origin != str) {
+			n_rules++;
+			continue;
+		}
+		if (r->len == len && memcmp(r->src, str, len) == 0 &&
+		    spa_streq(r->location, location)) {
+			/* move to the end, the first rules are evicted first */
+			spa_list_remove(&r->link);
+			spa_list_append(&context->conf_rules, &r->link);
+			goto done;
+		}
+		/* the config changed, recompile */
+		conf_rules_remove(r);
+	}
+	if ((r = compile_rules(location, str, len)) == NULL) {
+		pthread_mutex_unlock(&conf_rules_lock);
+		return NULL;
+	}
+	pw_log_debug("%p: compiled %zd rules from %s", context,
+			pw_array_get_len(&r->rules, struct match_rule),
+			location ? location : "<none>");
+
+	for (; n_rules >= MAX_CONF_RULES; n_rules--)
+		conf_rules_remove(spa_list_first(&context->conf_rules, struct conf_rules, link));
+
+	spa_list_append(&context->conf_rules, &r->link);
+done:
+	r->ref++;
+	pthread_mutex_unlock(&conf_rules_lock);
+	return r;
+}
+
+void pw_context_conf_clear_rules(struct pw_context *context)
+{
+	struct conf_rules *r;
+
+	pthread_mutex_lock(&conf_rules_lock);
+	spa_list_consume(r, &context->conf_rules, link)
+		conf_rules_remove(r);
+	pthread_mutex_unlock(&conf_rules_lock);
+}
+
+static bool match_item(const struct match_item *item, const struct spa_dict *props)
+{
+	int match = 0, fail = 0;
+	uint32_t i;
+
+	for (i = 0; i < item->n_values; i++) {
+		const struct match_value *v = &item->values[i];
+		const char *str = spa_dict_lookup(props, v->key);
+		bool success = false;
+
+		if (v->is_null)
+			success = str == NULL;
+		else if (str != NULL) {
+			if (v->is_regex)
+				success = v->regex_valid &&
+					regexec(&v->regex, str, 0, NULL, 0) == 0;
+			else
+				success = spa_streq(str, v->value);
+		}
+		if (success) {
+			match++;
+			pw_log_debug("'%s' match '%s' < > '%s'", v->key, str, v->value);
+		}
+		else
+			fail++;
+	}
+	return match > 0 && fail == 0;
+}
+
+static int match_rules(void *data, const char *location, const char *section,
+		const char *str, size_t len)
+{
+	struct match *match = data;
+	const struct spa_dict *props = match->props;
+	struct conf_rules *r;
+	struct match_rule *rule;
+	int res = 0;
+
+	if ((r = find_rules(match->context, location, str, len)) == NULL)
+		return -errno;
+
+	pw_array_for_each(rule, &r->rules) {
+		struct match_item *item;
+		struct match_action *a;
+		bool have_match = false;
+
+		pw_array_for_each(item, &rule->items) {
+			if ((have_match = match_item(item, props)))
+				break;
+		}
+		if (!have_match)
+			continue;
+
+		pw_array_for_each(a, &rule->actions) {
+			pw_log_debug("action %s", a->key);
+
+			if ((res = match->matched(match->data, location, a->key, a->val, a->len)) < 0)
+				goto done;
+		}
+	}
+	res = 0;
+done:
+	conf_rules_release(r);
+	return res;
 }
 
 SPA_EXPORT
@@ -1054,6 +1478,7 @@ int pw_context_conf_section_match_rules(struct pw_context *context, const char *
 		void *data)
 {
 	struct match match = {
+		.context = context,
 		.props = props,
 		.matched = callback,
 		.data = data };
@@ -52,12 +52,23 @@ PW_LOG_TOPIC_EXTERN(log_context);
 #define PW_LOG_TOPIC_DEFAULT log_context
 
 /** \cond */
+#define MAX_DATA_LOOPS	64
+
+struct data_loop {
+	struct pw_data_loop *impl;
+	int ref;
+	struct spa_hook_list driver_listener_list;
+};
+
 struct impl {
 	struct pw_context this;
 	struct spa_handle *dbus_handle;
 	struct spa_plugin_loader plugin_loader;
 	unsigned int recalc:1;
 	unsigned int recalc_pending:1;
+
+	struct data_loop data_loops[MAX_DATA_LOOPS];
+	uint32_t n_data_loops;
 };
 
 
@@ -123,24 +134,30 @@ static int try_load_conf(struct pw_context *this, const char *conf_prefix,
 
 static int context_set_freewheel(struct pw_context *context, bool freewheel)
 {
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
 	struct spa_thread *thr;
+	uint32_t i;
 	int res = 0;
 
-	if ((thr = pw_data_loop_get_thread(context->data_loop_impl)) == NULL)
-		return -EIO;
-
-	if (freewheel) {
+	if (freewheel)
 		pw_log_info("%p: enter freewheel", context);
-		if (context->thread_utils)
-			res = spa_thread_utils_drop_rt(context->thread_utils, thr);
-	} else {
+	else
 		pw_log_info("%p: exit freewheel", context);
-		/* Use the priority as configured within the realtime module */
-		if (context->thread_utils)
+
+	for (i = 0; i < impl->n_data_loops; i++) {
+		if ((thr = pw_data_loop_get_thread(impl->data_loops[i].impl)) == NULL)
+			return -EIO;
+
+		if (context->thread_utils == NULL)
+			continue;
+		if (freewheel)
+			res = spa_thread_utils_drop_rt(context->thread_utils, thr);
+		else
+			/* Use the priority as configured within the realtime module */
 			res = spa_thread_utils_acquire_rt(context->thread_utils, thr, -1);
+		if (res < 0)
+			pw_log_info("%p: freewheel error:%s", context, spa_strerror(res));
 	}
-	if (res < 0)
-		pw_log_info("%p: freewheel error:%s", context, spa_strerror(res));
 
 	context->freewheeling = freewheel;
 
@@ -197,6 +214,44 @@ static int do_data_loop_setup(struct spa_loop *loop, bool async, uint32_t seq,
 	return 0;
 }
 
+static int create_data_loops(struct impl *impl, struct spa_cpu *cpu)
+{
+	struct pw_context *this = &impl->this;
+	struct pw_properties *pr;
+	const char *str;
+	int32_t i, n_loops;
+
+	n_loops = pw_properties_get_int32(this->properties, "context.num-data-loops", 1);
+	if (n_loops <= 0)
+		n_loops = cpu ? (int32_t)spa_cpu_get_count(cpu) : 1;
+	n_loops = SPA_CLAMP(n_loops, 1, MAX_DATA_LOOPS);
+
+	pr = pw_properties_copy(this->properties);
+	if (pr == NULL)
+		return -errno;
+	if ((str = pw_properties_get(pr, "context.data-loop." PW_KEY_LIBRARY_NAME_SYSTEM)))
+		pw_properties_set(pr, PW_KEY_LIBRARY_NAME_SYSTEM, str);
+
+	for (i = 0; i < n_loops; i++) {
+		struct pw_data_loop *dl;
+
+		pw_properties_setf(pr, PW_KEY_LOOP_NAME, "data-loop.%d", i);
+
+		if ((dl = pw_data_loop_new(&pr->dict)) == NULL) {
+			int res = -errno;
+			pw_properties_free(pr);
+			return res;
+		}
+		impl->data_loops[i].impl = dl;
+		spa_hook_list_init(&impl->data_loops[i].driver_listener_list);
+		impl->n_data_loops++;
+	}
+	pw_properties_free(pr);
+
+	pw_log_info("%p: created %d data loops", this, n_loops);
+	return 0;
+}
+
 /** Create a new context object
  *
  * \param main_loop the main loop to use
@@ -214,8 +269,9 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	const char *lib, *str, *conf_prefix, *conf_name;
 	void *dbus_iface = NULL;
 	uint32_t n_support;
-	struct pw_properties *pr, *conf;
+	struct pw_properties *conf;
 	struct spa_cpu *cpu;
+	uint32_t i;
 	int res = 0;
 
 	impl = calloc(1, sizeof(struct impl) + user_data_size);
@@ -251,8 +307,8 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	spa_list_init(&this->control_list[1]);
 	spa_list_init(&this->export_list);
 	spa_list_init(&this->driver_list);
+	spa_list_init(&this->conf_rules);
 	spa_hook_list_init(&this->listener_list);
-	spa_hook_list_init(&this->driver_listener_list);
 
 	this->sc_pagesize = sysconf(_SC_PAGESIZE);
 
@@ -288,7 +344,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 		}
 	}
 
-	n_support = pw_get_support(this->support, SPA_N_ELEMENTS(this->support) - 6);
+	n_support = pw_get_support(this->support, SPA_N_ELEMENTS(this->support) - 8);
 	cpu = spa_support_find(this->support, n_support, SPA_TYPE_INTERFACE_CPU);
 
 	res = pw_context_conf_update_props(this, "context.properties", properties);
@@ -324,16 +380,9 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	pw_settings_init(this);
 	this->settings = this->defaults;
 
-	pr = pw_properties_copy(properties);
-	if ((str = pw_properties_get(pr, "context.data-loop." PW_KEY_LIBRARY_NAME_SYSTEM)))
-		pw_properties_set(pr, PW_KEY_LIBRARY_NAME_SYSTEM, str);
-
-	this->data_loop_impl = pw_data_loop_new(&pr->dict);
-	pw_properties_free(pr);
-	if (this->data_loop_impl == NULL)  {
-		res = -errno;
+	if ((res = create_data_loops(impl, cpu)) < 0)
 		goto error_free;
-	}
+	this->data_loop_impl = impl->data_loops[0].impl;
 
 	this->pool = pw_mempool_new(NULL);
 	if (this->pool == NULL) {
@@ -359,6 +408,7 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	this->support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_DataSystem, this->data_system);
 	this->support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_DataLoop, this->data_loop->loop);
 	this->support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_PluginLoader, &impl->plugin_loader);
+	this->support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_ThreadUtils, pw_thread_utils_get());
 
 	if ((str = pw_properties_get(properties, "support.dbus")) == NULL ||
 	    pw_properties_parse_bool(str)) {
@@ -407,11 +457,14 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 		goto error_free;
 	pw_log_info("%p: parsed %d context.exec items", this, res);
 
-	if ((res = pw_data_loop_start(this->data_loop_impl)) < 0)
-		goto error_free;
+	for (i = 0; i < impl->n_data_loops; i++) {
+		struct pw_data_loop *dl = impl->data_loops[i].impl;
+
+		if ((res = pw_data_loop_start(dl)) < 0)
+			goto error_free;
 
-	pw_data_loop_invoke(this->data_loop_impl,
-			do_data_loop_setup, 0, NULL, 0, false, this);
+		pw_data_loop_invoke(dl, do_data_loop_setup, 0, NULL, 0, false, this);
+	}
 
 	pw_settings_expose(this);
 
@@ -444,6 +497,7 @@ void pw_context_destroy(struct pw_context *context)
 	struct factory_entry *entry;
 	struct pw_impl_metadata *metadata;
 	struct pw_impl_core *core_impl;
+	uint32_t i;
 
 	pw_log_debug("%p: destroy", context);
 	pw_context_emit_destroy(context);
@@ -463,8 +517,8 @@ void pw_context_destroy(struct pw_context *context)
 	spa_list_consume(resource, &context->registry_resource_list, link)
 		pw_resource_destroy(resource);
 
-	if (context->data_loop_impl)
-		pw_data_loop_stop(context->data_loop_impl);
+	for (i = 0; i < impl->n_data_loops; i++)
+		pw_data_loop_stop(impl->data_loops[i].impl);
 
 	spa_list_consume(module, &context->module_list, link)
 		pw_impl_module_destroy(module);
@@ -481,8 +535,10 @@ void pw_context_destroy(struct pw_context *context)
 	pw_log_debug("%p: free", context);
 	pw_context_emit_free(context);
 
-	if (context->data_loop_impl)
-		pw_data_loop_destroy(context->data_loop_impl);
+	for (i = 0; i < impl->n_data_loops; i++) {
+		pw_data_loop_destroy(impl->data_loops[i].impl);
+		spa_hook_list_clean(&impl->data_loops[i].driver_listener_list);
+	}
 
 	if (context->pool)
 		pw_mempool_destroy(context->pool);
@@ -490,6 +546,7 @@ void pw_context_destroy(struct pw_context *context)
 	if (context->work_queue)
 		pw_work_queue_destroy(context->work_queue);
 
+	pw_context_conf_clear_rules(context);
 	pw_properties_free(context->properties);
 	pw_properties_free(context->conf);
 
@@ -509,7 +566,6 @@ void pw_context_destroy(struct pw_context *context)
 	pw_map_clear(&context->globals);
 
 	spa_hook_list_clean(&context->listener_list);
-	spa_hook_list_clean(&context->driver_listener_list);
 
 	free(context);
 }
@@ -548,6 +604,116 @@ struct pw_data_loop *pw_context_get_data_loop(struct pw_context *context)
 	return context->data_loop_impl;
 }
 
+static struct data_loop *find_data_loop(struct impl *impl, struct pw_loop *loop)
+{
+	uint32_t i;
+	for (i = 0; i < impl->n_data_loops; i++) {
+		if (pw_data_loop_get_loop(impl->data_loops[i].impl) == loop)
+			return &impl->data_loops[i];
+	}
+	return NULL;
+}
+
+static struct data_loop *find_data_loop_by_name(struct impl *impl, const char *name)
+{
+	uint32_t i;
+	for (i = 0; i < impl->n_data_loops; i++) {
+		struct pw_loop *l = pw_data_loop_get_loop(impl->data_loops[i].impl);
+		if (spa_streq(l->name, name))
+			return &impl->data_loops[i];
+	}
+	return NULL;
+}
+
+static struct data_loop *select_data_loop(struct impl *impl, const struct spa_dict *props)
+{
+	struct pw_context *this = &impl->this;
+	struct data_loop *dl = NULL;
+	struct pw_impl_node *n;
+	const char *str;
+	uint32_t i;
+
+	if (props != NULL &&
+	    (str = spa_dict_lookup(props, PW_KEY_NODE_LOOP_NAME)) != NULL) {
+		if ((dl = find_data_loop_by_name(impl, str)) != NULL)
+			return dl;
+		pw_log_warn("%p: unknown data loop %s, using default", this, str);
+		return &impl->data_loops[0];
+	}
+	if (impl->n_data_loops < 2 || props == NULL ||
+	    (str = spa_dict_lookup(props, PW_KEY_DEVICE_ID)) == NULL)
+		return &impl->data_loops[0];
+
+	/* keep all nodes of a device in the same loop */
+	spa_list_for_each(n, &this->node_list, link) {
+		if (n->data_loop != NULL &&
+		    spa_streq(pw_properties_get(n->properties, PW_KEY_DEVICE_ID), str) &&
+		    (dl = find_data_loop(impl, n->data_loop)) != NULL)
+			return dl;
+	}
+	/* else spread the devices over the least used loops */
+	dl = &impl->data_loops[0];
+	for (i = 1; i < impl->n_data_loops; i++) {
+		if (impl->data_loops[i].ref < dl->ref)
+			dl = &impl->data_loops[i];
+	}
+	return dl;
+}
+
+SPA_EXPORT
+struct pw_loop *pw_context_acquire_loop(struct pw_context *context, const struct spa_dict *props)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	struct data_loop *dl;
+	struct pw_loop *loop;
+
+	dl = select_data_loop(impl, props);
+	dl->ref++;
+	loop = pw_data_loop_get_loop(dl->impl);
+
+	pw_log_debug("%p: acquire loop %s ref:%d", context, loop->name, dl->ref);
+	return loop;
+}
+
+SPA_EXPORT
+void pw_context_release_loop(struct pw_context *context, struct pw_loop *loop)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	struct data_loop *dl;
+
+	if ((dl = find_data_loop(impl, loop)) != NULL && dl->ref > 0) {
+		dl->ref--;
+		pw_log_debug("%p: release loop %s ref:%d", context, loop->name, dl->ref);
+	}
+}
+
+SPA_EXPORT
+struct spa_hook_list *pw_context_get_driver_listener_list(struct pw_context *context,
+		struct pw_loop *loop)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	struct data_loop *dl;
+
+	if ((dl = find_data_loop(impl, loop)) == NULL)
+		dl = &impl->data_loops[0];
+	return &dl->driver_listener_list;
+}
+
+SPA_EXPORT
+int pw_context_for_each_data_loop(struct pw_context *context,
+		int (*callback) (void *data, struct pw_loop *loop), void *data)
+{
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	uint32_t i;
+	int res;
+
+	for (i = 0; i < impl->n_data_loops; i++) {
+		if ((res = callback(data, pw_data_loop_get_loop(impl->data_loops[i].impl))) != 0)
+			return res;
+	}
+	return 0;
+}
+
 SPA_EXPORT
 struct pw_work_queue *pw_context_get_work_queue(struct pw_context *context)
 {
@@ -1455,10 +1621,13 @@ struct spa_handle *pw_context_load_spa_handle(struct pw_context *context,
 		const char *factory_name,
 		const struct spa_dict *info)
 {
-	const char *lib;
+	struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+	const char *lib, *str;
 	const struct spa_support *support;
-	uint32_t n_support;
+	struct spa_support loop_support[SPA_N_ELEMENTS(context->support)];
+	uint32_t i, n_support;
 	struct spa_handle *handle;
+	struct data_loop *dl;
 
 	pw_log_debug("%p: load factory %s", context, factory_name);
 
@@ -1474,6 +1643,23 @@ struct spa_handle *pw_context_load_spa_handle(struct pw_context *context,
 
 	support = pw_context_get_support(context, &n_support);
 
+	/* give the plugin the data loop it was assigned to */
+	if (info != NULL &&
+	    (str = spa_dict_lookup(info, PW_KEY_NODE_LOOP_NAME)) != NULL &&
+	    (dl = find_data_loop_by_name(impl, str)) != NULL &&
+	    dl != &impl->data_loops[0]) {
+		struct pw_loop *loop = pw_data_loop_get_loop(dl->impl);
+
+		for (i = 0; i < n_support; i++) {
+			loop_support[i] = support[i];
+			if (spa_streq(support[i].type, SPA_TYPE_INTERFACE_DataLoop))
+				loop_support[i].data = loop->loop;
+			else if (spa_streq(support[i].type, SPA_TYPE_INTERFACE_DataSystem))
+				loop_support[i].data = loop->system;
+		}
+		support = loop_support;
+	}
+
 	handle = pw_load_spa_handle(lib, factory_name,
 			info, n_support, support);
 
@@ -1538,10 +1724,19 @@ int pw_context_set_object(struct pw_context *context, const char *type, void *va
 		entry->value = value;
 	}
 	if (spa_streq(type, SPA_TYPE_INTERFACE_ThreadUtils)) {
+		struct impl *impl = SPA_CONTAINER_OF(context, struct impl, this);
+		uint32_t i;
+
 		context->thread_utils = value;
-		if (context->data_loop_impl)
-			pw_data_loop_set_thread_utils(context->data_loop_impl,
+		for (i = 0; i < impl->n_data_loops; i++)
+			pw_data_loop_set_thread_utils(impl->data_loops[i].impl,
 					context->thread_utils);
+
+		/* plugins loaded from now on create their threads with this */
+		for (i = 0; i < context->n_support; i++) {
+			if (spa_streq(context->support[i].type, SPA_TYPE_INTERFACE_ThreadUtils))
+				context->support[i].data = value ? value : pw_thread_utils_get();
+		}
 	}
 	return 0;
 }
@@ -139,6 +139,13 @@ struct pw_loop *pw_context_get_main_loop(struct pw_context *context);
 /** get the context data loop. Since 0.3.56 */
 struct pw_data_loop *pw_context_get_data_loop(struct pw_context *context);
 
+/** Get a data loop from the context data loop pool. The loop is selected with
+ * the node.loop.name property or, when there are multiple data loops, by the
+ * device.id property. Release with pw_context_release_loop(). Since 0.3.57 */
+struct pw_loop *pw_context_acquire_loop(struct pw_context *context, const struct spa_dict *props);
+/** Release a loop acquired with pw_context_acquire_loop(). Since 0.3.57 */
+void pw_context_release_loop(struct pw_context *context, struct pw_loop *loop);
+
 /** Get the work queue from the context: Since 0.3.26 */
 struct pw_work_queue *pw_context_get_work_queue(struct pw_context *context);
 
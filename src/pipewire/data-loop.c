@@ -199,12 +199,17 @@ int pw_data_loop_start(struct pw_data_loop *loop)
 	if (!loop->running) {
 		struct spa_thread_utils *utils;
 		struct spa_thread *thr;
+		struct spa_dict_item items[1];
+		struct spa_dict dict = SPA_DICT_INIT(items, 0);
 
 		loop->running = true;
 
+		if (loop->loop->name != NULL)
+			items[dict.n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_THREAD_NAME, loop->loop->name);
+
 		if ((utils = loop->thread_utils) == NULL)
 			utils = pw_thread_utils_get();
-		thr = spa_thread_utils_create(utils, NULL, do_loop, loop);
+		thr = spa_thread_utils_create(utils, dict.n_items ? &dict : NULL, do_loop, loop);
 		loop->thread = (pthread_t)thr;
 		if (thr == NULL) {
 			pw_log_error("%p: can't create thread: %m", loop);
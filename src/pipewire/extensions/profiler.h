@@ -29,7 +29,11 @@
 extern "C" {
 #endif
 
+#include <errno.h>
+#include <string.h>
+
 #include <spa/utils/defs.h>
+#include <spa/utils/histogram.h>
 
 /** \defgroup pw_profiler Profiler
  * Profiler interface
@@ -41,34 +45,75 @@ extern "C" {
  */
 #define PW_TYPE_INTERFACE_Profiler		PW_TYPE_INFO_INTERFACE_BASE "Profiler"
 
-#define PW_VERSION_PROFILER			3
+#define PW_VERSION_PROFILER			4
 struct pw_profiler;
 
 #define PW_EXTENSION_MODULE_PROFILER		PIPEWIRE_MODULE_PREFIX "module-profiler"
 
 #define PW_PROFILER_EVENT_PROFILE		0
-#define PW_PROFILER_EVENT_NUM			1
+#define PW_PROFILER_EVENT_RING			1
+#define PW_PROFILER_EVENT_NODE			2
+#define PW_PROFILER_EVENT_NODE_STATS		3
+#define PW_PROFILER_EVENT_NUM			4
+
+struct pw_profiler_node_stats;
 
 /** \ref pw_profiler events */
 struct pw_profiler_events {
-#define PW_VERSION_PROFILER_EVENTS		0
+#define PW_VERSION_PROFILER_EVENTS		1
 	uint32_t version;
 
+	/**
+	 * Profiler data as a struct of Profiler objects. Sent until the
+	 * shared memory ring is enabled with pw_profiler_enable_ring().
+	 */
 	void (*profile) (void *data, const struct spa_pod *pod);
+	/**
+	 * The shared memory ring with the profiler records, sent after
+	 * pw_profiler_enable_ring(). Since version 4.
+	 *
+	 * \param mem_id the memory id of the ring, map it read-only with
+	 *		pw_mempool_map_id()
+	 * \param offset offset of the \ref pw_profiler_ring in the memory
+	 * \param size size of the ring and its data
+	 */
+	void (*ring) (void *data, uint32_t mem_id, uint32_t offset, uint32_t size);
+	/**
+	 * The name of a node that appears in the records. Since version 4.
+	 *
+	 * \param id the node id
+	 * \param name the node name or NULL when the node was removed
+	 */
+	void (*node) (void *data, uint32_t id, const char *name);
+	/**
+	 * The timing statistics of a node, sent periodically when they
+	 * changed. Since version 4.
+	 *
+	 * \param id the node id
+	 * \param stats the statistics
+	 */
+	void (*node_stats) (void *data, uint32_t id, const struct pw_profiler_node_stats *stats);
 };
 
 #define PW_PROFILER_METHOD_ADD_LISTENER		0
-#define PW_PROFILER_METHOD_NUM			1
+#define PW_PROFILER_METHOD_ENABLE_RING		1
+#define PW_PROFILER_METHOD_NUM			2
 
 /** \ref pw_profiler methods */
 struct pw_profiler_methods {
-#define PW_VERSION_PROFILER_METHODS		0
+#define PW_VERSION_PROFILER_METHODS		1
 	uint32_t version;
 
 	int (*add_listener) (void *object,
 			struct spa_hook *listener,
 			const struct pw_profiler_events *events,
 			void *data);
+	/**
+	 * Receive the profiler records in a shared memory ring instead
+	 * of the profile event. The ring, node and node_stats events are
+	 * sent after this. Since version 4.
+	 */
+	int (*enable_ring) (void *object);
 };
 
 #define pw_profiler_method(o,method,version,...)			\
@@ -81,9 +126,167 @@ struct pw_profiler_methods {
 })
 
 #define pw_profiler_add_listener(c,...)		pw_profiler_method(c,add_listener,0,__VA_ARGS__)
+#define pw_profiler_enable_ring(c)		pw_profiler_method(c,enable_ring,1)
 
 #define PW_KEY_PROFILER_NAME		"profiler.name"
 
+#define PW_PROFILER_RING_MAGIC		0x50575052u
+#define PW_PROFILER_RING_VERSION	0
+
+/** The shared memory profiler ring.
+ *
+ * The profiler writes one \ref pw_profiler_record per graph cycle into the
+ * data area and never waits for readers. Each reader keeps its own read
+ * index and uses pw_profiler_ring_read() to get the records. A reader that
+ * is too slow loses the records that were overwritten. */
+struct pw_profiler_ring {
+	uint32_t magic;			/**< PW_PROFILER_RING_MAGIC */
+	uint32_t version;		/**< PW_PROFILER_RING_VERSION */
+	uint32_t offset;		/**< offset of the data area from the ring */
+	uint32_t size;			/**< size of the data area */
+	uint64_t writeindex;		/**< end of the last complete record */
+	uint64_t reserved;		/**< end of the record being written */
+};
+
+/** Timing of one node in a graph cycle */
+struct pw_profiler_block {
+	uint32_t id;			/**< node id, the name is sent with the node event */
+	int32_t status;			/**< activation status */
+	int64_t prev_signal_time;
+	int64_t signal_time;
+	int64_t awake_time;
+	int64_t finish_time;
+	struct spa_fraction latency;
+};
+
+/** One graph cycle of a driver, followed by n_blocks blocks */
+struct pw_profiler_record {
+	uint32_t size;			/**< size of the record and its blocks */
+	uint32_t n_blocks;		/**< number of blocks, the first one is the driver */
+	int64_t count;			/**< cycle counter of the profiler */
+	float cpu_load[3];
+	int32_t xrun_count;
+	uint32_t clock_flags;
+	uint32_t clock_id;
+	int64_t clock_nsec;
+	struct spa_fraction clock_rate;
+	uint64_t clock_position;
+	uint64_t clock_duration;
+	int64_t clock_delay;
+	double clock_rate_diff;
+	uint64_t clock_next_nsec;
+	struct pw_profiler_block blocks[];
+};
+
+/** Timing statistics of a node, accumulated by the driver */
+struct pw_profiler_node_stats {
+	struct spa_histogram wait;	/**< signal to awake time */
+	struct spa_histogram busy;	/**< awake to finish time */
+	uint32_t xrun_count;			/**< xruns reported by the node */
+	uint32_t incomplete_count;		/**< cycles where the node did not finish
+						  *  before the next cycle started */
+	uint32_t xrun_pending_count;		/**< xruns of the driver while the node
+						  *  was still pending */
+};
+
+/** A reader of a \ref pw_profiler_ring.
+ *
+ * The ring memory can be written by all clients of the profiler, so the
+ * geometry of the ring is checked once by pw_profiler_ring_reader_init() and
+ * the reader only uses its own copy of it. */
+struct pw_profiler_ring_reader {
+	const struct pw_profiler_ring *ring;
+	const uint8_t *data;		/**< the data area */
+	uint32_t size;			/**< size of the data area */
+	uint64_t index;			/**< index of the next record to read */
+};
+
+/** Get the index of the next record that will be written */
+static inline uint64_t pw_profiler_ring_get_index(const struct pw_profiler_ring *ring)
+{
+	return __atomic_load_n(&ring->writeindex, __ATOMIC_ACQUIRE);
+}
+
+/** Set up \a reader for the ring in \a mem of \a mem_size bytes, as mapped
+ * from the ring event. Reading starts at the next record that is written.
+ *
+ * \return 0 on success or -EINVAL when the ring is not valid
+ */
+static inline int pw_profiler_ring_reader_init(struct pw_profiler_ring_reader *reader,
+		const void *mem, uint32_t mem_size)
+{
+	const struct pw_profiler_ring *ring = (const struct pw_profiler_ring *)mem;
+	uint32_t offset, size;
+
+	if (mem_size < sizeof(*ring))
+		return -EINVAL;
+
+	offset = __atomic_load_n(&ring->offset, __ATOMIC_RELAXED);
+	size = __atomic_load_n(&ring->size, __ATOMIC_RELAXED);
+	if (ring->magic != PW_PROFILER_RING_MAGIC ||
+	    ring->version != PW_PROFILER_RING_VERSION ||
+	    offset < sizeof(*ring) || offset > mem_size ||
+	    size == 0 || size > mem_size - offset)
+		return -EINVAL;
+
+	reader->ring = ring;
+	reader->data = SPA_PTROFF(ring, offset, const uint8_t);
+	reader->size = size;
+	reader->index = pw_profiler_ring_get_index(ring);
+	return 0;
+}
+
+static inline void pw_profiler_ring_copy(const struct pw_profiler_ring_reader *reader,
+		uint64_t index, void *data, uint32_t size)
+{
+	uint32_t offs = index % reader->size, l0 = SPA_MIN(size, reader->size - offs);
+
+	memcpy(data, reader->data + offs, l0);
+	if (SPA_UNLIKELY(l0 < size))
+		memcpy(SPA_PTROFF(data, l0, void), reader->data, size - l0);
+}
+
+/** Read the next record into \a data of \a size bytes.
+ *
+ * \return the size of the record and the reader is moved to the next record,
+ *	0 when there is no record, -ENOSPC when the record did not fit and was
+ *	skipped or -EPIPE when records were lost and the reader was moved to the
+ *	next record that will be written.
+ */
+static inline int pw_profiler_ring_read(struct pw_profiler_ring_reader *reader,
+		void *data, uint32_t size)
+{
+	uint64_t r = reader->index, w;
+	uint32_t len;
+
+	w = pw_profiler_ring_get_index(reader->ring);
+	if (r == w)
+		return 0;
+	if (w - r > reader->size)
+		goto lost;
+
+	pw_profiler_ring_copy(reader, r, &len, sizeof(len));
+	if (len < sizeof(struct pw_profiler_record) || len > w - r)
+		goto lost;
+	if (len > size) {
+		reader->index = r + len;
+		return -ENOSPC;
+	}
+	pw_profiler_ring_copy(reader, r, data, len);
+
+	/* check that the writer did not overwrite the record while we
+	 * were copying it */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&reader->ring->reserved, __ATOMIC_RELAXED) - r > reader->size)
+		goto lost;
+
+	reader->index = r + len;
+	return len;
+lost:
+	reader->index = pw_profiler_ring_get_index(reader->ring);
+	return -EPIPE;
+}
+
 /**
  * \}
  */
@@ -129,6 +129,7 @@ struct filter {
 	const char *path;
 
 	struct pw_context *context;
+	struct pw_loop *data_loop;
 
 	enum pw_filter_flags flags;
 
@@ -482,7 +483,7 @@ static int impl_set_io(void *object, uint32_t id, void *data, size_t size)
 			impl->position = data;
 		else
 			impl->position = NULL;
-		pw_loop_invoke(impl->context->data_loop,
+		pw_loop_invoke(impl->data_loop,
 			do_set_position, 1, NULL, 0, true, impl);
 		break;
 	}
@@ -1267,6 +1268,7 @@ filter_new(struct pw_context *context, const char *name,
 	this->state = PW_FILTER_STATE_UNCONNECTED;
 
 	impl->context = context;
+	impl->data_loop = context->data_loop;
 	impl->allow_mlock = context->settings.mem_allow_mlock;
 	impl->warn_mlock = context->settings.mem_warn_mlock;
 
@@ -1505,7 +1507,8 @@ pw_filter_connect(struct pw_filter *filter,
 	struct filter *impl = SPA_CONTAINER_OF(filter, struct filter, this);
 	int res;
 	uint32_t i;
-	struct spa_dict_item items[1];
+	struct spa_dict_item items[2];
+	uint32_t n_items = 0;
 
 	pw_log_debug("%p: connect", filter);
 	impl->flags = flags;
@@ -1564,9 +1567,15 @@ pw_filter_connect(struct pw_filter *filter,
 
 	pw_log_debug("%p: export node %p", filter, &impl->impl_node);
 
-	items[0] = SPA_DICT_ITEM_INIT(PW_KEY_OBJECT_REGISTER, "false");
+	/* run the filter in the same data loop as the exported node */
+	impl->data_loop = pw_context_acquire_loop(impl->context, &filter->properties->dict);
+	pw_context_release_loop(impl->context, impl->data_loop);
+
+	items[n_items++] = SPA_DICT_ITEM_INIT(PW_KEY_OBJECT_REGISTER, "false");
+	if (impl->data_loop->name != NULL)
+		items[n_items++] = SPA_DICT_ITEM_INIT(PW_KEY_NODE_LOOP_NAME, impl->data_loop->name);
 	filter->proxy = pw_core_export(filter->core,
-			SPA_TYPE_INTERFACE_Node, &SPA_DICT_INIT_ARRAY(items),
+			SPA_TYPE_INTERFACE_Node, &SPA_DICT_INIT(items, n_items),
 			&impl->impl_node, 0);
 	if (filter->proxy == NULL) {
 		res = -errno;
@@ -1856,7 +1865,7 @@ static inline int call_trigger(struct filter *impl)
 {
 	int res = 0;
 	if (SPA_FLAG_IS_SET(impl->flags, PW_FILTER_FLAG_DRIVER)) {
-		res = pw_loop_invoke(impl->context->data_loop,
+		res = pw_loop_invoke(impl->data_loop,
 			do_process, 1, NULL, 0, false, impl);
 	}
 	return res;
@@ -1955,7 +1964,7 @@ SPA_EXPORT
 int pw_filter_flush(struct pw_filter *filter, bool drain)
 {
 	struct filter *impl = SPA_CONTAINER_OF(filter, struct filter, this);
-	pw_loop_invoke(impl->context->data_loop,
+	pw_loop_invoke(impl->data_loop,
 			drain ? do_drain : do_flush, 1, NULL, 0, true, impl);
 	return 0;
 }
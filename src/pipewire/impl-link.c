@@ -581,6 +581,18 @@ error:
 	return res;
 }
 
+static int
+do_activate_link_input(struct spa_loop *loop,
+		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_link *this = user_data;
+
+	pw_log_trace("%p: activate input", this);
+
+	spa_list_append(&this->input->rt.mix_list, &this->rt.in_mix.rt_link);
+	return 0;
+}
+
 static int
 do_activate_link(struct spa_loop *loop,
 		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
@@ -591,7 +603,9 @@ do_activate_link(struct spa_loop *loop,
 	pw_log_trace("%p: activate", this);
 
 	spa_list_append(&this->output->rt.mix_list, &this->rt.out_mix.rt_link);
-	spa_list_append(&this->input->rt.mix_list, &this->rt.in_mix.rt_link);
+	/* else added from the data loop of the input node */
+	if (impl->inode->data_loop == impl->onode->data_loop)
+		spa_list_append(&this->input->rt.mix_list, &this->rt.in_mix.rt_link);
 
 	if (impl->inode != impl->onode) {
 		struct pw_node_activation_state *state;
@@ -599,9 +613,10 @@ do_activate_link(struct spa_loop *loop,
 		this->rt.target.activation = impl->inode->rt.activation;
 		spa_list_append(&impl->onode->rt.target_list, &this->rt.target.link);
 
+		/* the input node can run in another data loop */
 		state = &this->rt.target.activation->state[0];
 		if (!this->rt.target.active && impl->onode->rt.driver_target.node != NULL) {
-			state->required++;
+			ATOMIC_INC(state->required);
 			this->rt.target.active = true;
 		}
 
@@ -632,6 +647,9 @@ int pw_impl_link_activate(struct pw_impl_link *this)
 			return res;
 		impl->io_set = true;
 	}
+	if (impl->inode->data_loop != impl->onode->data_loop)
+		pw_loop_invoke(impl->inode->data_loop,
+		       do_activate_link_input, SPA_ID_INVALID, NULL, 0, false, this);
 	pw_loop_invoke(this->output->node->data_loop,
 	       do_activate_link, SPA_ID_INVALID, NULL, 0, false, this);
 
@@ -796,6 +814,18 @@ int pw_impl_link_prepare(struct pw_impl_link *this)
 	return 0;
 }
 
+static int
+do_deactivate_link_input(struct spa_loop *loop,
+		   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_link *this = user_data;
+
+	pw_log_trace("%p: disable %p", this, &this->rt.in_mix);
+
+	spa_list_remove(&this->rt.in_mix.rt_link);
+	return 0;
+}
+
 static int
 do_deactivate_link(struct spa_loop *loop,
 		   bool async, uint32_t seq, const void *data, size_t size, void *user_data)
@@ -806,7 +836,9 @@ do_deactivate_link(struct spa_loop *loop,
 	pw_log_trace("%p: disable %p and %p", this, &this->rt.in_mix, &this->rt.out_mix);
 
 	spa_list_remove(&this->rt.out_mix.rt_link);
-	spa_list_remove(&this->rt.in_mix.rt_link);
+	/* else removed from the data loop of the input node */
+	if (impl->inode->data_loop == impl->onode->data_loop)
+		spa_list_remove(&this->rt.in_mix.rt_link);
 
 	if (this->input->node != this->output->node) {
 		struct pw_node_activation_state *state;
@@ -814,7 +846,7 @@ do_deactivate_link(struct spa_loop *loop,
 		spa_list_remove(&this->rt.target.link);
 		state = &this->rt.target.activation->state[0];
 		if (this->rt.target.active) {
-			state->required--;
+			ATOMIC_DEC(state->required);
 			this->rt.target.active = false;
 		}
 
@@ -836,6 +868,9 @@ int pw_impl_link_deactivate(struct pw_impl_link *this)
 
 	pw_loop_invoke(this->output->node->data_loop,
 		       do_deactivate_link, SPA_ID_INVALID, NULL, 0, true, this);
+	if (impl->inode->data_loop != impl->onode->data_loop)
+		pw_loop_invoke(impl->inode->data_loop,
+		       do_deactivate_link_input, SPA_ID_INVALID, NULL, 0, true, this);
 
 	port_set_io(this, this->output, SPA_IO_Buffers, NULL, 0,
 			&this->rt.out_mix);
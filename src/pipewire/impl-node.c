@@ -87,6 +87,32 @@ struct resource_data {
 
 /** \endcond */
 
+/* must be called from the data loop of the driver */
+static void add_to_driver(struct pw_impl_node *this, struct pw_impl_node *driver)
+{
+	struct pw_node_activation_state *nstate = &this->rt.activation->state[0];
+
+	if (this->rt.target.active)
+		return;
+
+	spa_list_append(&driver->rt.target_list, &this->rt.target.link);
+	ATOMIC_INC(nstate->required);
+	this->rt.target.active = true;
+}
+
+/* must be called from the data loop of the driver */
+static void remove_from_driver(struct pw_impl_node *this)
+{
+	struct pw_node_activation_state *nstate = &this->rt.activation->state[0];
+
+	if (!this->rt.target.active)
+		return;
+
+	spa_list_remove(&this->rt.target.link);
+	ATOMIC_DEC(nstate->required);
+	this->rt.target.active = false;
+}
+
 static void add_node(struct pw_impl_node *this, struct pw_impl_node *driver)
 {
 	struct pw_node_activation_state *dstate, *nstate;
@@ -104,17 +130,16 @@ static void add_node(struct pw_impl_node *this, struct pw_impl_node *driver)
 	this->rt.driver_target.data = driver;
 	spa_list_append(&this->rt.target_list, &this->rt.driver_target.link);
 
-	spa_list_append(&driver->rt.target_list, &this->rt.target.link);
-	nstate = &this->rt.activation->state[0];
-	if (!this->rt.target.active) {
-		nstate->required++;
-		this->rt.target.active = true;
-	}
+	/* when the driver runs in another data loop, the node is added to the
+	 * driver from that loop, see node_add() */
+	if (driver->data_loop == this->data_loop)
+		add_to_driver(this, driver);
 
+	nstate = &this->rt.activation->state[0];
 	spa_list_for_each(t, &this->rt.target_list, link) {
 		dstate = &t->activation->state[0];
 		if (!t->active) {
-			dstate->required++;
+			ATOMIC_INC(dstate->required);
 			t->active = true;
 		}
 		pw_log_trace("%p: driver state:%p pending:%d/%d, node state:%p pending:%d/%d",
@@ -127,6 +152,7 @@ static void remove_node(struct pw_impl_node *this)
 {
 	struct pw_node_activation_state *dstate, *nstate;
 	struct pw_node_target *t;
+	struct pw_impl_node *driver = this->rt.driver_target.node;
 
 	if (this->exported)
 		return;
@@ -135,18 +161,14 @@ static void remove_node(struct pw_impl_node *this)
 			this, this->rt.driver_target.data,
 			this->rt.driver_target.activation, this->rt.activation);
 
-	spa_list_remove(&this->rt.target.link);
+	if (driver == NULL || driver->data_loop == this->data_loop)
+		remove_from_driver(this);
 
 	nstate = &this->rt.activation->state[0];
-	if (this->rt.target.active) {
-		nstate->required--;
-		this->rt.target.active = false;
-	}
-
 	spa_list_for_each(t, &this->rt.target_list, link) {
 		dstate = &t->activation->state[0];
 		if (t->active) {
-			dstate->required--;
+			ATOMIC_DEC(dstate->required);
 			t->active = false;
 		}
 		pw_log_trace("%p: driver state:%p pending:%d/%d, node state:%p pending:%d/%d",
@@ -170,6 +192,27 @@ do_node_remove(struct spa_loop *loop,
 	return 0;
 }
 
+static int
+do_remove_from_driver(struct spa_loop *loop,
+	       bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_node *this = user_data;
+	if (!this->exported)
+		remove_from_driver(this);
+	return 0;
+}
+
+/* first stop signaling the driver, then remove the node from the driver so
+ * that the driver never waits for a node it doesn't schedule anymore */
+static void node_remove(struct pw_impl_node *this)
+{
+	struct pw_impl_node *driver = this->rt.driver_target.node;
+
+	pw_loop_invoke(this->data_loop, do_node_remove, 1, NULL, 0, true, this);
+	if (driver != NULL && driver->data_loop != this->data_loop)
+		pw_loop_invoke(driver->data_loop, do_remove_from_driver, 1, NULL, 0, true, this);
+}
+
 static void node_deactivate(struct pw_impl_node *this)
 {
 	struct pw_impl_port *port;
@@ -184,7 +227,7 @@ static void node_deactivate(struct pw_impl_node *this)
 		spa_list_for_each(link, &port->links, output_link)
 			pw_impl_link_deactivate(link);
 	}
-	pw_loop_invoke(this->data_loop, do_node_remove, 1, NULL, 0, true, this);
+	node_remove(this);
 }
 
 static int pause_node(struct pw_impl_node *this)
@@ -339,6 +382,30 @@ do_node_add(struct spa_loop *loop,
 	return 0;
 }
 
+static int
+do_add_to_driver(struct spa_loop *loop,
+	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_node *this = user_data;
+	struct pw_impl_node *driver = *(struct pw_impl_node **)data;
+
+	if (!this->exported)
+		add_to_driver(this, driver);
+	return 0;
+}
+
+/* first let the driver schedule the node, then make the driver wait for the
+ * node */
+static void node_add(struct pw_impl_node *this)
+{
+	struct pw_impl_node *driver = this->driver_node;
+
+	if (driver->data_loop != this->data_loop)
+		pw_loop_invoke(driver->data_loop, do_add_to_driver, 1,
+				&driver, sizeof(struct pw_impl_node *), true, this);
+	pw_loop_invoke(this->data_loop, do_node_add, 1, NULL, 0, true, this);
+}
+
 static void node_update_state(struct pw_impl_node *node, enum pw_node_state state, int res, char *error)
 {
 	struct impl *impl = SPA_CONTAINER_OF(node, struct impl, this);
@@ -355,7 +422,7 @@ static void node_update_state(struct pw_impl_node *node, enum pw_node_state stat
 			}
 		}
 		if (res >= 0)
-			pw_loop_invoke(node->data_loop, do_node_add, 1, NULL, 0, true, node);
+			node_add(node);
 		break;
 	default:
 		break;
@@ -793,12 +860,24 @@ do_move_nodes(struct spa_loop *loop,
 	node->current_quantum = node->rt.position->clock.duration;
 
 	if (node->source.loop != NULL) {
-		remove_node(node);
+		if (node->rt.driver_target.node != NULL)
+			remove_node(node);
 		add_node(node, driver);
 	}
 	return 0;
 }
 
+static int
+do_unlink_node(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_impl_node *node = user_data;
+
+	if (node->source.loop != NULL && node->rt.driver_target.node != NULL)
+		remove_node(node);
+	return 0;
+}
+
 static void remove_segment_owner(struct pw_impl_node *driver, uint32_t node_id)
 {
 	struct pw_node_activation *a = driver->rt.activation;
@@ -810,7 +889,7 @@ SPA_EXPORT
 int pw_impl_node_set_driver(struct pw_impl_node *node, struct pw_impl_node *driver)
 {
 	struct impl *impl = SPA_CONTAINER_OF(node, struct impl, this);
-	struct pw_impl_node *old = node->driver_node;
+	struct pw_impl_node *old = node->driver_node, *current;
 
 	if (driver == NULL)
 		driver = node;
@@ -844,6 +923,23 @@ int pw_impl_node_set_driver(struct pw_impl_node *node, struct pw_impl_node *driv
 	node->driver_node = driver;
 	node->moved = true;
 
+	/* when a driver runs in another data loop, the node first stops
+	 * signaling the old driver before the old driver drops it and the new
+	 * driver schedules the node before the node signals it. */
+	current = node->rt.driver_target.node;
+	if ((current != NULL && current->data_loop != node->data_loop) ||
+	    driver->data_loop != node->data_loop) {
+		pw_loop_invoke(node->data_loop,
+		       do_unlink_node, 1, NULL, 0, true, node);
+		if (current != NULL && current->data_loop != node->data_loop)
+			pw_loop_invoke(current->data_loop,
+			       do_remove_from_driver, 1, NULL, 0, true, node);
+		if (driver->data_loop != node->data_loop && node->source.loop != NULL)
+			pw_loop_invoke(driver->data_loop,
+			       do_add_to_driver, 1, &driver, sizeof(struct pw_impl_node *),
+			       true, node);
+	}
+
 	pw_loop_invoke(node->data_loop,
 		       do_move_nodes, SPA_ID_INVALID, &driver, sizeof(struct pw_impl_node *),
 		       true, impl);
@@ -894,7 +990,7 @@ static void check_properties(struct pw_impl_node *node)
 
 	/* not scheduled automatically so we add an additional required trigger */
 	if (pw_properties_get_bool(node->properties, PW_KEY_NODE_TRIGGER, false))
-		node->rt.activation->state[0].required++;
+		ATOMIC_INC(node->rt.activation->state[0].required);
 
 	/* group defines what nodes are scheduled together */
 	if ((str = pw_properties_get(node->properties, PW_KEY_NODE_GROUP)) == NULL)
@@ -1022,6 +1118,24 @@ static void dump_states(struct pw_impl_node *driver)
 	}
 }
 
+static inline int process_node(void *data);
+
+static inline void trigger_target(struct pw_impl_node *this, struct pw_node_target *t)
+{
+	struct pw_impl_node *node = t->node;
+
+	/* local targets running in another data loop are woken up with their
+	 * eventfd so that they are processed in their own thread */
+	if (SPA_UNLIKELY(node != NULL && node->data_loop != this->data_loop &&
+	    t->signal == process_node)) {
+		if (SPA_UNLIKELY(spa_system_eventfd_write(this->context->data_system,
+						node->source.fd, 1) < 0))
+			pw_log_warn("%p: write failed %m", node);
+	} else {
+		t->signal(t->data);
+	}
+}
+
 static inline int resume_node(struct pw_impl_node *this, int status)
 {
 	struct pw_node_target *t;
@@ -1047,12 +1161,46 @@ static inline int resume_node(struct pw_impl_node *this, int status)
 		if (pw_node_activation_state_dec(state, 1)) {
 			a->status = PW_NODE_ACTIVATION_TRIGGERED;
 			a->signal_time = nsec;
-			t->signal(t->data);
+			trigger_target(this, t);
 		}
 	}
 	return 0;
 }
 
+/* called by the driver at the end of a cycle or when the next cycle starts
+ * before the graph finished. Nodes that finished get their times added to
+ * the histograms, nodes that are still pending are counted as incomplete. */
+static inline void update_histograms(struct pw_impl_node *driver)
+{
+	struct pw_node_target *t;
+
+	if (SPA_UNLIKELY(driver->exported))
+		return;
+
+	spa_list_for_each(t, &driver->rt.target_list, link) {
+		struct pw_node_activation *a = t->activation;
+
+		if (t->node == NULL)
+			continue;
+
+		switch (a->status) {
+		case PW_NODE_ACTIVATION_FINISHED:
+			if (a->awake_time < a->signal_time ||
+			    a->finish_time < a->awake_time)
+				break;
+			spa_histogram_add(&a->wait_histogram,
+					a->awake_time - a->signal_time);
+			spa_histogram_add(&a->busy_histogram,
+					a->finish_time - a->awake_time);
+			break;
+		case PW_NODE_ACTIVATION_TRIGGERED:
+		case PW_NODE_ACTIVATION_AWAKE:
+			a->incomplete_count++;
+			break;
+		}
+	}
+}
+
 static inline void calculate_stats(struct pw_impl_node *this,  struct pw_node_activation *a)
 {
 	if (SPA_LIKELY(a->signal_time > a->prev_signal_time)) {
@@ -1103,6 +1251,7 @@ static inline int process_node(void *data)
 
 		/* calculate CPU time */
 		calculate_stats(this, a);
+		update_histograms(this);
 
 		pw_log_trace_fp("%p: graph completed wait:%"PRIu64" run:%"PRIu64
 				" busy:%"PRIu64" period:%"PRIu64" cpu:%f:%f:%f", this,
@@ -1240,7 +1389,9 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	impl->work = pw_context_get_work_queue(this->context);
 	impl->pending_id = SPA_ID_INVALID;
 
-	this->data_loop = context->data_loop;
+	this->data_loop = pw_context_acquire_loop(context, &properties->dict);
+	this->driver_listener_list = pw_context_get_driver_listener_list(context,
+			this->data_loop);
 
 	spa_list_init(&this->follower_list);
 
@@ -1605,6 +1756,7 @@ static int node_ready(void *data, int status)
 		uint64_t min_timeout = UINT64_MAX;
 
 		if (SPA_UNLIKELY(state->pending > 0)) {
+			update_histograms(node);
 			pw_context_driver_emit_incomplete(node->context, node);
 			if (ratelimit_test(&node->rt.rate_limit, a->signal_time, SPA_LOG_LEVEL_DEBUG)) {
 				pw_log_debug("(%s-%u) graph not finished: state:%p quantum:%"PRIu64
@@ -1716,6 +1868,25 @@ static void update_xrun_stats(struct pw_node_activation *a, uint64_t trigger, ui
 	a->max_delay = SPA_MAX(a->max_delay, delay);
 }
 
+/* blame the xrun of a driver on the nodes that are still pending */
+static void update_xrun_pending(struct pw_impl_node *driver)
+{
+	struct pw_node_target *t;
+
+	if (driver->exported)
+		return;
+
+	spa_list_for_each(t, &driver->rt.target_list, link) {
+		struct pw_node_activation *a = t->activation;
+
+		if (t->node == NULL || t->node == driver)
+			continue;
+		if (a->status == PW_NODE_ACTIVATION_TRIGGERED ||
+		    a->status == PW_NODE_ACTIVATION_AWAKE)
+			a->xrun_pending_count++;
+	}
+}
+
 static int node_xrun(void *data, uint64_t trigger, uint64_t delay, struct spa_pod *info)
 {
 	struct pw_impl_node *this = data;
@@ -1725,6 +1896,8 @@ static int node_xrun(void *data, uint64_t trigger, uint64_t delay, struct spa_po
 	update_xrun_stats(a, trigger, delay);
 	if (da && da != a)
 		update_xrun_stats(da, trigger, delay);
+	if (this->driver && this->driving)
+		update_xrun_pending(this);
 
 	if (ratelimit_test(&this->rt.rate_limit, a->signal_time, SPA_LOG_LEVEL_INFO)) {
 		struct spa_fraction rate;
@@ -1740,6 +1913,8 @@ static int node_xrun(void *data, uint64_t trigger, uint64_t delay, struct spa_po
 				this->name, this->info.id,
 				rate.num, rate.denom, a->xrun_count,
 				trigger, delay, a->max_delay);
+		if (this->driver && this->driving)
+			dump_states(this);
 	}
 
 	pw_context_driver_emit_xrun(this->context, this);
@@ -1876,6 +2051,8 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 
 	clear_info(node);
 
+	pw_context_release_loop(context, node->data_loop);
+
 	spa_system_close(context->data_system, node->source.fd);
 	free(impl);
 }
@@ -2225,7 +2402,7 @@ int pw_impl_node_set_active(struct pw_impl_node *node, bool active)
 			pw_context_recalc_graph(node->context,
 					active ? "node activate" : "node deactivate");
 		else if (!active && node->exported)
-			pw_loop_invoke(node->data_loop, do_node_remove, 1, NULL, 0, true, node);
+			node_remove(node);
 	}
 	return 0;
 }
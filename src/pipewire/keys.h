@@ -61,6 +61,8 @@ extern "C" {
 #define PW_KEY_LIBRARY_NAME_LOOP	"library.name.loop"	/**< name of the loop library to use */
 #define PW_KEY_LIBRARY_NAME_DBUS	"library.name.dbus"	/**< name of the dbus library to use */
 
+#define PW_KEY_LOOP_NAME		"loop.name"		/**< the name of a loop */
+
 /** object properties */
 #define PW_KEY_OBJECT_PATH		"object.path"		/**< unique path to construct the object */
 #define PW_KEY_OBJECT_ID		"object.id"		/**< a global object id */
@@ -192,6 +194,8 @@ extern "C" {
 #define PW_KEY_NODE_TRIGGER		"node.trigger"		/**< the node is not scheduled automatically
 								  *   based on the dependencies in the graph
 								  *   but it will be triggered explicitly. */
+#define PW_KEY_NODE_LOOP_NAME		"node.loop.name"	/**< the name of the data loop to run the
+								  *  node in. */
 
 /** Port keys */
 #define PW_KEY_PORT_ID			"port.id"		/**< port id */
@@ -23,6 +23,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <spa/support/loop.h>
 #include <spa/utils/names.h>
@@ -58,7 +60,7 @@ struct pw_loop *pw_loop_new(const struct spa_dict *props)
 	void *iface;
 	struct spa_support support[32];
 	uint32_t n_support;
-	const char *lib;
+	const char *lib, *str;
 
 	n_support = pw_get_support(support, 32);
 
@@ -70,6 +72,9 @@ struct pw_loop *pw_loop_new(const struct spa_dict *props)
 
 	this = &impl->this;
 
+	if (props && (str = spa_dict_lookup(props, PW_KEY_LOOP_NAME)) != NULL)
+		this->name = strdup(str);
+
 	if (props)
 		lib = spa_dict_lookup(props, PW_KEY_LIBRARY_NAME_SYSTEM);
 	else
@@ -142,6 +147,7 @@ error_unload_loop:
 error_unload_system:
 	pw_unload_spa_handle(impl->system_handle);
 error_free:
+	free((char*)this->name);
 	free(impl);
 error_cleanup:
 	errno = -res;
@@ -158,5 +164,6 @@ void pw_loop_destroy(struct pw_loop *loop)
 
 	pw_unload_spa_handle(impl->loop_handle);
 	pw_unload_spa_handle(impl->system_handle);
+	free((char*)loop->name);
 	free(impl);
 }
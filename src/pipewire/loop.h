@@ -49,6 +49,7 @@ struct pw_loop {
 	struct spa_loop *loop;			/**< wrapped loop */
 	struct spa_loop_control *control;	/**< loop control */
 	struct spa_loop_utils *utils;		/**< loop utils */
+	const char *name;			/**< the loop name, can be NULL */
 };
 
 struct pw_loop *
@@ -705,6 +705,7 @@ void pw_deinit(void)
 	free(support->i18n_domain);
 	spa_zero(global_support);
 	pthread_mutex_unlock(&support_lock);
+	pw_conf_clear_cache();
 done:
 	pthread_mutex_unlock(&init_lock);
 
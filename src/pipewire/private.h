@@ -39,6 +39,7 @@ extern "C" {
 #include <spa/param/latency-utils.h>
 #include <spa/utils/result.h>
 #include <spa/utils/type-info.h>
+#include <spa/utils/histogram.h>
 
 #if defined(__FreeBSD__) || defined(__MidnightBSD__)
 struct ucred {
@@ -383,13 +384,13 @@ pw_core_resource_errorf(struct pw_resource *resource, uint32_t id, int seq,
 	va_end(args);
 }
 
-#define pw_context_driver_emit(c,m,v,...) spa_hook_list_call_simple(&c->driver_listener_list, struct pw_context_driver_events, m, v, ##__VA_ARGS__)
-#define pw_context_driver_emit_start(c,n)	pw_context_driver_emit(c, start, 0, n)
-#define pw_context_driver_emit_xrun(c,n)	pw_context_driver_emit(c, xrun, 0, n)
-#define pw_context_driver_emit_incomplete(c,n)	pw_context_driver_emit(c, incomplete, 0, n)
-#define pw_context_driver_emit_timeout(c,n)	pw_context_driver_emit(c, timeout, 0, n)
-#define pw_context_driver_emit_drained(c,n)	pw_context_driver_emit(c, drained, 0, n)
-#define pw_context_driver_emit_complete(c,n)	pw_context_driver_emit(c, complete, 0, n)
+#define pw_context_driver_emit(c,n,m,v) spa_hook_list_call_simple((n)->driver_listener_list, struct pw_context_driver_events, m, v, n)
+#define pw_context_driver_emit_start(c,n)	pw_context_driver_emit(c, n, start, 0)
+#define pw_context_driver_emit_xrun(c,n)	pw_context_driver_emit(c, n, xrun, 0)
+#define pw_context_driver_emit_incomplete(c,n)	pw_context_driver_emit(c, n, incomplete, 0)
+#define pw_context_driver_emit_timeout(c,n)	pw_context_driver_emit(c, n, timeout, 0)
+#define pw_context_driver_emit_drained(c,n)	pw_context_driver_emit(c, n, drained, 0)
+#define pw_context_driver_emit_complete(c,n)	pw_context_driver_emit(c, n, complete, 0)
 
 struct pw_context_driver_events {
 #define PW_VERSION_CONTEXT_DRIVER_EVENTS	0
@@ -426,6 +427,7 @@ struct pw_context {
 
 	struct pw_properties *conf;		/**< configuration of the context */
 	struct pw_properties *properties;	/**< properties of the context */
+	struct spa_list conf_rules;		/**< compiled match rules */
 
 	struct settings defaults;		/**< default parameters */
 	struct settings settings;		/**< current parameters */
@@ -455,7 +457,6 @@ struct pw_context {
 	struct spa_list export_list;		/**< list of export types */
 	struct spa_list driver_list;		/**< list of driver nodes */
 
-	struct spa_hook_list driver_listener_list;
 	struct spa_hook_list listener_list;
 
 	struct spa_thread_utils *thread_utils;
@@ -564,7 +565,8 @@ struct pw_node_activation_state {
 
 static inline void pw_node_activation_state_reset(struct pw_node_activation_state *state)
 {
-        state->pending = state->required;
+	/* required is updated from the data loops of the peer nodes */
+        state->pending = __atomic_load_n(&state->required, __ATOMIC_SEQ_CST);
 }
 
 #define pw_node_activation_state_dec(s,c) (__atomic_sub_fetch(&(s)->pending, c, __ATOMIC_SEQ_CST) == 0)
@@ -628,6 +630,13 @@ struct pw_node_activation {
 	uint32_t command;				/* next command */
 	uint32_t reposition_owner;			/* owner id with new reposition info, last one
 							 * to update wins */
+
+	/* updated by the driver at the end of each cycle */
+	struct spa_histogram wait_histogram;		/* signal to awake time */
+	struct spa_histogram busy_histogram;		/* awake to finish time */
+	uint32_t incomplete_count;			/* cycles where this node did not finish
+							 * before the next cycle started */
+	uint32_t xrun_pending_count;			/* driver xruns while this node was pending */
 };
 
 #define ATOMIC_CAS(v,ov,nv)						\
@@ -725,6 +734,7 @@ struct pw_impl_node {
 	struct spa_hook_list listener_list;
 
 	struct pw_loop *data_loop;		/**< the data loop for this node */
+	struct spa_hook_list *driver_listener_list;	/**< driver listeners of the data loop */
 
 	struct spa_fraction latency;		/**< requested latency */
 	struct spa_fraction max_latency;	/**< maximum latency */
@@ -1175,6 +1185,17 @@ void pw_proxy_remove(struct pw_proxy *proxy);
 
 int pw_context_recalc_graph(struct pw_context *context, const char *reason);
 
+/** Get the driver listeners of a data loop. Driver events are emitted from
+ * the data loop of the driver so the list must only be changed from that loop. */
+struct spa_hook_list *pw_context_get_driver_listener_list(struct pw_context *context,
+		struct pw_loop *loop);
+/** Call \a callback for each data loop of the context until it returns non 0 */
+int pw_context_for_each_data_loop(struct pw_context *context,
+		int (*callback) (void *data, struct pw_loop *loop), void *data);
+
+void pw_context_conf_clear_rules(struct pw_context *context);
+void pw_conf_clear_cache(void);
+
 void pw_impl_port_update_info(struct pw_impl_port *port, const struct spa_port_info *info);
 
 int pw_impl_port_register(struct pw_impl_port *port,
@@ -35,14 +35,137 @@
 PW_LOG_TOPIC_EXTERN(log_properties);
 #define PW_LOG_TOPIC_DEFAULT log_properties
 
+/* properties with at least this many items get a hash index */
+#define INDEX_MIN_ITEMS	16
+
 /** \cond */
+struct index_slot {
+	uint32_t hash;
+	uint32_t idx;		/* item index + 1, 0 when the slot is free */
+};
+
 struct properties {
 	struct pw_properties this;
 
 	struct pw_array items;
+
+	struct index_slot *index;	/* open addressing, linear probing */
+	uint32_t index_mask;
 };
 /** \endcond */
 
+static inline uint32_t hash_key(const char *key)
+{
+	uint32_t h = 2166136261u;
+	while (*key) {
+		h ^= (uint8_t)*key++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static void index_insert(struct properties *impl, uint32_t hash, uint32_t idx)
+{
+	uint32_t i = hash & impl->index_mask;
+	while (impl->index[i].idx != 0)
+		i = (i + 1) & impl->index_mask;
+	impl->index[i].hash = hash;
+	impl->index[i].idx = idx + 1;
+}
+
+static int index_find_slot(const struct properties *impl, const char *key, uint32_t hash)
+{
+	const struct spa_dict_item *items = impl->items.data;
+	uint32_t i = hash & impl->index_mask;
+
+	while (impl->index[i].idx != 0) {
+		const struct index_slot *s = &impl->index[i];
+		if (s->hash == hash && spa_streq(items[s->idx - 1].key, key))
+			return i;
+		i = (i + 1) & impl->index_mask;
+	}
+	return -1;
+}
+
+static void index_free(struct properties *impl)
+{
+	free(impl->index);
+	impl->index = NULL;
+	impl->index_mask = 0;
+}
+
+/* (re)build the index with room for twice the items, when this fails
+ * we simply continue without an index */
+static void index_rebuild(struct properties *impl)
+{
+	const struct spa_dict_item *items = impl->items.data;
+	uint32_t i, size, n_items = impl->this.dict.n_items;
+
+	index_free(impl);
+
+	size = 32;
+	while (size < n_items * 2)
+		size <<= 1;
+	if ((impl->index = calloc(size, sizeof(struct index_slot))) == NULL)
+		return;
+	impl->index_mask = size - 1;
+
+	for (i = 0; i < n_items; i++)
+		index_insert(impl, hash_key(items[i].key), i);
+}
+
+static void index_add(struct properties *impl, uint32_t idx)
+{
+	uint32_t n_items = impl->this.dict.n_items;
+
+	if (impl->index == NULL) {
+		if (n_items >= INDEX_MIN_ITEMS)
+			index_rebuild(impl);
+	} else if (n_items * 2 > impl->index_mask + 1) {
+		index_rebuild(impl);
+	} else {
+		const struct spa_dict_item *items = impl->items.data;
+		index_insert(impl, hash_key(items[idx].key), idx);
+	}
+}
+
+/* remove the slot of the item at \a idx and move the slot of
+ * the item at \a last to \a idx */
+static void index_remove(struct properties *impl, uint32_t idx, uint32_t last)
+{
+	const struct spa_dict_item *items = impl->items.data;
+	uint32_t i, j, k, mask = impl->index_mask;
+	int slot;
+
+	if (impl->index == NULL)
+		return;
+
+	if ((slot = index_find_slot(impl, items[idx].key, hash_key(items[idx].key))) < 0)
+		goto error;
+
+	/* backward shift deletion, keeps the probe sequences intact */
+	i = slot;
+	for (j = (i + 1) & mask; impl->index[j].idx != 0; j = (j + 1) & mask) {
+		k = impl->index[j].hash & mask;
+		if ((j > i && (k <= i || k > j)) ||
+		    (j < i && (k <= i && k > j))) {
+			impl->index[i] = impl->index[j];
+			i = j;
+		}
+	}
+	impl->index[i].idx = 0;
+
+	if (idx != last) {
+		if ((slot = index_find_slot(impl, items[last].key, hash_key(items[last].key))) < 0)
+			goto error;
+		impl->index[slot].idx = idx + 1;
+	}
+	return;
+error:
+	pw_log_warn("%p: index out of sync, dropping", impl);
+	index_free(impl);
+}
+
 static int add_func(struct pw_properties *this, char *key, char *value)
 {
 	struct spa_dict_item *item;
@@ -60,6 +183,8 @@ static int add_func(struct pw_properties *this, char *key, char *value)
 
 	this->dict.items = impl->items.data;
 	this->dict.n_items++;
+
+	index_add(impl, this->dict.n_items - 1);
 	return 0;
 }
 
@@ -71,7 +196,15 @@ static void clear_item(struct spa_dict_item *item)
 
 static int find_index(const struct pw_properties *this, const char *key)
 {
+	const struct properties *impl = SPA_CONTAINER_OF(this, const struct properties, this);
 	const struct spa_dict_item *item;
+	int slot;
+
+	if (impl->index != NULL && key != NULL) {
+		if ((slot = index_find_slot(impl, key, hash_key(key))) < 0)
+			return -1;
+		return impl->index[slot].idx - 1;
+	}
 	item = spa_dict_lookup_item(&this->dict, key);
 	if (item == NULL)
 		return -1;
@@ -287,6 +420,7 @@ void pw_properties_clear(struct pw_properties *properties)
 		clear_item(item);
 	pw_array_reset(&impl->items);
 	properties->dict.n_items = 0;
+	index_free(impl);
 }
 
 /** Update properties
@@ -401,9 +535,10 @@ static int do_replace(struct pw_properties *properties, const char *key, char *v
 			goto exit_noupdate;
 
 		if (value == NULL) {
+			uint32_t last_index = pw_array_get_len(&impl->items, struct spa_dict_item) - 1;
 			struct spa_dict_item *last = pw_array_get_unchecked(&impl->items,
-						     pw_array_get_len(&impl->items, struct spa_dict_item) - 1,
-						     struct spa_dict_item);
+						     last_index, struct spa_dict_item);
+			index_remove(impl, index, last_index);
 			clear_item(item);
 			item->key = last->key;
 			item->value = last->value;
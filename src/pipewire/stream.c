@@ -102,6 +102,7 @@ struct stream {
 
 	struct pw_context *context;
 	struct spa_hook context_listener;
+	struct pw_loop *data_loop;
 
 	enum spa_direction direction;
 	enum pw_stream_flags flags;
@@ -478,7 +479,7 @@ static int impl_set_io(void *object, uint32_t id, void *data, size_t size)
 		else
 			impl->position = NULL;
 
-		pw_loop_invoke(impl->context->data_loop,
+		pw_loop_invoke(impl->data_loop,
 				do_set_position, 1, NULL, 0, true, impl);
 		break;
 	default:
@@ -1391,6 +1392,26 @@ static const struct pw_context_driver_events context_events = {
 	.drained = context_drained,
 };
 
+static int
+do_add_context_listener(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct stream *impl = user_data;
+	spa_hook_list_append(impl->node->driver_listener_list,
+			&impl->context_listener,
+			&context_events, impl);
+	return 0;
+}
+
+static int
+do_remove_context_listener(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct stream *impl = user_data;
+	spa_hook_remove(&impl->context_listener);
+	return 0;
+}
+
 struct match {
 	struct pw_stream *stream;
 	int count;
@@ -1489,12 +1510,10 @@ stream_new(struct pw_context *context, const char *name,
 	this->state = PW_STREAM_STATE_UNCONNECTED;
 
 	impl->context = context;
+	impl->data_loop = context->data_loop;
 	impl->allow_mlock = context->settings.mem_allow_mlock;
 	impl->warn_mlock = context->settings.mem_warn_mlock;
 
-	spa_hook_list_append(&impl->context->driver_listener_list,
-			&impl->context_listener,
-			&context_events, impl);
 	return impl;
 
 error_properties:
@@ -1626,8 +1645,6 @@ void pw_stream_destroy(struct pw_stream *stream)
 	spa_hook_list_clean(&impl->hooks);
 	spa_hook_list_clean(&stream->listener_list);
 
-	spa_hook_remove(&impl->context_listener);
-
 	if (impl->data.context)
 		pw_context_destroy(impl->data.context);
 
@@ -1970,6 +1987,11 @@ pw_stream_connect(struct pw_stream *stream,
 		}
 		pw_impl_node_set_implementation(impl->node, &impl->impl_node);
 	}
+	impl->data_loop = impl->node->data_loop;
+
+	pw_loop_invoke(impl->data_loop,
+			do_add_context_listener, 1, NULL, 0, true, impl);
+
 	pw_impl_node_set_active(impl->node,
 			!SPA_FLAG_IS_SET(impl->flags, PW_STREAM_FLAG_INACTIVE));
 
@@ -2029,6 +2051,8 @@ int pw_stream_disconnect(struct pw_stream *stream)
 	}
 
 	if (impl->node) {
+		pw_loop_invoke(impl->data_loop,
+				do_remove_context_listener, 1, NULL, 0, true, impl);
 		pw_impl_node_destroy(impl->node);
 		impl->node = NULL;
 	}
@@ -2278,7 +2302,7 @@ int pw_stream_queue_buffer(struct pw_stream *stream, struct pw_buffer *buffer)
 	if (impl->direction == SPA_DIRECTION_OUTPUT &&
 	    impl->driving && !impl->using_trigger) {
 		pw_log_debug("deprecated: use pw_stream_trigger_process() to drive the stream.");
-		res = pw_loop_invoke(impl->context->data_loop,
+		res = pw_loop_invoke(impl->data_loop,
 			do_trigger_deprecated, 1, NULL, 0, false, impl);
 	}
 	return res;
@@ -2319,7 +2343,7 @@ SPA_EXPORT
 int pw_stream_flush(struct pw_stream *stream, bool drain)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	pw_loop_invoke(impl->context->data_loop,
+	pw_loop_invoke(impl->data_loop,
 			drain ? do_drain : do_flush, 1, NULL, 0, true, impl);
 	if (!drain)
 		spa_node_send_command(impl->node->node,
@@ -2381,7 +2405,7 @@ int pw_stream_trigger_process(struct pw_stream *stream)
 			pw_loop_invoke(impl->context->main_loop,
 				do_call_process, 1, NULL, 0, false, impl);
 		}
-		res = pw_loop_invoke(impl->context->data_loop,
+		res = pw_loop_invoke(impl->data_loop,
 			do_trigger_process, 1, NULL, 0, false, impl);
 	}
 	return res;
@@ -29,6 +29,7 @@
 
 #include <spa/utils/result.h>
 #include <spa/utils/string.h>
+#include <spa/utils/json.h>
 #include <spa/pod/parser.h>
 #include <spa/debug/pod.h>
 
@@ -37,13 +38,24 @@
 
 #define MAX_NAME		128
 #define MAX_FOLLOWERS		64
+#define MAX_RECORD		(64 * 1024)
+#define RING_INTERVAL		(100 * SPA_NSEC_PER_MSEC)
 #define DEFAULT_FILENAME	"profiler.log"
+#define TRACE_PID		1
 
 struct follower {
 	uint32_t id;
 	char name[MAX_NAME];
 };
 
+struct node_name {
+	struct spa_list link;
+	uint32_t id;
+	char name[MAX_NAME];
+	int32_t xrun_count;
+	unsigned int have_xrun_count:1;
+};
+
 struct data {
 	struct pw_main_loop *loop;
 	struct pw_context *context;
@@ -57,6 +69,11 @@ struct data {
 	const char *filename;
 	FILE *output;
 
+	const char *trace_filename;
+	FILE *trace;
+	uint64_t n_trace_events;
+	unsigned int trace_warned:1;
+
 	int64_t count;
 	int64_t start_status;
 	int64_t last_status;
@@ -65,6 +82,12 @@ struct data {
 	struct spa_hook profiler_listener;
 	int check_profiler;
 
+	struct pw_memmap *ring_map;
+	struct pw_profiler_ring_reader ring;
+	struct spa_source *ring_timer;
+	void *record;
+	struct spa_list names;
+
 	uint32_t driver_id;
 
 	int n_followers;
@@ -112,6 +135,20 @@ static int process_clock(struct data *d, const struct spa_pod *pod, struct point
 			SPA_POD_Long(&point->clock.next_nsec));
 }
 
+static int update_driver(struct data *d, uint32_t driver_id,
+		struct measurement *driver, struct point *point)
+{
+	if (d->driver_id == 0) {
+		d->driver_id = driver_id;
+		printf("logging driver %u\n", driver_id);
+	}
+	else if (d->driver_id != driver_id)
+		return -1;
+
+	point->driver = *driver;
+	return 0;
+}
+
 static int process_driver_block(struct data *d, const struct spa_pod *pod, struct point *point)
 {
 	char *name = NULL;
@@ -130,15 +167,7 @@ static int process_driver_block(struct data *d, const struct spa_pod *pod, struc
 			SPA_POD_Int(&driver.status))) < 0)
 		return res;
 
-	if (d->driver_id == 0) {
-		d->driver_id = driver_id;
-		printf("logging driver %u\n", driver_id);
-	}
-	else if (d->driver_id != driver_id)
-		return -1;
-
-	point->driver = driver;
-	return 0;
+	return update_driver(d, driver_id, &driver, point);
 }
 
 static int find_follower(struct data *d, uint32_t id, const char *name)
@@ -168,12 +197,27 @@ static int add_follower(struct data *d, uint32_t id, const char *name)
 	return idx;
 }
 
+static int update_follower(struct data *d, uint32_t id, const char *name,
+		struct measurement *m, struct point *point)
+{
+	int idx;
+
+	if ((idx = find_follower(d, id, name)) < 0) {
+		if ((idx = add_follower(d, id, name)) < 0) {
+			pw_log_warn("too many followers");
+			return -ENOSPC;
+		}
+	}
+	point->follower[idx] = *m;
+	return 0;
+}
+
 static int process_follower_block(struct data *d, const struct spa_pod *pod, struct point *point)
 {
 	uint32_t id = 0;
 	const char *name =  NULL;
 	struct measurement m;
-	int res, idx;
+	int res;
 
 	spa_zero(m);
 	if ((res = spa_pod_parse_struct(pod,
@@ -186,14 +230,7 @@ static int process_follower_block(struct data *d, const struct spa_pod *pod, str
 			SPA_POD_Int(&m.status))) < 0)
 		return res;
 
-	if ((idx = find_follower(d, id, name)) < 0) {
-		if ((idx = add_follower(d, id, name)) < 0) {
-			pw_log_warn("too many followers");
-			return -ENOSPC;
-		}
-	}
-	point->follower[idx] = m;
-	return 0;
+	return update_follower(d, id, name, &m, point);
 }
 
 static void dump_point(struct data *d, struct point *point)
@@ -431,6 +468,12 @@ static void profiler_profile(void *data, const struct spa_pod *pod)
 	struct spa_pod_prop *p;
 	struct point point;
 
+	if (d->trace != NULL && !d->trace_warned) {
+		fprintf(stderr, "The profiler of the server has no ring, "
+				"no trace events will be written\n");
+		d->trace_warned = true;
+	}
+
 	SPA_POD_STRUCT_FOREACH(pod, o) {
 		int res = 0;
 		if (!spa_pod_is_object_type(o, SPA_TYPE_OBJECT_Profiler))
@@ -464,9 +507,284 @@ static void profiler_profile(void *data, const struct spa_pod *pod)
 	}
 }
 
+static struct node_name *find_name(struct data *d, uint32_t id)
+{
+	struct node_name *n;
+	spa_list_for_each(n, &d->names, link) {
+		if (n->id == id)
+			return n;
+	}
+	return NULL;
+}
+
+static void block_to_measurement(const struct pw_profiler_block *b, struct measurement *m)
+{
+	spa_zero(*m);
+	m->prev_signal = b->prev_signal_time;
+	m->signal = b->signal_time;
+	m->awake = b->awake_time;
+	m->finish = b->finish_time;
+	m->status = b->status;
+}
+
+/* The trace is written in the Chrome trace event format, which can be
+ * loaded in chrome://tracing and ui.perfetto.dev. All nodes are threads
+ * of one process so that each node gets its own track. */
+static void trace_begin(struct data *d, const char *ph, const char *name, uint32_t tid)
+{
+	fprintf(d->trace, "%s\n{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%u",
+			d->n_trace_events++ ? "," : "", ph, name, TRACE_PID, tid);
+}
+
+static void trace_time(struct data *d, const char *key, int64_t nsec)
+{
+	/* the trace event times are in microseconds */
+	fprintf(d->trace, ",\"%s\":%"PRIi64".%03"PRIi64, key,
+			nsec / 1000, nsec % 1000);
+}
+
+static void trace_node_name(struct data *d, uint32_t id, const char *name)
+{
+	char buf[MAX_NAME * 6 + 3];
+
+	if (d->trace == NULL)
+		return;
+
+	spa_json_encode_string(buf, sizeof(buf), name);
+	trace_begin(d, "M", "thread_name", id);
+	fprintf(d->trace, ",\"args\":{\"name\":%s}}", buf);
+	trace_begin(d, "M", "thread_sort_index", id);
+	fprintf(d->trace, ",\"args\":{\"sort_index\":%u}}", id);
+}
+
+static void trace_span(struct data *d, const char *name, uint32_t id,
+		int64_t start, int64_t end, const char *args)
+{
+	trace_begin(d, "X", name, id);
+	trace_time(d, "ts", start);
+	trace_time(d, "dur", end - start);
+	fprintf(d->trace, "%s}", args);
+}
+
+static void trace_record(struct data *d, const struct pw_profiler_record *r)
+{
+	const struct pw_profiler_block *driver = &r->blocks[0];
+	struct node_name *n;
+	char args[256], name[64], load[3][64];
+	uint32_t i;
+
+	/* the driver track has a span for each cycle, from the start of the
+	 * cycle until the graph completed */
+	snprintf(args, sizeof(args),
+			",\"args\":{\"count\":%"PRIi64",\"quantum\":%"PRIu64
+			",\"rate\":%u,\"delay\":%"PRIi64"}",
+			r->count, r->clock_duration, r->clock_rate.denom, r->clock_delay);
+	if (driver->finish_time >= driver->signal_time)
+		trace_span(d, "cycle", driver->id, driver->signal_time,
+				driver->finish_time, args);
+	else {
+		trace_begin(d, "i", "incomplete", driver->id);
+		trace_time(d, "ts", driver->signal_time);
+		fprintf(d->trace, ",\"s\":\"t\"%s}", args);
+	}
+
+	/* counters are per process and name, add the driver id to the name */
+	snprintf(name, sizeof(name), "cpu load %u", driver->id);
+	trace_begin(d, "C", name, driver->id);
+	trace_time(d, "ts", driver->signal_time);
+	/* the locale can use a decimal comma */
+	for (i = 0; i < 3; i++)
+		spa_json_format_float(load[i], sizeof(load[i]), r->cpu_load[i]);
+	fprintf(d->trace, ",\"args\":{\"fast\":%s,\"medium\":%s,\"slow\":%s}}",
+			load[0], load[1], load[2]);
+
+	if ((n = find_name(d, driver->id)) != NULL) {
+		if (n->have_xrun_count && r->xrun_count != n->xrun_count) {
+			/* the xrun happened before this cycle started */
+			trace_begin(d, "i", "xrun", driver->id);
+			trace_time(d, "ts", driver->signal_time);
+			fprintf(d->trace, ",\"s\":\"p\",\"args\":{\"xruns\":%d}}",
+					r->xrun_count - n->xrun_count);
+		}
+		n->xrun_count = r->xrun_count;
+		n->have_xrun_count = true;
+	}
+
+	for (i = 1; i < r->n_blocks; i++) {
+		const struct pw_profiler_block *b = &r->blocks[i];
+
+		snprintf(args, sizeof(args), ",\"args\":{\"driver\":%u,\"status\":%d}",
+				driver->id, b->status);
+
+		if (b->signal_time < driver->signal_time) {
+			/* not signaled in this cycle */
+			continue;
+		}
+		if (b->awake_time < b->signal_time) {
+			trace_begin(d, "i", "not awake", b->id);
+			trace_time(d, "ts", b->signal_time);
+			fprintf(d->trace, ",\"s\":\"t\"%s}", args);
+			continue;
+		}
+		trace_span(d, "wait", b->id, b->signal_time, b->awake_time, args);
+
+		if (b->finish_time < b->awake_time) {
+			trace_begin(d, "i", "not finished", b->id);
+			trace_time(d, "ts", b->awake_time);
+			fprintf(d->trace, ",\"s\":\"t\"%s}", args);
+			continue;
+		}
+		trace_span(d, "busy", b->id, b->awake_time, b->finish_time, args);
+	}
+}
+
+static int trace_open(struct data *d)
+{
+	struct node_name *n;
+
+	d->trace = fopen(d->trace_filename, "w");
+	if (d->trace == NULL)
+		return -errno;
+
+	fprintf(d->trace, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	trace_begin(d, "M", "process_name", 0);
+	fprintf(d->trace, ",\"args\":{\"name\":\"PipeWire graph\"}}");
+
+	spa_list_for_each(n, &d->names, link)
+		trace_node_name(d, n->id, n->name);
+	return 0;
+}
+
+static void trace_close(struct data *d)
+{
+	if (d->trace == NULL)
+		return;
+	fprintf(d->trace, "\n]}\n");
+	fclose(d->trace);
+	d->trace = NULL;
+	printf("wrote %"PRIu64" trace events to %s\n", d->n_trace_events, d->trace_filename);
+}
+
+static void process_record(struct data *d, const struct pw_profiler_record *r)
+{
+	struct point point;
+	struct measurement m;
+	struct node_name *n;
+	char name[MAX_NAME];
+	uint32_t i;
+
+	if (r->n_blocks == 0 ||
+	    r->size < sizeof(*r) + r->n_blocks * sizeof(struct pw_profiler_block))
+		return;
+
+	if (d->trace != NULL)
+		trace_record(d, r);
+
+	spa_zero(point);
+	point.count = r->count;
+	point.cpu_load[0] = r->cpu_load[0];
+	point.cpu_load[1] = r->cpu_load[1];
+	point.cpu_load[2] = r->cpu_load[2];
+	point.clock.flags = r->clock_flags;
+	point.clock.id = r->clock_id;
+	point.clock.nsec = r->clock_nsec;
+	point.clock.rate = r->clock_rate;
+	point.clock.position = r->clock_position;
+	point.clock.duration = r->clock_duration;
+	point.clock.delay = r->clock_delay;
+	point.clock.rate_diff = r->clock_rate_diff;
+	point.clock.next_nsec = r->clock_next_nsec;
+
+	block_to_measurement(&r->blocks[0], &m);
+	if (update_driver(d, r->blocks[0].id, &m, &point) < 0)
+		return;
+
+	for (i = 1; i < r->n_blocks; i++) {
+		const struct pw_profiler_block *b = &r->blocks[i];
+
+		if ((n = find_name(d, b->id)) != NULL)
+			snprintf(name, sizeof(name), "%s", n->name);
+		else
+			snprintf(name, sizeof(name), "%u", b->id);
+
+		block_to_measurement(b, &m);
+		update_follower(d, b->id, name, &m, &point);
+	}
+	dump_point(d, &point);
+}
+
+static void do_read_ring(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	int res;
+
+	while ((res = pw_profiler_ring_read(&d->ring, d->record, MAX_RECORD)) != 0) {
+		if (res == -EPIPE)
+			pw_log_warn("profiler records lost");
+		else if (res > 0)
+			process_record(d, d->record);
+	}
+}
+
+static void profiler_ring(void *data, uint32_t mem_id, uint32_t offset, uint32_t size)
+{
+	struct data *d = data;
+	struct timespec interval;
+
+	if (d->ring_map != NULL)
+		return;
+
+	d->ring_map = pw_mempool_map_id(pw_core_get_mempool(d->core), mem_id,
+			PW_MEMMAP_FLAG_READ, offset, size, NULL);
+	if (d->ring_map == NULL) {
+		pw_log_error("can't map profiler ring: %m");
+		return;
+	}
+	if (pw_profiler_ring_reader_init(&d->ring, d->ring_map->ptr, size) < 0) {
+		pw_log_error("invalid profiler ring");
+		pw_memmap_free(d->ring_map);
+		d->ring_map = NULL;
+		return;
+	}
+	if ((d->record = malloc(MAX_RECORD)) == NULL) {
+		pw_log_error("can't allocate record: %m");
+		return;
+	}
+
+	d->ring_timer = pw_loop_add_timer(pw_main_loop_get_loop(d->loop), do_read_ring, d);
+	interval.tv_sec = 0;
+	interval.tv_nsec = RING_INTERVAL;
+	pw_loop_update_timer(pw_main_loop_get_loop(d->loop), d->ring_timer,
+			&interval, &interval, false);
+}
+
+static void profiler_node(void *data, uint32_t id, const char *name)
+{
+	struct data *d = data;
+	struct node_name *n;
+
+	if ((n = find_name(d, id)) == NULL) {
+		if (name == NULL)
+			return;
+		if ((n = calloc(1, sizeof(*n))) == NULL)
+			return;
+		n->id = id;
+		spa_list_append(&d->names, &n->link);
+	}
+	if (name == NULL) {
+		spa_list_remove(&n->link);
+		free(n);
+		return;
+	}
+	snprintf(n->name, sizeof(n->name), "%s", name);
+	trace_node_name(d, id, n->name);
+}
+
 static const struct pw_profiler_events profiler_events = {
 	PW_VERSION_PROFILER_EVENTS,
         .profile = profiler_profile,
+	.ring = profiler_ring,
+	.node = profiler_node,
 };
 
 static void registry_event_global(void *data, uint32_t id,
@@ -491,6 +809,8 @@ static void registry_event_global(void *data, uint32_t id,
 	printf("Attaching to Profiler id:%d\n", id);
 	d->profiler = proxy;
 	pw_proxy_add_object_listener(proxy, &d->profiler_listener, &profiler_events, d);
+	if (version >= 4)
+		pw_profiler_enable_ring((struct pw_profiler*)proxy);
 
 	return;
 
@@ -546,7 +866,8 @@ static void show_help(const char *name, bool error)
 		"  -h, --help                            Show this help\n"
 		"      --version                         Show version\n"
 		"  -r, --remote                          Remote daemon name\n"
-		"  -o, --output                          Profiler output name (default \"%s\")\n",
+		"  -o, --output                          Profiler output name (default \"%s\")\n"
+		"  -t, --trace                           Write a Chrome trace event file\n",
 		name,
 		DEFAULT_FILENAME);
 }
@@ -562,14 +883,16 @@ int main(int argc, char *argv[])
 		{ "version",	no_argument,		NULL, 'V' },
 		{ "remote",	required_argument,	NULL, 'r' },
 		{ "output",	required_argument,	NULL, 'o' },
+		{ "trace",	required_argument,	NULL, 't' },
 		{ NULL, 0, NULL, 0}
 	};
 	int c;
+	struct node_name *n;
 
 	setlocale(LC_ALL, "");
 	pw_init(&argc, &argv);
 
-	while ((c = getopt_long(argc, argv, "hVr:o:", long_options, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hVr:o:t:", long_options, NULL)) != -1) {
 		switch (c) {
 		case 'h':
 			show_help(argv[0], false);
@@ -585,6 +908,9 @@ int main(int argc, char *argv[])
 		case 'o':
 			opt_output = optarg;
 			break;
+		case 't':
+			data.trace_filename = optarg;
+			break;
 		case 'r':
 			opt_remote = optarg;
 			break;
@@ -594,6 +920,8 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	spa_list_init(&data.names);
+
 	data.loop = pw_main_loop_new(NULL);
 	if (data.loop == NULL) {
 		fprintf(stderr, "Can't create data loop: %m\n");
@@ -632,6 +960,14 @@ int main(int argc, char *argv[])
 
 	printf("Logging to %s\n", data.filename);
 
+	if (data.trace_filename != NULL) {
+		if (trace_open(&data) < 0) {
+			fprintf(stderr, "Can't open file %s: %m\n", data.trace_filename);
+			return -1;
+		}
+		printf("Tracing to %s\n", data.trace_filename);
+	}
+
 	pw_core_add_listener(data.core,
 				   &data.core_listener,
 				   &core_events, &data);
@@ -645,6 +981,19 @@ int main(int argc, char *argv[])
 
 	pw_main_loop_run(data.loop);
 
+	if (data.ring_map && data.record)
+		do_read_ring(&data, 0);
+	trace_close(&data);
+	if (data.ring_timer)
+		pw_loop_destroy_source(l, data.ring_timer);
+	if (data.ring_map)
+		pw_memmap_free(data.ring_map);
+	free(data.record);
+	spa_list_consume(n, &data.names, link) {
+		spa_list_remove(&n->link);
+		free(n);
+	}
+
 	if (data.profiler) {
 		spa_hook_remove(&data.profiler_listener);
 		pw_proxy_destroy((struct pw_proxy*)data.profiler);
@@ -37,6 +37,8 @@
 #include <pipewire/extensions/profiler.h>
 
 #define MAX_NAME		128
+#define MAX_RECORD		(64 * 1024)
+#define RING_INTERVAL		(100 * SPA_NSEC_PER_MSEC)
 
 struct driver {
 	int64_t count;
@@ -66,6 +68,7 @@ struct node {
 	uint32_t errors;
 	int32_t last_error_status;
 	uint32_t generation;
+	struct pw_profiler_node_stats stats;
 };
 
 struct data {
@@ -82,12 +85,19 @@ struct data {
 	struct spa_hook profiler_listener;
 	int check_profiler;
 
+	struct pw_memmap *ring_map;
+	struct pw_profiler_ring_reader ring;
+	struct spa_source *ring_timer;
+	void *record;
+
 	struct spa_source *timer;
 
 	int n_nodes;
 	struct spa_list node_list;
 	uint32_t generation;
 
+	unsigned int show_latency:1;
+
 	WINDOW *win;
 };
 
@@ -157,12 +167,50 @@ static void remove_node(struct data *d, struct node *n)
 	free(n);
 }
 
+static int update_driver(struct data *d, uint32_t id, struct measurement *m, struct point *point)
+{
+	struct node *n;
+
+	if ((n = find_node(d, id)) == NULL)
+		return -ENOENT;
+
+	n->driver = n;
+	n->measurement = *m;
+	n->info = point->info;
+	point->driver = n;
+	n->generation = d->generation;
+
+	if (m->status != 3) {
+		n->errors++;
+		if (n->last_error_status == -1)
+			n->last_error_status = m->status;
+	}
+	return 0;
+}
+
+static int update_follower(struct data *d, uint32_t id, struct measurement *m, struct point *point)
+{
+	struct node *n;
+
+	if ((n = find_node(d, id)) == NULL)
+		return -ENOENT;
+
+	n->measurement = *m;
+	n->driver = point->driver;
+	n->generation = d->generation;
+	if (m->status != 3) {
+		n->errors++;
+		if (n->last_error_status == -1)
+			n->last_error_status = m->status;
+	}
+	return 0;
+}
+
 static int process_driver_block(struct data *d, const struct spa_pod *pod, struct point *point)
 {
 	char *name = NULL;
 	uint32_t id = 0;
 	struct measurement m;
-	struct node *n;
 	int res;
 
 	spa_zero(m);
@@ -177,21 +225,7 @@ static int process_driver_block(struct data *d, const struct spa_pod *pod, struc
 			SPA_POD_Fraction(&m.latency))) < 0)
 		return res;
 
-	if ((n = find_node(d, id)) == NULL)
-		return -ENOENT;
-
-	n->driver = n;
-	n->measurement = m;
-	n->info = point->info;
-	point->driver = n;
-	n->generation = d->generation;
-
-	if (m.status != 3) {
-		n->errors++;
-		if (n->last_error_status == -1)
-			n->last_error_status = m.status;
-	}
-	return 0;
+	return update_driver(d, id, &m, point);
 }
 
 static int process_follower_block(struct data *d, const struct spa_pod *pod, struct point *point)
@@ -199,7 +233,6 @@ static int process_follower_block(struct data *d, const struct spa_pod *pod, str
 	uint32_t id = 0;
 	const char *name =  NULL;
 	struct measurement m;
-	struct node *n;
 	int res;
 
 	spa_zero(m);
@@ -214,18 +247,65 @@ static int process_follower_block(struct data *d, const struct spa_pod *pod, str
 			SPA_POD_Fraction(&m.latency))) < 0)
 		return res;
 
-	if ((n = find_node(d, id)) == NULL)
-		return -ENOENT;
+	return update_follower(d, id, &m, point);
+}
 
-	n->measurement = m;
-	n->driver = point->driver;
-	n->generation = d->generation;
-	if (m.status != 3) {
-		n->errors++;
-		if (n->last_error_status == -1)
-			n->last_error_status = m.status;
+static void block_to_measurement(const struct pw_profiler_block *b, struct measurement *m)
+{
+	spa_zero(*m);
+	m->prev_signal = b->prev_signal_time;
+	m->signal = b->signal_time;
+	m->awake = b->awake_time;
+	m->finish = b->finish_time;
+	m->status = b->status;
+	m->latency = b->latency;
+}
+
+static void process_record(struct data *d, const struct pw_profiler_record *r)
+{
+	struct point point;
+	struct measurement m;
+	uint32_t i;
+
+	if (r->n_blocks == 0 ||
+	    r->size < sizeof(*r) + r->n_blocks * sizeof(struct pw_profiler_block))
+		return;
+
+	spa_zero(point);
+	point.info.count = r->count;
+	point.info.cpu_load[0] = r->cpu_load[0];
+	point.info.cpu_load[1] = r->cpu_load[1];
+	point.info.cpu_load[2] = r->cpu_load[2];
+	point.info.xrun_count = r->xrun_count;
+	point.info.clock.flags = r->clock_flags;
+	point.info.clock.id = r->clock_id;
+	point.info.clock.nsec = r->clock_nsec;
+	point.info.clock.rate = r->clock_rate;
+	point.info.clock.position = r->clock_position;
+	point.info.clock.duration = r->clock_duration;
+	point.info.clock.delay = r->clock_delay;
+	point.info.clock.rate_diff = r->clock_rate_diff;
+	point.info.clock.next_nsec = r->clock_next_nsec;
+
+	block_to_measurement(&r->blocks[0], &m);
+	if (update_driver(d, r->blocks[0].id, &m, &point) < 0)
+		return;
+
+	for (i = 1; i < r->n_blocks; i++) {
+		block_to_measurement(&r->blocks[i], &m);
+		update_follower(d, r->blocks[i].id, &m, &point);
+	}
+}
+
+static void do_read_ring(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	int res;
+
+	while ((res = pw_profiler_ring_read(&d->ring, d->record, MAX_RECORD)) != 0) {
+		if (res > 0)
+			process_record(d, d->record);
 	}
-	return 0;
 }
 
 static const char *print_time(char *buf, size_t len, uint64_t val)
@@ -303,6 +383,34 @@ static void print_node(struct data *d, struct driver *i, struct node *n, int y)
 			n->name);
 }
 
+static void print_node_latency(struct data *d, struct node *n, int y)
+{
+	const struct pw_profiler_node_stats *s = &n->stats;
+	char buf[6][64];
+
+	mvwprintw(d->win, y, 0, "%s %4.1u %s %s %s %s %s %s %4.1u %4.1u  %s%s",
+			n->measurement.status != 3 ? "!" : " ",
+			n->id,
+			print_time(buf[0], 64, spa_histogram_percentile(&s->wait, 0.99)),
+			print_time(buf[1], 64, spa_histogram_percentile(&s->wait, 0.999)),
+			print_time(buf[2], 64, s->wait.max),
+			print_time(buf[3], 64, spa_histogram_percentile(&s->busy, 0.99)),
+			print_time(buf[4], 64, spa_histogram_percentile(&s->busy, 0.999)),
+			print_time(buf[5], 64, s->busy.max),
+			s->incomplete_count,
+			s->xrun_pending_count,
+			n->driver == n ? "" : " + ",
+			n->name);
+}
+
+static void do_print_node(struct data *d, struct driver *i, struct node *n, int y)
+{
+	if (d->show_latency)
+		print_node_latency(d, n, y);
+	else
+		print_node(d, i, n, y);
+}
+
 static void do_refresh(struct data *d)
 {
 	struct node *n, *t, *f;
@@ -310,7 +418,10 @@ static void do_refresh(struct data *d)
 
 	wclear(d->win);
 	wattron(d->win, A_REVERSE);
-	wprintw(d->win, "%-*.*s", COLS, COLS, "S   ID  QUANT   RATE    WAIT    BUSY   W/Q   B/Q  ERR  NAME ");
+	if (d->show_latency)
+		wprintw(d->win, "%-*.*s", COLS, COLS, "S   ID  WAIT99 WAIT999 WAITMAX  BUSY99 BUSY999 BUSYMAX  INC  XRP  NAME ");
+	else
+		wprintw(d->win, "%-*.*s", COLS, COLS, "S   ID  QUANT   RATE    WAIT    BUSY   W/Q   B/Q  ERR  NAME ");
 	wattroff(d->win, A_REVERSE);
 	wprintw(d->win, "\n");
 
@@ -318,7 +429,7 @@ static void do_refresh(struct data *d)
 		if (n->driver != n)
 			continue;
 
-		print_node(d, &n->info, n, y++);
+		do_print_node(d, &n->info, n, y++);
 		if(y > LINES)
 			break;
 
@@ -334,7 +445,7 @@ static void do_refresh(struct data *d)
 			if (f->driver != n || f == n)
 				continue;
 
-			print_node(d, &n->info, f, y++);
+			do_print_node(d, &n->info, f, y++);
 			if(y > LINES)
 				break;
 
@@ -393,9 +504,53 @@ static void profiler_profile(void *data, const struct spa_pod *pod)
 	}
 }
 
+static void profiler_ring(void *data, uint32_t mem_id, uint32_t offset, uint32_t size)
+{
+	struct data *d = data;
+	struct timespec interval;
+
+	if (d->ring_map != NULL)
+		return;
+
+	d->ring_map = pw_mempool_map_id(pw_core_get_mempool(d->core), mem_id,
+			PW_MEMMAP_FLAG_READ, offset, size, NULL);
+	if (d->ring_map == NULL) {
+		pw_log_error("can't map profiler ring: %m");
+		return;
+	}
+	if (pw_profiler_ring_reader_init(&d->ring, d->ring_map->ptr, size) < 0) {
+		pw_log_error("invalid profiler ring");
+		pw_memmap_free(d->ring_map);
+		d->ring_map = NULL;
+		return;
+	}
+	if ((d->record = malloc(MAX_RECORD)) == NULL) {
+		pw_log_error("can't allocate record: %m");
+		return;
+	}
+
+	d->ring_timer = pw_loop_add_timer(pw_main_loop_get_loop(d->loop), do_read_ring, d);
+	interval.tv_sec = 0;
+	interval.tv_nsec = RING_INTERVAL;
+	pw_loop_update_timer(pw_main_loop_get_loop(d->loop), d->ring_timer,
+			&interval, &interval, false);
+}
+
+static void profiler_node_stats(void *data, uint32_t id,
+		const struct pw_profiler_node_stats *stats)
+{
+	struct data *d = data;
+	struct node *n;
+
+	if ((n = find_node(d, id)) != NULL)
+		n->stats = *stats;
+}
+
 static const struct pw_profiler_events profiler_events = {
 	PW_VERSION_PROFILER_EVENTS,
         .profile = profiler_profile,
+	.ring = profiler_ring,
+	.node_stats = profiler_node_stats,
 };
 
 static void registry_event_global(void *data, uint32_t id,
@@ -428,6 +583,8 @@ static void registry_event_global(void *data, uint32_t id,
 
 		d->profiler = proxy;
 		pw_proxy_add_object_listener(proxy, &d->profiler_listener, &profiler_events, d);
+		if (version >= 4)
+			pw_profiler_enable_ring((struct pw_profiler*)proxy);
 	}
 
 	return;
@@ -520,6 +677,10 @@ static void do_handle_io(void *data, int fd, uint32_t mask)
 		case 'q':
 			pw_main_loop_quit(d->loop);
 			break;
+		case 'l':
+			d->show_latency = !d->show_latency;
+			do_refresh(d);
+			break;
 		default:
 			do_refresh(d);
 			break;
@@ -628,6 +789,12 @@ int main(int argc, char *argv[])
 	spa_list_consume(n, &data.node_list, link)
 		remove_node(&data, n);
 
+	if (data.ring_timer)
+		pw_loop_destroy_source(l, data.ring_timer);
+	if (data.ring_map)
+		pw_memmap_free(data.ring_map);
+	free(data.record);
+
 	if (data.profiler) {
 		spa_hook_remove(&data.profiler_listener);
 		pw_proxy_destroy((struct pw_proxy*)data.profiler);
@@ -0,0 +1,132 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <spa/utils/string.h>
+
+#include <pipewire/pipewire.h>
+
+#define MAX_COUNT 100000
+#define MAX_ITEMS 1000
+
+static char keys[MAX_ITEMS][64];
+static char values[MAX_ITEMS][32];
+
+static void gen_values(void)
+{
+	uint32_t i;
+
+	/* keys with a common prefix, like real node properties */
+	for (i = 0; i < MAX_ITEMS; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "node.property.key.%u", i);
+		snprintf(values[i], sizeof(values[i]), "value-%u", i);
+	}
+}
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static struct pw_properties *gen_properties(uint32_t n_items)
+{
+	struct pw_properties *props;
+	uint32_t i;
+
+	props = pw_properties_new(NULL, NULL);
+	spa_assert_se(props != NULL);
+	for (i = 0; i < n_items; i++)
+		pw_properties_set(props, keys[i], values[i]);
+	return props;
+}
+
+static void test_properties(uint32_t n_items)
+{
+	struct pw_properties *props;
+	uint64_t t1, t2, t3, t4;
+	uint32_t i, idx;
+	const char *str;
+
+	props = gen_properties(n_items);
+
+	t1 = get_time();
+	for (i = 0; i < MAX_COUNT; i++) {
+		idx = random() % n_items;
+		str = pw_properties_get(props, keys[idx]);
+		spa_assert_se(spa_streq(str, values[idx]));
+	}
+	t2 = get_time();
+
+	fprintf(stderr, "%4u get elapsed %"PRIu64" count %u = %"PRIu64"/sec\n", n_items,
+			t2 - t1, MAX_COUNT, MAX_COUNT * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1));
+
+	t2 = get_time();
+	for (i = 0; i < MAX_COUNT; i++) {
+		idx = random() % n_items;
+		pw_properties_set(props, keys[idx], (i & 1) ? values[idx] : "changed");
+	}
+	t3 = get_time();
+
+	fprintf(stderr, "%4u set elapsed %"PRIu64" count %u = %"PRIu64"/sec\n", n_items,
+			t3 - t2, MAX_COUNT, MAX_COUNT * (uint64_t)SPA_NSEC_PER_SEC / (t3 - t2));
+
+	t3 = get_time();
+	for (i = 0; i < MAX_COUNT; i++) {
+		idx = random() % n_items;
+		pw_properties_set(props, keys[idx], NULL);
+		pw_properties_set(props, keys[idx], values[idx]);
+	}
+	t4 = get_time();
+
+	fprintf(stderr, "%4u remove/add elapsed %"PRIu64" count %u = %"PRIu64"/sec\n", n_items,
+			t4 - t3, MAX_COUNT, MAX_COUNT * (uint64_t)SPA_NSEC_PER_SEC / (t4 - t3));
+
+	spa_assert_se(props->dict.n_items == n_items);
+	pw_properties_free(props);
+}
+
+int main(int argc, char *argv[])
+{
+	pw_init(&argc, &argv);
+
+	gen_values();
+
+	/* warmup */
+	test_properties(100);
+
+	test_properties(10);
+	test_properties(20);
+	test_properties(50);
+	test_properties(100);
+	test_properties(1000);
+
+	pw_deinit();
+
+	return 0;
+}
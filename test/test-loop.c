@@ -22,6 +22,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -450,6 +451,164 @@ PWTEST(cancel_thread_while_dispatching)
 	return PWTEST_PASS;
 }
 
+#define MT_THREADS	4
+#define MT_ITEMS	2000u
+
+struct mt_data {
+	struct pw_loop *l;
+	uint32_t next[MT_THREADS];
+	uint32_t errors;
+};
+
+struct mt_thread {
+	struct mt_data *data;
+	uint32_t id;
+	pthread_t thread;
+};
+
+static int mt_invoke(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *d, size_t size, void *user_data)
+{
+	struct mt_data *data = user_data;
+	const uint32_t *id = d;
+
+	/* items of one thread are executed in order */
+	if (size != sizeof(uint32_t) || data->next[*id] != seq)
+		data->errors++;
+	data->next[*id] = seq + 1;
+	return 0;
+}
+
+static int mt_check(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *d, size_t size, void *user_data)
+{
+	struct mt_data *data = user_data;
+	const uint32_t *id = d;
+	return data->next[*id];
+}
+
+static void *mt_thread_func(void *user_data)
+{
+	struct mt_thread *t = user_data;
+	struct mt_data *data = t->data;
+	uint32_t i;
+
+	for (i = 0; i < MT_ITEMS;) {
+		if (pw_loop_invoke(data->l, mt_invoke, i, &t->id,
+					sizeof(t->id), false, data) < 0) {
+			usleep(100);
+			continue;
+		}
+		i++;
+	}
+	/* a blocking invoke is executed after all queued items */
+	if (pw_loop_invoke(data->l, mt_check, 0, &t->id, sizeof(t->id), true, data) != MT_ITEMS)
+		__atomic_add_fetch(&data->errors, 1, __ATOMIC_SEQ_CST);
+
+	return NULL;
+}
+
+PWTEST(invoke_multiple_threads)
+{
+	struct mt_data data = { 0 };
+	struct mt_thread threads[MT_THREADS];
+	uint32_t i;
+
+	pw_init(NULL, NULL);
+
+	struct pw_data_loop *dl = pw_data_loop_new(NULL);
+	pwtest_ptr_notnull(dl);
+
+	data.l = pw_data_loop_get_loop(dl);
+	pwtest_ptr_notnull(data.l);
+
+	pwtest_neg_errno_ok(pw_data_loop_start(dl));
+
+	for (i = 0; i < MT_THREADS; i++) {
+		threads[i].data = &data;
+		threads[i].id = i;
+		pwtest_int_eq(pthread_create(&threads[i].thread, NULL,
+					mt_thread_func, &threads[i]), 0);
+	}
+	for (i = 0; i < MT_THREADS; i++)
+		pthread_join(threads[i].thread, NULL);
+
+	pwtest_neg_errno_ok(pw_data_loop_stop(dl));
+
+	for (i = 0; i < MT_THREADS; i++)
+		pwtest_int_eq(data.next[i], (uint32_t)MT_ITEMS);
+	pwtest_int_eq(data.errors, 0u);
+
+	pw_data_loop_destroy(dl);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+struct tl_data {
+	struct pw_thread_loop *tl;
+	struct mt_data *data;
+	uint32_t id;
+	pthread_t thread;
+};
+
+static void *tl_thread_func(void *user_data)
+{
+	struct tl_data *t = user_data;
+	struct mt_data *data = t->data;
+	uint32_t i;
+
+	/* blocking invokes with the thread loop lock held, the loop hooks
+	 * release the lock while waiting for the invoke */
+	for (i = 0; i < MT_ITEMS / 10; i++) {
+		pw_thread_loop_lock(t->tl);
+		if (pw_loop_invoke(data->l, mt_invoke, i, &t->id,
+					sizeof(t->id), true, data) < 0)
+			__atomic_add_fetch(&data->errors, 1, __ATOMIC_SEQ_CST);
+		pw_thread_loop_unlock(t->tl);
+	}
+	return NULL;
+}
+
+PWTEST(invoke_block_thread_loop)
+{
+	struct mt_data data = { 0 };
+	struct tl_data threads[MT_THREADS];
+	struct pw_thread_loop *tl;
+	uint32_t i;
+
+	pw_init(NULL, NULL);
+
+	tl = pw_thread_loop_new("test", NULL);
+	pwtest_ptr_notnull(tl);
+
+	data.l = pw_thread_loop_get_loop(tl);
+	pwtest_neg_errno_ok(pw_thread_loop_start(tl));
+
+	for (i = 0; i < MT_THREADS; i++) {
+		threads[i].tl = tl;
+		threads[i].data = &data;
+		threads[i].id = i;
+		pwtest_int_eq(pthread_create(&threads[i].thread, NULL,
+					tl_thread_func, &threads[i]), 0);
+	}
+	for (i = 0; i < MT_THREADS; i++)
+		pthread_join(threads[i].thread, NULL);
+
+	pw_thread_loop_stop(tl);
+
+	for (i = 0; i < MT_THREADS; i++)
+		pwtest_int_eq(data.next[i], (uint32_t)MT_ITEMS / 10);
+	pwtest_int_eq(data.errors, 0u);
+
+	pw_thread_loop_destroy(tl);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
 PWTEST_SUITE(support)
 {
 	pwtest_add(pwtest_loop_destroy2, PWTEST_NOARG);
@@ -458,6 +617,8 @@ PWTEST_SUITE(support)
 	pwtest_add(destroy_managed_source_before_dispatch, PWTEST_NOARG);
 	pwtest_add(destroy_managed_source_before_dispatch_recurse, PWTEST_NOARG);
 	pwtest_add(cancel_thread_while_dispatching, PWTEST_NOARG);
+	pwtest_add(invoke_multiple_threads, PWTEST_NOARG);
+	pwtest_add(invoke_block_thread_loop, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }
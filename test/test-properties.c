@@ -605,6 +605,111 @@ PWTEST(properties_update)
 	return PWTEST_PASS;
 }
 
+PWTEST(properties_many)
+{
+	struct pw_properties *props;
+	char key[64], val[64];
+	uint32_t i, j, n = 200;
+
+	/* large enough to use the hash index */
+	props = pw_properties_new(NULL, NULL);
+	pwtest_ptr_notnull(props);
+
+	for (i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		snprintf(val, sizeof(val), "%u", i);
+		pwtest_int_eq(pw_properties_set(props, key, val), 1);
+	}
+	pwtest_int_eq(props->dict.n_items, n);
+
+	for (i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		snprintf(val, sizeof(val), "%u", i);
+		pwtest_str_eq(pw_properties_get(props, key), val);
+	}
+	pwtest_ptr_null(pw_properties_get(props, "key.none"));
+
+	/* update every other item */
+	for (i = 0; i < n; i += 2) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		snprintf(val, sizeof(val), "%u", i);
+		pwtest_int_eq(pw_properties_set(props, key, val), 0);
+		pwtest_int_eq(pw_properties_setf(props, key, "new.%u", i), 1);
+	}
+	pwtest_int_eq(props->dict.n_items, n);
+
+	/* remove every third item, the last item moves into the hole and
+	 * the colliding slots are shifted back */
+	for (i = 0; i < n; i += 3) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		pwtest_int_eq(pw_properties_set(props, key, NULL), 1);
+		pwtest_int_eq(pw_properties_set(props, key, NULL), 0);
+
+		for (j = 0; j < n; j++) {
+			snprintf(key, sizeof(key), "key.%u", j);
+			if (j % 3 == 0 && j <= i)
+				pwtest_ptr_null(pw_properties_get(props, key));
+			else
+				pwtest_ptr_notnull(pw_properties_get(props, key));
+		}
+	}
+	pwtest_int_eq(props->dict.n_items, n - (n + 2) / 3);
+
+	for (i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		if (i % 3 == 0) {
+			pwtest_ptr_null(pw_properties_get(props, key));
+			continue;
+		}
+		if (i % 2 == 0)
+			snprintf(val, sizeof(val), "new.%u", i);
+		else
+			snprintf(val, sizeof(val), "%u", i);
+		pwtest_str_eq(pw_properties_get(props, key), val);
+		pwtest_str_eq(spa_dict_lookup(&props->dict, key), val);
+	}
+
+	/* add the removed items again */
+	for (i = 0; i < n; i += 3) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		snprintf(val, sizeof(val), "again.%u", i);
+		pwtest_int_eq(pw_properties_set(props, key, val), 1);
+	}
+	pwtest_int_eq(props->dict.n_items, n);
+
+	for (i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		if (i % 3 == 0)
+			snprintf(val, sizeof(val), "again.%u", i);
+		else if (i % 2 == 0)
+			snprintf(val, sizeof(val), "new.%u", i);
+		else
+			snprintf(val, sizeof(val), "%u", i);
+		pwtest_str_eq(pw_properties_get(props, key), val);
+	}
+
+	/* remove all but a few items, below the index threshold */
+	for (i = 0; i < n - 4; i++) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		pwtest_int_eq(pw_properties_set(props, key, NULL), 1);
+	}
+	pwtest_int_eq(props->dict.n_items, 4U);
+	for (i = n - 4; i < n; i++) {
+		snprintf(key, sizeof(key), "key.%u", i);
+		pwtest_ptr_notnull(pw_properties_get(props, key));
+	}
+
+	pw_properties_clear(props);
+	pwtest_int_eq(props->dict.n_items, 0U);
+	pwtest_ptr_null(pw_properties_get(props, "key.199"));
+	pwtest_int_eq(pw_properties_set(props, "key.199", "x"), 1);
+	pwtest_str_eq(pw_properties_get(props, "key.199"), "x");
+
+	pw_properties_free(props);
+
+	return PWTEST_PASS;
+}
+
 PWTEST_SUITE(properties)
 {
 	pwtest_add(properties_abi, PWTEST_NOARG);
@@ -624,6 +729,7 @@ PWTEST_SUITE(properties)
 	pwtest_add(properties_new_dict, PWTEST_NOARG);
 	pwtest_add(properties_new_json, PWTEST_NOARG);
 	pwtest_add(properties_update, PWTEST_NOARG);
+	pwtest_add(properties_many, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }
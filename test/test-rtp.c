@@ -0,0 +1,328 @@
+/* PipeWire
+ *
+ * Copyright © 2022 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pwtest.h"
+
+#include <math.h>
+
+#include <spa/param/audio/format-utils.h>
+#include <spa/utils/names.h>
+#include <spa/utils/string.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+
+#define RATE		48000
+#define LEVEL		0.25f
+
+/* there is no session manager to configure the ports, use one DSP port
+ * on all nodes so that the links have only one port to pick */
+#define PORT_CONFIG	"{ mode = dsp }"
+
+/* how much signal must arrive at the receiver, 200ms */
+#define WANTED_FRAMES	(RATE / 5)
+#define TIMEOUT_SEC	10
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct pw_core *core;
+
+	struct pw_stream *playback;
+	struct spa_hook playback_listener;
+	struct pw_stream *capture;
+	struct spa_hook capture_listener;
+
+	struct pw_proxy *driver;
+	struct pw_proxy *links[2];
+
+	uint32_t n_ready;
+	uint32_t n_frames;
+	bool linked;
+};
+
+static void link_nodes(struct data *d)
+{
+	static const char * const nodes[][2] = {
+		{ "rtp-test.playback", "rtp-test.sink" },
+		{ "rtp-test.source", "rtp-test.capture" },
+	};
+	struct pw_properties *props;
+	uint32_t i;
+
+	for (i = 0; i < SPA_N_ELEMENTS(nodes); i++) {
+		props = pw_properties_new(
+				PW_KEY_LINK_OUTPUT_NODE, nodes[i][0],
+				PW_KEY_LINK_INPUT_NODE, nodes[i][1],
+				NULL);
+		d->links[i] = pw_core_create_object(d->core, "link-factory",
+				PW_TYPE_INTERFACE_Link, PW_VERSION_LINK,
+				&props->dict, 0);
+		pwtest_ptr_notnull(d->links[i]);
+		pw_properties_free(props);
+	}
+
+	/* all nodes are in the same group and run from this driver, add it
+	 * last so that the links are negotiated before the nodes start */
+	props = pw_properties_new(
+			SPA_KEY_FACTORY_NAME, SPA_NAME_SUPPORT_NODE_DRIVER,
+			PW_KEY_NODE_NAME, "rtp-test.driver",
+			PW_KEY_NODE_GROUP, "rtp-test",
+			PW_KEY_PRIORITY_DRIVER, "1",
+			NULL);
+	d->driver = pw_core_create_object(d->core, "spa-node-factory",
+			PW_TYPE_INTERFACE_Node, PW_VERSION_NODE, &props->dict, 0);
+	pwtest_ptr_notnull(d->driver);
+	pw_properties_free(props);
+
+	d->linked = true;
+}
+
+static void stream_state_changed(void *data, enum pw_stream_state old,
+		enum pw_stream_state state, const char *error)
+{
+	struct data *d = data;
+
+	if (state == PW_STREAM_STATE_ERROR)
+		pwtest_fail_with_msg("stream error: %s", error);
+
+	/* the rtp nodes are exported before our streams, link when both
+	 * our streams are paused */
+	if (state == PW_STREAM_STATE_PAUSED && old < state &&
+	    ++d->n_ready == 2 && !d->linked)
+		link_nodes(d);
+}
+
+static void playback_process(void *data)
+{
+	struct data *d = data;
+	struct pw_buffer *b;
+	struct spa_buffer *buf;
+	float *dst;
+	uint32_t i, n_frames, stride;
+
+	if ((b = pw_stream_dequeue_buffer(d->playback)) == NULL)
+		return;
+
+	buf = b->buffer;
+	if ((dst = buf->datas[0].data) == NULL)
+		return;
+
+	stride = sizeof(float);
+	n_frames = buf->datas[0].maxsize / stride;
+	if (b->requested)
+		n_frames = SPA_MIN(b->requested, n_frames);
+
+	for (i = 0; i < n_frames; i++)
+		dst[i] = LEVEL;
+
+	buf->datas[0].chunk->offset = 0;
+	buf->datas[0].chunk->stride = stride;
+	buf->datas[0].chunk->size = n_frames * stride;
+
+	pw_stream_queue_buffer(d->playback, b);
+}
+
+static void capture_process(void *data)
+{
+	struct data *d = data;
+	struct pw_buffer *b;
+	struct spa_buffer *buf;
+	float *src;
+	uint32_t i, n_frames;
+
+	if ((b = pw_stream_dequeue_buffer(d->capture)) == NULL)
+		return;
+
+	buf = b->buffer;
+	if ((src = buf->datas[0].data) != NULL) {
+		n_frames = buf->datas[0].chunk->size / sizeof(float);
+		src = SPA_PTROFF(src, buf->datas[0].chunk->offset, float);
+
+		/* the receiver plays silence until it is synced, only count
+		 * the frames that carry our signal */
+		for (i = 0; i < n_frames; i++) {
+			if (fabsf(src[i] - LEVEL) < 0.01f)
+				d->n_frames++;
+		}
+	}
+	pw_stream_queue_buffer(d->capture, b);
+
+	if (d->n_frames >= WANTED_FRAMES)
+		pw_main_loop_quit(d->loop);
+}
+
+static const struct pw_stream_events playback_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = stream_state_changed,
+	.process = playback_process,
+};
+
+static const struct pw_stream_events capture_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = stream_state_changed,
+	.process = capture_process,
+};
+
+static struct pw_stream *create_stream(struct data *d, const char *name,
+		enum spa_direction direction, struct spa_hook *listener,
+		const struct pw_stream_events *events)
+{
+	struct pw_stream *stream;
+	const struct spa_pod *params[1];
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	stream = pw_stream_new(d->core, name,
+			pw_properties_new(
+				PW_KEY_MEDIA_TYPE, "Audio",
+				PW_KEY_MEDIA_CATEGORY,
+					direction == SPA_DIRECTION_OUTPUT ?
+					"Playback" : "Capture",
+				PW_KEY_NODE_NAME, name,
+				PW_KEY_NODE_GROUP, "rtp-test",
+				"adapter.auto-port-config", PORT_CONFIG,
+				NULL));
+	pwtest_ptr_notnull(stream);
+	pw_stream_add_listener(stream, listener, events, d);
+
+	params[0] = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat,
+			&SPA_AUDIO_INFO_RAW_INIT(
+				.format = SPA_AUDIO_FORMAT_F32,
+				.rate = RATE,
+				.channels = 1,
+				.position = { SPA_AUDIO_CHANNEL_MONO }));
+
+	pwtest_neg_errno_ok(pw_stream_connect(stream, direction, PW_ID_ANY,
+			PW_STREAM_FLAG_MAP_BUFFERS, params, 1));
+	return stream;
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	pwtest_fail_with_msg("timeout, received %u of %u frames",
+			d->n_frames, WANTED_FRAMES);
+}
+
+static void load_module(struct data *d, const char *name, const char *args)
+{
+	struct pw_impl_module *module;
+
+	module = pw_context_load_module(d->context, name, args, NULL);
+	if (module == NULL)
+		pwtest_error_with_msg("can't load %s: %m", name);
+}
+
+PWTEST(rtp_loopback)
+{
+	struct pw_properties *p = pwtest_get_props(current_test);
+	struct data data = { 0 }, *d = &data;
+	struct spa_source *timer;
+	struct timespec timeout = { TIMEOUT_SEC, 0 }, interval = { 0, 0 };
+	const char *ip, *str;
+	char ifname[64] = "", args[1024];
+	uint32_t i;
+
+	ip = pw_properties_get(p, "ip");
+	if ((str = pw_properties_get(p, "ifname")) != NULL)
+		snprintf(ifname, sizeof(ifname), "local.ifname = %s", str);
+
+	pw_init(0, NULL);
+
+	d->loop = pw_main_loop_new(NULL);
+	pwtest_ptr_notnull(d->loop);
+
+	d->context = pw_context_new(pw_main_loop_get_loop(d->loop),
+			pw_properties_new(
+				PW_KEY_CONFIG_NAME, "null",
+				NULL), 0);
+	pwtest_ptr_notnull(d->context);
+
+	pw_context_add_spa_lib(d->context, "audio.convert.*", "audioconvert/libspa-audioconvert");
+	pw_context_add_spa_lib(d->context, "support.*", "support/libspa-support");
+
+	load_module(d, "libpipewire-module-protocol-native", NULL);
+	load_module(d, "libpipewire-module-client-node", NULL);
+	load_module(d, "libpipewire-module-adapter", NULL);
+	load_module(d, "libpipewire-module-link-factory", NULL);
+	load_module(d, "libpipewire-module-spa-node-factory", NULL);
+
+	d->core = pw_context_connect_self(d->context, NULL, 0);
+	pwtest_ptr_notnull(d->core);
+	/* the rtp modules use this core for their streams */
+	pw_context_set_object(d->context, PW_TYPE_INTERFACE_Core, d->core);
+
+	snprintf(args, sizeof(args),
+			"{ %s source.ip = %s source.port = 46010 "
+			" sess.latency.msec = 20 audio.channels = 1 audio.position = [ MONO ] "
+			" stream.props = { node.name = rtp-test.source node.group = rtp-test "
+			"   adapter.auto-port-config = " PORT_CONFIG " } }",
+			ifname, ip);
+	load_module(d, "libpipewire-module-rtp-source", args);
+
+	snprintf(args, sizeof(args),
+			"{ %s destination.ip = %s destination.port = 46010 "
+			" sap.ip = %s net.loop = true audio.channels = 1 audio.position = [ MONO ] "
+			" stream.props = { node.name = rtp-test.sink node.group = rtp-test "
+			"   adapter.auto-port-config = " PORT_CONFIG " } }",
+			ifname, ip, ip);
+	load_module(d, "libpipewire-module-rtp-sink", args);
+
+	d->playback = create_stream(d, "rtp-test.playback", SPA_DIRECTION_OUTPUT,
+			&d->playback_listener, &playback_events);
+	d->capture = create_stream(d, "rtp-test.capture", SPA_DIRECTION_INPUT,
+			&d->capture_listener, &capture_events);
+
+	timer = pw_loop_add_timer(pw_main_loop_get_loop(d->loop), on_timeout, d);
+	pw_loop_update_timer(pw_main_loop_get_loop(d->loop), timer,
+			&timeout, &interval, false);
+
+	pw_main_loop_run(d->loop);
+
+	pwtest_int_ge(d->n_frames, (uint32_t)WANTED_FRAMES);
+
+	pw_loop_destroy_source(pw_main_loop_get_loop(d->loop), timer);
+	pw_stream_destroy(d->capture);
+	pw_stream_destroy(d->playback);
+	for (i = 0; i < SPA_N_ELEMENTS(d->links); i++)
+		pw_proxy_destroy(d->links[i]);
+	pw_proxy_destroy(d->driver);
+	pw_context_destroy(d->context);
+	pw_main_loop_destroy(d->loop);
+
+	pw_deinit();
+
+	return PWTEST_PASS;
+}
+
+PWTEST_SUITE(rtp)
+{
+	pwtest_add(rtp_loopback, PWTEST_ARG_PROP, "ip", "127.0.0.1");
+	pwtest_add(rtp_loopback,
+			PWTEST_ARG_PROP, "ip", "224.0.0.56",
+			PWTEST_ARG_PROP, "ifname", "lo");
+
+	return PWTEST_PASS;
+}
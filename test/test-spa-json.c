@@ -28,6 +28,7 @@
 
 #include <spa/utils/defs.h>
 #include <spa/utils/json.h>
+#include <spa/utils/json-dom.h>
 #include <spa/utils/string.h>
 
 PWTEST(json_abi)
@@ -318,6 +319,78 @@ PWTEST(json_int)
 	return PWTEST_PASS;
 }
 
+PWTEST(json_dom)
+{
+	struct spa_json_dom dom = { 0 };
+	const struct spa_json_node *root, *n, *m;
+	const char *str = "# comment\n"
+		"context.properties = { a = 1 \"b c\" = [ 1, 2, { x = y } ] }\n"
+		"context.modules = [ { name = foo args = { n = -11 } } ]\n"
+		"z = true z = null";
+	char val[256];
+	int i, len;
+
+	pwtest_int_eq(spa_json_dom_parse(&dom, str, strlen(str)), 0);
+
+	root = spa_json_dom_root(&dom);
+	pwtest_ptr_notnull(root);
+	pwtest_int_eq((int)root->type, SPA_JSON_DOM_OBJECT);
+	pwtest_int_eq(root->n_children, 4u);
+
+	n = spa_json_dom_lookup(&dom, root, "context.properties");
+	pwtest_ptr_notnull(n);
+	pwtest_int_eq((int)n->type, SPA_JSON_DOM_OBJECT);
+	m = spa_json_dom_lookup(&dom, n, "b c");
+	pwtest_ptr_notnull(m);
+	pwtest_int_eq((int)m->type, SPA_JSON_DOM_ARRAY);
+	pwtest_int_eq(m->n_children, 3u);
+	i = 0;
+	spa_json_dom_for_each(&dom, m, n) {
+		pwtest_ptr_null(spa_json_dom_key(&dom, n));
+		pwtest_int_eq((int)n->type, i < 2 ? SPA_JSON_DOM_NUMBER : SPA_JSON_DOM_OBJECT);
+		i++;
+	}
+	pwtest_int_eq(i, 3);
+	pwtest_ptr_null(spa_json_dom_lookup(&dom, m, "x"));
+
+	n = spa_json_dom_lookup(&dom, root, "context.modules");
+	pwtest_ptr_notnull(n);
+	n = spa_json_dom_first(&dom, n);
+	pwtest_ptr_notnull(n);
+	m = spa_json_dom_lookup(&dom, n, "name");
+	pwtest_ptr_notnull(m);
+	pwtest_int_gt(spa_json_dom_get_string(&dom, m, val, sizeof(val)), 0);
+	pwtest_str_eq(val, "foo");
+	m = spa_json_dom_lookup(&dom, n, "args");
+	pwtest_ptr_notnull(m);
+	pwtest_int_gt(spa_json_dom_get_string(&dom, m, val, sizeof(val)), 0);
+	pwtest_str_eq(val, "{ n = -11 }");
+
+	/* the last key wins */
+	n = spa_json_dom_lookup(&dom, root, "z");
+	pwtest_ptr_notnull(n);
+	pwtest_int_eq((int)n->type, SPA_JSON_DOM_NULL);
+	pwtest_ptr_eq(spa_json_dom_value(&dom, n, &len), strstr(str, "null"));
+	pwtest_int_eq(len, 4);
+
+	pwtest_ptr_null(spa_json_dom_lookup(&dom, root, "unknown"));
+
+	spa_json_dom_clear(&dom);
+
+	pwtest_int_eq(spa_json_dom_parse(&dom, "[ a [ b c ] ]", 13), 0);
+	root = spa_json_dom_root(&dom);
+	pwtest_int_eq((int)root->type, SPA_JSON_DOM_ARRAY);
+	pwtest_int_eq(root->len, 13u);
+	pwtest_int_eq(root->n_children, 2u);
+	n = spa_json_dom_next(&dom, spa_json_dom_first(&dom, root));
+	pwtest_ptr_notnull(n);
+	pwtest_int_eq(n->len, 7u);
+	pwtest_ptr_null(spa_json_dom_next(&dom, n));
+	spa_json_dom_clear(&dom);
+
+	return PWTEST_PASS;
+}
+
 PWTEST_SUITE(spa_json)
 {
 	pwtest_add(json_abi, PWTEST_NOARG);
@@ -328,6 +401,7 @@ PWTEST_SUITE(spa_json)
 	pwtest_add(json_float, PWTEST_NOARG);
 	pwtest_add(json_float_check, PWTEST_NOARG);
 	pwtest_add(json_int, PWTEST_NOARG);
+	pwtest_add(json_dom, PWTEST_NOARG);
 
 	return PWTEST_PASS;
 }